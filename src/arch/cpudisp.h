@@ -26,6 +26,7 @@
 #define CPUDISP_H
 
 	#include "variable.h"
+	#include "bitmap.h"
 
 #if defined(__x86_64__)
 #include "cpudisp_amd64.h"
@@ -39,6 +40,7 @@
 	inline static void select_cpu(void)
 	{
 		offmemcmp = offmemcmp_generic;
+		bitcount  = bitcount_generic;
 	}
 #endif
 
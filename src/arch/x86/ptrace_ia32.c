@@ -85,3 +85,103 @@ uintptr_t pt_readreturn_address(pid_t child)
 	sp = ptrace(PTRACE_PEEKUSER, child, 4 * UESP, NULL);
 	return (ptrace(PTRACE_PEEKDATA, child, sp, NULL));
 }
+
+/**
+ * @brief Reads the current stack pointer (ESP in x86) from
+ * the child process.
+ *
+ * @param child Child process.
+ *
+ * @return Returns the child stack pointer.
+ */
+uintptr_t pt_readregister_sp(pid_t child)
+{
+	return (ptrace(PTRACE_PEEKUSER, child, 4 * UESP, NULL));
+}
+
+/**
+ * @brief Considering the child process is at the very first
+ * instruction of a function, retrieves its argument number
+ * @p idx (cdecl: pushed onto the stack, right after the
+ * return address).
+ *
+ * @param child Child process.
+ * @param idx Argument index.
+ *
+ * @return Returns the argument value.
+ */
+uintptr_t pt_readcall_arg(pid_t child, int idx)
+{
+	uintptr_t sp;
+	sp = ptrace(PTRACE_PEEKUSER, child, 4 * UESP, NULL);
+	return (ptrace(PTRACE_PEEKDATA, child, sp + 4 * (idx + 1), NULL));
+}
+
+/**
+ * @brief Reads the integer value returned by a function
+ * (EAX in x86).
+ *
+ * @param child Child process.
+ *
+ * @return Returns the returned value.
+ */
+uintptr_t pt_readreturn_value(pid_t child)
+{
+	return (ptrace(PTRACE_PEEKUSER, child, 4 * EAX, NULL));
+}
+
+/**
+ * @brief Executes a system call inside the child process.
+ *
+ * The instruction at the current program counter is temporarily
+ * replaced by an 'int 0x80' and single-stepped, and then, both
+ * registers and memory are restored, so the child does not
+ * notice anything.
+ *
+ * @param child Child process, must be stopped.
+ * @param number System call number.
+ * @param arg1 First argument.
+ * @param arg2 Second argument.
+ * @param arg3 Third argument.
+ * @param arg4 Fourth argument.
+ * @param arg5 Fifth argument.
+ * @param arg6 Sixth argument.
+ *
+ * @return Returns the system call return value, as seen by the
+ * kernel, i.e: a negative errno if error.
+ */
+long pt_syscall(pid_t child, long number, long arg1, long arg2, long arg3,
+	long arg4, long arg5, long arg6)
+{
+	struct user_regs_struct saved; /* Saved registers.  */
+	struct user_regs_struct regs;  /* Syscall registers. */
+	long insn;                     /* Original insn.     */
+	long ret;                      /* Return value.      */
+
+	if (ptrace(PTRACE_GETREGS, child, NULL, &saved) < 0)
+		return (-1);
+
+	/* int 0x80: CD 80. */
+	insn = pt_readmemory_long(child, saved.eip);
+	pt_writememory_long(child, saved.eip, (insn & ~0xFFFF) | 0x80CD);
+
+	regs = saved;
+	regs.eax = number;
+	regs.ebx = arg1;
+	regs.ecx = arg2;
+	regs.edx = arg3;
+	regs.esi = arg4;
+	regs.edi = arg5;
+	regs.ebp = arg6;
+	ptrace(PTRACE_SETREGS, child, NULL, &regs);
+
+	pt_step_insn(child);
+
+	ptrace(PTRACE_GETREGS, child, NULL, &regs);
+	ret = regs.eax;
+
+	/* Restore everything. */
+	pt_writememory_long(child, saved.eip, insn);
+	ptrace(PTRACE_SETREGS, child, NULL, &saved);
+	return (ret);
+}
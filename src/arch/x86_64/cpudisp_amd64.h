@@ -30,5 +30,9 @@
 		size_t length);
 	int64_t offmemcmp_sse2(void *src, void *dest, size_t block_size,
 		size_t length);
+	size_t bitcount_avx2(void *old, void *new, size_t length,
+		uint64_t *counts);
+	size_t bitcount_sse2(void *old, void *new, size_t length,
+		uint64_t *counts);
 
 #endif /* CPUDISP_AMD64_H */
@@ -116,8 +116,14 @@ void select_cpu(void)
 	/* If AVX2 Enabled. */
 #ifdef CAN_BUILD_AVX2
 	if (supports_avx2())
+	{
 		offmemcmp = offmemcmp_avx2;
+		bitcount  = bitcount_avx2;
+	}
 	else
 #endif
+	{
 		offmemcmp = offmemcmp_sse2;
+		bitcount  = bitcount_sse2;
+	}
 }
@@ -85,3 +85,103 @@ uintptr_t pt_readreturn_address(pid_t child)
 	sp = ptrace(PTRACE_PEEKUSER, child, 8 * RSP, NULL);
 	return (ptrace(PTRACE_PEEKDATA, child, sp, NULL));
 }
+
+/**
+ * @brief Reads the current stack pointer (RSP in x86_64) from
+ * the child process.
+ *
+ * @param child Child process.
+ *
+ * @return Returns the child stack pointer.
+ */
+uintptr_t pt_readregister_sp(pid_t child)
+{
+	return (ptrace(PTRACE_PEEKUSER, child, 8 * RSP, NULL));
+}
+
+/**
+ * @brief Considering the child process is at the very first
+ * instruction of a function, retrieves its integer argument
+ * number @p idx (System V ABI: RDI, RSI, RDX, RCX, R8, R9).
+ *
+ * @param child Child process.
+ * @param idx Argument index, from 0 to 5.
+ *
+ * @return Returns the argument value.
+ */
+uintptr_t pt_readcall_arg(pid_t child, int idx)
+{
+	static const int regs[] = {RDI, RSI, RDX, RCX, R8, R9};
+	if (idx < 0 || idx > 5)
+		return (0);
+	return (ptrace(PTRACE_PEEKUSER, child, 8 * regs[idx], NULL));
+}
+
+/**
+ * @brief Reads the integer value returned by a function
+ * (RAX in x86_64).
+ *
+ * @param child Child process.
+ *
+ * @return Returns the returned value.
+ */
+uintptr_t pt_readreturn_value(pid_t child)
+{
+	return (ptrace(PTRACE_PEEKUSER, child, 8 * RAX, NULL));
+}
+
+/**
+ * @brief Executes a system call inside the child process.
+ *
+ * The instruction at the current program counter is temporarily
+ * replaced by a 'syscall' and single-stepped, and then, both
+ * registers and memory are restored, so the child does not
+ * notice anything.
+ *
+ * @param child Child process, must be stopped.
+ * @param number System call number.
+ * @param arg1 First argument.
+ * @param arg2 Second argument.
+ * @param arg3 Third argument.
+ * @param arg4 Fourth argument.
+ * @param arg5 Fifth argument.
+ * @param arg6 Sixth argument.
+ *
+ * @return Returns the system call return value, as seen by the
+ * kernel, i.e: a negative errno if error.
+ */
+long pt_syscall(pid_t child, long number, long arg1, long arg2, long arg3,
+	long arg4, long arg5, long arg6)
+{
+	struct user_regs_struct saved; /* Saved registers.  */
+	struct user_regs_struct regs;  /* Syscall registers. */
+	long insn;                     /* Original insn.     */
+	long ret;                      /* Return value.      */
+
+	if (ptrace(PTRACE_GETREGS, child, NULL, &saved) < 0)
+		return (-1);
+
+	/* syscall: 0F 05. */
+	insn = pt_readmemory_long(child, saved.rip);
+	pt_writememory_long(child, saved.rip, (insn & ~0xFFFF) | 0x050F);
+
+	regs = saved;
+	regs.rax = number;
+	regs.rdi = arg1;
+	regs.rsi = arg2;
+	regs.rdx = arg3;
+	regs.r10 = arg4;
+	regs.r8  = arg5;
+	regs.r9  = arg6;
+	ptrace(PTRACE_SETREGS, child, NULL, &regs);
+
+	pt_step_insn(child);
+
+	ptrace(PTRACE_GETREGS, child, NULL, &regs);
+	ret = regs.rax;
+
+	/* Restore everything. */
+	pt_writememory_long(child, saved.rip, insn);
+	ptrace(PTRACE_SETREGS, child, NULL, &saved);
+	return (ret);
+}
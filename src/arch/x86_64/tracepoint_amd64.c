@@ -0,0 +1,973 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Fast tracepoints (x86_64).
+ *
+ * Every breakpoint costs, at least, two context switches and a
+ * handful of ptrace() calls, even if nothing has changed since the
+ * last line, which is the common case. Fast tracepoints avoid
+ * this by moving the 'did something change?' question to the
+ * child process itself:
+ *
+ * - A single RWX page is mapped (via an injected mmap) near the
+ *   target function, holding a small control block, a shadow copy
+ *   of all the watched variables, a 'checker' routine and one
+ *   trampoline per line.
+ *
+ * - The first instruction(s) of each eligible line are replaced
+ *   by a 'jmp rel32' to its trampoline, which saves the scratch
+ *   registers, calls the checker and only executes an int3 if any
+ *   variable differs from its shadow copy. Then, the line id is
+ *   saved in the control block, the relocated instructions are
+ *   executed and the execution jumps back to the function.
+ *
+ * - When PBD sees a trap inside a trampoline, it handles it just
+ *   like a regular breakpoint (using the line saved in the control
+ *   block as the previous line) and updates the shadow copy.
+ *
+ * Lines that cannot be safely patched (function entry, possible
+ * return addresses, branches inside the patched area...) keep
+ * using regular breakpoints.
+ */
+
+#define _GNU_SOURCE
+#include "tracepoint.h"
+#include "dwarf_helper.h"
+#include "insn.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <limits.h>
+
+#if !defined(__x86_64__)
+	#error "tracepoint_amd64.c should only be included on x86_64 builds!"
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/* 'jmp rel32' size. */
+#define TP_JMP_SIZE 5
+
+/* Red zone size, as defined by the System V AMD64 ABI. */
+#define TP_RED_ZONE 128
+
+/* Control block layout. */
+#define TP_CTL_LAST_LINE 0
+#define TP_CTL_FORCE     4
+#define TP_CTL_SIZE      16
+
+/* Worst case sizes, used to compute the page size. */
+#define TP_CHECKER_SIZE    32
+#define TP_CHECKER_VAR     48
+#define TP_TRAMPOLINE_SIZE (48 + TP_JMP_SIZE - 1 + INSN_MAX_LEN)
+
+/* Max distance between the page and the function. */
+#define TP_MAX_DISTANCE (INT32_MAX - (16 << 20))
+
+/* Per-byte attributes of the function code. */
+#define TP_INSN    0x01 /* Instruction start.         */
+#define TP_TARGET  0x02 /* Branch target.             */
+#define TP_RETADDR 0x04 /* Possible return address.   */
+#define TP_BRANCH  0x08 /* Control transfer.          */
+#define TP_BP      0x10 /* Breakpoint address.        */
+
+/**
+ * @brief Tracepoint, one per line breakpoint.
+ */
+struct tracepoint
+{
+	struct breakpoint *bp; /* Line breakpoint.                     */
+	uint32_t id;           /* Line id, as seen by the trampolines. */
+	size_t patch_size;     /* Patched bytes, 0 if not patched.     */
+	uintptr_t stub;        /* Trampoline address.                  */
+	uintptr_t trap;        /* int3 address, inside trampoline.     */
+};
+
+/**
+ * @brief Code being generated.
+ */
+struct tp_code
+{
+	uint8_t *buf;     /* Code buffer.               */
+	size_t size;      /* Current size.              */
+	uintptr_t base;   /* Buffer address, in child.  */
+};
+
+/* Tracepoints, by line address, trap address and id. */
+static struct hashtable *tp_lines;
+static struct hashtable *tp_traps;
+static struct array *tp_ids;
+
+/* Injected page. */
+static uintptr_t tp_page;
+static uintptr_t tp_shadow;
+static size_t tp_shadow_size;
+static uint8_t *tp_shadow_buf;
+
+/* Shadow offset for each variable, SIZE_MAX if not watched. */
+static size_t *tp_offsets;
+static size_t tp_nvars;
+
+/* Shadow copy needs to be refreshed. */
+static int tp_stale;
+
+/* ------------------------------------------------------------------------*
+ * Code emission                                                           *
+ * ------------------------------------------------------------------------*/
+
+static inline uintptr_t code_pc(struct tp_code *c)
+{
+	return (c->base + c->size);
+}
+
+static inline void emit8(struct tp_code *c, uint8_t b)
+{
+	c->buf[c->size++] = b;
+}
+
+static inline void emit_bytes(struct tp_code *c, const uint8_t *b, size_t n)
+{
+	memcpy(c->buf + c->size, b, n);
+	c->size += n;
+}
+
+static inline void emit32(struct tp_code *c, uint32_t v)
+{
+	for (int i = 0; i < 4; i++)
+		emit8(c, (v >> (i * 8)) & 0xFF);
+}
+
+static inline void emit64(struct tp_code *c, uint64_t v)
+{
+	for (int i = 0; i < 8; i++)
+		emit8(c, (v >> (i * 8)) & 0xFF);
+}
+
+/**
+ * @brief Emits a 32-bit displacement relative to the end of the
+ * instruction, i.e: after the displacement and more @p trailing
+ * bytes.
+ */
+static inline void emit_rel32(struct tp_code *c, uintptr_t target,
+	int trailing)
+{
+	emit32(c, (uint32_t)(int32_t)(target - (code_pc(c) + 4 + trailing)));
+}
+
+/**
+ * @brief Patches a previously emitted 'jcc rel32' displacement at
+ * @p pos to point to the current position.
+ */
+static inline void fix_rel32(struct tp_code *c, size_t pos)
+{
+	uint32_t rel = (uint32_t)(c->size - (pos + 4));
+	memcpy(c->buf + pos, &rel, 4);
+}
+
+/**
+ * @brief Checks if the variable @p v can be watched by the
+ * checker, i.e: the same types var_check_changes() supports.
+ */
+static int tp_var_supported(struct dw_variable *v)
+{
+	if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+		return (v->byte_size <= 8 || v->byte_size == 12 ||
+			v->byte_size == 16);
+
+	if (v->type.var_type == TARRAY)
+		return (!!(v->type.array.var_type & (TBASE_TYPE|TENUM|TPOINTER)));
+
+	return (0);
+}
+
+/**
+ * @brief Emits the checker routine, that compares all the watched
+ * variables against its shadow copies.
+ *
+ * Returns (in al) 1 if something differs (or if a check was forced)
+ * and 0 otherwise. Clobbers rax, rcx, rsi, rdi and flags.
+ *
+ * @param c Code buffer.
+ * @param vars Variables list.
+ */
+static void tp_emit_checker(struct tp_code *c, struct array *vars)
+{
+	size_t *fixups;   /* jne displacements. */
+	size_t nfixups;   /* Amount of fixups.  */
+
+	fixups = calloc(2 * tp_nvars + 1, sizeof(size_t));
+	nfixups = 0;
+
+	/* cld. */
+	emit8(c, 0xFC);
+
+	/* cmp byte [rip+force], 0 ; jne changed. */
+	emit8(c, 0x80); emit8(c, 0x3D);
+	emit_rel32(c, tp_page + TP_CTL_FORCE, 1);
+	emit8(c, 0x00);
+	emit8(c, 0x0F); emit8(c, 0x85);
+	fixups[nfixups++] = c->size;
+	emit32(c, 0);
+
+	for (size_t i = 0; i < tp_nvars; i++)
+	{
+		struct dw_variable *v;
+		uintptr_t shadow;
+
+		if (tp_offsets[i] == SIZE_MAX)
+			continue;
+
+		v = array_get(&vars, i, NULL);
+		shadow = tp_shadow + tp_offsets[i];
+
+		/* rsi = variable address. */
+		if (v->scope == VLOCAL)
+		{
+			/* lea rsi, [rbp+disp32]. */
+			emit8(c, 0x48); emit8(c, 0x8D); emit8(c, 0xB5);
+			emit32(c, (uint32_t)(int32_t)v->location.fp_offset);
+		}
+		else if (v->location.address <= UINT32_MAX)
+		{
+			/* mov esi, imm32. */
+			emit8(c, 0xBE);
+			emit32(c, v->location.address);
+		}
+		else
+		{
+			/* mov rsi, imm64. */
+			emit8(c, 0x48); emit8(c, 0xBE);
+			emit64(c, v->location.address);
+		}
+
+		switch (v->byte_size)
+		{
+			/* mov al, [rsi] ; cmp al, [rip+shadow]. */
+			case 1:
+				emit_bytes(c, (const uint8_t[]){0x8A, 0x06, 0x3A, 0x05}, 4);
+				emit_rel32(c, shadow, 0);
+				break;
+
+			/* mov ax, [rsi] ; cmp ax, [rip+shadow]. */
+			case 2:
+				emit_bytes(c,
+					(const uint8_t[]){0x66, 0x8B, 0x06, 0x66, 0x3B, 0x05}, 6);
+				emit_rel32(c, shadow, 0);
+				break;
+
+			/* mov eax, [rsi] ; cmp eax, [rip+shadow]. */
+			case 4:
+				emit_bytes(c, (const uint8_t[]){0x8B, 0x06, 0x3B, 0x05}, 4);
+				emit_rel32(c, shadow, 0);
+				break;
+
+			/* mov rax, [rsi] ; cmp rax, [rip+shadow]. */
+			case 8:
+				emit_bytes(c,
+					(const uint8_t[]){0x48, 0x8B, 0x06, 0x48, 0x3B, 0x05}, 6);
+				emit_rel32(c, shadow, 0);
+				break;
+
+			/* Arrays and others: repe cmps{q,b}. */
+			default:
+				/* lea rdi, [rip+shadow]. */
+				emit_bytes(c, (const uint8_t[]){0x48, 0x8D, 0x3D}, 3);
+				emit_rel32(c, shadow, 0);
+
+				if (v->byte_size >= 8)
+				{
+					/* mov ecx, n ; repe cmpsq. */
+					emit8(c, 0xB9);
+					emit32(c, v->byte_size / 8);
+					emit_bytes(c, (const uint8_t[]){0xF3, 0x48, 0xA7}, 3);
+
+					if (!(v->byte_size % 8))
+						break;
+
+					/* jne changed. */
+					emit8(c, 0x0F); emit8(c, 0x85);
+					fixups[nfixups++] = c->size;
+					emit32(c, 0);
+				}
+
+				/* mov ecx, n ; repe cmpsb. */
+				emit8(c, 0xB9);
+				emit32(c, v->byte_size % 8);
+				emit_bytes(c, (const uint8_t[]){0xF3, 0xA6}, 2);
+				break;
+		}
+
+		/* jne changed. */
+		emit8(c, 0x0F); emit8(c, 0x85);
+		fixups[nfixups++] = c->size;
+		emit32(c, 0);
+	}
+
+	/* xor eax, eax ; ret. */
+	emit_bytes(c, (const uint8_t[]){0x31, 0xC0, 0xC3}, 3);
+
+	/* changed: mov al, 1 ; ret. */
+	for (size_t i = 0; i < nfixups; i++)
+		fix_rel32(c, fixups[i]);
+
+	emit_bytes(c, (const uint8_t[]){0xB0, 0x01, 0xC3}, 3);
+	free(fixups);
+}
+
+/**
+ * @brief Emits the trampoline for the tracepoint @p tp.
+ *
+ * @param c Code buffer.
+ * @param tp Tracepoint.
+ * @param code Original function code.
+ * @param low_pc Function start address.
+ * @param checker Checker routine address.
+ *
+ * @return Returns 0 if success and a negative number if the
+ * original instructions could not be relocated.
+ */
+static int tp_emit_trampoline(struct tp_code *c, struct tracepoint *tp,
+	const uint8_t *code, uintptr_t low_pc, uintptr_t checker)
+{
+	struct insn insn;  /* Relocated instruction. */
+	size_t start;      /* Trampoline start.      */
+	size_t off;        /* Instruction offset.    */
+
+	start = c->size;
+	tp->stub = code_pc(c);
+
+	/* lea rsp, [rsp-128] ; pushfq ; push rax, rcx, rsi, rdi. */
+	emit_bytes(c, (const uint8_t[]){0x48, 0x8D, 0x64, 0x24,
+		(uint8_t)-TP_RED_ZONE, 0x9C, 0x50, 0x51, 0x56, 0x57}, 10);
+
+	/* call checker. */
+	emit8(c, 0xE8);
+	emit_rel32(c, checker, 0);
+
+	/* test al, al ; jz +1 ; int3. */
+	emit_bytes(c, (const uint8_t[]){0x84, 0xC0, 0x74, 0x01}, 4);
+	tp->trap = code_pc(c);
+	emit8(c, BP_OPCODE);
+
+	/* mov dword [rip+last_line], id. */
+	emit8(c, 0xC7); emit8(c, 0x05);
+	emit_rel32(c, tp_page + TP_CTL_LAST_LINE, 4);
+	emit32(c, tp->id);
+
+	/* pop rdi, rsi, rcx, rax ; popfq ; lea rsp, [rsp+128]. */
+	emit_bytes(c, (const uint8_t[]){0x5F, 0x5E, 0x59, 0x58, 0x9D,
+		0x48, 0x8D, 0xA4, 0x24, TP_RED_ZONE, 0x00, 0x00, 0x00}, 13);
+
+	/* Relocated instructions. */
+	off = tp->bp->addr - low_pc;
+	for (size_t len = 0; len < tp->patch_size; len += insn.length)
+	{
+		insn_decode(code + off + len, INSN_MAX_LEN, tp->bp->addr + len,
+			INSN_MODE64, &insn);
+
+		if (insn.flags & INSN_RIPREL)
+		{
+			int32_t disp;
+			int64_t target;
+			int64_t new_disp;
+
+			memcpy(&disp, code + off + len + insn.disp_off, 4);
+			target = (int64_t)(insn.addr + insn.length) + disp;
+			new_disp = target - (int64_t)(code_pc(c) + insn.length);
+
+			if (new_disp < INT32_MIN || new_disp > INT32_MAX)
+			{
+				c->size = start;
+				return (-1);
+			}
+
+			disp = (int32_t)new_disp;
+			emit_bytes(c, code + off + len, insn.length);
+			memcpy(c->buf + c->size - insn.length + insn.disp_off, &disp, 4);
+		}
+		else
+			emit_bytes(c, code + off + len, insn.length);
+	}
+
+	/* jmp back. */
+	emit8(c, 0xE9);
+	emit_rel32(c, tp->bp->addr + tp->patch_size, 0);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------*
+ * Function analysis                                                       *
+ * ------------------------------------------------------------------------*/
+
+/**
+ * @brief Decodes the whole function and marks, for each byte,
+ * whether it is an instruction start, a branch target or a
+ * possible return address.
+ *
+ * @param code Function code.
+ * @param size Function size.
+ * @param low_pc Function address.
+ * @param attrs Attributes, one per byte.
+ *
+ * @return Returns 0 if success, or a negative number if the
+ * function cannot be patched at all.
+ */
+static int tp_analyze(const uint8_t *code, size_t size, uintptr_t low_pc,
+	uint8_t *attrs)
+{
+	struct insn insn; /* Current instruction. */
+	size_t off;       /* Current offset.      */
+
+	for (off = 0; off < size; off += insn.length)
+	{
+		if (insn_decode(code + off, size - off, low_pc + off,
+			INSN_MODE64, &insn) < 0)
+		{
+			fprintf(stderr, "PBD: fast tracepoints: unknown instruction "
+				"at %" PRIxPTR "\n", low_pc + off);
+			return (-1);
+		}
+
+		attrs[off] |= TP_INSN;
+		if (!(insn.flags & INSN_BRANCH))
+			continue;
+
+		attrs[off] |= TP_BRANCH;
+
+		/*
+		 * Jump tables (and friends) may target anywhere, so it is
+		 * not safe to patch anything.
+		 */
+		if ((insn.flags & INSN_INDIRECT) && !(insn.flags & INSN_CALL))
+		{
+			fprintf(stderr, "PBD: fast tracepoints: indirect jump found "
+				"at %" PRIxPTR "\n", low_pc + off);
+			return (-1);
+		}
+
+		if ((insn.flags & INSN_RELATIVE) && insn.target >= low_pc &&
+			insn.target < low_pc + size)
+			attrs[insn.target - low_pc] |= TP_TARGET;
+
+		/*
+		 * Recursive (or possibly recursive) calls: the return address
+		 * will hold a breakpoint, see do_analysis().
+		 */
+		if ((insn.flags & INSN_CALL) && off + insn.length < size &&
+			((insn.flags & INSN_INDIRECT) || insn.target == low_pc))
+			attrs[off + insn.length] |= TP_RETADDR;
+	}
+	return (0);
+}
+
+/**
+ * @brief Gets the amount of bytes that need to be relocated in
+ * order to patch the line at offset @p off.
+ *
+ * @param code Function code.
+ * @param size Function size.
+ * @param attrs Code attributes.
+ * @param off Line offset.
+ *
+ * @return Returns the amount of bytes or 0 if the line cannot
+ * be patched.
+ */
+static size_t tp_patch_size(const uint8_t *code, size_t size,
+	const uint8_t *attrs, size_t off)
+{
+	struct insn insn; /* Current instruction. */
+	size_t len;       /* Patched size.        */
+
+	if (!(attrs[off] & TP_INSN) || (attrs[off] & TP_RETADDR))
+		return (0);
+
+	for (len = 0; len < TP_JMP_SIZE; len += insn.length)
+	{
+		if (off + len >= size)
+			return (0);
+
+		/* Nothing may jump (or return) into the patched area. */
+		if (len && (attrs[off + len] & (TP_TARGET|TP_RETADDR|TP_BP)))
+			return (0);
+
+		if (attrs[off + len] & TP_BRANCH)
+			return (0);
+
+		insn_decode(code + off + len, size - off - len, 0, INSN_MODE64, &insn);
+	}
+
+	return (off + len <= size ? len : 0);
+}
+
+/**
+ * @brief Finds a free address, near the target function, in order
+ * to map the tracepoints page.
+ *
+ * Gaps below the function are preferred, since the area right
+ * after the executable is usually reserved for the heap.
+ *
+ * @param child Child process.
+ * @param low_pc Function start.
+ * @param high_pc Function end.
+ * @param size Page size.
+ *
+ * @return Returns the address found or 0 if none.
+ */
+static uintptr_t tp_find_gap(pid_t child, uintptr_t low_pc,
+	uintptr_t high_pc, size_t size)
+{
+	char path[64];        /* Maps path.        */
+	char line[512];       /* Current line.     */
+	uintptr_t prev_end;   /* Previous end.     */
+	uintptr_t below;      /* Best gap below.   */
+	uintptr_t above;      /* Best gap above.   */
+	uintptr_t start, end; /* Mapping range.    */
+	FILE *fp;             /* Maps file.        */
+
+	snprintf(path, sizeof(path), "/proc/%d/maps", child);
+	if ((fp = fopen(path, "r")) == NULL)
+		return (0);
+
+	prev_end = 0x10000;
+	below = 0;
+	above = 0;
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR, &start, &end) != 2)
+			continue;
+
+		/* Gap: [prev_end, start). */
+		if (start > prev_end && start - prev_end >= size)
+		{
+			/* Highest address below the function. */
+			if (start <= low_pc)
+			{
+				uintptr_t addr = (start - size) & ~((uintptr_t)0xFFF);
+				if (addr >= prev_end && high_pc - addr < TP_MAX_DISTANCE)
+					below = addr;
+			}
+
+			/* Lowest address above the function. */
+			else if (prev_end > high_pc && !above)
+			{
+				uintptr_t addr = (prev_end + 0xFFF) & ~((uintptr_t)0xFFF);
+				if (addr + size <= start && addr + size - low_pc < TP_MAX_DISTANCE)
+					above = addr;
+			}
+		}
+
+		if (end > prev_end)
+			prev_end = end;
+	}
+
+	fclose(fp);
+	return (below ? below : above);
+}
+
+/* ------------------------------------------------------------------------*
+ * Public routines                                                         *
+ * ------------------------------------------------------------------------*/
+
+/**
+ * @brief Initializes the fast tracepoints for the function
+ * [@p low_pc, @p high_pc]: injects the tracepoints page into the
+ * child and patches all eligible lines.
+ *
+ * Must be called after the breakpoints were inserted.
+ *
+ * @param child Child process.
+ * @param breakpoints Breakpoints list.
+ * @param vars Variables list, first context.
+ * @param low_pc Function start.
+ * @param high_pc Function end (inclusive).
+ *
+ * @return Returns the amount of lines patched or a negative number
+ * if error.
+ */
+int tp_init(pid_t child, struct hashtable *breakpoints,
+	struct array *vars, uintptr_t low_pc, uintptr_t high_pc)
+{
+	struct breakpoint *b_k;   /* Breakpoint key.        */
+	struct breakpoint *b_v;   /* Breakpoint value.      */
+	struct tracepoint *tp;    /* Current tracepoint.    */
+	struct tp_code c;         /* Generated code.        */
+	uint8_t *code;            /* Function code.         */
+	uint8_t *attrs;           /* Code attributes.       */
+	uintptr_t checker;        /* Checker address.       */
+	size_t size;              /* Function size.         */
+	size_t page_size;         /* Page size.             */
+	long ret;                 /* Syscall return.        */
+	int patched;              /* Patched lines.         */
+	((void)b_k);
+
+	size = high_pc - low_pc + 1;
+	patched = 0;
+
+	/* Original code, without our breakpoints. */
+	if ((code = (uint8_t *)pt_readmemory(child, low_pc, size)) == NULL)
+		return (-1);
+
+	attrs = calloc(size, sizeof(uint8_t));
+
+	HASHTABLE_FOREACH(breakpoints, b_k, b_v,
+	{
+		if (b_v->addr >= low_pc && b_v->addr <= high_pc)
+		{
+			code[b_v->addr - low_pc] = b_v->original_byte;
+			attrs[b_v->addr - low_pc] |= TP_BP;
+		}
+	});
+
+	if (tp_analyze(code, size, low_pc, attrs) < 0)
+		goto err0;
+
+	/* Shadow layout. */
+	tp_nvars = array_size(&vars);
+	tp_offsets = malloc(sizeof(size_t) * (tp_nvars + 1));
+	tp_shadow_size = 0;
+
+	for (size_t i = 0; i < tp_nvars; i++)
+	{
+		struct dw_variable *v = array_get(&vars, i, NULL);
+		tp_offsets[i] = SIZE_MAX;
+
+		if (!tp_var_supported(v))
+			continue;
+
+		tp_offsets[i] = tp_shadow_size;
+		tp_shadow_size += (v->byte_size + 7) & ~7;
+	}
+
+	/* Tracepoints, one per line. */
+	hashtable_init(&tp_lines, NULL);
+	hashtable_init(&tp_traps, NULL);
+	array_init(&tp_ids);
+
+	HASHTABLE_FOREACH(breakpoints, b_k, b_v,
+	{
+		tp = calloc(1, sizeof(struct tracepoint));
+		tp->bp = b_v;
+		array_add(&tp_ids, tp);
+		tp->id = array_size(&tp_ids);
+		hashtable_add(&tp_lines, (void *)b_v->addr, tp);
+
+		/* The function entry should always trap, see do_analysis(). */
+		if (b_v->addr > low_pc && b_v->addr <= high_pc)
+			tp->patch_size = tp_patch_size(code, size, attrs,
+				b_v->addr - low_pc);
+	});
+
+	/* Page: control block, shadow, checker and trampolines. */
+	page_size = TP_CTL_SIZE + tp_shadow_size + TP_CHECKER_SIZE +
+		TP_CHECKER_VAR * tp_nvars + TP_TRAMPOLINE_SIZE * array_size(&tp_ids);
+	page_size = (page_size + 0xFFF) & ~((size_t)0xFFF);
+
+	if ((tp_page = tp_find_gap(child, low_pc, high_pc, page_size)) == 0)
+	{
+		fprintf(stderr, "PBD: fast tracepoints: no room near the function!\n");
+		goto err0;
+	}
+
+	ret = pt_syscall(child, SYS_mmap, tp_page, page_size,
+		PROT_READ|PROT_WRITE|PROT_EXEC,
+		MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED_NOREPLACE, -1, 0);
+
+	if ((uintptr_t)ret != tp_page)
+	{
+		fprintf(stderr, "PBD: fast tracepoints: unable to map page "
+			"(%ld)\n", ret);
+		goto err0;
+	}
+
+	tp_shadow = tp_page + TP_CTL_SIZE;
+	tp_shadow_buf = calloc(1, tp_shadow_size + 1);
+
+	/* Generate code. */
+	c.buf  = calloc(1, page_size);
+	c.base = tp_page;
+	c.size = TP_CTL_SIZE + tp_shadow_size;
+
+	checker = code_pc(&c);
+	tp_emit_checker(&c, vars);
+
+	for (size_t i = 0; i < array_size(&tp_ids); i++)
+	{
+		tp = array_get(&tp_ids, i, NULL);
+		if (!tp->patch_size)
+			continue;
+
+		if (tp_emit_trampoline(&c, tp, code, low_pc, checker) < 0)
+		{
+			tp->patch_size = 0;
+			continue;
+		}
+		hashtable_add(&tp_traps, (void *)tp->trap, tp);
+	}
+
+	pt_writememory(child, tp_page, (char *)c.buf, c.size);
+	free(c.buf);
+
+	/* Patch lines. */
+	for (size_t i = 0; i < array_size(&tp_ids); i++)
+	{
+		uint8_t jmp[INSN_MAX_LEN + TP_JMP_SIZE];
+		int32_t rel;
+
+		tp = array_get(&tp_ids, i, NULL);
+		if (!tp->patch_size)
+			continue;
+
+		rel = (int32_t)(tp->stub - (tp->bp->addr + TP_JMP_SIZE));
+		memset(jmp, 0x90, sizeof(jmp));
+		jmp[0] = 0xE9;
+		memcpy(jmp + 1, &rel, 4);
+
+		pt_writememory(child, tp->bp->addr, (char *)jmp, tp->patch_size);
+		patched++;
+	}
+
+	free(attrs);
+	free(code);
+	return (patched);
+
+err0:
+	free(attrs);
+	free(code);
+	tp_finish();
+	return (-1);
+}
+
+/**
+ * @brief Given the address @p pc of a trap, checks if it belongs
+ * to a trampoline.
+ *
+ * @param pc Trap address.
+ *
+ * @return Returns the line breakpoint if the trap belongs to
+ * a trampoline, or NULL otherwise.
+ */
+struct breakpoint *tp_find(uintptr_t pc)
+{
+	struct tracepoint *tp;
+
+	if (tp_traps == NULL)
+		return (NULL);
+
+	tp = hashtable_get(&tp_traps, (void *)pc);
+	return (tp ? tp->bp : NULL);
+}
+
+/**
+ * @brief Gets the last line executed, as seen by the control
+ * block.
+ *
+ * @param child Child process.
+ *
+ * @return Returns the last line breakpoint or NULL if none.
+ */
+struct breakpoint *tp_last_line(pid_t child)
+{
+	struct tracepoint *tp;
+	uint32_t id;
+
+	id = pt_readmemory_long(child, tp_page + TP_CTL_LAST_LINE) & 0xFFFFFFFF;
+	if (id == 0 || id > array_size(&tp_ids))
+		return (NULL);
+
+	tp = array_get(&tp_ids, id - 1, NULL);
+	return (tp->bp);
+}
+
+/**
+ * @brief Forces the next line to trap, regardless of changes.
+ *
+ * This is necessary whenever the current function context
+ * changes (function entry and return), since the shadow copy
+ * belongs to the previous context.
+ *
+ * @param child Child process.
+ * @param bp If not NULL, also sets the last line executed.
+ */
+void tp_force(pid_t child, struct breakpoint *bp)
+{
+	struct tracepoint *tp;
+	uint8_t ctl[8] = {0};
+
+	tp = bp ? hashtable_get(&tp_lines, (void *)bp->addr) : NULL;
+	if (tp)
+	{
+		memcpy(ctl + TP_CTL_LAST_LINE, &tp->id, 4);
+		ctl[TP_CTL_FORCE] = 1;
+		pt_writememory(child, tp_page, (char *)ctl, sizeof(ctl));
+	}
+	else
+	{
+		ctl[TP_CTL_FORCE] = 1;
+		pt_writememory(child, tp_page + TP_CTL_FORCE,
+			(char *)ctl + TP_CTL_FORCE, 1);
+	}
+	tp_stale = 1;
+}
+
+/**
+ * @brief Updates the shadow copy (if necessary) and the control
+ * block after a line has been checked.
+ *
+ * @param child Child process.
+ * @param vars Variables list, current context.
+ * @param bp Line breakpoint, if a regular breakpoint, or NULL
+ * if a trampoline trap.
+ * @param dirty If the variables have changed since the last update.
+ */
+void tp_update(pid_t child, struct array *vars, struct breakpoint *bp,
+	int dirty)
+{
+	struct tracepoint *tp;
+	uint8_t ctl[8] = {0};
+
+	/* Shadow copy. */
+	if (dirty || tp_stale || !bp)
+	{
+		for (size_t i = 0; i < tp_nvars; i++)
+		{
+			struct dw_variable *v;
+			uint8_t *dst;
+
+			if (tp_offsets[i] == SIZE_MAX)
+				continue;
+
+			v = array_get(&vars, i, NULL);
+			dst = tp_shadow_buf + tp_offsets[i];
+
+			if (v->type.var_type == TARRAY)
+			{
+				if (v->value.p_value)
+					memcpy(dst, v->value.p_value, v->byte_size);
+			}
+			else if (v->initialized)
+				memcpy(dst, v->value.u8_value, v->byte_size);
+			else
+				memcpy(dst, v->scratch_value.u8_value, v->byte_size);
+		}
+		pt_writememory(child, tp_shadow, (char *)tp_shadow_buf, tp_shadow_size);
+		tp_stale = 0;
+	}
+
+	/*
+	 * Trampolines sets the line by themselves, so only the force
+	 * flag needs to be cleared.
+	 */
+	tp = bp ? hashtable_get(&tp_lines, (void *)bp->addr) : NULL;
+	if (tp)
+	{
+		memcpy(ctl + TP_CTL_LAST_LINE, &tp->id, 4);
+		pt_writememory(child, tp_page, (char *)ctl, sizeof(ctl));
+	}
+	else
+		pt_writememory(child, tp_page + TP_CTL_FORCE,
+			(char *)ctl + TP_CTL_FORCE, 1);
+}
+
+/**
+ * @brief Checks if the shadow copy inside the child matches
+ * the current variables values, i.e: if the checker compares
+ * against the right values. Expected to be called right after
+ * tp_update().
+ *
+ * @param child Child process.
+ * @param vars Variables list, current context.
+ *
+ * @return Returns the index of the first variable out of sync,
+ * or -1 if all of them match (or if not possible to check).
+ */
+int tp_check_shadow(pid_t child, struct array *vars)
+{
+	uint8_t *shadow; /* Child shadow copy. */
+	uint8_t *src;    /* Expected value.    */
+	int ret;         /* Return value.      */
+
+	if (tp_shadow_buf == NULL || tp_shadow_size == 0)
+		return (-1);
+
+	shadow = (uint8_t *)pt_readmemory(child, tp_shadow, tp_shadow_size);
+	if (shadow == NULL)
+		return (-1);
+
+	ret = -1;
+	for (size_t i = 0; i < tp_nvars && ret < 0; i++)
+	{
+		struct dw_variable *v;
+
+		if (tp_offsets[i] == SIZE_MAX)
+			continue;
+
+		v = array_get(&vars, i, NULL);
+		if (v->type.var_type == TARRAY)
+			src = (uint8_t *)v->value.p_value;
+		else if (v->initialized)
+			src = v->value.u8_value;
+		else
+			src = v->scratch_value.u8_value;
+
+		if (src && memcmp(shadow + tp_offsets[i], src, v->byte_size))
+			ret = (int)i;
+	}
+
+	free(shadow);
+	return (ret);
+}
+
+/**
+ * @brief Deallocates all the tracepoints resources.
+ *
+ * @note The child process is not restored, this is expected
+ * to be called at exit.
+ */
+void tp_finish(void)
+{
+	if (tp_ids != NULL)
+	{
+		for (size_t i = 0; i < array_size(&tp_ids); i++)
+			free(array_get(&tp_ids, i, NULL));
+		array_finish(&tp_ids);
+	}
+
+	if (tp_lines != NULL)
+		hashtable_finish(&tp_lines, 0);
+	if (tp_traps != NULL)
+		hashtable_finish(&tp_traps, 0);
+
+	free(tp_offsets);
+	free(tp_shadow_buf);
+
+	tp_ids = NULL;
+	tp_lines = NULL;
+	tp_traps = NULL;
+	tp_offsets = NULL;
+	tp_shadow_buf = NULL;
+}
@@ -0,0 +1,978 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "arrow.h"
+#include "pbd.h"
+#include "util.h"
+#include "variable.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Arrow: metadata version, message headers and types. */
+#define AR_METADATA_V5     4
+#define AR_MSG_SCHEMA      1
+#define AR_MSG_DICTIONARY  2
+#define AR_MSG_BATCH       3
+#define AR_TYPE_INT        2
+#define AR_TYPE_FLOAT      3
+#define AR_TYPE_UTF8       5
+#define AR_TYPE_BOOL       6
+#define AR_TYPE_TIMESTAMP 10
+#define AR_TYPE_LIST      12
+
+/* Columns, in schema order. */
+enum ar_column
+{
+	AR_SEQ, AR_TIME, AR_DEPTH, AR_LINE, AR_VAR, AR_NAME, AR_GLOBAL,
+	AR_INDEX, AR_BEFORE_INT, AR_AFTER_INT, AR_BEFORE_UINT, AR_AFTER_UINT,
+	AR_BEFORE_FLOAT, AR_AFTER_FLOAT, AR_COLUMNS
+};
+
+/* Record batch: FieldNodes (the list has a child) and buffers. */
+#define AR_NODES   (AR_COLUMNS + 1)
+#define AR_BUFFERS (AR_COLUMNS * 2 + 2)
+
+/**
+ * Growable byte buffer.
+ */
+struct ar_buf
+{
+	uint8_t *data; /* Data.     */
+	size_t len;    /* Length.   */
+	size_t cap;    /* Capacity. */
+};
+
+/**
+ * Column being built.
+ */
+struct ar_col
+{
+	struct ar_buf valid;   /* Validity bitmap.            */
+	struct ar_buf data;    /* Values, or list offsets.    */
+	struct ar_buf child;   /* List values.                */
+	size_t nulls;          /* Null count.                 */
+};
+
+/**
+ * FlatBuffers builder: the buffer is filled from its end, so
+ * that the objects are created before the ones referencing them.
+ * References are the amount of bytes used when the object was
+ * created, i.e: its distance to the end of the buffer.
+ */
+struct ar_fb
+{
+	uint8_t *buf;                  /* Buffer.                 */
+	size_t cap;                    /* Capacity.               */
+	size_t used;                   /* Bytes used, at the end. */
+	size_t minalign;               /* Largest alignment.      */
+	size_t table;                  /* Current table start.    */
+	uint32_t slots[AR_FB_SLOTS];   /* Current table fields.   */
+	int nslots;                    /* Slots used.             */
+};
+
+/* Arrow output state. */
+static struct ar
+{
+	FILE *fp;                       /* Output file.          */
+	pthread_mutex_t lock;           /* Columns lock.         */
+	struct ar_col cols[AR_COLUMNS]; /* Columns.              */
+	size_t rows;                    /* Rows in the batch.    */
+	uint64_t seq;                   /* Last event sequence.  */
+	uint64_t last_flush;            /* Last flush, in ns.    */
+	struct ar_fb fb;                /* Metadata builder.     */
+	struct ar_buf body;             /* Message body.         */
+} ar = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/* ------------------------------------------------------------------*
+ * Buffers                                                           *
+ * ------------------------------------------------------------------*/
+
+/**
+ * @brief Reserves @p n more bytes in @p b, zero-filled.
+ *
+ * @return Returns a pointer to the bytes reserved.
+ */
+static uint8_t *ar_reserve(struct ar_buf *b, size_t n)
+{
+	uint8_t *data;
+	size_t cap;
+
+	if (b->len + n > b->cap)
+	{
+		cap = b->cap ? b->cap : 4096;
+		while (b->len + n > cap)
+			cap *= 2;
+
+		if ((data = realloc(b->data, cap)) == NULL)
+			QUIT(EXIT_FAILURE, "--arrow: out of memory!\n");
+
+		b->data = data;
+		b->cap  = cap;
+	}
+
+	data = b->data + b->len;
+	memset(data, 0, n);
+	b->len += n;
+	return (data);
+}
+
+/**
+ * @brief Appends @p n bytes of @p p into @p b.
+ */
+static inline void ar_put(struct ar_buf *b, const void *p, size_t n)
+{
+	memcpy(ar_reserve(b, n), p, n);
+}
+
+/**
+ * @brief Sets the bit @p i of the bitmap @p b, growing it as
+ * needed.
+ */
+static void ar_bit(struct ar_buf *b, size_t i, int set)
+{
+	if ((i >> 3) >= b->len)
+		ar_reserve(b, (i >> 3) + 1 - b->len);
+
+	if (set)
+		b->data[i >> 3] |= 1 << (i & 7);
+}
+
+/* ------------------------------------------------------------------*
+ * FlatBuffers                                                       *
+ * ------------------------------------------------------------------*/
+
+/**
+ * @brief Pushes @p n bytes of @p p (or zeros, if NULL) in front
+ * of the builder data.
+ */
+static void fb_push(struct ar_fb *fb, const void *p, size_t n)
+{
+	uint8_t *buf;
+	size_t cap;
+
+	if (fb->used + n > fb->cap)
+	{
+		cap = fb->cap ? fb->cap : 1024;
+		while (fb->used + n > cap)
+			cap *= 2;
+
+		if ((buf = malloc(cap)) == NULL)
+			QUIT(EXIT_FAILURE, "--arrow: out of memory!\n");
+
+		memcpy(buf + cap - fb->used, fb->buf + fb->cap - fb->used, fb->used);
+		free(fb->buf);
+		fb->buf = buf;
+		fb->cap = cap;
+	}
+
+	fb->used += n;
+	if (p != NULL)
+		memcpy(fb->buf + fb->cap - fb->used, p, n);
+	else
+		memset(fb->buf + fb->cap - fb->used, 0, n);
+}
+
+/**
+ * @brief Pads the builder so that, after pushing @p extra bytes,
+ * the data is aligned to @p size.
+ */
+static void fb_align(struct ar_fb *fb, size_t size, size_t extra)
+{
+	if (size > fb->minalign)
+		fb->minalign = size;
+
+	fb_push(fb, NULL, (-(fb->used + extra)) & (size - 1));
+}
+
+/**
+ * @brief Creates a string.
+ *
+ * @return Returns the string reference.
+ */
+static uint32_t fb_string(struct ar_fb *fb, const char *s)
+{
+	uint32_t len;
+
+	len = (uint32_t)strlen(s);
+	fb_align(fb, 4, len + 1);
+	fb_push(fb, NULL, 1);
+	fb_push(fb, s, len);
+	fb_push(fb, &len, 4);
+	return ((uint32_t)fb->used);
+}
+
+/**
+ * @brief Creates a vector of @p n structs (or scalars) of
+ * @p size bytes each.
+ *
+ * @return Returns the vector reference.
+ */
+static uint32_t fb_vector(struct ar_fb *fb, const void *elems, uint32_t n,
+	size_t size)
+{
+	fb_align(fb, 4, n * size);
+	fb_align(fb, size > 8 ? 8 : size, n * size);
+	fb_push(fb, elems, n * size);
+	fb_push(fb, &n, 4);
+	return ((uint32_t)fb->used);
+}
+
+/**
+ * @brief Creates a vector of references to @p n tables.
+ *
+ * @return Returns the vector reference.
+ */
+static uint32_t fb_vector_refs(struct ar_fb *fb, const uint32_t *refs,
+	uint32_t n)
+{
+	uint32_t off;
+
+	fb_align(fb, 4, n * 4);
+	for (uint32_t i = n; i > 0; i--)
+	{
+		off = (uint32_t)fb->used + 4 - refs[i - 1];
+		fb_push(fb, &off, 4);
+	}
+	fb_push(fb, &n, 4);
+	return ((uint32_t)fb->used);
+}
+
+/**
+ * @brief Starts a table, whose children should already exist.
+ */
+static void fb_start(struct ar_fb *fb)
+{
+	memset(fb->slots, 0, sizeof(fb->slots));
+	fb->nslots = 0;
+	fb->table  = fb->used;
+}
+
+/**
+ * @brief Adds the scalar field @p slot, of @p size bytes, into
+ * the current table.
+ */
+static void fb_add(struct ar_fb *fb, int slot, const void *p, size_t size)
+{
+	fb_align(fb, size, 0);
+	fb_push(fb, p, size);
+	fb->slots[slot] = (uint32_t)fb->used;
+	if (slot >= fb->nslots)
+		fb->nslots = slot + 1;
+}
+
+/**
+ * @brief Adds the reference field @p slot, to the object
+ * @p ref, into the current table.
+ */
+static void fb_add_ref(struct ar_fb *fb, int slot, uint32_t ref)
+{
+	uint32_t off;
+
+	fb_align(fb, 4, 0);
+	off = (uint32_t)fb->used + 4 - ref;
+	fb_add(fb, slot, &off, 4);
+}
+
+/**
+ * @brief Ends the current table, writing its vtable.
+ *
+ * @return Returns the table reference.
+ */
+static uint32_t fb_end(struct ar_fb *fb)
+{
+	uint16_t vt[AR_FB_SLOTS + 2]; /* Vtable.      */
+	uint32_t table;               /* Table ref.   */
+	int32_t soff;                 /* Vtable soff. */
+
+	fb_align(fb, 4, 0);
+	fb_push(fb, NULL, 4);
+	table = (uint32_t)fb->used;
+
+	vt[0] = (uint16_t)((fb->nslots + 2) * 2);
+	vt[1] = (uint16_t)(table - fb->table);
+	for (int i = 0; i < fb->nslots; i++)
+		vt[i + 2] = fb->slots[i] ? (uint16_t)(table - fb->slots[i]) : 0;
+
+	fb_push(fb, vt, vt[0]);
+
+	/* The vtable precedes the table. */
+	soff = (int32_t)(fb->used - table);
+	memcpy(fb->buf + fb->cap - table, &soff, 4);
+	return (table);
+}
+
+/**
+ * @brief Finishes the buffer, with @p root as the root table.
+ */
+static void fb_finish(struct ar_fb *fb, uint32_t root)
+{
+	uint32_t off;
+
+	fb_align(fb, fb->minalign, 4);
+	off = (uint32_t)fb->used + 4 - root;
+	fb_push(fb, &off, 4);
+}
+
+/**
+ * @brief Resets the builder, keeping its buffer.
+ */
+static void fb_reset(struct ar_fb *fb)
+{
+	fb->used     = 0;
+	fb->minalign = 1;
+}
+
+/* ------------------------------------------------------------------*
+ * Messages                                                          *
+ * ------------------------------------------------------------------*/
+
+/**
+ * @brief Creates an Int type table.
+ */
+static uint32_t ar_type_int(struct ar_fb *fb, int32_t bits, uint8_t is_signed)
+{
+	fb_start(fb);
+	fb_add(fb, 0, &bits, 4);
+	fb_add(fb, 1, &is_signed, 1);
+	return (fb_end(fb));
+}
+
+/**
+ * @brief Creates a Field table.
+ *
+ * @param fb Builder.
+ * @param name Field name.
+ * @param nullable Nullable field?.
+ * @param type_type Type (union type).
+ * @param type Type table.
+ * @param dict Dictionary encoding table, or 0 if none.
+ * @param children Children vector, or 0 if none.
+ *
+ * @return Returns the field reference.
+ */
+static uint32_t ar_field(struct ar_fb *fb, const char *name, uint8_t nullable,
+	uint8_t type_type, uint32_t type, uint32_t dict, uint32_t children)
+{
+	uint32_t name_ref;
+
+	name_ref = fb_string(fb, name);
+	if (!children)
+		children = fb_vector_refs(fb, NULL, 0);
+
+	fb_start(fb);
+	fb_add_ref(fb, 0, name_ref);
+	fb_add(fb, 1, &nullable, 1);
+	fb_add(fb, 2, &type_type, 1);
+	fb_add_ref(fb, 3, type);
+	if (dict)
+		fb_add_ref(fb, 4, dict);
+	fb_add_ref(fb, 5, children);
+	return (fb_end(fb));
+}
+
+/**
+ * @brief Writes the message built in ar.fb, whose root is the
+ * header @p header, of type @p type, followed by the body.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int ar_write_message(uint8_t type, uint32_t header)
+{
+	static const uint8_t pad[8];
+	struct ar_fb *fb;   /* Builder.        */
+	int64_t body_len;   /* Body length.    */
+	int16_t version;    /* Version.        */
+	int32_t prefix[2];  /* Continuation.   */
+	uint32_t padding;   /* Metadata pad.   */
+
+	fb       = &ar.fb;
+	body_len = (int64_t)ar.body.len;
+	version  = AR_METADATA_V5;
+
+	fb_start(fb);
+	fb_add(fb, 3, &body_len, 8);
+	fb_add_ref(fb, 2, header);
+	fb_add(fb, 0, &version, 2);
+	fb_add(fb, 1, &type, 1);
+	fb_finish(fb, fb_end(fb));
+
+	/* Continuation, metadata size (padded to 8) and metadata. */
+	padding   = (uint32_t)((-fb->used) & 7);
+	prefix[0] = -1;
+	prefix[1] = (int32_t)(fb->used + padding);
+
+	if (fwrite(prefix, sizeof(prefix), 1, ar.fp) != 1 ||
+		fwrite(fb->buf + fb->cap - fb->used, fb->used, 1, ar.fp) != 1 ||
+		fwrite(pad, 1, padding, ar.fp) != padding ||
+		(ar.body.len && fwrite(ar.body.data, ar.body.len, 1, ar.fp) != 1))
+	{
+		return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Appends the buffer @p p, of @p len bytes, into the
+ * message body, padded to 8 bytes.
+ *
+ * @param bufs Buffers (offset and length) list, to be filled.
+ * @param nbufs Amount of buffers, incremented.
+ */
+static void ar_body_add(int64_t *bufs, int *nbufs, const void *p, size_t len)
+{
+	bufs[*nbufs * 2]     = (int64_t)ar.body.len;
+	bufs[*nbufs * 2 + 1] = (int64_t)len;
+	(*nbufs)++;
+
+	if (!len)
+		return;
+
+	ar_put(&ar.body, p, len);
+	ar_reserve(&ar.body, (-len) & 7);
+}
+
+/**
+ * @brief Creates a RecordBatch table.
+ */
+static uint32_t ar_batch(struct ar_fb *fb, int64_t length,
+	const int64_t *nodes, int nnodes, const int64_t *bufs, int nbufs)
+{
+	uint32_t nodes_ref;
+	uint32_t bufs_ref;
+
+	bufs_ref  = fb_vector(fb, bufs, (uint32_t)nbufs, 16);
+	nodes_ref = fb_vector(fb, nodes, (uint32_t)nnodes, 16);
+
+	fb_start(fb);
+	fb_add(fb, 0, &length, 8);
+	fb_add_ref(fb, 1, nodes_ref);
+	fb_add_ref(fb, 2, bufs_ref);
+	return (fb_end(fb));
+}
+
+/**
+ * @brief Writes the schema.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int ar_write_schema(void)
+{
+	static const struct
+	{
+		const char *name; /* Column name.         */
+		uint8_t type;     /* Arrow type.          */
+		int32_t bits;     /* Int/Timestamp bits.  */
+		uint8_t sign;     /* Signed?.             */
+		uint8_t nullable; /* Nullable?.           */
+	} cols[AR_COLUMNS] =
+	{
+		{"seq",          AR_TYPE_INT,       64, 0, 0},
+		{"time",         AR_TYPE_TIMESTAMP, 64, 1, 0},
+		{"depth",        AR_TYPE_INT,       32, 1, 0},
+		{"line",         AR_TYPE_INT,       32, 0, 0},
+		{"var_id",       AR_TYPE_INT,       32, 1, 0},
+		{"name",         AR_TYPE_UTF8,       0, 0, 0},
+		{"global",       AR_TYPE_BOOL,       0, 0, 0},
+		{"index",        AR_TYPE_LIST,       0, 0, 1},
+		{"before_int",   AR_TYPE_INT,       64, 1, 1},
+		{"after_int",    AR_TYPE_INT,       64, 1, 1},
+		{"before_uint",  AR_TYPE_INT,       64, 0, 1},
+		{"after_uint",   AR_TYPE_INT,       64, 0, 1},
+		{"before_float", AR_TYPE_FLOAT,      0, 0, 1},
+		{"after_float",  AR_TYPE_FLOAT,      0, 0, 1},
+	};
+
+	uint32_t fields[AR_COLUMNS]; /* Fields.         */
+	uint32_t type, dict, child;  /* Current field.  */
+	struct ar_fb *fb;            /* Builder.        */
+	int16_t short_val;
+	int64_t long_val;
+	uint32_t str;
+
+	fb = &ar.fb;
+	fb_reset(fb);
+
+	for (int i = 0; i < AR_COLUMNS; i++)
+	{
+		dict  = 0;
+		child = 0;
+
+		switch (cols[i].type)
+		{
+			case AR_TYPE_INT:
+				type = ar_type_int(fb, cols[i].bits, cols[i].sign);
+				break;
+
+			case AR_TYPE_TIMESTAMP:
+				str = fb_string(fb, "UTC");
+				short_val = 3; /* Nanosecond. */
+				fb_start(fb);
+				fb_add(fb, 0, &short_val, 2);
+				fb_add_ref(fb, 1, str);
+				type = fb_end(fb);
+				break;
+
+			case AR_TYPE_FLOAT:
+				short_val = 2; /* Double. */
+				fb_start(fb);
+				fb_add(fb, 0, &short_val, 2);
+				type = fb_end(fb);
+				break;
+
+			/* Variable names: dictionary 0, int32 indexes. */
+			case AR_TYPE_UTF8:
+				type = ar_type_int(fb, 32, 1);
+				long_val = 0;
+				fb_start(fb);
+				fb_add(fb, 0, &long_val, 8);
+				fb_add_ref(fb, 1, type);
+				dict = fb_end(fb);
+
+				fb_start(fb);
+				type = fb_end(fb);
+				break;
+
+			/* Array indexes: list<item: int32>. */
+			case AR_TYPE_LIST:
+				type  = ar_type_int(fb, 32, 1);
+				child = ar_field(fb, "item", 0, AR_TYPE_INT, type, 0, 0);
+				child = fb_vector_refs(fb, &child, 1);
+
+				fb_start(fb);
+				type = fb_end(fb);
+				break;
+
+			default:
+				fb_start(fb);
+				type = fb_end(fb);
+				break;
+		}
+
+		fields[i] = ar_field(fb, cols[i].name, cols[i].nullable, cols[i].type,
+			type, dict, child);
+	}
+
+	str = fb_vector_refs(fb, fields, AR_COLUMNS);
+	short_val = 0; /* Little endian. */
+	fb_start(fb);
+	fb_add(fb, 0, &short_val, 2);
+	fb_add_ref(fb, 1, str);
+
+	ar.body.len = 0;
+	return (ar_write_message(AR_MSG_SCHEMA, fb_end(fb)));
+}
+
+/**
+ * @brief Writes the dictionary of the variables names: the
+ * name of each variable, by its index in @p vars.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int ar_write_dictionary(struct array *vars)
+{
+	struct dw_variable *v;   /* Current variable.  */
+	struct ar_buf offsets;   /* Names offsets.     */
+	struct ar_buf names;     /* Names.             */
+	int64_t nodes[2];        /* FieldNode.         */
+	int64_t bufs[3 * 2];     /* Buffers.           */
+	int nbufs;               /* Buffers amount.    */
+	uint32_t batch;          /* RecordBatch.       */
+	struct ar_fb *fb;        /* Builder.           */
+	int64_t id;              /* Dictionary id.     */
+	int32_t off;             /* Current offset.    */
+	int n;                   /* Variables amount.  */
+	int ret;
+
+	memset(&offsets, 0, sizeof(offsets));
+	memset(&names, 0, sizeof(names));
+
+	n   = (int) array_size(&vars);
+	off = 0;
+	ar_put(&offsets, &off, 4);
+
+	for (int i = 0; i < n; i++)
+	{
+		v = array_get(&vars, i, NULL);
+		v->arrow = i;
+
+		ar_put(&names, v->name, strlen(v->name));
+		off = (int32_t)names.len;
+		ar_put(&offsets, &off, 4);
+	}
+
+	ar.body.len = 0;
+	nbufs = 0;
+	ar_body_add(bufs, &nbufs, NULL, 0);
+	ar_body_add(bufs, &nbufs, offsets.data, offsets.len);
+	ar_body_add(bufs, &nbufs, names.data, names.len);
+
+	nodes[0] = n;
+	nodes[1] = 0;
+
+	fb = &ar.fb;
+	fb_reset(fb);
+	batch = ar_batch(fb, n, nodes, 1, bufs, nbufs);
+
+	id = 0;
+	fb_start(fb);
+	fb_add(fb, 0, &id, 8);
+	fb_add_ref(fb, 1, batch);
+
+	ret = ar_write_message(AR_MSG_DICTIONARY, fb_end(fb));
+	free(offsets.data);
+	free(names.data);
+	return (ret);
+}
+
+/**
+ * @brief Writes the events accumulated as a record batch. The
+ * lock should be held.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int ar_flush_locked(void)
+{
+	int64_t nodes[AR_NODES * 2]; /* FieldNodes.      */
+	int64_t bufs[AR_BUFFERS * 2];/* Buffers.         */
+	struct ar_col *c;            /* Current column.  */
+	struct ar_col *data;         /* Data column.     */
+	int nnodes, nbufs;
+	size_t bits_len;
+	size_t nvalues;
+	int ret;
+
+	if (!ar.rows)
+		return (0);
+
+	ar.body.len = 0;
+	nnodes = 0;
+	nbufs  = 0;
+	bits_len = (ar.rows + 7) / 8;
+
+	for (int i = 0; i < AR_COLUMNS; i++)
+	{
+		c = &ar.cols[i];
+
+		nodes[nnodes * 2]     = (int64_t)ar.rows;
+		nodes[nnodes * 2 + 1] = (int64_t)c->nulls;
+		nnodes++;
+
+		/* Validity bitmap, only if there are nulls. */
+		if (c->nulls)
+		{
+			ar_bit(&c->valid, ar.rows - 1, 0);
+			ar_body_add(bufs, &nbufs, c->valid.data, bits_len);
+		}
+		else
+			ar_body_add(bufs, &nbufs, NULL, 0);
+
+		/* The names are the variables ids, dictionary-encoded. */
+		data = (i == AR_NAME) ? &ar.cols[AR_VAR] : c;
+
+		if (i == AR_GLOBAL)
+		{
+			ar_bit(&c->data, ar.rows - 1, 0);
+			ar_body_add(bufs, &nbufs, c->data.data, bits_len);
+		}
+		else
+			ar_body_add(bufs, &nbufs, data->data.data, data->data.len);
+
+		/* List values. */
+		if (i == AR_INDEX)
+		{
+			nvalues = c->child.len / sizeof(int32_t);
+			nodes[nnodes * 2]     = (int64_t)nvalues;
+			nodes[nnodes * 2 + 1] = 0;
+			nnodes++;
+
+			ar_body_add(bufs, &nbufs, NULL, 0);
+			ar_body_add(bufs, &nbufs, c->child.data, c->child.len);
+		}
+	}
+
+	fb_reset(&ar.fb);
+	ret = ar_write_message(AR_MSG_BATCH, ar_batch(&ar.fb, (int64_t)ar.rows,
+		nodes, nnodes, bufs, nbufs));
+
+	/* Next batch. */
+	for (int i = 0; i < AR_COLUMNS; i++)
+	{
+		ar.cols[i].valid.len = 0;
+		ar.cols[i].data.len  = 0;
+		ar.cols[i].child.len = 0;
+		ar.cols[i].nulls     = 0;
+	}
+	ar.rows = 0;
+
+	if (ret < 0)
+		fprintf(stderr, "PBD: --arrow: unable to write the record batch!\n");
+	return (ret);
+}
+
+/**
+ * @brief Current time, in nanoseconds.
+ */
+static uint64_t ar_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+/**
+ * @brief Initializes the Arrow output: writes the schema and the
+ * variables dictionary.
+ *
+ * @param file Output file.
+ * @param vars Variables list, of the first context.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int ar_init(const char *file, struct array *vars)
+{
+	if ((ar.fp = fopen(file, "wb")) == NULL)
+		return (-1);
+
+	if (ar_write_schema() < 0 || ar_write_dictionary(vars) < 0)
+		return (-1);
+
+	ar.last_flush = ar_now();
+	return (0);
+}
+
+/**
+ * @brief Appends a value, as per @p encoding, into the before
+ * or after columns starting at @p col (int, uint and float
+ * columns are 2 apart).
+ */
+static void ar_value(int col, union var_value *value, int encoding,
+	size_t size, int valid)
+{
+	struct ar_col *c;
+	uint64_t u;
+	int64_t s;
+	double d;
+	int which;
+
+	which = -1;
+	u = 0;
+	s = 0;
+	d = 0;
+
+	if (valid)
+	{
+		switch (encoding)
+		{
+			case ENC_SIGNED:
+				which = 0;
+				switch (size)
+				{
+					case 1: s = (int8_t)  value->u64_value[0]; break;
+					case 2: s = (int16_t) value->u64_value[0]; break;
+					case 4: s = (int32_t) value->u64_value[0]; break;
+					case 8: s = (int64_t) value->u64_value[0]; break;
+					default: which = -1;
+				}
+				break;
+
+			case ENC_UNSIGNED:
+			case ENC_POINTER:
+				which = 1;
+				switch (size)
+				{
+					case 1: u = (uint8_t)  value->u64_value[0]; break;
+					case 2: u = (uint16_t) value->u64_value[0]; break;
+					case 4: u = (uint32_t) value->u64_value[0]; break;
+					case 8: u = (uint64_t) value->u64_value[0]; break;
+					default: which = -1;
+				}
+				break;
+
+			case ENC_FLOAT:
+				which = 2;
+				switch (size)
+				{
+					case 4:  d = value->f_value; break;
+					case 8:  d = value->d_value; break;
+					case 12:
+					case 16: d = (double)value->ld_value; break;
+					default: which = -1;
+				}
+				break;
+		}
+	}
+
+	for (int k = 0; k < 3; k++)
+	{
+		c = &ar.cols[col + k * 2];
+		if (k == 0)
+			ar_put(&c->data, &s, 8);
+		else if (k == 1)
+			ar_put(&c->data, &u, 8);
+		else
+			ar_put(&c->data, &d, 8);
+
+		ar_bit(&c->valid, ar.rows, k == which);
+		if (k != which)
+			c->nulls++;
+	}
+}
+
+/**
+ * @brief Line printer (see line_output) that appends the change
+ * into the current record batch, flushed on size or time.
+ *
+ * @param depth Current function depth.
+ * @param line_no Current line number.
+ * @param v Variable analized.
+ * @param v_before Value before being changed.
+ * @param v_after Value after being changed.
+ * @param array_idxs Computed index, only applicable
+ *        if variable is an array, otherwise,
+ *        this value can safely be NULL.
+ */
+void ar_printer(int depth, unsigned line_no,
+	struct dw_variable *v, union var_value *v_before,
+	union var_value *v_after, int *array_idxs)
+{
+	struct ar_col *idx; /* Index column.    */
+	uint64_t now;       /* Event time.      */
+	int32_t i32;
+	size_t size;
+	int valid;
+
+	now = ar_now();
+
+	pthread_mutex_lock(&ar.lock);
+
+	ar.seq++;
+	ar_put(&ar.cols[AR_SEQ].data, &ar.seq, 8);
+	ar_put(&ar.cols[AR_TIME].data, &now, 8);
+
+	i32 = depth;
+	ar_put(&ar.cols[AR_DEPTH].data, &i32, 4);
+	i32 = (int32_t)line_no;
+	ar_put(&ar.cols[AR_LINE].data, &i32, 4);
+	i32 = v->arrow;
+	ar_put(&ar.cols[AR_VAR].data, &i32, 4);
+	ar_bit(&ar.cols[AR_GLOBAL].data, ar.rows, v->scope == VGLOBAL);
+
+	/* Array indexes, if an element. */
+	idx = &ar.cols[AR_INDEX];
+	if (!idx->data.len)
+	{
+		i32 = 0;
+		ar_put(&idx->data, &i32, 4);
+	}
+
+	if (v->type.var_type == TARRAY && array_idxs != NULL)
+	{
+		ar_put(&idx->child, array_idxs, v->type.array.dimensions * 4);
+		ar_bit(&idx->valid, ar.rows, 1);
+	}
+	else
+	{
+		ar_bit(&idx->valid, ar.rows, 0);
+		idx->nulls++;
+	}
+
+	i32 = (int32_t)(idx->child.len / 4);
+	ar_put(&idx->data, &i32, 4);
+
+	/* Values: bitmap arrays and strings have no element values. */
+	size  = (v->type.var_type == TARRAY) ?
+		v->type.array.size_per_element : v->byte_size;
+	valid = !((v->bitmap || v->string) && v->type.var_type == TARRAY);
+
+	ar_value(AR_BEFORE_INT, v_before, v->bitmap ? ENC_UNSIGNED :
+		v->type.encoding, size, valid);
+	ar_value(AR_AFTER_INT, v_after, v->bitmap ? ENC_UNSIGNED :
+		v->type.encoding, size, valid);
+
+	ar.rows++;
+
+	if (ar.rows >= AR_BATCH_ROWS ||
+		now - ar.last_flush >= AR_FLUSH_MS * 1000000ULL)
+	{
+		ar_flush_locked();
+		ar.last_flush = now;
+	}
+
+	pthread_mutex_unlock(&ar.lock);
+}
+
+/**
+ * @brief Flushes the pending events if the time threshold has
+ * passed, for when no events are coming.
+ */
+void ar_tick(void)
+{
+	uint64_t now;
+
+	now = ar_now();
+	pthread_mutex_lock(&ar.lock);
+	if (ar.rows && now - ar.last_flush >= AR_FLUSH_MS * 1000000ULL)
+	{
+		ar_flush_locked();
+		ar.last_flush = now;
+		fflush(ar.fp);
+	}
+	pthread_mutex_unlock(&ar.lock);
+}
+
+/**
+ * @brief Writes the pending events and the end of stream, and
+ * closes the output.
+ */
+void ar_finish(void)
+{
+	static const int32_t eos[2] = {-1, 0};
+
+	if (ar.fp == NULL)
+		return;
+
+	pthread_mutex_lock(&ar.lock);
+	ar_flush_locked();
+	fwrite(eos, sizeof(eos), 1, ar.fp);
+	fclose(ar.fp);
+	ar.fp = NULL;
+	pthread_mutex_unlock(&ar.lock);
+
+	for (int i = 0; i < AR_COLUMNS; i++)
+	{
+		free(ar.cols[i].valid.data);
+		free(ar.cols[i].data.data);
+		free(ar.cols[i].child.data);
+	}
+	free(ar.fb.buf);
+	free(ar.body.data);
+	memset(ar.cols, 0, sizeof(ar.cols));
+	memset(&ar.fb, 0, sizeof(ar.fb));
+	memset(&ar.body, 0, sizeof(ar.body));
+}
@@ -0,0 +1,164 @@
+#!/usr/bin/env bash
+
+#
+# MIT License
+#
+# Copyright (c) 2019-2020 Davidson Francis <davidsondfgl@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+# ---------------------------------------------------------------------------
+# Synthetic target generator
+#
+# Emits, to stdout, a C program whose 'target' function has the shape
+# given by the parameters below, so that PBD can be measured as a function
+# of each one of them.
+#
+# The target function executes a loop of <iterations>, with <lines>
+# statements each. A fraction of those statements (<density>%, evenly
+# spread) changes a variable (locals, globals and array elements, in
+# round-robin), the remaining ones only read them (no changes). When <depth> > 1,
+# the function calls itself recursively until the given depth.
+#
+# Note: the loop counter is a local variable too, and thus, also
+# changes once per iteration.
+# ---------------------------------------------------------------------------
+
+usage()
+{
+	echo "Usage: $0 [options]"
+	echo "  -l <num>  Amount of local variables  (default: 4)"
+	echo "  -g <num>  Amount of global variables (default: 4)"
+	echo "  -a <num>  Elements per array dimension, 0 = no array (default: 0)"
+	echo "  -d <num>  Array dimensions (default: 1)"
+	echo "  -r <num>  Recursion depth (default: 1)"
+	echo "  -L <num>  Statements (lines) per loop iteration (default: 32)"
+	echo "  -c <num>  Change density, in percent (default: 25)"
+	echo "  -i <num>  Loop iterations (default: 1000)"
+	exit 1
+}
+
+locals=4
+globals=4
+array=0
+dims=1
+depth=1
+lines=32
+density=25
+iterations=1000
+
+while getopts "l:g:a:d:r:L:c:i:h" opt
+do
+	case "$opt" in
+		l) locals="$OPTARG"     ;;
+		g) globals="$OPTARG"    ;;
+		a) array="$OPTARG"      ;;
+		d) dims="$OPTARG"       ;;
+		r) depth="$OPTARG"      ;;
+		L) lines="$OPTARG"      ;;
+		c) density="$OPTARG"    ;;
+		i) iterations="$OPTARG" ;;
+		*) usage                ;;
+	esac
+done
+
+if (( locals < 1 || depth < 1 || lines < 1 || dims < 1 || dims > 8 ||
+	density < 0 || density > 100 ))
+then
+	usage
+fi
+
+# Array declaration and the index expression for the element 'k'
+arr_decl=""
+arr_idx=""
+if (( array > 0 ))
+then
+	for (( d=0; d<dims; d++ ))
+	do
+		arr_decl+="[$array]"
+		arr_idx+="[(it + k + $d) % $array]"
+	done
+fi
+
+# Variables that may be changed: l<N>, g<N> and the array
+vars=()
+for (( v=0; v<locals; v++ )); do vars+=("l$v"); done
+for (( v=0; v<globals; v++ )); do vars+=("g$v"); done
+(( array > 0 )) && vars+=("arr")
+
+echo "/* Generated by gen-target.sh -l $locals -g $globals -a $array -d $dims"\
+	"-r $depth -L $lines -c $density -i $iterations */"
+echo "#include <stdlib.h>"
+echo ""
+
+for (( v=0; v<globals; v++ ))
+do
+	echo "int g$v;"
+done
+(( array > 0 )) && echo "int arr$arr_decl;"
+
+echo ""
+echo "void target(int depth)"
+echo "{"
+for (( v=0; v<locals; v++ ))
+do
+	echo "	int l$v = 0;"
+done
+echo ""
+echo "	for (int it = 0; it < $iterations; it++)"
+echo "	{"
+
+nchanged=0
+for (( k=0; k<lines; k++ ))
+do
+	# Evenly spread: the line k changes if the amount of changing lines
+	# up to k+1 is greater than the amount up to k.
+	if (( (k + 1) * density / 100 > k * density / 100 ))
+	then
+		var="${vars[$(( nchanged % ${#vars[@]} ))]}"
+		nchanged=$((nchanged + 1))
+
+		if [ "$var" == "arr" ]
+		then
+			echo "		arr${arr_idx//k/$k} = it + $k;"
+		else
+			echo "		$var = it + $k;"
+		fi
+	else
+		var="${vars[$(( k % ${#vars[@]} ))]}"
+		if [ "$var" == "arr" ]
+		then
+			var="l0"
+		fi
+		echo "		if ($var < 0) abort();"
+	fi
+done
+
+echo "	}"
+echo ""
+echo "	if (depth > 1)"
+echo "		target(depth - 1);"
+echo "}"
+echo ""
+echo "int main(void)"
+echo "{"
+echo "	target($depth);"
+echo "	return (0);"
+echo "}"
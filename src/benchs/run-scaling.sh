@@ -0,0 +1,123 @@
+#!/usr/bin/env bash
+
+#
+# MIT License
+#
+# Copyright (c) 2019-2020 Davidson Francis <davidsondfgl@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+# ---------------------------------------------------------------------------
+# Scaling curves
+#
+# For each parameter of gen-target.sh, varies it alone (the others keep
+# their default values), builds the generated target, runs it natively
+# and under PBD, and saves into 'csv_scaling':
+#   - stops:       amount of stops handled by PBD (from --stats)
+#   - ns_per_stop: PBD time, minus the native time, per stop
+#   - slowdown:    PBD time / native time
+#
+# Usage: run-scaling.sh [parameter...], e.g: run-scaling.sh locals depth
+# (default: all parameters)
+# ---------------------------------------------------------------------------
+
+CC=${CC:-gcc}
+PBD=${PBD:-../pbd}
+ITERATIONS=${ITERATIONS:-1000}
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+# Same flags that PBD requires, see the Makefile
+CFLAGS="-std=c99 -O0 -gdwarf-2 -fno-omit-frame-pointer"
+if echo "int main(){}" | $CC -x c - -o "$WORKDIR/pie" && \
+	file "$WORKDIR/pie" | grep -Eq "shared|pie"
+then
+	CFLAGS+=" -no-pie"
+fi
+
+# Parameter name, gen-target.sh flag and values
+declare -A flag=(
+	[locals]="-l"  [globals]="-g" [array]="-a"   [dims]="-d"
+	[depth]="-r"   [lines]="-L"   [density]="-c"
+)
+declare -A values=(
+	[locals]="1 2 4 8 16 32 64 128"
+	[globals]="0 1 2 4 8 16 32 64 128"
+	[array]="0 16 64 256 1024 4096 16384 65536"
+	[dims]="1 2 3 4"
+	[depth]="1 2 4 8 16 32 64"
+	[lines]="4 8 16 32 64 128 256"
+	[density]="0 5 10 25 50 75 100"
+)
+order="locals globals array dims depth lines density"
+
+params=${*:-$order}
+
+# Current time, in seconds
+now() { date -u +%s.%N; }
+
+echo "param, value, stops, native, pbd, ns_per_stop, slowdown" > csv_scaling
+
+for param in $params
+do
+	if [ -z "${flag[$param]}" ]
+	then
+		echo "Unknown parameter: $param (expected: $order)"
+		exit 1
+	fi
+
+	echo "> $param..."
+	for value in ${values[$param]}
+	do
+		extra=""
+		# Multiple dimensions only make sense with an array
+		[ "$param" == "dims" ] && extra="-a 8"
+
+		./gen-target.sh -i "$ITERATIONS" ${flag[$param]} "$value" $extra \
+			> "$WORKDIR/target.c"
+		$CC $CFLAGS "$WORKDIR/target.c" -o "$WORKDIR/target" || exit 1
+
+		start=$(now)
+		"$WORKDIR/target"
+		end=$(now)
+		native=$(awk "BEGIN {print $end - $start}")
+
+		start=$(now)
+		stops=$("$PBD" --stats "$WORKDIR/target" target 2>&1 >/dev/null \
+			| grep -E "^PBD: stats: [0-9]+ stops," | awk '{print $3}')
+		end=$(now)
+		pbd=$(awk "BEGIN {print $end - $start}")
+
+		ns=$(awk "BEGIN {print ($stops > 0) ? ($pbd - $native) * 1e9 / $stops : 0}")
+		slow=$(awk "BEGIN {print $pbd / $native}")
+
+		printf "    %-8s = %-6s stops: %-9s ns/stop: %-10.1f slowdown: %.1fx\n" \
+			"$param" "$value" "$stops" "$ns" "$slow"
+		printf "%s, %s, %s, %f, %f, %f, %f\n" "$param" "$value" "$stops" \
+			"$native" "$pbd" "$ns" "$slow" >> csv_scaling
+	done
+done
+
+# Plot graph, if possible
+if [ -x "$(command -v Rscript)" ]
+then
+	echo "Plotting graph..."
+	Rscript plot-scaling.R &> /dev/null
+fi
@@ -0,0 +1,194 @@
+#!/usr/bin/env bash
+
+#
+# MIT License
+#
+# Copyright (c) 2019-2020 Davidson Francis <davidsondfgl@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# ---------------------------------------------------------------------------
+# Setup phases on huge binaries
+#
+# Generates and builds (once, kept in $TARGETS) a target with CUS Compile
+# Units, GLOBALS global variables (spread among the CUs) and a SRC_LINES
+# lines source file containing the target function, and then measures
+# each PBD setup phase (as reported by --stats) separately, for each one
+# of the configurations below:
+#   - default: globals + locals
+#   - locals:  no globals (-l)
+#   - static:  static analysis (-S)
+#   - lines:   source code reading and highlighting (-s -c)
+#
+# The results (wall time and peak RSS growth of each phase, averaged over
+# RUNS runs, and the total time) are saved into 'json_setup'.
+#
+# Usage: run-setup.sh [config...], e.g: run-setup.sh default static
+# (default: all configurations)
+# ---------------------------------------------------------------------------
+
+CC=${CC:-gcc}
+PBD=${PBD:-../pbd}
+CUS=${CUS:-10000}
+GLOBALS=${GLOBALS:-100000}
+SRC_LINES=${SRC_LINES:-50000}
+TARGET_LINES=${TARGET_LINES:-256}
+RUNS=${RUNS:-3}
+TARGETS=${TARGETS:-setup_targets}
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+# Same flags that PBD requires, see the Makefile
+CFLAGS="-std=c99 -O0 -gdwarf-2 -fno-omit-frame-pointer"
+if echo "int main(){}" | $CC -x c - -o "$WORKDIR/pie" && \
+	file "$WORKDIR/pie" | grep -Eq "shared|pie"
+then
+	CFLAGS+=" -no-pie"
+fi
+
+# Configuration name and PBD options
+declare -A options=(
+	[default]="" [locals]="-l" [static]="-S" [lines]="-s -c"
+)
+order="default locals static lines"
+
+configs=${*:-$order}
+
+# Current time, in seconds
+now() { date -u +%s.%N; }
+
+# Emits the Compile Unit $1, with $2 globals and a function using them
+gen_cu()
+{
+	for g in $(seq 1 "$2")
+	do
+		echo "int cu$1_g$g;"
+	done
+	echo "int cu$1_f(int a)"
+	echo "{"
+	echo "	int l1 = a; char buf[16];"
+	echo "	buf[0] = l1; cu$1_g1 += l1 + buf[0];"
+	echo "	return (cu$1_g1);"
+	echo "}"
+}
+
+# Builds the target, if not built yet
+dir="$TARGETS/cus$CUS-globals$GLOBALS-lines$SRC_LINES"
+if [ ! -x "$dir/target" ]
+then
+	echo "> Generating target (cus: $CUS, globals: $GLOBALS," \
+		"lines: $SRC_LINES)..."
+	mkdir -p "$dir" || exit 1
+
+	per_cu=$(( (GLOBALS + CUS - 1) / CUS ))
+	for cu in $(seq 1 "$CUS")
+	do
+		gen_cu "$cu" "$per_cu" > "$dir/cu$cu.c"
+	done
+
+	# Target function plus filler functions, up to SRC_LINES lines
+	./gen-target.sh -L "$TARGET_LINES" -i 1 > "$dir/main.c" || exit 1
+	awk -v lines="$SRC_LINES" -v cur="$(wc -l < "$dir/main.c")" '
+	BEGIN {
+		for (n = 0; cur < lines; n++) {
+			printf "int fill%d(int a)\n{\n\tint b = a + %d;\n", n, n
+			printf "\tif (b < 0)\n\t\tb = -b;\n\treturn (b * 2);\n}\n\n"
+			cur += 8
+		}
+	}' >> "$dir/main.c"
+
+	echo "> Building..."
+	export CC CFLAGS
+	find "$dir" -name "cu*.c" -print0 | xargs -0 -n 64 -P "$(nproc)" \
+		sh -c 'for f; do $CC $CFLAGS -c "$f" -o "${f%.c}.o" || exit 255; done' sh \
+		|| exit 1
+
+	# Built from its own directory, so that -s and -S find the source
+	(cd "$dir" && $CC $CFLAGS cu*.o main.c -o target) || exit 1
+	rm -f "$dir"/cu*.o
+fi
+
+echo "> Target: $dir ($(du -h "$dir/target" | cut -f1))"
+
+entries=""
+
+for config in $configs
+do
+	if [ -z "${options[$config]+x}" ]
+	then
+		echo "Unknown configuration: $config (expected: $order)"
+		exit 1
+	fi
+
+	log="$WORKDIR/$config.log"
+	: > "$log"
+
+	start=$(now)
+	for _ in $(seq 1 "$RUNS")
+	do
+		# shellcheck disable=SC2086
+		"$PBD" --stats ${options[$config]} -d "$dir/target" target \
+			2>> "$log" > /dev/null || exit 1
+	done
+	end=$(now)
+	total=$(awk "BEGIN {print ($end - $start) / $RUNS}")
+
+	printf "    %-8s total: %-10.4f" "$config" "$total"
+
+	# Averaged wall time and peak RSS growth, for each phase, in order
+	phases=$(awk -F", " -v runs="$RUNS" '
+	/^PBD: stats: setup: / {
+		name = substr($1, 20)
+		if (!(name in wall))
+			names[n++] = name
+		wall[name] += $2
+		rss[name] += $3
+	}
+	END {
+		for (i = 0; i < n; i++) {
+			printf "%s        {\"phase\": \"%s\", \"wall_s\": %f, " \
+				"\"peak_rss_growth_kib\": %d}", (i ? ",\n" : ""), names[i],
+				wall[names[i]] / runs, rss[names[i]] / runs
+			printf " %s: %.4f", names[i], wall[names[i]] / runs > "/dev/stderr"
+		}
+		printf "\n" > "/dev/stderr"
+	}' "$log")
+
+	[ -n "$entries" ] && entries+=$',\n'
+	entries+="    {
+      \"name\": \"$config\",
+      \"options\": \"${options[$config]}\",
+      \"total_s\": $total,
+      \"phases\": [
+$phases
+      ]
+    }"
+done
+
+cat > json_setup <<JSON
+{
+  "cus": $CUS,
+  "globals": $GLOBALS,
+  "source_lines": $SRC_LINES,
+  "runs": $RUNS,
+  "configs": [
+$entries
+  ]
+}
+JSON
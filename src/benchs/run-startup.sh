@@ -0,0 +1,121 @@
+#!/usr/bin/env bash
+
+#
+# MIT License
+#
+# Copyright (c) 2019-2020 Davidson Francis <davidsondfgl@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+# ---------------------------------------------------------------------------
+# Startup time: internal DWARF reader vs libdwarf
+#
+# Builds targets with an increasing amount of Compile Units (each one with
+# FUNCS functions and a few variables), and measures how long PBD takes to
+# read the debug information of the target function (the last one) with
+# the internal reader and with --libdwarf, saving into 'csv_startup':
+#   - cus:      amount of Compile Units
+#   - internal: PBD startup time (s), internal reader
+#   - libdwarf: PBD startup time (s), libdwarf
+#   - speedup:  libdwarf / internal
+#
+# Usage: run-startup.sh [cus...], e.g: run-startup.sh 100 1000
+# ---------------------------------------------------------------------------
+
+CC=${CC:-gcc}
+PBD=${PBD:-../pbd}
+FUNCS=${FUNCS:-50}
+RUNS=${RUNS:-5}
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+# Same flags that PBD requires, see the Makefile
+CFLAGS="-std=c99 -O0 -gdwarf-2 -fno-omit-frame-pointer"
+if echo "int main(){}" | $CC -x c - -o "$WORKDIR/pie" && \
+	file "$WORKDIR/pie" | grep -Eq "shared|pie"
+then
+	CFLAGS+=" -no-pie"
+fi
+
+sizes=${*:-"10 100 500 1000"}
+
+# Current time, in seconds
+now() { date -u +%s.%N; }
+
+# Emits the Compile Unit $1, with $FUNCS functions
+gen_cu()
+{
+	echo "int cu$1_global;"
+	for f in $(seq 1 "$FUNCS")
+	do
+		echo "int cu$1_f$f(int a, int b)"
+		echo "{"
+		echo "	int l1 = a, l2 = b; char buf[16];"
+		echo "	buf[0] = l1; cu$1_global += l1 + l2 + buf[0];"
+		echo "	return (cu$1_global);"
+		echo "}"
+	done
+}
+
+# Average PBD startup time, for $RUNS runs
+# $1: target, $2...: extra options
+startup()
+{
+	local target=$1
+	shift
+
+	start=$(now)
+	for _ in $(seq 1 "$RUNS")
+	do
+		"$PBD" "$@" -d "$target" target > /dev/null 2>&1 || return 1
+	done
+	end=$(now)
+	awk "BEGIN {print ($end - $start) / $RUNS}"
+}
+
+echo "cus, internal, libdwarf, speedup" > csv_startup
+
+for cus in $sizes
+do
+	dir="$WORKDIR/$cus"
+	mkdir -p "$dir"
+
+	for cu in $(seq 1 "$cus")
+	do
+		gen_cu "$cu" > "$dir/cu$cu.c"
+		$CC $CFLAGS -c "$dir/cu$cu.c" -o "$dir/cu$cu.o" || exit 1
+	done
+
+	{
+		echo "int g;"
+		echo "void target(void) { int i = 1; g = i; }"
+		echo "int main(void) { target(); return (0); }"
+	} > "$dir/main.c"
+	$CC $CFLAGS "$dir"/*.o "$dir/main.c" -o "$dir/target" || exit 1
+
+	internal=$(startup "$dir/target")            || exit 1
+	libdwarf=$(startup "$dir/target" --libdwarf) || exit 1
+	speedup=$(awk "BEGIN {print $libdwarf / $internal}")
+
+	printf "    cus = %-6s internal: %-10.4f libdwarf: %-10.4f speedup: %.2fx\n" \
+		"$cus" "$internal" "$libdwarf" "$speedup"
+	printf "%s, %f, %f, %f\n" "$cus" "$internal" "$libdwarf" "$speedup" \
+		>> csv_startup
+done
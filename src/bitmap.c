@@ -0,0 +1,369 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "bitmap.h"
+#include "dwarf_helper.h"
+#include "variable.h"
+
+#include <fnmatch.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Size of each bits list (set or cleared). */
+#define BM_LIST_BS 256
+
+/* Bits set/cleared count pointer. */
+size_t (*bitcount)(void *old, void *new, size_t length, uint64_t *counts) =
+	bitcount_generic;
+
+/* Name patterns. */
+static char *patterns[BM_MAX_PATTERNS];
+static int npatterns;
+
+/* Patterns used by '--bitmap auto'. */
+static const char *const auto_patterns[] = {
+	"*flag*", "*mask*", "*bitmap*", "*bitset*", "*bits"
+};
+
+/**
+ * @brief List of bit ranges being formatted.
+ */
+struct bm_list
+{
+	char *buf;         /* Output buffer.              */
+	size_t size;       /* Buffer size.                */
+	size_t len;        /* Buffer length.              */
+	uint64_t first;    /* Current range start.        */
+	uint64_t last;     /* Current range end.          */
+	int open;          /* There is a current range.   */
+	uint64_t dropped;  /* Bits that did not fit.      */
+};
+
+/**
+ * @brief Adds a new variable name pattern (as in fnmatch(3)) to
+ * be reported as bitmap, or the built-in patterns, if 'auto'.
+ *
+ * @param pattern Name pattern.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int bm_add_pattern(const char *pattern)
+{
+	if (!strcmp(pattern, "auto"))
+	{
+		for (size_t i = 0; i < sizeof auto_patterns / sizeof *auto_patterns; i++)
+			if (bm_add_pattern(auto_patterns[i]) < 0)
+				return (-1);
+		return (0);
+	}
+
+	if (npatterns == BM_MAX_PATTERNS)
+	{
+		fprintf(stderr, "PBD: --bitmap: too many patterns (max: %d)\n",
+			BM_MAX_PATTERNS);
+		return (-1);
+	}
+
+	patterns[npatterns] = malloc(sizeof(char) * (strlen(pattern) + 1));
+	if (patterns[npatterns] == NULL)
+		return (-1);
+
+	strcpy(patterns[npatterns], pattern);
+	npatterns++;
+	return (0);
+}
+
+/**
+ * @brief Marks all the integer variables (and arrays of) whose
+ * names match any of the patterns as bitmaps.
+ *
+ * @param vars Variables list.
+ */
+void bm_mark(struct array *vars)
+{
+	for (int i = 0; i < (int) array_size(&vars); i++)
+	{
+		struct dw_variable *v;
+		int encoding;
+		int var_type;
+
+		v = array_get(&vars, i, NULL);
+		var_type = v->type.var_type;
+		encoding = v->type.encoding;
+
+		if (var_type == TARRAY)
+			var_type = v->type.array.var_type;
+
+		if (!(var_type & (TBASE_TYPE|TENUM)) ||
+			!(encoding & (ENC_SIGNED|ENC_UNSIGNED)))
+			continue;
+
+		for (int j = 0; j < npatterns; j++)
+		{
+			if (fnmatch(patterns[j], v->name, 0) == 0)
+			{
+				v->bitmap = 1;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Appends the current range of @p l into its buffer,
+ * or counts it as dropped, if it does not fit.
+ *
+ * @param l Bit list.
+ */
+static void bm_list_flush(struct bm_list *l)
+{
+	char item[48];
+	int n;
+
+	if (!l->open)
+		return;
+
+	if (l->first == l->last)
+		n = snprintf(item, sizeof item, "%s%" PRIu64, l->len ? "," : "",
+			l->first);
+	else
+		n = snprintf(item, sizeof item, "%s%" PRIu64 "-%" PRIu64,
+			l->len ? "," : "", l->first, l->last);
+
+	/* Keep room for the '...(+N)' suffix. */
+	if (l->dropped || l->len + n + 32 >= l->size)
+		l->dropped += l->last - l->first + 1;
+	else
+	{
+		memcpy(l->buf + l->len, item, n + 1);
+		l->len += n;
+	}
+	l->open = 0;
+}
+
+/**
+ * @brief Adds the bit @p bit to the list @p l, merging it into
+ * the current range when contiguous.
+ *
+ * @param l Bit list.
+ * @param bit Bit index.
+ */
+static inline void bm_list_add(struct bm_list *l, uint64_t bit)
+{
+	if (l->open && bit == l->last + 1)
+	{
+		l->last = bit;
+		return;
+	}
+
+	bm_list_flush(l);
+	l->first = bit;
+	l->last  = bit;
+	l->open  = 1;
+}
+
+/**
+ * @brief Counts the bits set (0 -> 1) and cleared (1 -> 0) from
+ * @p old to @p new, and adds them into @p counts.
+ *
+ * @param old Old contents.
+ * @param new New contents.
+ * @param length Contents length, in bytes.
+ * @param counts Bits set (counts[0]) and cleared (counts[1]).
+ *
+ * @return Returns @p length, i.e: the amount of bytes counted.
+ */
+size_t bitcount_generic(void *old, void *new, size_t length,
+	uint64_t *counts)
+{
+	const uint8_t *o; /* Old contents. */
+	const uint8_t *n; /* New contents. */
+	uint64_t wo, wn;  /* Words.        */
+	size_t off;       /* Offset.       */
+
+	o = old;
+	n = new;
+
+	for (off = 0; off + 8 <= length; off += 8)
+	{
+		memcpy(&wo, o + off, 8);
+		memcpy(&wn, n + off, 8);
+		counts[0] += __builtin_popcountll(~wo & wn);
+		counts[1] += __builtin_popcountll(~wn & wo);
+	}
+	for (; off < length; off++)
+	{
+		counts[0] += __builtin_popcount(~o[off] & n[off] & 0xFF);
+		counts[1] += __builtin_popcount(~n[off] & o[off] & 0xFF);
+	}
+	return (length);
+}
+
+/**
+ * @brief Adds the bits of the word @p bits, whose first bit is
+ * @p base, to the list @p l.
+ *
+ * @param l Bit list.
+ * @param bits Bits.
+ * @param base Index of the first bit of the word.
+ */
+static inline void bm_list_word(struct bm_list *l, uint64_t bits,
+	uint64_t base)
+{
+	/* List already full, only the amount of bits matters. */
+	if (l->dropped)
+	{
+		bm_list_flush(l);
+		l->dropped += __builtin_popcountll(bits);
+		return;
+	}
+
+	/* Whole word set, quite common for ranges. */
+	if (bits == UINT64_MAX && l->open && l->last + 1 == base)
+	{
+		l->last = base + 63;
+		return;
+	}
+
+	while (bits)
+	{
+		bm_list_add(l, base + __builtin_ctzll(bits));
+		bits &= bits - 1;
+	}
+}
+
+/**
+ * @brief Formats the bits set and cleared between @p old and
+ * @p new, like: +{5,17,32-63} -{9}.
+ *
+ * Equal spans are skipped with offmemcmp() (SIMD, when available)
+ * and the differing words are XORed and have their bits extracted
+ * with count trailing zeros. Once both lists are full, the bits
+ * left are only counted, with bitcount() (SIMD, when available).
+ * Bit N is the bit N % 8 of the byte N / 8, i.e: the element bits
+ * in little-endian.
+ *
+ * @param buffer Output buffer.
+ * @param size Output buffer size, should be at least BM_BS.
+ * @param old Old contents.
+ * @param new New contents.
+ * @param len Contents length, in bytes.
+ *
+ * @return Returns the formatted buffer.
+ */
+char *bm_format(char *buffer, size_t size, const void *old,
+	const void *new, size_t len)
+{
+	char set_buf[BM_LIST_BS];  /* Bits set.     */
+	char clr_buf[BM_LIST_BS];  /* Bits cleared. */
+	struct bm_list set;
+	struct bm_list clr;
+	const uint8_t *o;
+	const uint8_t *n;
+	uint64_t counts[2];
+	int64_t diff;
+	size_t done;
+	size_t off;
+
+	memset(&set, 0, sizeof set);
+	memset(&clr, 0, sizeof clr);
+	set.buf = set_buf; set.size = sizeof set_buf; set_buf[0] = '\0';
+	clr.buf = clr_buf; clr.size = sizeof clr_buf; clr_buf[0] = '\0';
+
+	o = old;
+	n = new;
+	off = 0;
+
+	while (off < len &&
+		(diff = offmemcmp((void *)(o + off), (void *)(n + off), 1,
+			len - off)) >= 0)
+	{
+		uint64_t wo, wn, x;
+		size_t chunk;
+
+		/* Word containing the first difference. */
+		off  += diff;
+		off  -= off % 8;
+		chunk = (len - off) < 8 ? (len - off) : 8;
+
+		wo = wn = 0;
+		memcpy(&wo, o + off, chunk);
+		memcpy(&wn, n + off, chunk);
+
+		x = wo ^ wn;
+		bm_list_word(&set, x & wn, (uint64_t)off * 8);
+		bm_list_word(&clr, x & wo, (uint64_t)off * 8);
+		off += chunk;
+
+		/* Both lists full, just count the remaining bits. */
+		if (set.dropped && clr.dropped)
+		{
+			bm_list_flush(&set);
+			bm_list_flush(&clr);
+
+			counts[0] = counts[1] = 0;
+			done = bitcount((void *)(o + off), (void *)(n + off),
+				len - off, counts);
+			off += done;
+			bitcount_generic((void *)(o + off), (void *)(n + off),
+				len - off, counts);
+
+			set.dropped += counts[0];
+			clr.dropped += counts[1];
+			break;
+		}
+	}
+
+	bm_list_flush(&set);
+	bm_list_flush(&clr);
+
+	if (set.dropped)
+		snprintf(set_buf + set.len, 32, ",...(+%" PRIu64 ")", set.dropped);
+	if (clr.dropped)
+		snprintf(clr_buf + clr.len, 32, ",...(+%" PRIu64 ")", clr.dropped);
+
+	if (set_buf[0] && clr_buf[0])
+		snprintf(buffer, size, "+{%s} -{%s}", set_buf, clr_buf);
+	else if (set_buf[0])
+		snprintf(buffer, size, "+{%s}", set_buf);
+	else if (clr_buf[0])
+		snprintf(buffer, size, "-{%s}", clr_buf);
+	else
+		snprintf(buffer, size, "{}");
+
+	return (buffer);
+}
+
+/**
+ * @brief Deallocates the patterns.
+ */
+void bm_finish(void)
+{
+	for (int i = 0; i < npatterns; i++)
+		free(patterns[i]);
+	npatterns = 0;
+}
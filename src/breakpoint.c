@@ -187,7 +187,7 @@ void bp_skipbreakpoint(struct breakpoint *bp, pid_t child)
 
 	/* Execute and wait. */
 	pt_continue_single_step(child);
-	pt_waitchild();
+	pt_waittracee(child);
 
 	/* Enables the breakpoint again. */
 	insn = (insn & ~0xFF) | BP_OPCODE;
@@ -0,0 +1,589 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "core.h"
+#include "pbd.h"
+#include "elf_helper.h"
+#include "function.h"
+#include "heatmap.h"
+#include "line.h"
+#include "strdiff.h"
+#include "variable.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/procfs.h>
+#include <sys/reg.h>
+#include <unistd.h>
+
+/* Registers, as found in the NT_PRSTATUS notes. */
+#if defined(__x86_64__)
+	#define CR_PC RIP
+	#define CR_BP RBP
+	#define CR_SP RSP
+	#define CR_CLASS ELFCLASS64
+#elif defined(__i386__)
+	#define CR_PC EIP
+	#define CR_BP EBP
+	#define CR_SP UESP
+	#define CR_CLASS ELFCLASS32
+#endif
+
+/**
+ * Variables snapshot of a single core file.
+ */
+struct cr_snapshot
+{
+	const char *file;         /* Core file.                    */
+	union var_value *values;  /* Values, per variable.         */
+	char *valid;              /* Value read?, per variable.    */
+	uintptr_t fp;             /* Target function frame.        */
+	unsigned line_no;         /* Line being executed.          */
+	int on_stack;             /* Is the function on the stack? */
+	int error;                /* Unable to read the core.      */
+	int prev;                 /* Previous valid snapshot.      */
+	char *out;                /* Diff output.                  */
+	size_t out_size;          /* Diff output size.             */
+};
+
+/* Snapshot series. */
+static struct cr_snapshot *cr_snaps;
+static int cr_nsnaps;
+static int cr_next;
+
+/* Target function. */
+static struct array *cr_vars;
+static struct dw_function *cr_func;
+static struct array *cr_lines;
+
+/**
+ * @brief Checks if the address @p pc belongs to the target
+ * function (whose high_pc is inclusive).
+ *
+ * @param pc Address.
+ *
+ * @return Returns 1 if it belongs and 0 otherwise.
+ */
+static inline int cr_in_function(uintptr_t pc)
+{
+	return (pc >= cr_func->low_pc && pc <= cr_func->high_pc);
+}
+
+/**
+ * @brief Finds the source line of the address @p pc, or the
+ * first line of the function, if not found.
+ *
+ * @param pc Address.
+ *
+ * @return Returns the line number.
+ */
+static unsigned cr_line(uintptr_t pc)
+{
+	struct dw_line *l;     /* Current line.   */
+	struct dw_line *best;  /* Closest line.   */
+	struct dw_line *first; /* Function start. */
+
+	best  = NULL;
+	first = NULL;
+
+	for (size_t i = 0; i < array_size(&cr_lines); i++)
+	{
+		l = array_get(&cr_lines, i, NULL);
+		if (!first || l->addr < first->addr)
+			first = l;
+		if (l->addr <= pc && (!best || l->addr > best->addr))
+			best = l;
+	}
+
+	if (!best)
+		best = first;
+	return (best ? best->line_no : 1);
+}
+
+/* Frame search state. */
+struct cr_frame
+{
+	struct elf_file *ef;
+	struct cr_snapshot *s;
+};
+
+/**
+ * @brief NT_PRSTATUS callback: walks the frame pointers of a
+ * thread until the target function is found.
+ *
+ * @param desc Note descriptor (struct elf_prstatus).
+ * @param size Descriptor size.
+ * @param data Frame search state.
+ *
+ * @return Returns 1 if the function was found (stopping the
+ * iteration) and 0 otherwise.
+ */
+static int cr_find_frame(const uint8_t *desc, size_t size, void *data)
+{
+	struct elf_prstatus prs;  /* Thread status.   */
+	struct cr_frame *fr;      /* Search state.    */
+	uintptr_t pc, bp, sp;     /* Frame registers. */
+	uintptr_t frame[2];       /* Saved bp, ret.   */
+	uintptr_t *stack;         /* Stack top.       */
+	size_t len;               /* Stack read.      */
+
+	if (size < sizeof(prs))
+		return (0);
+
+	fr = data;
+	memcpy(&prs, desc, sizeof(prs));
+	pc = prs.pr_reg[CR_PC];
+	bp = prs.pr_reg[CR_BP];
+	sp = prs.pr_reg[CR_SP];
+
+	/* Innermost frame. */
+	if (cr_in_function(pc))
+	{
+		fr->s->fp = bp;
+		fr->s->line_no = cr_line(pc);
+		return (1);
+	}
+
+	/* Walk through the frame pointers. */
+	for (int i = 0; i < CR_MAX_FRAMES && bp; i++)
+	{
+		if (elf_read_vaddr(fr->ef, bp, frame, sizeof(frame)) < 0)
+			break;
+
+		/*
+		 * The call instruction is right before the return, which
+		 * may be past the function end (e.g: noreturn calls).
+		 */
+		if (cr_in_function(frame[1] - 1))
+		{
+			fr->s->fp = frame[0];
+			fr->s->line_no = cr_line(frame[1] - 1);
+			return (1);
+		}
+
+		/* Stacks grow down. */
+		if (frame[0] <= bp)
+			break;
+		bp = frame[0];
+	}
+
+	/*
+	 * The thread is likely stopped inside a library (e.g: libc)
+	 * built without frame pointers, so scan the stack top for a
+	 * return address into the function, right after the saved
+	 * frame pointer of its callee.
+	 */
+	if ((stack = malloc(CR_STACK_SCAN)) == NULL)
+		return (0);
+
+	/* The stack may be smaller than that. */
+	len = CR_STACK_SCAN;
+	while (len > sizeof(frame) && elf_read_vaddr(fr->ef, sp, stack, len) < 0)
+		len /= 2;
+
+	if (len > sizeof(frame))
+	{
+		for (size_t i = 1; i < len / sizeof(uintptr_t); i++)
+		{
+			uintptr_t addr = sp + i * sizeof(uintptr_t);
+
+			if (!cr_in_function(stack[i] - 1) || stack[i - 1] <= addr ||
+				stack[i - 1] - addr > CR_STACK_SCAN)
+				continue;
+
+			fr->s->fp = stack[i - 1];
+			fr->s->line_no = cr_line(stack[i] - 1);
+			free(stack);
+			return (1);
+		}
+	}
+	free(stack);
+	return (0);
+}
+
+/**
+ * @brief Reads the variable @p v from the core file @p ef.
+ *
+ * @param ef Core file.
+ * @param s Snapshot.
+ * @param v Variable to be read.
+ * @param value Value read.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int cr_read_var(struct elf_file *ef, struct cr_snapshot *s,
+	struct dw_variable *v, union var_value *value)
+{
+	uintptr_t location;
+
+	if (v->scope == VGLOBAL)
+		location = v->location.address;
+	else if (s->on_stack)
+		location = s->fp + v->location.fp_offset;
+	else
+		return (-1);
+
+	/* Base types. */
+	if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+	{
+		if (v->byte_size > sizeof(value->u8_value))
+			return (-1);
+
+		memset(value, 0, sizeof(*value));
+		return (elf_read_vaddr(ef, location, value->u8_value, v->byte_size));
+	}
+
+	/* Arrays. */
+	else if (v->type.var_type == TARRAY &&
+		(v->type.array.var_type & (TBASE_TYPE|TENUM|TPOINTER)))
+	{
+		if ((value->p_value = malloc(v->byte_size)) == NULL)
+			return (-1);
+
+		if (elf_read_vaddr(ef, location, value->p_value, v->byte_size) < 0)
+		{
+			free(value->p_value);
+			return (-1);
+		}
+		return (0);
+	}
+
+	return (-1);
+}
+
+/**
+ * @brief Reads all the variables of the core file of the
+ * snapshot @p s.
+ *
+ * @param s Snapshot.
+ */
+static void cr_load(struct cr_snapshot *s)
+{
+	struct elf_file ef;    /* Core file.      */
+	struct cr_frame fr;    /* Frame search.   */
+	int nvars;             /* Variables.      */
+
+	nvars = (int) array_size(&cr_vars);
+	s->values = calloc(nvars, sizeof(union var_value));
+	s->valid  = calloc(nvars, sizeof(char));
+
+	if (!s->values || !s->valid || elf_open(&ef, s->file) < 0)
+	{
+		s->error = 1;
+		return;
+	}
+
+	/* Same architecture only. */
+	if (ef.type != ET_CORE || ef.elf_class != CR_CLASS)
+	{
+		s->error = 1;
+		elf_close(&ef);
+		return;
+	}
+
+	fr.ef = &ef;
+	fr.s  = s;
+	s->on_stack = elf_notes_iter(&ef, NT_PRSTATUS, cr_find_frame, &fr);
+
+	/* Function not running, points to its beginning. */
+	if (!s->on_stack)
+		s->line_no = cr_line(cr_func->low_pc);
+
+	for (int i = 0; i < nvars; i++)
+		s->valid[i] = !cr_read_var(&ef, s, array_get(&cr_vars, i, NULL),
+			&s->values[i]);
+
+	elf_close(&ef);
+}
+
+/**
+ * @brief Computes the element indexes of the array @p v, for
+ * the element @p elem.
+ *
+ * @param v Array variable.
+ * @param elem Element (flat) index.
+ * @param idxs Indexes, per dimension.
+ */
+static void cr_array_idxs(struct dw_variable *v, size_t elem, int *idxs)
+{
+	for (int j = v->type.array.dimensions - 1; j >= 0; j--)
+	{
+		idxs[j] = elem % v->type.array.elements_per_dimension[j];
+		elem /= v->type.array.elements_per_dimension[j];
+	}
+}
+
+/**
+ * @brief Compares the variable @p v between two snapshots and
+ * outputs its changes, using the current printer.
+ *
+ * @param v Variable.
+ * @param line_no Line number.
+ * @param old Value, previous snapshot.
+ * @param new Value, current snapshot.
+ */
+static void cr_diff_var(struct dw_variable *v, unsigned line_no,
+	union var_value *old, union var_value *new)
+{
+	int idxs[MATRIX_MAX_DIMENSIONS] = {0}; /* Element indexes. */
+	union var_value value1, value2;        /* Element values.  */
+	size_t size_per_element;               /* Element size.    */
+	int64_t byte_offset;                   /* Change offset.   */
+	size_t off;                            /* Current offset.  */
+
+	if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+	{
+		if (memcmp(old->u8_value, new->u8_value, v->byte_size))
+			line_output(1, line_no, v, old, new, NULL);
+		return;
+	}
+
+	/* Bitmaps and strings are reported at once. */
+	if (v->bitmap || v->string)
+	{
+		if (offmemcmp(old->p_value, new->p_value, 1, v->byte_size) >= 0 &&
+			(!v->string || sd_changed(old->p_value, new->p_value,
+			v->byte_size)))
+		{
+			if (args.flags & FLG_HEATMAP)
+				hm_update_range(v, old->p_value, new->p_value, 0, v->byte_size);
+
+			line_output(1, line_no, v, old, new, NULL);
+		}
+		return;
+	}
+
+	size_per_element = v->type.array.size_per_element;
+	off = 0;
+
+	while (off < v->byte_size &&
+		(byte_offset = offmemcmp(old->p_value + off, new->p_value + off,
+		size_per_element, v->byte_size - off)) >= 0)
+	{
+		off += byte_offset;
+
+		memcpy(value1.u8_value, old->p_value + off, size_per_element);
+		memcpy(value2.u8_value, new->p_value + off, size_per_element);
+
+		if (args.flags & FLG_HEATMAP)
+			hm_update(v, off / size_per_element);
+
+		cr_array_idxs(v, off / size_per_element, idxs);
+		line_output(1, line_no, v, &value1, &value2, idxs);
+
+		off += size_per_element;
+	}
+}
+
+/**
+ * @brief Compares the snapshot @p s with its previous valid
+ * snapshot and writes the changes into its own output buffer.
+ *
+ * @param s Snapshot.
+ */
+static void cr_diff(struct cr_snapshot *s)
+{
+	struct cr_snapshot *p;
+	FILE *out;
+
+	if ((out = open_memstream(&s->out, &s->out_size)) == NULL)
+		return;
+
+	pbd_output = out;
+
+	fn_printf(1, 0, "[Core: %s] (%s) %s, line: %u\n", s->file,
+		args.function, s->on_stack ? "on the stack" : "not running",
+		s->line_no);
+
+	if (s->prev >= 0)
+	{
+		p = &cr_snaps[s->prev];
+
+		for (int i = 0; i < (int) array_size(&cr_vars); i++)
+		{
+			struct dw_variable *v;
+			v = array_get(&cr_vars, i, NULL);
+
+			if (!p->valid[i] || !s->valid[i])
+				continue;
+
+			/* Locals of different calls are not comparable. */
+			if (v->scope != VGLOBAL && p->fp != s->fp)
+				continue;
+
+			cr_diff_var(v, s->line_no, &p->values[i], &s->values[i]);
+		}
+	}
+
+	fclose(out);
+}
+
+/**
+ * @brief Worker thread: loads (or compares, if @p arg is not
+ * NULL) the snapshots, one at a time.
+ *
+ * @param arg If not NULL, compares instead of loading.
+ *
+ * @return Always NULL.
+ */
+static void *cr_worker(void *arg)
+{
+	int i;
+
+	while ((i = __atomic_fetch_add(&cr_next, 1, __ATOMIC_RELAXED)) < cr_nsnaps)
+	{
+		if (arg)
+		{
+			if (!cr_snaps[i].error)
+				cr_diff(&cr_snaps[i]);
+		}
+		else
+			cr_load(&cr_snaps[i]);
+	}
+	return (NULL);
+}
+
+/**
+ * @brief Runs @p nthreads workers over all the snapshots, and
+ * waits for them.
+ *
+ * @param nthreads Amount of threads.
+ * @param diff If set, compares the snapshots, otherwise, loads
+ * them.
+ */
+static void cr_parallel(int nthreads, int diff)
+{
+	pthread_t *threads;
+	int started;
+
+	cr_next = 0;
+	started = 0;
+
+	threads = calloc(nthreads, sizeof(pthread_t));
+	for (int i = 0; threads && i < nthreads; i++, started++)
+		if (pthread_create(&threads[i], NULL, cr_worker, diff ? cr_snaps : NULL))
+			break;
+
+	/* If no thread could be created, do everything here. */
+	if (!started)
+		cr_worker(diff ? cr_snaps : NULL);
+
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+}
+
+/**
+ * @brief Compares the variables @p vars of the target function
+ * @p func along the core files @p cores, in order.
+ *
+ * The core files are read and compared in parallel, but the
+ * output follows the order of the snapshots.
+ *
+ * @param cores Core files list.
+ * @param vars Variables list.
+ * @param func Target function.
+ * @param lines Function lines.
+ *
+ * @return Returns the amount of core files that could not be
+ * read.
+ */
+int cr_run(struct array *cores, struct array *vars,
+	struct dw_function *func, struct array *lines)
+{
+	FILE *out;      /* Main output.          */
+	long nprocs;    /* Online CPUs.          */
+	int nthreads;   /* Worker threads.       */
+	int errors;     /* Unreadable cores.     */
+	int prev;       /* Last valid snapshot.  */
+
+	cr_nsnaps = (int) array_size(&cores);
+	cr_vars   = vars;
+	cr_func   = func;
+	cr_lines  = lines;
+
+	if ((cr_snaps = calloc(cr_nsnaps, sizeof(struct cr_snapshot))) == NULL)
+		return (cr_nsnaps);
+
+	for (int i = 0; i < cr_nsnaps; i++)
+		cr_snaps[i].file = array_get(&cores, i, NULL);
+
+	/* All variables already have a value. */
+	for (int i = 0; i < (int) array_size(&vars); i++)
+		((struct dw_variable *)array_get(&vars, i, NULL))->initialized = 1;
+
+	nprocs   = sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads = (nprocs > 0 && nprocs < cr_nsnaps) ? (int)nprocs : cr_nsnaps;
+
+	/* Load all of them. */
+	cr_parallel(nthreads, 0);
+
+	/* Each snapshot is compared against the previous valid one. */
+	prev = -1;
+	errors = 0;
+	for (int i = 0; i < cr_nsnaps; i++)
+	{
+		cr_snaps[i].prev = prev;
+		if (cr_snaps[i].error)
+			errors++;
+		else
+			prev = i;
+	}
+
+	out = pbd_output;
+	cr_parallel(nthreads, 1);
+	pbd_output = out;
+
+	/* Output, in order. */
+	for (int i = 0; i < cr_nsnaps; i++)
+	{
+		struct cr_snapshot *s = &cr_snaps[i];
+
+		if (s->error)
+			fprintf(stderr, "PBD: unable to read the core file %s, "
+				"skipping!\n", s->file);
+		else if (s->out)
+			fwrite(s->out, 1, s->out_size, out);
+
+		/* Deallocate. */
+		for (int j = 0; s->values && j < (int) array_size(&vars); j++)
+		{
+			struct dw_variable *v = array_get(&vars, j, NULL);
+			if (s->valid[j] && v->type.var_type == TARRAY)
+				free(s->values[j].p_value);
+		}
+
+		free(s->values);
+		free(s->valid);
+		free(s->out);
+	}
+
+	free(cr_snaps);
+	cr_snaps = NULL;
+	return (errors);
+}
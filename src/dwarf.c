@@ -31,28 +31,23 @@
 #include <limits.h>
 
 /**
- * Initializes the use of libdwarf library.
+ * Initializes the use of libdwarf library, for the file
+ * already set in @p dw.
  *
- * @param file Elf file to be read.
- * @param Dwarf Utils structure.
- *
- * @return If success, returns 0.
+ * @param dw Dwarf Utils structure.
  */
-int *dw_init(const char *file, struct dw_utils *dw)
+static void dw_libdwarf_init(struct dw_utils *dw)
 {
 	Dwarf_Error error;      /* Error code.      */
 	Dwarf_Handler errhand;  /* Error handler.   */
 	Dwarf_Ptr errarg;       /* Error argument.  */
 	int res;                /* Return code.     */
 
-	/* Clear structure. */
-	memset(dw, 0, sizeof(struct dw_utils));
-
 	/* Open file. */
-	dw->fd = open(file, O_RDONLY);
+	dw->fd = open(dw->file, O_RDONLY);
 	if (dw->fd < 0)
 		QUIT(EXIT_FAILURE, "Cannot open file (%s), please check if the\n"
-		    "file exists and have R/X permissions!\n", file);
+		    "file exists and have R/X permissions!\n", dw->file);
 
 	/* Initializes dwarf. */
 	errhand = NULL;
@@ -62,9 +57,51 @@ int *dw_init(const char *file, struct dw_utils *dw)
 		QUIT(EXIT_FAILURE, "Cannot process file\n");
 
 	dw->initialized = 1;
+}
+
+/**
+ * Initializes the DWARF reading: the internal reader, if
+ * able to read the file, or the libdwarf library, otherwise.
+ *
+ * @param file Elf file to be read.
+ * @param Dwarf Utils structure.
+ *
+ * @return If success, returns 0.
+ */
+int *dw_init(const char *file, struct dw_utils *dw)
+{
+	/* Clear structure. */
+	memset(dw, 0, sizeof(struct dw_utils));
+	dw->fd = -1;
+	dw->file = file;
+
+	if (!(args.flags & FLG_LIBDWARF) && !dwr_init(&dw->reader, file))
+	{
+		dw->internal = 1;
+		return (0);
+	}
+
+	dw_libdwarf_init(dw);
 	return (0);
 }
 
+/**
+ * Switches from the internal reader to the libdwarf, when
+ * the former is not able to read something. The target
+ * function, if any, is searched again.
+ *
+ * @param dw Dwarf Utils structure.
+ */
+static void dw_fallback(struct dw_utils *dw)
+{
+	dwr_finish(&dw->reader);
+	dw->internal = 0;
+
+	dw_libdwarf_init(dw);
+	if (dw->func != NULL)
+		dw_get_address_by_function(dw, dw->func);
+}
+
 /**
  * Finalizes the use of libdwarf library.
  *
@@ -77,6 +114,9 @@ void dw_finish(struct dw_utils *dw)
 	if (dw == NULL)
 		return;
 
+	if (dw->internal)
+		dwr_finish(&dw->reader);
+
 	if (dw->initialized)
 		dwarf_finish(dw->dbg, &error);
 
@@ -84,6 +124,7 @@ void dw_finish(struct dw_utils *dw)
 		close(dw->fd);
 
 	/* Invalidate flags to avoid double finishing. */
+	dw->internal = 0;
 	dw->initialized = 0;
 	dw->fd = -1;
 }
@@ -630,6 +671,17 @@ int dw_get_address_by_function
 	dw->dw_func.low_pc = 0;
 	dw->cu_die = NULL;
 	dw->fn_die = NULL;
+	dw->func = func;
+
+	if (dw->internal)
+	{
+		if (!dwr_get_address_by_function(&dw->reader, func, &dw->dw_func))
+			return (0);
+
+		/* Not found or not readable, let libdwarf try. */
+		dw_fallback(dw);
+		return (0);
+	}
 
 	/*
 	 * Loop through all compile units and searchs
@@ -842,6 +894,13 @@ struct array *dw_get_all_variables(struct dw_utils *dw)
 	struct dw_variable *var;   /* Variable.        */
 	struct array *vars;        /* Variables array. */
 
+	if (dw->internal)
+	{
+		if ((vars = dwr_get_all_variables(&dw->reader, &dw->dw_func)) != NULL)
+			return (vars);
+		dw_fallback(dw);
+	}
+
 	/* Invalid Compile Unit. */
 	if (!dw->cu_die)
 		QUIT(EXIT_FAILURE, "Compile Unit not found!\n");
@@ -970,6 +1029,14 @@ struct array *dw_get_all_lines(struct dw_utils *dw)
 	struct dw_line *line;      /* Line.                   */
 	struct array *array_lines; /* Line array.             */
 
+	if (dw->internal)
+	{
+		array_lines = dwr_get_all_lines(&dw->reader, &dw->dw_func);
+		if (array_lines != NULL)
+			return (array_lines);
+		dw_fallback(dw);
+	}
+
 	/* Invalid Compile Unit. */
 	if (!dw->cu_die)
 		QUIT(EXIT_FAILURE, "Compile Unit not found!\n");
@@ -1079,6 +1146,13 @@ char *dw_get_source_file(struct dw_utils *dw)
 	Dwarf_Bool battr;      /* Boolean.           */
 	Dwarf_Attribute attr;  /* Attribute.         */
 
+	if (dw->internal)
+	{
+		if ((filename = dwr_get_source_file(&dw->reader)) != NULL)
+			return (filename);
+		dw_fallback(dw);
+	}
+
 	/* Invalid Compile Unit. */
 	if (!dw->cu_die)
 		QUIT(EXIT_FAILURE, "Compile Unit not found!\n");
@@ -1137,6 +1211,14 @@ int dw_is_c_language(struct dw_utils *dw)
 
 	ret = 0;
 
+	if (dw->internal)
+	{
+		if ((ret = dwr_is_c_language(&dw->reader)) >= 0)
+			return (ret);
+		ret = 0;
+		dw_fallback(dw);
+	}
+
 	/* Invalid Compile Unit. */
 	if (!dw->cu_die)
 		QUIT(EXIT_FAILURE, "Compile Unit not found!\n");
@@ -1201,3 +1283,384 @@ void dw_lines_array_free(struct array *lines)
 	}
 	array_finish(&lines);
 }
+
+/**
+ * Searches the variable (or parameter) @p name between the
+ * children of @p parent.
+ *
+ * @param dw Dwarf Utils structure pointer.
+ * @param parent Parent DIE: subprogram or Compile Unit.
+ * @param name Variable name.
+ * @param var_die Variable DIE found.
+ *
+ * @return Returns 0 if found and a negative number otherwise.
+ */
+static int dw_find_variable(struct dw_utils *dw, Dwarf_Die parent,
+	const char *name, Dwarf_Die *var_die)
+{
+	Dwarf_Die child0, child1;  /* Siblings.   */
+	Dwarf_Error error;         /* Error code. */
+	Dwarf_Half tag;            /* Tag.        */
+	char *n;                   /* DIE name.   */
+	int found;                 /* Found?.     */
+
+	if (dwarf_child(parent, &child1, &error) != DW_DLV_OK)
+		return (-1);
+
+	found = 0;
+	do
+	{
+		child0 = child1;
+
+		if (dwarf_tag(child1, &tag, &error) == DW_DLV_OK &&
+			(tag == DW_TAG_variable || tag == DW_TAG_formal_parameter) &&
+			dwarf_diename(child1, &n, &error) == DW_DLV_OK)
+		{
+			found = !strcmp(n, name);
+			dwarf_dealloc(dw->dbg, n, DW_DLA_STRING);
+
+			if (found)
+			{
+				*var_die = child1;
+				return (0);
+			}
+		}
+
+		if (dwarf_siblingof(dw->dbg, child0, &child1, &error) != DW_DLV_OK)
+			break;
+
+		dwarf_dealloc(dw->dbg, child0, DW_DLA_DIE);
+	} while (1);
+
+	dwarf_dealloc(dw->dbg, child0, DW_DLA_DIE);
+	return (-1);
+}
+
+/**
+ * Gets the type DIE of @p die, skipping typedefs and qualifiers.
+ *
+ * @param dw Dwarf Utils structure pointer.
+ * @param die DIE with a type.
+ * @param type_die Type DIE.
+ * @param tag Type tag.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dw_type_die(struct dw_utils *dw, Dwarf_Die die,
+	Dwarf_Die *type_die, Dwarf_Half *tag)
+{
+	Dwarf_Error error;     /* Error code. */
+	Dwarf_Attribute attr;  /* Attribute.  */
+	Dwarf_Off offset;      /* Offset.     */
+
+	*type_die = die;
+	do
+	{
+		if (dwarf_attr(*type_die, DW_AT_type, &attr, &error))
+			return (-1);
+		if (dwarf_global_formref(attr, &offset, &error))
+			return (-1);
+		if (dwarf_offdie_b(dw->dbg, offset, 1, type_die, &error))
+			return (-1);
+		if (dwarf_tag(*type_die, tag, &error))
+			return (-1);
+
+	} while (*tag == DW_TAG_typedef || *tag == DW_TAG_const_type ||
+		*tag == DW_TAG_volatile_type);
+
+	return (0);
+}
+
+/**
+ * Reads the offset of the member DIE @p die: a constant or,
+ * as in DWARF 2, a DW_OP_plus_uconst expression.
+ *
+ * @param dw Dwarf Utils structure pointer.
+ * @param die Member DIE.
+ * @param offset Member offset.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dw_member_offset(struct dw_utils *dw, Dwarf_Die die,
+	Dwarf_Unsigned *offset)
+{
+	Dwarf_Error error;      /* Error code.              */
+	Dwarf_Attribute attr;   /* Attribute.               */
+	Dwarf_Locdesc **llbuf;  /* Location descriptor buf. */
+	Dwarf_Signed lcnt;      /* Location count.          */
+	Dwarf_Bool battr;       /* Boolean.                 */
+	Dwarf_Half form;        /* Attribute form.          */
+	int retcode;            /* Return code.             */
+
+	/* Union members do not have a location. */
+	if (dwarf_hasattr(die, DW_AT_data_member_location, &battr, &error) ||
+		!battr)
+	{
+		*offset = 0;
+		return (0);
+	}
+
+	if (dwarf_attr(die, DW_AT_data_member_location, &attr, &error) ||
+		dwarf_whatform(attr, &form, &error))
+		return (-1);
+
+	if (form != DW_FORM_block1 && form != DW_FORM_block2 &&
+		form != DW_FORM_block4 && form != DW_FORM_block &&
+		form != DW_FORM_exprloc)
+	{
+		return (dwarf_formudata(attr, offset, &error) ? -1 : 0);
+	}
+
+	if (dwarf_loclist_n(attr, &llbuf, &lcnt, &error))
+		return (-1);
+
+	retcode = -1;
+	if (lcnt == 1 && llbuf[0]->ld_cents == 1 &&
+		llbuf[0]->ld_s[0].lr_atom == DW_OP_plus_uconst)
+	{
+		*offset = llbuf[0]->ld_s[0].lr_number;
+		retcode = 0;
+	}
+
+	for (int i = 0; i < lcnt; i++)
+	{
+		dwarf_dealloc(dw->dbg, llbuf[i]->ld_s, DW_DLA_LOC_BLOCK);
+		dwarf_dealloc(dw->dbg, llbuf[i], DW_DLA_LOCDESC);
+	}
+	dwarf_dealloc(dw->dbg, llbuf, DW_DLA_LIST);
+	return (retcode);
+}
+
+/**
+ * Gets the pointer variable @p name, a local of the target
+ * function or a global of its Compile Unit, and the members
+ * of the structure it points to.
+ *
+ * Only the members PBD is able to show (base types, enums
+ * and pointers) are returned; bit-fields are ignored.
+ *
+ * @param dw Dwarf Utils structure pointer.
+ * @param name Variable name.
+ * @param members Returned structure members (struct dw_member).
+ * @param struct_size Returned structure size, in bytes.
+ *
+ * @return Returns the variable or NULL if not found or not a
+ * pointer to a structure.
+ */
+struct dw_variable *dw_get_struct_pointer(struct dw_utils *dw,
+	const char *name, struct array **members, size_t *struct_size)
+{
+	Dwarf_Die var_die;         /* Variable DIE.    */
+	Dwarf_Die type_die;        /* Type DIE.        */
+	Dwarf_Die child0, child1;  /* Members.         */
+	Dwarf_Die tmp;             /* Member type.     */
+	Dwarf_Error error;         /* Error code.      */
+	Dwarf_Attribute attr;      /* Attribute.       */
+	Dwarf_Unsigned value;      /* Attribute value. */
+	Dwarf_Bool battr;          /* Boolean.         */
+	Dwarf_Half tag;            /* Tag.             */
+	struct dw_variable *var;   /* Variable.        */
+	struct dw_member *m;       /* Member.          */
+	char *n;                   /* Member name.     */
+
+	if (dw->internal)
+	{
+		if ((var = dwr_get_struct_pointer(&dw->reader, &dw->dw_func, name,
+			members, struct_size)) != NULL)
+			return (var);
+		dw_members_free(*members);
+		dw_fallback(dw);
+	}
+
+	*members = NULL;
+
+	if (dw_find_variable(dw, dw->fn_die, name, &var_die) &&
+		dw_find_variable(dw, dw->cu_die, name, &var_die))
+		return (NULL);
+
+	/* Pointer to structure. */
+	if (dw_type_die(dw, var_die, &type_die, &tag) ||
+		tag != DW_TAG_pointer_type ||
+		dw_type_die(dw, type_die, &type_die, &tag) ||
+		tag != DW_TAG_structure_type)
+		return (NULL);
+
+	if (dwarf_attr(type_die, DW_AT_byte_size, &attr, &error) ||
+		dwarf_formudata(attr, &value, &error))
+		return (NULL);
+
+	*struct_size = value;
+
+	var = calloc(1, sizeof(struct dw_variable));
+	if (dw_parse_variable_location(&var_die, dw, var) ||
+		dw_parse_variable_type(&var_die, dw, var))
+	{
+		free(var);
+		return (NULL);
+	}
+	var->name = malloc(sizeof(char) * (strlen(name) + 1));
+	strcpy(var->name, name);
+
+	/* Members, only the ones PBD is able to show. */
+	array_init(members);
+	if (dwarf_child(type_die, &child1, &error) != DW_DLV_OK)
+		return (var);
+
+	do
+	{
+		child0 = child1;
+
+		if (dwarf_tag(child1, &tag, &error) != DW_DLV_OK ||
+			tag != DW_TAG_member ||
+			(!dwarf_hasattr(child1, DW_AT_bit_size, &battr, &error) && battr) ||
+			dwarf_diename(child1, &n, &error) != DW_DLV_OK)
+			continue;
+
+		m = calloc(1, sizeof(struct dw_member));
+		if (dw_member_offset(dw, child1, &value) ||
+			dw_parse_variable_base_type(&child1, dw, &m->byte_size,
+				&m->var_type, &m->encoding, &tmp) ||
+			!(m->var_type & (TBASE_TYPE|TENUM|TPOINTER)))
+		{
+			dwarf_dealloc(dw->dbg, n, DW_DLA_STRING);
+			free(m);
+			continue;
+		}
+
+		m->offset = value;
+		m->name = malloc(sizeof(char) * (strlen(n) + 1));
+		strcpy(m->name, n);
+		dwarf_dealloc(dw->dbg, n, DW_DLA_STRING);
+		array_add(members, m);
+
+	} while (dwarf_siblingof(dw->dbg, child0, &child1, &error) == DW_DLV_OK);
+
+	return (var);
+}
+
+/**
+ * @brief Deallocates the structure members returned by
+ * dw_get_struct_pointer().
+ *
+ * @param members Members list.
+ */
+void dw_members_free(struct array *members)
+{
+	struct dw_member *m;
+
+	if (members == NULL)
+		return;
+
+	while (array_size(&members) > 0)
+	{
+		m = array_remove_last(&members, NULL);
+		free(m->name);
+		free(m);
+	}
+	array_finish(&members);
+}
+
+/**
+ * Gets the enumerators of the enumeration type of the variable
+ * @p name (or of its elements, if an array), a local of the
+ * target function or a global of its Compile Unit.
+ *
+ * @param dw Dwarf Utils structure pointer.
+ * @param name Variable name.
+ *
+ * @return Returns the enumerators (struct dw_enumerator) or NULL
+ * if not found or not an enumeration.
+ */
+struct array *dw_get_enumerators(struct dw_utils *dw, const char *name)
+{
+	Dwarf_Die var_die;         /* Variable DIE.     */
+	Dwarf_Die type_die;        /* Type DIE.         */
+	Dwarf_Die child0, child1;  /* Enumerators.      */
+	Dwarf_Error error;         /* Error code.       */
+	Dwarf_Attribute attr;      /* Attribute.        */
+	Dwarf_Unsigned value;      /* Enumerator value. */
+	Dwarf_Signed svalue;       /* Signed value.     */
+	Dwarf_Half form;           /* Attribute form.   */
+	Dwarf_Half tag;            /* Tag.              */
+	struct dw_enumerator *e;   /* Enumerator.       */
+	struct array *enums;       /* Enumerators.      */
+	char *n;                   /* Enumerator name.  */
+
+	if (dw->internal)
+	{
+		if ((enums = dwr_get_enumerators(&dw->reader, name)) != NULL)
+			return (enums);
+		dw_fallback(dw);
+	}
+
+	if (dw_find_variable(dw, dw->fn_die, name, &var_die) &&
+		dw_find_variable(dw, dw->cu_die, name, &var_die))
+		return (NULL);
+
+	/* Enumeration, or array of enumerations. */
+	if (dw_type_die(dw, var_die, &type_die, &tag) ||
+		(tag == DW_TAG_array_type &&
+		dw_type_die(dw, type_die, &type_die, &tag)) ||
+		tag != DW_TAG_enumeration_type)
+		return (NULL);
+
+	array_init(&enums);
+	if (dwarf_child(type_die, &child1, &error) != DW_DLV_OK)
+		return (enums);
+
+	do
+	{
+		child0 = child1;
+
+		if (dwarf_tag(child1, &tag, &error) != DW_DLV_OK ||
+			tag != DW_TAG_enumerator ||
+			dwarf_attr(child1, DW_AT_const_value, &attr, &error) ||
+			dwarf_whatform(attr, &form, &error))
+			continue;
+
+		/* Negative values are sign-extended. */
+		if (form == DW_FORM_sdata)
+		{
+			if (dwarf_formsdata(attr, &svalue, &error))
+				continue;
+			value = (Dwarf_Unsigned)svalue;
+		}
+		else if (dwarf_formudata(attr, &value, &error))
+			continue;
+
+		if (dwarf_diename(child1, &n, &error) != DW_DLV_OK)
+			continue;
+
+		e = malloc(sizeof(struct dw_enumerator));
+		e->name = malloc(sizeof(char) * (strlen(n) + 1));
+		strcpy(e->name, n);
+		e->value = value;
+		dwarf_dealloc(dw->dbg, n, DW_DLA_STRING);
+		array_add(&enums, e);
+
+	} while (dwarf_siblingof(dw->dbg, child0, &child1, &error) == DW_DLV_OK);
+
+	return (enums);
+}
+
+/**
+ * @brief Deallocates the enumerators returned by
+ * dw_get_enumerators().
+ *
+ * @param enums Enumerators list.
+ */
+void dw_enumerators_free(struct array *enums)
+{
+	struct dw_enumerator *e;
+
+	if (enums == NULL)
+		return;
+
+	while (array_size(&enums) > 0)
+	{
+		e = array_remove_last(&enums, NULL);
+		free(e->name);
+		free(e);
+	}
+	array_finish(&enums);
+}
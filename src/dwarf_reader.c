@@ -0,0 +1,2057 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Minimal, purpose-built DWARF reader.
+ *
+ * libdwarf is a generic library and as such, allocates (and
+ * expects us to deallocate) every single DIE, attribute and
+ * string we touch, which dominates the startup time on large
+ * binaries. This reader only covers what PBD needs: CU headers,
+ * abbreviation tables, DIE walking (with skip-by-sibling),
+ * location expressions/lists and the line number program, and
+ * works directly over the mmap'ed ELF file, without any per-DIE
+ * allocation.
+ *
+ * Only DWARF versions 2, 3 and 4 (32 and 64-bit formats) are
+ * supported; anything else makes the routines fail and PBD
+ * falls back to libdwarf.
+ */
+
+#include <dwarf.h>
+#include <limits.h>
+
+#include "dwarf_helper.h"
+#include "dwarf_reader.h"
+#include "hashtable.h"
+#include "line.h"
+#include "pbd.h"
+
+/* Maximum location entries we care about. */
+#define DWR_MAX_LOCS 32
+
+/* Maximum abbreviation code supported. */
+#define DWR_MAX_ABBREV_CODE (1 << 20)
+
+/**
+ * @brief Bounded cursor over a section.
+ */
+struct dwr_buf
+{
+	const uint8_t *p;
+	const uint8_t *end;
+	int err;
+};
+
+/**
+ * @brief Location entry, similar to libdwarf's Dwarf_Loc, but
+ * only with the first operation of the expression.
+ */
+struct dwr_loc
+{
+	uint8_t atom;   /* First operation.        */
+	int64_t number; /* First operand, if any.  */
+	int ops;        /* Amount of operations.   */
+};
+
+/* ------------------------------------------------------------------------*
+ * Primitive readers                                                       *
+ * ------------------------------------------------------------------------*/
+
+/**
+ * @brief Initializes a cursor @p b at @p off in the section @p sec.
+ */
+static inline void dwr_buf_init(struct dwr_buf *b,
+	const struct elf_section *sec, uint64_t off)
+{
+	b->err = (off > sec->size);
+	b->p   = sec->data + (b->err ? sec->size : off);
+	b->end = sec->data + sec->size;
+}
+
+/**
+ * @brief Reads a little-endian fixed-size integer of @p size bytes.
+ */
+static inline uint64_t dwr_fixed(struct dwr_buf *b, int size)
+{
+	uint64_t v = 0;
+	if (b->end - b->p < size)
+	{
+		b->err = 1;
+		b->p = b->end;
+		return (0);
+	}
+	for (int i = 0; i < size; i++)
+		v |= (uint64_t)b->p[i] << (i * 8);
+	b->p += size;
+	return (v);
+}
+
+/**
+ * @brief Reads an unsigned LEB128 number.
+ */
+static inline uint64_t dwr_uleb(struct dwr_buf *b)
+{
+	uint64_t v = 0;
+	int shift = 0;
+	while (b->p < b->end)
+	{
+		uint8_t byte = *b->p++;
+		if (shift < 64)
+			v |= (uint64_t)(byte & 0x7F) << shift;
+		shift += 7;
+		if (!(byte & 0x80))
+			return (v);
+	}
+	b->err = 1;
+	return (0);
+}
+
+/**
+ * @brief Reads a signed LEB128 number.
+ */
+static inline int64_t dwr_sleb(struct dwr_buf *b)
+{
+	uint64_t v = 0;
+	int shift = 0;
+	while (b->p < b->end)
+	{
+		uint8_t byte = *b->p++;
+		if (shift < 64)
+			v |= (uint64_t)(byte & 0x7F) << shift;
+		shift += 7;
+		if (!(byte & 0x80))
+		{
+			if (shift < 64 && (byte & 0x40))
+				v |= -((uint64_t)1 << shift);
+			return ((int64_t)v);
+		}
+	}
+	b->err = 1;
+	return (0);
+}
+
+/**
+ * @brief Reads a NUL-terminated string, returning a pointer to it.
+ */
+static inline const char *dwr_cstr(struct dwr_buf *b)
+{
+	const uint8_t *s = b->p;
+	while (b->p < b->end && *b->p)
+		b->p++;
+	if (b->p >= b->end)
+	{
+		b->err = 1;
+		return (NULL);
+	}
+	b->p++;
+	return ((const char *)s);
+}
+
+/**
+ * @brief Skips @p n bytes.
+ */
+static inline void dwr_skip(struct dwr_buf *b, uint64_t n)
+{
+	if ((uint64_t)(b->end - b->p) < n)
+	{
+		b->err = 1;
+		b->p = b->end;
+		return;
+	}
+	b->p += n;
+}
+
+/* ------------------------------------------------------------------------*
+ * Units, abbreviations and DIEs                                           *
+ * ------------------------------------------------------------------------*/
+
+/**
+ * @brief Reads the Compile Unit header found at @p off.
+ *
+ * @param r DWARF reader.
+ * @param off Unit offset inside .debug_info.
+ * @param cu Compile Unit structure to be filled.
+ *
+ * @return Returns 1 if success, 0 if there is no more units and
+ * a negative number if error or unsupported unit.
+ */
+static int dwr_cu_read(struct dwr *r, uint64_t off, struct dwr_cu *cu)
+{
+	struct dwr_buf b;  /* Cursor.      */
+	uint64_t length;   /* Unit length. */
+
+	if (off >= r->info.size)
+		return (0);
+
+	dwr_buf_init(&b, &r->info, off);
+	cu->offset = off;
+	cu->offset_size = 4;
+
+	length = dwr_fixed(&b, 4);
+	if (length == 0xffffffff)
+	{
+		cu->offset_size = 8;
+		length = dwr_fixed(&b, 8);
+	}
+	else if (length >= 0xfffffff0)
+		return (-1);
+
+	if (b.err || length > (uint64_t)(b.end - b.p))
+		return (-1);
+
+	cu->end = (b.p - r->info.data) + length;
+	cu->version = dwr_fixed(&b, 2);
+	cu->abbrev_offset = dwr_fixed(&b, cu->offset_size);
+	cu->addr_size = dwr_fixed(&b, 1);
+	cu->die_offset = b.p - r->info.data;
+
+	if (b.err || cu->version < 2 || cu->version > 4 ||
+		(cu->addr_size != 4 && cu->addr_size != 8))
+		return (-1);
+
+	return (1);
+}
+
+/**
+ * @brief Loads (if not already cached) the abbreviation table for
+ * the Compile Unit @p cu.
+ *
+ * The table is a plain array indexed by the abbreviation code,
+ * pointing to the tag of each abbreviation, inside .debug_abbrev.
+ *
+ * @param r DWARF reader.
+ * @param cu Compile Unit.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_abbrev_load(struct dwr *r, struct dwr_cu *cu)
+{
+	struct dwr_buf b;  /* Cursor.            */
+	uint64_t code;     /* Abbreviation code. */
+
+	if (r->abbrevs_valid && r->abbrevs_offset == cu->abbrev_offset)
+		return (0);
+
+	r->abbrevs_valid = 0;
+	if (r->abbrevs)
+		memset(r->abbrevs, 0, r->abbrevs_size * sizeof(uint8_t *));
+
+	dwr_buf_init(&b, &r->abbrev, cu->abbrev_offset);
+	while (!b.err && (code = dwr_uleb(&b)) != 0)
+	{
+		if (code >= DWR_MAX_ABBREV_CODE)
+			return (-1);
+
+		/* Grow table, if needed. */
+		if (code >= r->abbrevs_size)
+		{
+			const uint8_t **tmp;
+			size_t new_size;
+
+			new_size = r->abbrevs_size ? r->abbrevs_size : 64;
+			while (new_size <= code)
+				new_size *= 2;
+
+			tmp = realloc(r->abbrevs, new_size * sizeof(uint8_t *));
+			if (!tmp)
+				return (-1);
+
+			memset(tmp + r->abbrevs_size, 0,
+				(new_size - r->abbrevs_size) * sizeof(uint8_t *));
+
+			r->abbrevs = tmp;
+			r->abbrevs_size = new_size;
+		}
+
+		r->abbrevs[code] = b.p;
+
+		/* Skip tag, children and the attribute specs. */
+		dwr_uleb(&b);
+		dwr_skip(&b, 1);
+		while (!b.err)
+		{
+			uint64_t name = dwr_uleb(&b);
+			uint64_t form = dwr_uleb(&b);
+			if (!name && !form)
+				break;
+		}
+	}
+
+	if (b.err)
+		return (-1);
+
+	r->abbrevs_offset = cu->abbrev_offset;
+	r->abbrevs_valid = 1;
+	return (0);
+}
+
+/**
+ * @brief Skips the value of an attribute of form @p form.
+ *
+ * @param cu Compile Unit.
+ * @param b Cursor, pointing to the value.
+ * @param form Attribute form.
+ *
+ * @return Returns 0 if success and a negative number if the
+ * form is unknown.
+ */
+static int dwr_form_skip(struct dwr_cu *cu, struct dwr_buf *b, uint64_t form)
+{
+	switch (form)
+	{
+		case DW_FORM_flag_present:
+			break;
+		case DW_FORM_data1:
+		case DW_FORM_ref1:
+		case DW_FORM_flag:
+			dwr_skip(b, 1);
+			break;
+		case DW_FORM_data2:
+		case DW_FORM_ref2:
+			dwr_skip(b, 2);
+			break;
+		case DW_FORM_data4:
+		case DW_FORM_ref4:
+			dwr_skip(b, 4);
+			break;
+		case DW_FORM_data8:
+		case DW_FORM_ref8:
+		case DW_FORM_ref_sig8:
+			dwr_skip(b, 8);
+			break;
+		case DW_FORM_addr:
+			dwr_skip(b, cu->addr_size);
+			break;
+		case DW_FORM_ref_addr:
+			dwr_skip(b, cu->version == 2 ? cu->addr_size : cu->offset_size);
+			break;
+		case DW_FORM_strp:
+		case DW_FORM_sec_offset:
+			dwr_skip(b, cu->offset_size);
+			break;
+		case DW_FORM_sdata:
+			dwr_sleb(b);
+			break;
+		case DW_FORM_udata:
+		case DW_FORM_ref_udata:
+			dwr_uleb(b);
+			break;
+		case DW_FORM_string:
+			dwr_cstr(b);
+			break;
+		case DW_FORM_block1:
+			dwr_skip(b, dwr_fixed(b, 1));
+			break;
+		case DW_FORM_block2:
+			dwr_skip(b, dwr_fixed(b, 2));
+			break;
+		case DW_FORM_block4:
+			dwr_skip(b, dwr_fixed(b, 4));
+			break;
+		case DW_FORM_block:
+		case DW_FORM_exprloc:
+			dwr_skip(b, dwr_uleb(b));
+			break;
+		case DW_FORM_indirect:
+			return (dwr_form_skip(cu, b, dwr_uleb(b)));
+		default:
+			return (-1);
+	}
+	return (b->err ? -1 : 0);
+}
+
+/**
+ * @brief Reads the DIE found at @p off.
+ *
+ * All attributes are skipped in order to find where the DIE
+ * ends, and, as a bonus, DW_AT_sibling is saved, if present.
+ *
+ * @param r DWARF reader.
+ * @param cu Compile Unit.
+ * @param off DIE offset.
+ * @param die DIE structure to be filled.
+ *
+ * @return Returns 1 if a DIE was read, 0 if a null entry was
+ * found (end of siblings) and a negative number if error.
+ */
+static int dwr_die_read(struct dwr *r, struct dwr_cu *cu, uint64_t off,
+	struct dwr_die *die)
+{
+	struct dwr_buf b;    /* DIE cursor.    */
+	struct dwr_buf s;    /* Spec cursor.   */
+	uint64_t code;       /* Abbrev code.   */
+
+	if (off >= cu->end)
+		return (-1);
+
+	dwr_buf_init(&b, &r->info, off);
+	b.end = r->info.data + cu->end;
+
+	die->offset  = off;
+	die->sibling = 0;
+
+	code = dwr_uleb(&b);
+	if (b.err)
+		return (-1);
+
+	/* Null entry. */
+	if (code == 0)
+	{
+		die->after_attrs = b.p - r->info.data;
+		return (0);
+	}
+
+	if (code >= r->abbrevs_size || r->abbrevs[code] == NULL)
+		return (-1);
+
+	s.p   = r->abbrevs[code];
+	s.end = r->abbrev.data + r->abbrev.size;
+	s.err = 0;
+
+	die->tag = dwr_uleb(&s);
+	die->has_children = (dwr_fixed(&s, 1) == DW_CHILDREN_yes);
+	die->spec  = s.p;
+	die->attrs = b.p;
+
+	/* Skip all attributes. */
+	while (!s.err)
+	{
+		uint64_t name = dwr_uleb(&s);
+		uint64_t form = dwr_uleb(&s);
+		if (!name && !form)
+			break;
+
+		/* Sibling, saves the absolute offset. */
+		if (name == DW_AT_sibling)
+		{
+			const uint8_t *p = b.p;
+			if (dwr_form_skip(cu, &b, form))
+				return (-1);
+
+			switch (form)
+			{
+				case DW_FORM_ref1:
+				case DW_FORM_ref2:
+				case DW_FORM_ref4:
+				case DW_FORM_ref8:
+				{
+					struct dwr_buf v = {p, b.p, 0};
+					die->sibling = cu->offset + dwr_fixed(&v, b.p - p);
+					break;
+				}
+				case DW_FORM_ref_udata:
+				{
+					struct dwr_buf v = {p, b.p, 0};
+					die->sibling = cu->offset + dwr_uleb(&v);
+					break;
+				}
+				default:
+					break;
+			}
+			continue;
+		}
+
+		if (dwr_form_skip(cu, &b, form))
+			return (-1);
+	}
+
+	if (s.err || b.err)
+		return (-1);
+
+	/* Bogus sibling pointers should not break the walk. */
+	if (die->sibling <= off || die->sibling >= cu->end)
+		die->sibling = 0;
+
+	die->after_attrs = b.p - r->info.data;
+	return (1);
+}
+
+/**
+ * @brief Gets the offset of the next sibling of @p die, skipping
+ * its entire subtree, if necessary.
+ *
+ * @param r DWARF reader.
+ * @param cu Compile Unit.
+ * @param die Current DIE.
+ * @param next Next sibling offset (or null entry offset).
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_die_next(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_die *die, uint64_t *next)
+{
+	struct dwr_die child; /* Child DIE.     */
+	uint64_t off;         /* Current off.   */
+	int depth;            /* Current depth. */
+	int ret;              /* Return code.   */
+
+	if (die->sibling)
+	{
+		*next = die->sibling;
+		return (0);
+	}
+
+	if (!die->has_children)
+	{
+		*next = die->after_attrs;
+		return (0);
+	}
+
+	/* Skip the whole subtree. */
+	depth = 1;
+	off = die->after_attrs;
+	while (depth > 0)
+	{
+		if ((ret = dwr_die_read(r, cu, off, &child)) < 0)
+			return (-1);
+
+		/* Null entry, one level up. */
+		if (ret == 0)
+		{
+			depth--;
+			off = child.after_attrs;
+			continue;
+		}
+
+		if (child.sibling)
+			off = child.sibling;
+		else
+		{
+			off = child.after_attrs;
+			if (child.has_children)
+				depth++;
+		}
+	}
+
+	*next = off;
+	return (0);
+}
+
+/**
+ * @brief Searches for the attribute @p name in the DIE @p die.
+ *
+ * @param cu Compile Unit.
+ * @param die DIE.
+ * @param name Attribute name (DW_AT_*).
+ * @param attr Attribute found.
+ *
+ * @return Returns 0 if found and a negative number otherwise.
+ */
+static int dwr_die_attr(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_die *die, uint64_t name, struct dwr_attr *attr)
+{
+	struct dwr_buf b; /* Values cursor. */
+	struct dwr_buf s; /* Spec cursor.   */
+
+	b.p   = die->attrs;
+	b.end = r->info.data + die->after_attrs;
+	b.err = 0;
+	s.p   = die->spec;
+	s.end = r->abbrev.data + r->abbrev.size;
+	s.err = 0;
+
+	while (!s.err && !b.err)
+	{
+		uint64_t n = dwr_uleb(&s);
+		uint64_t f = dwr_uleb(&s);
+		if (!n && !f)
+			break;
+
+		/* Resolve indirect forms right away. */
+		while (f == DW_FORM_indirect)
+			f = dwr_uleb(&b);
+
+		if (n == name)
+		{
+			attr->form = f;
+			attr->ptr  = b.p;
+			return (0);
+		}
+
+		if (dwr_form_skip(cu, &b, f))
+			return (-1);
+	}
+	return (-1);
+}
+
+/* ------------------------------------------------------------------------*
+ * Attribute values                                                        *
+ * ------------------------------------------------------------------------*/
+
+/**
+ * @brief Initializes a cursor pointing to the attribute value.
+ */
+static inline void dwr_attr_buf(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_attr *attr, struct dwr_buf *b)
+{
+	b->p   = attr->ptr;
+	b->end = r->info.data + cu->end;
+	b->err = 0;
+}
+
+/**
+ * @brief Reads an unsigned constant (data*, udata, sdata, flag
+ * and sec_offset forms).
+ */
+static int dwr_attr_udata(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_attr *attr, uint64_t *v)
+{
+	struct dwr_buf b;
+	dwr_attr_buf(r, cu, attr, &b);
+
+	switch (attr->form)
+	{
+		case DW_FORM_data1:
+		case DW_FORM_flag:
+			*v = dwr_fixed(&b, 1);
+			break;
+		case DW_FORM_data2:
+			*v = dwr_fixed(&b, 2);
+			break;
+		case DW_FORM_data4:
+			*v = dwr_fixed(&b, 4);
+			break;
+		case DW_FORM_data8:
+			*v = dwr_fixed(&b, 8);
+			break;
+		case DW_FORM_sec_offset:
+			*v = dwr_fixed(&b, cu->offset_size);
+			break;
+		case DW_FORM_udata:
+			*v = dwr_uleb(&b);
+			break;
+		case DW_FORM_sdata:
+			*v = (uint64_t)dwr_sleb(&b);
+			break;
+		case DW_FORM_flag_present:
+			*v = 1;
+			break;
+		default:
+			return (-1);
+	}
+	return (b.err ? -1 : 0);
+}
+
+/**
+ * @brief Reads an address (DW_FORM_addr).
+ */
+static int dwr_attr_addr(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_attr *attr, uint64_t *v)
+{
+	struct dwr_buf b;
+	if (attr->form != DW_FORM_addr)
+		return (-1);
+
+	dwr_attr_buf(r, cu, attr, &b);
+	*v = dwr_fixed(&b, cu->addr_size);
+	return (b.err ? -1 : 0);
+}
+
+/**
+ * @brief Reads a reference and converts it to an absolute
+ * .debug_info offset.
+ */
+static int dwr_attr_ref(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_attr *attr, uint64_t *v)
+{
+	struct dwr_buf b;
+	dwr_attr_buf(r, cu, attr, &b);
+
+	switch (attr->form)
+	{
+		case DW_FORM_ref1:
+			*v = cu->offset + dwr_fixed(&b, 1);
+			break;
+		case DW_FORM_ref2:
+			*v = cu->offset + dwr_fixed(&b, 2);
+			break;
+		case DW_FORM_ref4:
+			*v = cu->offset + dwr_fixed(&b, 4);
+			break;
+		case DW_FORM_ref8:
+			*v = cu->offset + dwr_fixed(&b, 8);
+			break;
+		case DW_FORM_ref_udata:
+			*v = cu->offset + dwr_uleb(&b);
+			break;
+		case DW_FORM_ref_addr:
+			*v = dwr_fixed(&b,
+				cu->version == 2 ? cu->addr_size : cu->offset_size);
+			break;
+		default:
+			return (-1);
+	}
+	return (b.err ? -1 : 0);
+}
+
+/**
+ * @brief Reads a string (DW_FORM_string or DW_FORM_strp).
+ */
+static const char *dwr_attr_string(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_attr *attr)
+{
+	struct dwr_buf b;
+	uint64_t off;
+
+	dwr_attr_buf(r, cu, attr, &b);
+
+	if (attr->form == DW_FORM_string)
+		return (dwr_cstr(&b));
+
+	if (attr->form == DW_FORM_strp)
+	{
+		off = dwr_fixed(&b, cu->offset_size);
+		if (b.err || r->str.data == NULL)
+			return (NULL);
+
+		dwr_buf_init(&b, &r->str, off);
+		return (dwr_cstr(&b));
+	}
+	return (NULL);
+}
+
+/**
+ * @brief Gets the name (DW_AT_name) of a DIE.
+ */
+static const char *dwr_die_name(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_die *die)
+{
+	struct dwr_attr attr;
+	if (dwr_die_attr(r, cu, die, DW_AT_name, &attr))
+		return (NULL);
+	return (dwr_attr_string(r, cu, &attr));
+}
+
+/**
+ * @brief Gets the unsigned constant attribute @p name of a DIE.
+ */
+static int dwr_die_udata(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_die *die, uint64_t name, uint64_t *v)
+{
+	struct dwr_attr attr;
+	if (dwr_die_attr(r, cu, die, name, &attr))
+		return (-1);
+	return (dwr_attr_udata(r, cu, &attr, v));
+}
+
+/* ------------------------------------------------------------------------*
+ * Location expressions                                                    *
+ * ------------------------------------------------------------------------*/
+
+/**
+ * @brief Decodes a location expression, saving its first
+ * operation (and operand) and the amount of operations.
+ *
+ * @param cu Compile Unit.
+ * @param b Cursor, limited to the expression.
+ * @param loc Location to be filled.
+ */
+static void dwr_expr_decode(struct dwr_cu *cu, struct dwr_buf *b,
+	struct dwr_loc *loc)
+{
+	uint8_t op; /* Operation. */
+	int64_t n;  /* Operand.   */
+
+	loc->ops = 0;
+	loc->atom = 0;
+	loc->number = 0;
+
+	while (b->p < b->end && !b->err)
+	{
+		op = dwr_fixed(b, 1);
+		n  = 0;
+
+		if (op == DW_OP_addr)
+			n = dwr_fixed(b, cu->addr_size);
+		else if (op == DW_OP_fbreg || op == DW_OP_consts ||
+			(op >= DW_OP_breg0 && op <= DW_OP_breg31))
+			n = dwr_sleb(b);
+		else if (op == DW_OP_constu || op == DW_OP_plus_uconst ||
+			op == DW_OP_regx || op == DW_OP_piece)
+			n = dwr_uleb(b);
+		else if (op == DW_OP_bregx)
+		{
+			n = dwr_uleb(b);
+			dwr_sleb(b);
+		}
+		else if (op == DW_OP_const1u || op == DW_OP_const1s)
+			n = dwr_fixed(b, 1);
+		else if (op == DW_OP_const2u || op == DW_OP_const2s)
+			n = dwr_fixed(b, 2);
+		else if (op == DW_OP_const4u || op == DW_OP_const4s)
+			n = dwr_fixed(b, 4);
+		else if (op == DW_OP_const8u || op == DW_OP_const8s)
+			n = dwr_fixed(b, 8);
+		else if ((op >= DW_OP_lit0 && op <= DW_OP_reg31) ||
+			op == DW_OP_call_frame_cfa)
+			n = 0;
+
+		/*
+		 * Unknown operand, we are not able to proceed, so make sure
+		 * the expression is not accepted as a 'simple' one.
+		 */
+		else
+		{
+			if (!loc->ops)
+				loc->atom = op;
+			loc->ops = INT_MAX;
+			return;
+		}
+
+		if (!loc->ops)
+		{
+			loc->atom = op;
+			loc->number = n;
+		}
+		loc->ops++;
+	}
+}
+
+/**
+ * @brief Reads the location (single expression or location list)
+ * of the attribute @p attr.
+ *
+ * @param r DWARF reader.
+ * @param cu Compile Unit.
+ * @param attr Location attribute.
+ * @param locs Location entries.
+ * @param count Amount of location entries.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_attr_locations(struct dwr *r, struct dwr_cu *cu,
+	struct dwr_attr *attr, struct dwr_loc *locs, int *count)
+{
+	struct dwr_buf b;     /* Cursor.            */
+	struct dwr_buf e;     /* Expression cursor. */
+	uint64_t len;         /* Expression length. */
+	uint64_t off;         /* List offset.       */
+	uint64_t max_addr;    /* Base selection.    */
+
+	dwr_attr_buf(r, cu, attr, &b);
+	*count = 0;
+
+	switch (attr->form)
+	{
+		/* Single location expressions. */
+		case DW_FORM_block1:
+			len = dwr_fixed(&b, 1);
+			goto single;
+		case DW_FORM_block2:
+			len = dwr_fixed(&b, 2);
+			goto single;
+		case DW_FORM_block4:
+			len = dwr_fixed(&b, 4);
+			goto single;
+		case DW_FORM_block:
+		case DW_FORM_exprloc:
+			len = dwr_uleb(&b);
+		single:
+			if (b.err || len > (uint64_t)(b.end - b.p))
+				return (-1);
+			e.p = b.p;
+			e.end = b.p + len;
+			e.err = 0;
+			dwr_expr_decode(cu, &e, &locs[0]);
+			*count = 1;
+			return (e.err ? -1 : 0);
+
+		/* Location lists. */
+		case DW_FORM_data4:
+		case DW_FORM_data8:
+		case DW_FORM_sec_offset:
+			if (dwr_attr_udata(r, cu, attr, &off) || r->loc.data == NULL)
+				return (-1);
+			break;
+
+		default:
+			return (-1);
+	}
+
+	max_addr = (cu->addr_size == 8) ? UINT64_MAX : UINT32_MAX;
+	dwr_buf_init(&b, &r->loc, off);
+
+	while (!b.err && *count < DWR_MAX_LOCS)
+	{
+		uint64_t begin = dwr_fixed(&b, cu->addr_size);
+		uint64_t end   = dwr_fixed(&b, cu->addr_size);
+
+		/* End of list. */
+		if (!begin && !end)
+			break;
+
+		/* Base address selection, nothing to do here. */
+		if (begin == max_addr)
+			continue;
+
+		len = dwr_fixed(&b, 2);
+		if (b.err || len > (uint64_t)(b.end - b.p))
+			return (-1);
+
+		e.p = b.p;
+		e.end = b.p + len;
+		e.err = 0;
+		dwr_expr_decode(cu, &e, &locs[*count]);
+		(*count)++;
+		b.p += len;
+	}
+
+	return (b.err ? -1 : 0);
+}
+
+/* ------------------------------------------------------------------------*
+ * Public routines                                                         *
+ * ------------------------------------------------------------------------*/
+
+/**
+ * @brief Initializes the internal DWARF reader for the file @p file.
+ *
+ * @param r DWARF reader.
+ * @param file Executable to be read.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int dwr_init(struct dwr *r, const char *file)
+{
+	memset(r, 0, sizeof(struct dwr));
+
+	if (elf_open(&r->elf, file))
+		return (-1);
+
+	/* Mandatory sections. */
+	if (elf_get_section(&r->elf, ".debug_info", &r->info)     ||
+		elf_get_section(&r->elf, ".debug_abbrev", &r->abbrev) ||
+		r->info.data == NULL || r->abbrev.data == NULL)
+	{
+		dwr_finish(r);
+		return (-1);
+	}
+
+	/* Optional ones. */
+	if (elf_get_section(&r->elf, ".debug_line", &r->line))
+		memset(&r->line, 0, sizeof(struct elf_section));
+	if (elf_get_section(&r->elf, ".debug_str", &r->str))
+		memset(&r->str, 0, sizeof(struct elf_section));
+	if (elf_get_section(&r->elf, ".debug_loc", &r->loc))
+		memset(&r->loc, 0, sizeof(struct elf_section));
+
+	return (0);
+}
+
+/**
+ * @brief Releases all the resources used by the reader.
+ *
+ * @param r DWARF reader.
+ */
+void dwr_finish(struct dwr *r)
+{
+	free(r->abbrevs);
+	r->abbrevs = NULL;
+	r->abbrevs_size = 0;
+	r->abbrevs_valid = 0;
+	elf_close(&r->elf);
+}
+
+/**
+ * @brief Searches for the function @p func, in the same fashion
+ * as dw_get_address_by_function().
+ *
+ * @param r DWARF reader.
+ * @param func Function name.
+ * @param dw_func Function structure to be filled.
+ *
+ * @return Returns 0 if found and a negative number otherwise.
+ */
+int dwr_get_address_by_function(struct dwr *r, const char *func,
+	struct dw_function *dw_func)
+{
+	struct dwr_cu cu;      /* Current CU.       */
+	struct dwr_die die;    /* CU DIE.           */
+	struct dwr_die child;  /* Current child.    */
+	struct dwr_attr attr;  /* Attribute.        */
+	const char *name;      /* Function name.    */
+	uint64_t low_pc;       /* Low PC.           */
+	uint64_t high_pc;      /* High PC.          */
+	uint64_t off;          /* Current offset.   */
+	int found;             /* Found?            */
+	int ret;               /* Return code.      */
+
+	found = 0;
+	off = 0;
+
+	while ((ret = dwr_cu_read(r, off, &cu)) > 0)
+	{
+		off = cu.end;
+
+		if (dwr_abbrev_load(r, &cu) ||
+			dwr_die_read(r, &cu, cu.die_offset, &die) != 1)
+			return (-1);
+
+		if (!die.has_children)
+			continue;
+
+		/* Loop through all the siblings. */
+		uint64_t c_off = die.after_attrs;
+		while ((ret = dwr_die_read(r, &cu, c_off, &child)) > 0)
+		{
+			if (dwr_die_next(r, &cu, &child, &c_off))
+				return (-1);
+
+			if (child.tag != DW_TAG_subprogram)
+				continue;
+
+			name = dwr_die_name(r, &cu, &child);
+			if (name == NULL || strcmp(name, func))
+				continue;
+
+			/* Low PC. */
+			if (dwr_die_attr(r, &cu, &child, DW_AT_low_pc, &attr) ||
+				dwr_attr_addr(r, &cu, &attr, &low_pc))
+				continue;
+
+			/* High PC, address (DWARF 2/3) or offset (DWARF 4). */
+			if (dwr_die_attr(r, &cu, &child, DW_AT_high_pc, &attr))
+				continue;
+
+			if (attr.form == DW_FORM_addr)
+			{
+				if (dwr_attr_addr(r, &cu, &attr, &high_pc))
+					return (-1);
+				high_pc = high_pc - 1;
+			}
+			else
+			{
+				if (dwr_attr_udata(r, &cu, &attr, &high_pc))
+					return (-1);
+				high_pc = high_pc + low_pc - 1;
+			}
+
+			/*
+			 * Like the libdwarf version, the last match wins, so
+			 * both readers always agree.
+			 */
+			dw_func->low_pc  = low_pc;
+			dw_func->high_pc = high_pc;
+			r->cu = cu;
+			r->cu_die = die.offset;
+			r->fn_die = child.offset;
+			found = 1;
+		}
+
+		if (ret < 0)
+			return (-1);
+	}
+
+	if (ret < 0 || !found)
+		return (-1);
+
+	return (0);
+}
+
+/**
+ * @brief Checks if the target Compile Unit language is C.
+ *
+ * @param r DWARF reader.
+ *
+ * @return Returns 1 if C, 0 if not and a negative number if
+ * error.
+ */
+int dwr_is_c_language(struct dwr *r)
+{
+	struct dwr_die die; /* CU DIE.    */
+	uint64_t lang;      /* Language.  */
+
+	if (dwr_abbrev_load(r, &r->cu) ||
+		dwr_die_read(r, &r->cu, r->cu_die, &die) != 1)
+		return (-1);
+
+	if (dwr_die_udata(r, &r->cu, &die, DW_AT_language, &lang))
+		return (0);
+
+	switch (lang)
+	{
+		case DW_LANG_C89:
+		case DW_LANG_C:
+		case DW_LANG_C99:
+		case DW_LANG_C11:
+			return (1);
+		default:
+			return (0);
+	}
+}
+
+/**
+ * @brief Gets the frame base offset for the target function,
+ * please see dw_get_base_pointer_offset() for more details.
+ *
+ * @param r DWARF reader.
+ * @param dw_func Target function.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_get_base_pointer_offset(struct dwr *r,
+	struct dw_function *dw_func)
+{
+	struct dwr_loc locs[DWR_MAX_LOCS]; /* Locations.   */
+	struct dwr_die die;                /* Function.    */
+	struct dwr_attr attr;              /* Frame base.  */
+	int count;                         /* Loc. count.  */
+
+	if (dwr_die_read(r, &r->cu, r->fn_die, &die) != 1)
+		return (-1);
+
+	/* No frame base, nothing to do. */
+	if (dwr_die_attr(r, &r->cu, &die, DW_AT_frame_base, &attr))
+		return (0);
+
+	if (dwr_attr_locations(r, &r->cu, &attr, locs, &count) || !count)
+		return (-1);
+
+	if (locs[0].ops > 1)
+	{
+		fprintf(stderr, "dw_parse_variable: location entries greater than 1\n"
+			"  make sure you're building your target with: \n"
+			"  -O0 -gdwarf-2 -fno-omit-frame-pointer (and -no-pie if PIE enabled)\n");
+		return (0);
+	}
+
+	dw_func->bp_offset = INT_MIN;
+	for (int i = 0; i < count; i++)
+	{
+#if defined(__x86_64__)
+		if (locs[i].atom == DW_OP_reg6 || locs[i].atom == DW_OP_breg6)
+#elif defined(__i386__)
+		if (locs[i].atom == DW_OP_reg5 || locs[i].atom == DW_OP_breg5)
+#endif
+		{
+			/* GCC approach. */
+			if (count > 1)
+				dw_func->bp_offset = (int)locs[i].number;
+
+			/* clang approach. */
+			else
+				dw_func->bp_offset = 0;
+
+			break;
+		}
+	}
+
+	/* Let the caller decide what to do. */
+	if (dw_func->bp_offset == INT_MIN)
+		return (-1);
+
+	return (0);
+}
+
+/**
+ * @brief Parses the location of the variable DIE @p die.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_parse_variable_location(struct dwr *r, struct dwr_die *die,
+	struct dw_function *dw_func, struct dw_variable *var)
+{
+	struct dwr_loc locs[DWR_MAX_LOCS]; /* Locations.  */
+	struct dwr_attr attr;              /* Attribute.  */
+	int count;                         /* Loc. count. */
+
+	if (dwr_die_attr(r, &r->cu, die, DW_AT_location, &attr))
+		return (-1);
+
+	if (dwr_attr_locations(r, &r->cu, &attr, locs, &count) || !count)
+		return (-1);
+
+	/* Only one location supported for now. */
+	if (count > 1)
+	{
+		fprintf(stderr, "dw_parse_variable: location greater than 1\n"
+			"make sure you're building with -O0\n");
+		return (-1);
+	}
+
+	if (locs[0].ops > 1)
+	{
+		fprintf(stderr, "dw_parse_variable: location entries grater than 1\n"
+			"make sure you're building with -O0\n");
+		return (-1);
+	}
+
+	if (locs[0].atom == DW_OP_addr)
+	{
+		var->scope = VGLOBAL;
+		var->location.address = (uintptr_t)locs[0].number;
+	}
+	else if (locs[0].atom == DW_OP_fbreg)
+	{
+		var->scope = VLOCAL;
+		var->location.fp_offset = locs[0].number + dw_func->bp_offset;
+	}
+	else
+	{
+		fprintf(stderr, "dw_parse_variable: operand not supported!, make sure\n"
+			"you're building with -O0\n");
+		return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Follows the type of @p die (skipping typedefs) until a
+ * known type is found, just like dw_parse_variable_base_type().
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_parse_variable_base_type(struct dwr *r, struct dwr_die *die,
+	size_t *byte_size, int *var_type, int *encoding, struct dwr_die *type_die)
+{
+	struct dwr_attr attr; /* Attribute.       */
+	uint64_t offset;      /* Type offset.     */
+	uint64_t value;       /* Attribute value. */
+
+	if (dwr_die_attr(r, &r->cu, die, DW_AT_type, &attr))
+		return (-1);
+
+	*type_die = *die;
+	do
+	{
+		if (dwr_die_attr(r, &r->cu, type_die, DW_AT_type, &attr))
+			return (-1);
+		if (dwr_attr_ref(r, &r->cu, &attr, &offset))
+			return (-1);
+
+		/* References outside the CU are not supported. */
+		if (offset < r->cu.die_offset || offset >= r->cu.end)
+			return (-1);
+
+		if (dwr_die_read(r, &r->cu, offset, type_die) != 1)
+			return (-1);
+
+	} while (type_die->tag == DW_TAG_typedef);
+
+	switch (type_die->tag)
+	{
+		case DW_TAG_base_type:
+		case DW_TAG_structure_type:
+		case DW_TAG_union_type:
+		case DW_TAG_enumeration_type:
+			if (dwr_die_udata(r, &r->cu, type_die, DW_AT_byte_size, &value))
+				return (-1);
+
+			*byte_size = value;
+
+			if (type_die->tag == DW_TAG_structure_type)
+				*var_type = TSTRUCTURE;
+			else if (type_die->tag == DW_TAG_union_type)
+				*var_type = TUNION;
+			else if (type_die->tag == DW_TAG_enumeration_type)
+			{
+				*var_type = TENUM;
+				*encoding = ENC_SIGNED;
+			}
+			else
+			{
+				*var_type = TBASE_TYPE;
+				if (dwr_die_udata(r, &r->cu, type_die, DW_AT_encoding, &value))
+					return (-1);
+
+				switch (value)
+				{
+					case DW_ATE_signed:
+					case DW_ATE_signed_char:
+						*encoding = ENC_SIGNED;
+						break;
+					case DW_ATE_unsigned:
+					case DW_ATE_unsigned_char:
+						*encoding = ENC_UNSIGNED;
+						break;
+					case DW_ATE_float:
+						*encoding = ENC_FLOAT;
+						break;
+					default:
+						*encoding = ENC_UNKNOWN;
+						break;
+				}
+			}
+			return (0);
+
+		case DW_TAG_pointer_type:
+			*var_type = TPOINTER;
+			*encoding = ENC_POINTER;
+			*byte_size = sizeof(void *);
+			return (0);
+
+		case DW_TAG_array_type:
+			*var_type = TARRAY;
+			return (0);
+
+		default:
+			return (-1);
+	}
+}
+
+/**
+ * @brief Parses the type of the variable DIE @p die, including
+ * array dimensions, just like dw_parse_variable_type().
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_parse_variable_type(struct dwr *r, struct dwr_die *die,
+	struct dw_variable *var)
+{
+	struct dwr_die type_die;   /* Type DIE.       */
+	struct dwr_die type_child; /* Element type.   */
+	struct dwr_die child;      /* Subrange.       */
+	uint64_t off;              /* Child offset.   */
+	uint64_t value;            /* Bound/count.    */
+	size_t byte_size;
+	int var_type;
+	int encoding;
+	int ret;
+
+	byte_size = 0;
+	var_type  = 0;
+	encoding  = 0;
+
+	if (dwr_parse_variable_base_type(r, die, &byte_size, &var_type,
+		&encoding, &type_die))
+		return (-1);
+
+	var->byte_size = byte_size;
+	var->type.var_type = var_type;
+	var->type.encoding = encoding;
+
+	if (var_type != TARRAY)
+		return (0);
+
+	/* Element type. */
+	if (dwr_parse_variable_base_type(r, &type_die, &byte_size, &var_type,
+		&encoding, &type_child))
+		return (-1);
+
+	var->byte_size = 1;
+	var->type.array.size_per_element = byte_size;
+	var->type.array.var_type = var_type;
+	var->type.encoding = encoding;
+
+	/* Dimensions. (aka DW_TAG_subrange_type) */
+	if (!type_die.has_children)
+		return (-1);
+
+	off = type_die.after_attrs;
+	while ((ret = dwr_die_read(r, &r->cu, off, &child)) > 0)
+	{
+		if (dwr_die_next(r, &r->cu, &child, &off))
+			return (-1);
+
+		if (child.tag != DW_TAG_subrange_type)
+			continue;
+
+		/* GCC uses DW_AT_upper_bound, while clang uses DW_AT_count. */
+		if (!dwr_die_udata(r, &r->cu, &child, DW_AT_upper_bound, &value))
+			value++;
+		else if (dwr_die_udata(r, &r->cu, &child, DW_AT_count, &value))
+			return (-1);
+
+		if (var->type.array.dimensions >= MATRIX_MAX_DIMENSIONS)
+			return (-1);
+
+		var->byte_size *= value;
+		var->type.array.elements_per_dimension[var->type.array.dimensions]
+			= value;
+		var->type.array.dimensions++;
+	}
+
+	if (ret < 0)
+		return (-1);
+
+	/* Updates with the correct size (elements * size_per_element). */
+	var->byte_size *= var->type.array.size_per_element;
+	return (0);
+}
+
+/**
+ * @brief Parses the variable DIE @p die, just like
+ * dw_parse_variable().
+ *
+ * @return Returns a new variable or NULL if the variable is not
+ * supported or should be ignored.
+ */
+static struct dw_variable *dwr_parse_variable(struct dwr *r,
+	struct dwr_die *die, struct dw_function *dw_func)
+{
+	struct dw_variable *var; /* Variable.      */
+	const char *name;        /* Variable name. */
+
+	if ((name = dwr_die_name(r, &r->cu, die)) == NULL)
+		return (NULL);
+
+	/* Check if this variable is elegible to be added or not. */
+	if (args.flags & FLG_IGNR_LIST)
+	{
+		if (hashtable_get(&args.iw_list.ht_list, (void *)name) != NULL)
+			return (NULL);
+	}
+	else if (args.flags & FLG_WATCH_LIST)
+	{
+		if (hashtable_get(&args.iw_list.ht_list, (void *)name) == NULL)
+			return (NULL);
+	}
+
+	var = calloc(1, sizeof(struct dw_variable));
+
+	if (dwr_parse_variable_location(r, die, dw_func, var) ||
+		dwr_parse_variable_type(r, die, var))
+	{
+		free(var);
+		return (NULL);
+	}
+
+	var->name = malloc(sizeof(char) * (strlen(name) + 1));
+	strcpy(var->name, name);
+	return (var);
+}
+
+/**
+ * @brief Gets all the global variables and the local variables
+ * of the target function, in the same order as
+ * dw_get_all_variables().
+ *
+ * @param r DWARF reader.
+ * @param dw_func Target function.
+ *
+ * @return Returns the variables array or NULL if error.
+ */
+struct array *dwr_get_all_variables(struct dwr *r, struct dw_function *dw_func)
+{
+	struct dw_variable *var; /* Variable.         */
+	struct array *vars;      /* Variables array.  */
+	struct dwr_cu target;    /* Target CU.        */
+	struct dwr_die die;      /* Current DIE.      */
+	struct dwr_die child;    /* Current child.    */
+	uint64_t off;            /* Current offset.   */
+	uint64_t c_off;          /* Child offset.     */
+	int ret;                 /* Return code.      */
+
+	if (dwr_abbrev_load(r, &r->cu) ||
+		dwr_get_base_pointer_offset(r, dw_func))
+		return (NULL);
+
+	array_init(&vars);
+	target = r->cu;
+
+	/* Globals, from all the Compile Units. */
+	if (args.flags & FLG_ONLY_GLOBALS)
+	{
+		off = 0;
+		while ((ret = dwr_cu_read(r, off, &r->cu)) > 0)
+		{
+			off = r->cu.end;
+
+			if (dwr_abbrev_load(r, &r->cu) ||
+				dwr_die_read(r, &r->cu, r->cu.die_offset, &die) != 1)
+				goto err;
+
+			if (!die.has_children)
+				continue;
+
+			c_off = die.after_attrs;
+			while ((ret = dwr_die_read(r, &r->cu, c_off, &child)) > 0)
+			{
+				if (dwr_die_next(r, &r->cu, &child, &c_off))
+					goto err;
+
+				if (child.tag != DW_TAG_variable)
+					continue;
+
+				if ((var = dwr_parse_variable(r, &child, dw_func)) != NULL)
+					array_add(&vars, var);
+			}
+
+			if (ret < 0)
+				goto err;
+		}
+
+		if (ret < 0)
+			goto err;
+	}
+
+	/* Locals, from the target function. */
+	r->cu = target;
+	if (dwr_abbrev_load(r, &r->cu))
+		goto err;
+
+	if (args.flags & FLG_ONLY_LOCALS)
+	{
+		if (dwr_die_read(r, &r->cu, r->fn_die, &die) != 1)
+			goto err;
+
+		if (!die.has_children)
+			goto out;
+
+		c_off = die.after_attrs;
+		while ((ret = dwr_die_read(r, &r->cu, c_off, &child)) > 0)
+		{
+			if (dwr_die_next(r, &r->cu, &child, &c_off))
+				goto err;
+
+			if (child.tag != DW_TAG_variable &&
+				child.tag != DW_TAG_formal_parameter)
+				continue;
+
+			if ((var = dwr_parse_variable(r, &child, dw_func)) != NULL)
+				array_add(&vars, var);
+		}
+
+		if (ret < 0)
+			goto err;
+	}
+
+out:
+	return (vars);
+
+err:
+	r->cu = target;
+	var_array_free(vars);
+	return (NULL);
+}
+
+/**
+ * @brief Line number program state machine registers.
+ */
+struct dwr_line_state
+{
+	uint64_t address;
+	int64_t line;
+	int is_stmt;
+	int basic_block;
+	int end_sequence;
+};
+
+/**
+ * @brief Adds a line row into @p lines, if the address belongs to
+ * the target function.
+ */
+static void dwr_line_emit(struct array **lines, struct dwr_line_state *st,
+	struct dw_function *dw_func)
+{
+	struct dw_line *line;
+
+	if (st->address < dw_func->low_pc || st->address > dw_func->high_pc)
+		return;
+
+	/* Experimental: avoid equal statements, see dw_get_all_lines(). */
+	if (args.flags & FLG_IGNR_EQSTAT)
+	{
+		for (int i = 0; i < (int) array_size(lines); i++)
+		{
+			line = array_get(lines, i, NULL);
+			if (line->line_no == (unsigned)st->line)
+				return;
+		}
+	}
+
+	line = malloc(sizeof(struct dw_line));
+	line->addr = st->address;
+	line->line_no = st->line;
+	line->line_type = 0;
+
+	if (st->is_stmt)
+		line->line_type |= LBEGIN_STMT;
+	if (st->end_sequence)
+		line->line_type |= LEND_SEQ;
+	if (st->basic_block)
+		line->line_type |= LBLOCK;
+
+	array_add(lines, line);
+}
+
+/**
+ * @brief Runs the line number program of the target Compile Unit
+ * and gets all the lines that belongs to the target function.
+ *
+ * @param r DWARF reader.
+ * @param dw_func Target function.
+ *
+ * @return Returns an array of lines, sorted by line number, or
+ * NULL if error.
+ */
+struct array *dwr_get_all_lines(struct dwr *r, struct dw_function *dw_func)
+{
+	struct dwr_line_state st;  /* State machine.        */
+	struct array *lines;       /* Lines array.          */
+	struct dwr_die die;        /* CU DIE.               */
+	struct dwr_buf b;          /* Cursor.               */
+	const uint8_t *std_lens;   /* Std opcode lengths.   */
+	const uint8_t *prog_end;   /* Program end.          */
+	uint64_t stmt_list;        /* Program offset.       */
+	uint64_t length;           /* Unit length.          */
+	uint64_t header_length;    /* Header length.        */
+	int offset_size;           /* Offset size.          */
+	int version;               /* Line table version.   */
+	uint8_t min_inst_length;   /* Min inst. length.     */
+	uint8_t default_is_stmt;   /* Default is_stmt.      */
+	int8_t line_base;          /* Line base.            */
+	uint8_t line_range;        /* Line range.           */
+	uint8_t opcode_base;       /* Opcode base.          */
+
+	if (r->line.data == NULL || dwr_abbrev_load(r, &r->cu) ||
+		dwr_die_read(r, &r->cu, r->cu_die, &die) != 1 ||
+		dwr_die_udata(r, &r->cu, &die, DW_AT_stmt_list, &stmt_list))
+		return (NULL);
+
+	/* Header. */
+	dwr_buf_init(&b, &r->line, stmt_list);
+	offset_size = 4;
+	length = dwr_fixed(&b, 4);
+	if (length == 0xffffffff)
+	{
+		offset_size = 8;
+		length = dwr_fixed(&b, 8);
+	}
+	if (b.err || length > (uint64_t)(b.end - b.p))
+		return (NULL);
+
+	prog_end = b.p + length;
+	version = dwr_fixed(&b, 2);
+	if (version < 2 || version > 4)
+		return (NULL);
+
+	header_length = dwr_fixed(&b, offset_size);
+	if (header_length > (uint64_t)(prog_end - b.p))
+		return (NULL);
+
+	const uint8_t *prog = b.p + header_length;
+
+	min_inst_length = dwr_fixed(&b, 1);
+	if (version >= 4)
+		dwr_fixed(&b, 1); /* maximum_operations_per_instruction. */
+	default_is_stmt = dwr_fixed(&b, 1);
+	line_base = (int8_t)dwr_fixed(&b, 1);
+	line_range = dwr_fixed(&b, 1);
+	opcode_base = dwr_fixed(&b, 1);
+	std_lens = b.p;
+
+	if (b.err || !line_range || !opcode_base)
+		return (NULL);
+
+	/* Program. */
+	b.p = prog;
+	b.end = prog_end;
+
+	array_init(&lines);
+
+	memset(&st, 0, sizeof(st));
+	st.line = 1;
+	st.is_stmt = default_is_stmt;
+
+	while (b.p < b.end && !b.err)
+	{
+		uint8_t op = dwr_fixed(&b, 1);
+
+		/* Special opcodes. */
+		if (op >= opcode_base)
+		{
+			uint8_t adj = op - opcode_base;
+			st.address += (adj / line_range) * min_inst_length;
+			st.line += line_base + (adj % line_range);
+			dwr_line_emit(&lines, &st, dw_func);
+			st.basic_block = 0;
+			continue;
+		}
+
+		switch (op)
+		{
+			/* Extended opcodes. */
+			case 0:
+			{
+				uint64_t len = dwr_uleb(&b);
+				const uint8_t *next;
+
+				if (b.err || !len || len > (uint64_t)(b.end - b.p))
+					goto err;
+
+				next = b.p + len;
+				switch (dwr_fixed(&b, 1))
+				{
+					case DW_LNE_end_sequence:
+						st.end_sequence = 1;
+						dwr_line_emit(&lines, &st, dw_func);
+						memset(&st, 0, sizeof(st));
+						st.line = 1;
+						st.is_stmt = default_is_stmt;
+						break;
+					case DW_LNE_set_address:
+						st.address = dwr_fixed(&b, len - 1);
+						break;
+					default:
+						break;
+				}
+				b.p = next;
+				break;
+			}
+			case DW_LNS_copy:
+				dwr_line_emit(&lines, &st, dw_func);
+				st.basic_block = 0;
+				break;
+			case DW_LNS_advance_pc:
+				st.address += dwr_uleb(&b) * min_inst_length;
+				break;
+			case DW_LNS_advance_line:
+				st.line += dwr_sleb(&b);
+				break;
+			case DW_LNS_set_file:
+			case DW_LNS_set_column:
+			case DW_LNS_set_isa:
+				dwr_uleb(&b);
+				break;
+			case DW_LNS_negate_stmt:
+				st.is_stmt = !st.is_stmt;
+				break;
+			case DW_LNS_set_basic_block:
+				st.basic_block = 1;
+				break;
+			case DW_LNS_const_add_pc:
+				st.address += ((255 - opcode_base) / line_range) *
+					min_inst_length;
+				break;
+			case DW_LNS_fixed_advance_pc:
+				st.address += dwr_fixed(&b, 2);
+				break;
+			case DW_LNS_set_prologue_end:
+			case DW_LNS_set_epilogue_begin:
+				break;
+
+			/* Unknown standard opcode, skip its operands. */
+			default:
+				for (int i = 0; i < std_lens[op - 1]; i++)
+					dwr_uleb(&b);
+				break;
+		}
+	}
+
+	if (b.err)
+		goto err;
+
+	array_sort(&lines, line_cmp);
+	return (lines);
+
+err:
+	dw_lines_array_free(lines);
+	return (NULL);
+}
+
+/**
+ * @brief Gets the complete path for the target Compile Unit source
+ * file, in the same fashion as dw_get_source_file().
+ *
+ * @param r DWARF reader.
+ *
+ * @return Returns the source file name (should be freed) or NULL
+ * if not found.
+ */
+char *dwr_get_source_file(struct dwr *r)
+{
+	struct dwr_die die;      /* CU DIE.            */
+	struct dwr_attr attr;    /* Attribute.         */
+	const char *file;        /* CU name.           */
+	const char *comp_dir;    /* Compile dir.       */
+	char *filename;          /* Complete filename. */
+
+	if (dwr_abbrev_load(r, &r->cu) ||
+		dwr_die_read(r, &r->cu, r->cu_die, &die) != 1)
+		return (NULL);
+
+	if ((file = dwr_die_name(r, &r->cu, &die)) == NULL)
+		return (NULL);
+
+	if (dwr_die_attr(r, &r->cu, &die, DW_AT_comp_dir, &attr) ||
+		(comp_dir = dwr_attr_string(r, &r->cu, &attr)) == NULL)
+		return (NULL);
+
+	filename = malloc(sizeof(char) * (strlen(comp_dir) + strlen(file) + 2));
+	strcpy(filename, comp_dir);
+	strcat(filename, "/");
+	strcat(filename, file);
+	return (filename);
+}
+
+/**
+ * @brief Searches the variable (or parameter) @p name between the
+ * children of the DIE at @p parent.
+ *
+ * @return Returns 0 if found and a negative number otherwise.
+ */
+static int dwr_find_variable(struct dwr *r, uint64_t parent,
+	const char *name, struct dwr_die *var_die)
+{
+	struct dwr_die die;   /* Parent DIE.     */
+	struct dwr_die child; /* Current child.  */
+	const char *n;        /* Child name.     */
+	uint64_t off;         /* Child offset.   */
+
+	if (dwr_die_read(r, &r->cu, parent, &die) != 1 || !die.has_children)
+		return (-1);
+
+	off = die.after_attrs;
+	while (dwr_die_read(r, &r->cu, off, &child) > 0)
+	{
+		if (dwr_die_next(r, &r->cu, &child, &off))
+			return (-1);
+
+		if (child.tag != DW_TAG_variable &&
+			child.tag != DW_TAG_formal_parameter)
+			continue;
+
+		if ((n = dwr_die_name(r, &r->cu, &child)) != NULL && !strcmp(n, name))
+		{
+			*var_die = child;
+			return (0);
+		}
+	}
+	return (-1);
+}
+
+/**
+ * @brief Gets the type DIE of @p die, skipping typedefs and
+ * qualifiers.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_type_die(struct dwr *r, struct dwr_die *die,
+	struct dwr_die *type_die)
+{
+	struct dwr_attr attr; /* Attribute.   */
+	uint64_t offset;      /* Type offset. */
+
+	*type_die = *die;
+	do
+	{
+		if (dwr_die_attr(r, &r->cu, type_die, DW_AT_type, &attr) ||
+			dwr_attr_ref(r, &r->cu, &attr, &offset))
+			return (-1);
+
+		if (offset < r->cu.die_offset || offset >= r->cu.end)
+			return (-1);
+
+		if (dwr_die_read(r, &r->cu, offset, type_die) != 1)
+			return (-1);
+
+	} while (type_die->tag == DW_TAG_typedef ||
+		type_die->tag == DW_TAG_const_type ||
+		type_die->tag == DW_TAG_volatile_type);
+
+	return (0);
+}
+
+/**
+ * @brief Reads the offset of the member DIE @p die: a constant
+ * or, as in DWARF 2, a DW_OP_plus_uconst expression.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int dwr_member_offset(struct dwr *r, struct dwr_die *die,
+	uint64_t *offset)
+{
+	struct dwr_loc locs[DWR_MAX_LOCS]; /* Expression.       */
+	struct dwr_attr attr;              /* Attribute.        */
+	int count;                         /* Expression count. */
+
+	/* Union members do not have a location. */
+	if (dwr_die_attr(r, &r->cu, die, DW_AT_data_member_location, &attr))
+	{
+		*offset = 0;
+		return (0);
+	}
+
+	switch (attr.form)
+	{
+		case DW_FORM_block1:
+		case DW_FORM_block2:
+		case DW_FORM_block4:
+		case DW_FORM_block:
+		case DW_FORM_exprloc:
+			if (dwr_attr_locations(r, &r->cu, &attr, locs, &count) ||
+				count != 1 || locs[0].ops != 1 ||
+				locs[0].atom != DW_OP_plus_uconst)
+				return (-1);
+
+			*offset = locs[0].number;
+			return (0);
+
+		default:
+			return (dwr_attr_udata(r, &r->cu, &attr, offset));
+	}
+}
+
+/**
+ * @brief Gets the pointer variable @p name, a local of the target
+ * function or a global of its Compile Unit, and the members of
+ * the structure it points to, just like dw_get_struct_pointer().
+ *
+ * @param r DWARF reader.
+ * @param dw_func Target function.
+ * @param name Variable name.
+ * @param members Structure members found.
+ * @param struct_size Structure size.
+ *
+ * @return Returns the variable or NULL if not found or not a
+ * pointer to a structure.
+ */
+struct dw_variable *dwr_get_struct_pointer(struct dwr *r,
+	struct dw_function *dw_func, const char *name,
+	struct array **members, size_t *struct_size)
+{
+	struct dw_variable *var; /* Pointer variable. */
+	struct dw_member *m;     /* Member.           */
+	struct dwr_die var_die;  /* Variable DIE.     */
+	struct dwr_die type_die; /* Type DIE.         */
+	struct dwr_die child;    /* Member DIE.       */
+	struct dwr_die tmp;      /* Member type DIE.  */
+	struct dwr_attr attr;    /* Attribute.        */
+	const char *n;           /* Member name.      */
+	uint64_t value;          /* Attribute value.  */
+	uint64_t off;            /* Child offset.     */
+
+	*members = NULL;
+	if (dwr_abbrev_load(r, &r->cu))
+		return (NULL);
+
+	if (dwr_find_variable(r, r->fn_die, name, &var_die) &&
+		dwr_find_variable(r, r->cu_die, name, &var_die))
+		return (NULL);
+
+	/* Pointer to structure. */
+	if (dwr_type_die(r, &var_die, &type_die) ||
+		type_die.tag != DW_TAG_pointer_type ||
+		dwr_type_die(r, &type_die, &type_die) ||
+		type_die.tag != DW_TAG_structure_type ||
+		dwr_die_udata(r, &r->cu, &type_die, DW_AT_byte_size, &value) ||
+		!type_die.has_children)
+		return (NULL);
+
+	*struct_size = value;
+
+	var = calloc(1, sizeof(struct dw_variable));
+	if (dwr_parse_variable_location(r, &var_die, dw_func, var) ||
+		dwr_parse_variable_type(r, &var_die, var))
+	{
+		free(var);
+		return (NULL);
+	}
+	var->name = malloc(sizeof(char) * (strlen(name) + 1));
+	strcpy(var->name, name);
+
+	/* Members, only the ones PBD is able to show. */
+	array_init(members);
+	off = type_die.after_attrs;
+	while (dwr_die_read(r, &r->cu, off, &child) > 0)
+	{
+		if (dwr_die_next(r, &r->cu, &child, &off))
+			break;
+
+		if (child.tag != DW_TAG_member ||
+			(n = dwr_die_name(r, &r->cu, &child)) == NULL ||
+			!dwr_die_attr(r, &r->cu, &child, DW_AT_bit_size, &attr))
+			continue;
+
+		m = calloc(1, sizeof(struct dw_member));
+		if (dwr_member_offset(r, &child, &value) ||
+			dwr_parse_variable_base_type(r, &child, &m->byte_size,
+				&m->var_type, &m->encoding, &tmp) ||
+			!(m->var_type & (TBASE_TYPE|TENUM|TPOINTER)))
+		{
+			free(m);
+			continue;
+		}
+
+		m->offset = value;
+		m->name = malloc(sizeof(char) * (strlen(n) + 1));
+		strcpy(m->name, n);
+		array_add(members, m);
+	}
+	return (var);
+}
+
+/**
+ * @brief Gets the enumerators of the enumeration type of the
+ * variable @p name (or of its elements, if an array), a local
+ * of the target function or a global of its Compile Unit, just
+ * like dw_get_enumerators().
+ *
+ * @param r DWARF reader.
+ * @param name Variable name.
+ *
+ * @return Returns the enumerators (struct dw_enumerator) or NULL
+ * if not found or not an enumeration.
+ */
+struct array *dwr_get_enumerators(struct dwr *r, const char *name)
+{
+	struct dw_enumerator *e; /* Enumerator.       */
+	struct array *enums;     /* Enumerators.      */
+	struct dwr_die var_die;  /* Variable DIE.     */
+	struct dwr_die type_die; /* Type DIE.         */
+	struct dwr_die child;    /* Enumerator DIE.   */
+	struct dwr_attr attr;    /* Attribute.        */
+	const char *n;           /* Enumerator name.  */
+	uint64_t value;          /* Enumerator value. */
+	uint64_t off;            /* Child offset.     */
+
+	if (dwr_abbrev_load(r, &r->cu))
+		return (NULL);
+
+	if (dwr_find_variable(r, r->fn_die, name, &var_die) &&
+		dwr_find_variable(r, r->cu_die, name, &var_die))
+		return (NULL);
+
+	/* Enumeration, or array of enumerations. */
+	if (dwr_type_die(r, &var_die, &type_die) ||
+		(type_die.tag == DW_TAG_array_type &&
+		dwr_type_die(r, &type_die, &type_die)) ||
+		type_die.tag != DW_TAG_enumeration_type ||
+		!type_die.has_children)
+		return (NULL);
+
+	array_init(&enums);
+	off = type_die.after_attrs;
+	while (dwr_die_read(r, &r->cu, off, &child) > 0)
+	{
+		if (dwr_die_next(r, &r->cu, &child, &off))
+			break;
+
+		/* Signed forms (DW_FORM_sdata) are read sign-extended. */
+		if (child.tag != DW_TAG_enumerator ||
+			(n = dwr_die_name(r, &r->cu, &child)) == NULL ||
+			dwr_die_attr(r, &r->cu, &child, DW_AT_const_value, &attr) ||
+			dwr_attr_udata(r, &r->cu, &attr, &value))
+			continue;
+
+		e = malloc(sizeof(struct dw_enumerator));
+		e->name = malloc(sizeof(char) * (strlen(n) + 1));
+		strcpy(e->name, n);
+		e->value = value;
+		array_add(&enums, e);
+	}
+	return (enums);
+}
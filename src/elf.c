@@ -0,0 +1,572 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "elf_helper.h"
+
+/**
+ * @brief Checks if the range [@p off, @p off + @p len) lies
+ * entirely inside the mapped file.
+ *
+ * @param ef ELF file.
+ * @param off Range offset.
+ * @param len Range length.
+ *
+ * @return Returns 1 if valid and 0 otherwise.
+ */
+static inline int elf_in_bounds(struct elf_file *ef, uint64_t off, uint64_t len)
+{
+	return (off <= ef->size && len <= ef->size - off);
+}
+
+/**
+ * @brief Opens and maps the ELF file @p file, validating its
+ * identification and section header table.
+ *
+ * @param ef ELF file structure to be filled.
+ * @param file File to be opened.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int elf_open(struct elf_file *ef, const char *file)
+{
+	struct stat st;                 /* File status.           */
+	struct elf_section shstr;       /* Section names section. */
+	uint64_t phoff;                 /* Program headers off.   */
+	uint64_t shoff;                 /* Section headers off.   */
+	size_t shstrndx;                /* Section names index.   */
+
+	memset(ef, 0, sizeof(struct elf_file));
+	ef->fd = -1;
+
+	if ((ef->fd = open(file, O_RDONLY)) < 0)
+		return (-1);
+
+	if (fstat(ef->fd, &st) < 0 || (size_t)st.st_size < EI_NIDENT)
+		goto err0;
+
+	ef->size = st.st_size;
+	ef->map  = mmap(NULL, ef->size, PROT_READ, MAP_PRIVATE, ef->fd, 0);
+	if (ef->map == MAP_FAILED)
+	{
+		ef->map = NULL;
+		goto err0;
+	}
+
+	/* Identification: PBD only deals with little-endian x86 files. */
+	if (memcmp(ef->map, ELFMAG, SELFMAG) != 0 ||
+		ef->map[EI_DATA] != ELFDATA2LSB)
+		goto err0;
+
+	ef->elf_class = ef->map[EI_CLASS];
+	if (ef->elf_class == ELFCLASS64)
+	{
+		const Elf64_Ehdr *eh = (const Elf64_Ehdr *)ef->map;
+		if (!elf_in_bounds(ef, 0, sizeof(Elf64_Ehdr)))
+			goto err0;
+
+		ef->type      = eh->e_type;
+		ef->entry     = eh->e_entry;
+		phoff         = eh->e_phoff;
+		ef->phnum     = eh->e_phnum;
+		ef->phentsize = eh->e_phentsize;
+		shoff         = eh->e_shoff;
+		ef->shnum     = eh->e_shnum;
+		ef->shentsize = eh->e_shentsize;
+		shstrndx      = eh->e_shstrndx;
+	}
+	else if (ef->elf_class == ELFCLASS32)
+	{
+		const Elf32_Ehdr *eh = (const Elf32_Ehdr *)ef->map;
+		if (!elf_in_bounds(ef, 0, sizeof(Elf32_Ehdr)))
+			goto err0;
+
+		ef->type      = eh->e_type;
+		ef->entry     = eh->e_entry;
+		phoff         = eh->e_phoff;
+		ef->phnum     = eh->e_phnum;
+		ef->phentsize = eh->e_phentsize;
+		shoff         = eh->e_shoff;
+		ef->shnum     = eh->e_shnum;
+		ef->shentsize = eh->e_shentsize;
+		shstrndx      = eh->e_shstrndx;
+	}
+	else
+		goto err0;
+
+	/* Program headers, if any. */
+	if (phoff && ef->phnum &&
+		elf_in_bounds(ef, phoff, (uint64_t)ef->phnum * ef->phentsize))
+		ef->phdrs = ef->map + phoff;
+	else
+		ef->phnum = 0;
+
+	/*
+	 * Core files usually do not have sections at all, which is
+	 * fine, the section-related routines will just fail.
+	 */
+	if (!shoff || !ef->shnum)
+	{
+		ef->shnum = 0;
+		return (0);
+	}
+
+	if (!elf_in_bounds(ef, shoff, (uint64_t)ef->shnum * ef->shentsize))
+		goto err0;
+
+	ef->shdrs = ef->map + shoff;
+
+	/* Section names. */
+	if (shstrndx != SHN_UNDEF &&
+		!elf_get_section_by_index(ef, shstrndx, &shstr))
+	{
+		ef->shstrtab = (const char *)shstr.data;
+		ef->shstrtab_size = shstr.size;
+	}
+
+	return (0);
+
+err0:
+	elf_close(ef);
+	return (-1);
+}
+
+/**
+ * @brief Unmaps and closes a previously opened ELF file.
+ *
+ * @param ef ELF file.
+ */
+void elf_close(struct elf_file *ef)
+{
+	if (ef->map != NULL)
+		munmap(ef->map, ef->size);
+	if (ef->fd >= 0)
+		close(ef->fd);
+
+	ef->map = NULL;
+	ef->fd  = -1;
+}
+
+/**
+ * @brief Reads the section header @p idx and fills @p sec with
+ * its contents.
+ *
+ * @param ef ELF file.
+ * @param idx Section index.
+ * @param sec Section structure to be filled.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int elf_get_section_by_index(struct elf_file *ef, size_t idx,
+	struct elf_section *sec)
+{
+	uint64_t offset; /* Section offset. */
+
+	if (idx >= ef->shnum)
+		return (-1);
+
+	if (ef->elf_class == ELFCLASS64)
+	{
+		const Elf64_Shdr *sh;
+		sh = (const Elf64_Shdr *)(ef->shdrs + idx * ef->shentsize);
+		offset       = sh->sh_offset;
+		sec->size    = sh->sh_size;
+		sec->addr    = sh->sh_addr;
+		sec->type    = sh->sh_type;
+		sec->link    = sh->sh_link;
+		sec->entsize = sh->sh_entsize;
+	}
+	else
+	{
+		const Elf32_Shdr *sh;
+		sh = (const Elf32_Shdr *)(ef->shdrs + idx * ef->shentsize);
+		offset       = sh->sh_offset;
+		sec->size    = sh->sh_size;
+		sec->addr    = sh->sh_addr;
+		sec->type    = sh->sh_type;
+		sec->link    = sh->sh_link;
+		sec->entsize = sh->sh_entsize;
+	}
+
+	/* NOBITS sections (.bss) do not have file contents. */
+	if (sec->type == SHT_NOBITS)
+	{
+		sec->data = NULL;
+		return (0);
+	}
+
+	if (!elf_in_bounds(ef, offset, sec->size))
+		return (-1);
+
+	sec->data = ef->map + offset;
+	return (0);
+}
+
+/**
+ * @brief Searches for the section named @p name.
+ *
+ * @param ef ELF file.
+ * @param name Section name, like ".debug_info".
+ * @param sec Section structure to be filled.
+ *
+ * @return Returns 0 if found and a negative number otherwise.
+ */
+int elf_get_section(struct elf_file *ef, const char *name,
+	struct elf_section *sec)
+{
+	uint32_t name_off; /* Name offset. */
+
+	if (ef->shstrtab == NULL)
+		return (-1);
+
+	for (size_t i = 0; i < ef->shnum; i++)
+	{
+		if (ef->elf_class == ELFCLASS64)
+			name_off = ((const Elf64_Shdr *)
+				(ef->shdrs + i * ef->shentsize))->sh_name;
+		else
+			name_off = ((const Elf32_Shdr *)
+				(ef->shdrs + i * ef->shentsize))->sh_name;
+
+		if (name_off >= ef->shstrtab_size)
+			continue;
+
+		if (strncmp(ef->shstrtab + name_off, name,
+			ef->shstrtab_size - name_off) == 0)
+			return (elf_get_section_by_index(ef, i, sec));
+	}
+	return (-1);
+}
+
+/**
+ * @brief Iterates over all the symbols of the first symbol
+ * table of type @p sh_type (SHT_SYMTAB or SHT_DYNSYM), calling
+ * @p cb for each named symbol.
+ *
+ * @param ef ELF file.
+ * @param sh_type Symbol table type.
+ * @param cb Callback, if returns non-zero, the iteration stops.
+ * @param data Opaque pointer passed to the callback.
+ *
+ * @return Returns 1 if the iteration was stopped by the callback,
+ * 0 if all symbols were visited and a negative number if there
+ * is no such symbol table.
+ */
+int elf_symbols_iter(struct elf_file *ef, uint32_t sh_type,
+	int (*cb)(const struct elf_symbol *sym, void *data), void *data)
+{
+	struct elf_section symtab;  /* Symbol table.    */
+	struct elf_section strtab;  /* String table.    */
+	struct elf_symbol sym;      /* Current symbol.  */
+	size_t entsize;             /* Symbol size.     */
+	uint32_t name_off;          /* Name offset.     */
+
+	for (size_t i = 0; i < ef->shnum; i++)
+	{
+		if (elf_get_section_by_index(ef, i, &symtab) ||
+			symtab.type != sh_type || symtab.data == NULL)
+			continue;
+
+		if (elf_get_section_by_index(ef, symtab.link, &strtab) ||
+			strtab.data == NULL)
+			return (-1);
+
+		entsize = (ef->elf_class == ELFCLASS64) ?
+			sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+
+		for (size_t j = 0; j + entsize <= symtab.size; j += entsize)
+		{
+			if (ef->elf_class == ELFCLASS64)
+			{
+				const Elf64_Sym *s = (const Elf64_Sym *)(symtab.data + j);
+				name_off  = s->st_name;
+				sym.value = s->st_value;
+				sym.size  = s->st_size;
+				sym.type  = ELF64_ST_TYPE(s->st_info);
+			}
+			else
+			{
+				const Elf32_Sym *s = (const Elf32_Sym *)(symtab.data + j);
+				name_off  = s->st_name;
+				sym.value = s->st_value;
+				sym.size  = s->st_size;
+				sym.type  = ELF32_ST_TYPE(s->st_info);
+			}
+
+			if (!name_off || name_off >= strtab.size)
+				continue;
+
+			sym.name = (const char *)strtab.data + name_off;
+			if (cb(&sym, data))
+				return (1);
+		}
+		return (0);
+	}
+	return (-1);
+}
+
+/* Symbol lookup context. */
+struct elf_lookup
+{
+	const char *name;
+	struct elf_symbol *sym;
+};
+
+/**
+ * @brief Symbol comparison callback used by elf_lookup_symbol().
+ */
+static int elf_lookup_cb(const struct elf_symbol *sym, void *data)
+{
+	struct elf_lookup *lk = data;
+	if (sym->value == 0 || strcmp(sym->name, lk->name))
+		return (0);
+
+	*lk->sym = *sym;
+	return (1);
+}
+
+/**
+ * @brief Searches for the defined symbol named @p name in the
+ * symbol table of type @p sh_type.
+ *
+ * @param ef ELF file.
+ * @param sh_type Symbol table type (SHT_SYMTAB or SHT_DYNSYM).
+ * @param name Symbol name.
+ * @param sym Symbol found.
+ *
+ * @return Returns 0 if found and a negative number otherwise.
+ */
+int elf_lookup_symbol(struct elf_file *ef, uint32_t sh_type,
+	const char *name, struct elf_symbol *sym)
+{
+	struct elf_lookup lk;
+	lk.name = name;
+	lk.sym  = sym;
+	return (elf_symbols_iter(ef, sh_type, elf_lookup_cb, &lk) == 1 ? 0 : -1);
+}
+
+/**
+ * @brief Converts the file offset @p off into the virtual
+ * address it is loaded at, accordingly with the PT_LOAD
+ * segment that contains it.
+ *
+ * @param ef ELF file.
+ * @param off File offset.
+ * @param vaddr Virtual address (not relocated) found.
+ *
+ * @return Returns 0 if found and a negative number otherwise.
+ */
+int elf_offset_to_vaddr(struct elf_file *ef, uint64_t off, uint64_t *vaddr)
+{
+	uint64_t p_offset;  /* Segment offset.    */
+	uint64_t p_vaddr;   /* Segment address.   */
+	uint64_t p_filesz;  /* Segment file size. */
+	uint32_t p_type;    /* Segment type.      */
+
+	for (size_t i = 0; i < ef->phnum; i++)
+	{
+		if (ef->elf_class == ELFCLASS64)
+		{
+			const Elf64_Phdr *ph;
+			ph = (const Elf64_Phdr *)(ef->phdrs + i * ef->phentsize);
+			p_type   = ph->p_type;
+			p_offset = ph->p_offset;
+			p_vaddr  = ph->p_vaddr;
+			p_filesz = ph->p_filesz;
+		}
+		else
+		{
+			const Elf32_Phdr *ph;
+			ph = (const Elf32_Phdr *)(ef->phdrs + i * ef->phentsize);
+			p_type   = ph->p_type;
+			p_offset = ph->p_offset;
+			p_vaddr  = ph->p_vaddr;
+			p_filesz = ph->p_filesz;
+		}
+
+		if (p_type != PT_LOAD || off < p_offset || off - p_offset >= p_filesz)
+			continue;
+
+		*vaddr = off - p_offset + p_vaddr;
+		return (0);
+	}
+	return (-1);
+}
+
+/**
+ * @brief Reads the program header @p idx and fills @p seg with
+ * its contents.
+ *
+ * @param ef ELF file.
+ * @param idx Program header index.
+ * @param seg Segment structure to be filled.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int elf_get_segment(struct elf_file *ef, size_t idx, struct elf_segment *seg)
+{
+	if (idx >= ef->phnum)
+		return (-1);
+
+	if (ef->elf_class == ELFCLASS64)
+	{
+		const Elf64_Phdr *ph;
+		ph = (const Elf64_Phdr *)(ef->phdrs + idx * ef->phentsize);
+		seg->type   = ph->p_type;
+		seg->offset = ph->p_offset;
+		seg->vaddr  = ph->p_vaddr;
+		seg->filesz = ph->p_filesz;
+		seg->memsz  = ph->p_memsz;
+	}
+	else
+	{
+		const Elf32_Phdr *ph;
+		ph = (const Elf32_Phdr *)(ef->phdrs + idx * ef->phentsize);
+		seg->type   = ph->p_type;
+		seg->offset = ph->p_offset;
+		seg->vaddr  = ph->p_vaddr;
+		seg->filesz = ph->p_filesz;
+		seg->memsz  = ph->p_memsz;
+	}
+
+	/* Truncated files (e.g: partial core dumps). */
+	if (!elf_in_bounds(ef, seg->offset, seg->filesz))
+		seg->filesz = seg->offset < ef->size ? ef->size - seg->offset : 0;
+
+	return (0);
+}
+
+/**
+ * @brief Reads @p len bytes at the virtual address @p vaddr,
+ * as loaded by the PT_LOAD segments, into @p buf. Bytes not
+ * present in the file (p_memsz > p_filesz) are read as 0.
+ *
+ * This is mostly useful for core files, where the PT_LOAD
+ * segments hold the process memory.
+ *
+ * @param ef ELF file.
+ * @param vaddr Virtual address.
+ * @param buf Destination buffer.
+ * @param len Amount of bytes to be read.
+ *
+ * @return Returns 0 if the whole range was read and a negative
+ * number otherwise.
+ */
+int elf_read_vaddr(struct elf_file *ef, uint64_t vaddr, void *buf, size_t len)
+{
+	struct elf_segment seg; /* Current segment.  */
+	uint64_t off;           /* Segment offset.   */
+	size_t chunk;           /* Bytes to be read. */
+	uint8_t *dst;           /* Destination.      */
+	size_t i;
+
+	dst = buf;
+	while (len)
+	{
+		for (i = 0; i < ef->phnum; i++)
+		{
+			if (elf_get_segment(ef, i, &seg) < 0 || seg.type != PT_LOAD)
+				continue;
+			if (vaddr >= seg.vaddr && vaddr - seg.vaddr < seg.memsz)
+				break;
+		}
+
+		if (i == ef->phnum)
+			return (-1);
+
+		off   = vaddr - seg.vaddr;
+		chunk = (seg.memsz - off) < len ? (size_t)(seg.memsz - off) : len;
+
+		/* Within the file, the rest is zero-filled. */
+		if (off < seg.filesz)
+		{
+			size_t n = (seg.filesz - off) < chunk ?
+				(size_t)(seg.filesz - off) : chunk;
+
+			memcpy(dst, ef->map + seg.offset + off, n);
+			memset(dst + n, 0, chunk - n);
+		}
+		else
+			memset(dst, 0, chunk);
+
+		dst   += chunk;
+		vaddr += chunk;
+		len   -= chunk;
+	}
+	return (0);
+}
+
+/**
+ * @brief For each note of type @p type, found in the PT_NOTE
+ * segments, invokes the callback @p cb with its descriptor,
+ * until the callback returns something different from 0.
+ *
+ * @param ef ELF file.
+ * @param type Note type, e.g: NT_PRSTATUS.
+ * @param cb Callback, receives the note descriptor and size.
+ * @param data Callback data.
+ *
+ * @return Returns the last callback return value, or 0 if
+ * all notes were processed.
+ */
+int elf_notes_iter(struct elf_file *ef, uint32_t type,
+	int (*cb)(const uint8_t *desc, size_t size, void *data), void *data)
+{
+	struct elf_segment seg;  /* Note segment.  */
+	const Elf64_Nhdr *nh;    /* Note header.   */
+	uint64_t off, end;       /* Note offsets.  */
+	uint64_t desc_off;       /* Descriptor.    */
+	int ret;
+
+	/* Elf32_Nhdr and Elf64_Nhdr are the same. */
+	for (size_t i = 0; i < ef->phnum; i++)
+	{
+		if (elf_get_segment(ef, i, &seg) < 0 || seg.type != PT_NOTE)
+			continue;
+
+		off = seg.offset;
+		end = seg.offset + seg.filesz;
+
+		while (off + sizeof(Elf64_Nhdr) <= end)
+		{
+			nh = (const Elf64_Nhdr *)(ef->map + off);
+			desc_off = off + sizeof(Elf64_Nhdr) + ((nh->n_namesz + 3) & ~3ULL);
+
+			if (desc_off > end || nh->n_descsz > end - desc_off)
+				break;
+
+			if (nh->n_type == type &&
+				(ret = cb(ef->map + desc_off, nh->n_descsz, data)) != 0)
+				return (ret);
+
+			off = desc_off + ((nh->n_descsz + 3) & ~3ULL);
+		}
+	}
+	return (0);
+}
@@ -0,0 +1,390 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Event loop.
+ *
+ * Tracee state changes:
+ *   A pidfd only becomes readable when the process exits, not
+ *   on ptrace stops, so the tracee wake ups always come from a
+ *   signalfd for SIGCHLD (blocked). The state changes are then
+ *   collected, without blocking, with waitid(P_PIDFD) if pidfds
+ *   are supported (Linux >= 5.4), or with waitpid() otherwise.
+ *
+ *   Since SIGCHLD is coalesced, ev_tracee_wait() should be
+ *   called until there is nothing left.
+ */
+
+#define _GNU_SOURCE
+#include "evloop.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+/**
+ * @brief Event source.
+ */
+struct ev_source
+{
+	int fd;            /* File descriptor.          */
+	ev_callback cb;    /* Callback.                 */
+	void *data;        /* Callback data.            */
+	int used;          /* Slot in use.              */
+	int owned;         /* Should be closed by us?.  */
+};
+
+/* Event sources. */
+static struct ev_source ev_sources[EV_MAX_SOURCES];
+
+/* epoll fd. */
+static int ev_epfd = -1;
+
+/* Loop running?. */
+static int ev_running;
+
+/* Tracee. */
+static int ev_pidfd = -1;
+static int ev_sigfd = -1;
+static sigset_t ev_oldmask;
+
+/**
+ * @brief Initializes the event loop.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int ev_init(void)
+{
+	memset(ev_sources, 0, sizeof(ev_sources));
+	if ((ev_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return (-1);
+	return (0);
+}
+
+/**
+ * @brief Searches for the source of @p fd.
+ *
+ * @param fd File descriptor.
+ *
+ * @return Returns the source, or NULL if not found.
+ */
+static struct ev_source *ev_find(int fd)
+{
+	for (int i = 0; i < EV_MAX_SOURCES; i++)
+		if (ev_sources[i].used && ev_sources[i].fd == fd)
+			return (&ev_sources[i]);
+	return (NULL);
+}
+
+/**
+ * @brief Registers the file descriptor @p fd.
+ *
+ * @param fd File descriptor.
+ * @param events Events of interest (EPOLLIN, EPOLLOUT...).
+ * @param cb Callback invoked when @p fd is ready.
+ * @param data Callback data.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int ev_add(int fd, uint32_t events, ev_callback cb, void *data)
+{
+	struct epoll_event ev;   /* Event.  */
+	struct ev_source *src;   /* Source. */
+
+	src = NULL;
+	for (int i = 0; i < EV_MAX_SOURCES && src == NULL; i++)
+		if (!ev_sources[i].used)
+			src = &ev_sources[i];
+
+	if (src == NULL)
+		return (-1);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events   = events;
+	ev.data.ptr = src;
+	if (epoll_ctl(ev_epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return (-1);
+
+	src->fd    = fd;
+	src->cb    = cb;
+	src->data  = data;
+	src->used  = 1;
+	src->owned = 0;
+	return (0);
+}
+
+/**
+ * @brief Changes the events of interest of @p fd.
+ *
+ * @param fd File descriptor.
+ * @param events New events, 0 disables the source.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int ev_mod(int fd, uint32_t events)
+{
+	struct epoll_event ev;   /* Event.  */
+	struct ev_source *src;   /* Source. */
+
+	if ((src = ev_find(fd)) == NULL)
+		return (-1);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events   = events;
+	ev.data.ptr = src;
+	return (epoll_ctl(ev_epfd, EPOLL_CTL_MOD, fd, &ev));
+}
+
+/**
+ * @brief Unregisters the file descriptor @p fd.
+ *
+ * @param fd File descriptor.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int ev_del(int fd)
+{
+	struct ev_source *src;   /* Source. */
+
+	if ((src = ev_find(fd)) == NULL)
+		return (-1);
+
+	epoll_ctl(ev_epfd, EPOLL_CTL_DEL, fd, NULL);
+	if (src->owned)
+		close(src->fd);
+
+	src->used = 0;
+	return (0);
+}
+
+/**
+ * @brief Creates a periodic timer.
+ *
+ * @param period_ms Period, in milliseconds.
+ * @param cb Callback invoked at each expiration, which should
+ * call ev_timer_ack().
+ * @param data Callback data.
+ *
+ * @return Returns the timer file descriptor, or a negative
+ * number if error.
+ */
+int ev_timer(int period_ms, ev_callback cb, void *data)
+{
+	struct itimerspec its;  /* Timer spec. */
+	int fd;                 /* Timer fd.   */
+
+	if ((fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC)) < 0)
+		return (-1);
+
+	its.it_interval.tv_sec  = period_ms / 1000;
+	its.it_interval.tv_nsec = (period_ms % 1000) * 1000000L;
+	its.it_value = its.it_interval;
+
+	if (timerfd_settime(fd, 0, &its, NULL) < 0 ||
+		ev_add(fd, EPOLLIN, cb, data) < 0)
+	{
+		close(fd);
+		return (-1);
+	}
+
+	ev_find(fd)->owned = 1;
+	return (fd);
+}
+
+/**
+ * @brief Acknowledges the expirations of the timer @p fd.
+ *
+ * @param fd Timer file descriptor.
+ */
+void ev_timer_ack(int fd)
+{
+	uint64_t expirations;
+	if (read(fd, &expirations, sizeof(expirations)) < 0)
+		return;
+}
+
+/**
+ * @brief Prepares the notification of the state changes of
+ * the tracee @p pid.
+ *
+ * @param pid Tracee pid.
+ *
+ * @return Returns the file descriptor to be polled (EPOLLIN),
+ * or a negative number if error.
+ */
+int ev_tracee_open(pid_t pid)
+{
+	sigset_t mask;  /* SIGCHLD mask. */
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &mask, &ev_oldmask) < 0)
+		return (-1);
+
+	ev_sigfd = signalfd(-1, &mask, SFD_NONBLOCK|SFD_CLOEXEC);
+	if (ev_sigfd < 0)
+	{
+		sigprocmask(SIG_SETMASK, &ev_oldmask, NULL);
+		return (-1);
+	}
+
+	/* Not fatal, waitpid() is used instead. */
+	ev_pidfd = syscall(SYS_pidfd_open, pid, 0);
+	return (ev_sigfd);
+}
+
+/**
+ * @brief Consumes the pending SIGCHLD notifications.
+ *
+ * @param fd Tracee file descriptor.
+ */
+void ev_tracee_ack(int fd)
+{
+	struct signalfd_siginfo si;
+	while (read(fd, &si, sizeof(si)) == sizeof(si))
+		continue;
+}
+
+/**
+ * @brief Collects, without blocking, a state change of the
+ * tracee @p pid.
+ *
+ * @param pid Tracee pid.
+ * @param exited Set to 1 if the tracee has exited, 0 if stopped.
+ *
+ * @return Returns 1 if there was a state change, 0 if nothing
+ * happened and a negative number if error.
+ */
+int ev_tracee_wait(pid_t pid, int *exited)
+{
+	siginfo_t si;  /* Child info. */
+	int status;    /* Status.     */
+	pid_t ret;     /* Child pid.  */
+
+	if (ev_pidfd >= 0)
+	{
+		memset(&si, 0, sizeof(si));
+		while (waitid(P_PIDFD, ev_pidfd, &si,
+			WEXITED|WSTOPPED|WNOHANG|__WALL) < 0)
+		{
+			if (errno != EINTR)
+				return (-1);
+		}
+
+		if (si.si_pid == 0)
+			return (0);
+
+		*exited = (si.si_code == CLD_EXITED || si.si_code == CLD_KILLED ||
+			si.si_code == CLD_DUMPED);
+		return (1);
+	}
+
+	while ((ret = waitpid(pid, &status, WNOHANG|__WALL)) < 0)
+	{
+		if (errno != EINTR)
+			return (-1);
+	}
+
+	if (ret == 0)
+		return (0);
+
+	*exited = (WIFEXITED(status) || WIFSIGNALED(status));
+	return (1);
+}
+
+/**
+ * @brief Runs the event loop, until ev_stop() is called.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int ev_run(void)
+{
+	struct epoll_event evs[EV_MAX_SOURCES]; /* Ready events. */
+	struct ev_source *src;                  /* Source.       */
+	int n;                                  /* Amount ready. */
+
+	ev_running = 1;
+	while (ev_running)
+	{
+		if ((n = epoll_wait(ev_epfd, evs, EV_MAX_SOURCES, -1)) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+
+		for (int i = 0; i < n && ev_running; i++)
+		{
+			src = evs[i].data.ptr;
+			if (src->used)
+				src->cb(src->fd, evs[i].events, src->data);
+		}
+	}
+	return (0);
+}
+
+/**
+ * @brief Stops the event loop.
+ */
+void ev_stop(void)
+{
+	ev_running = 0;
+}
+
+/**
+ * @brief Releases all the event loop resources.
+ */
+void ev_finish(void)
+{
+	for (int i = 0; i < EV_MAX_SOURCES; i++)
+		if (ev_sources[i].used)
+			ev_del(ev_sources[i].fd);
+
+	if (ev_pidfd >= 0)
+		close(ev_pidfd);
+	if (ev_sigfd >= 0)
+	{
+		close(ev_sigfd);
+		sigprocmask(SIG_SETMASK, &ev_oldmask, NULL);
+	}
+	if (ev_epfd >= 0)
+		close(ev_epfd);
+
+	ev_pidfd = -1;
+	ev_sigfd = -1;
+	ev_epfd  = -1;
+}
@@ -29,8 +29,8 @@
 #include <string.h>
 #include <stdarg.h>
 
-/* Static buffer for indent level. */
-static char fn_indent_buff[64 + 1] = {0};
+/* Static buffer for indent level (one per tracer thread). */
+static PBD_TLS char fn_indent_buff[64 + 1] = {0};
 
 /**
  * @brief Returns a constant indented string for the
@@ -0,0 +1,787 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "heap.h"
+#include "pbd.h"
+#include "ptrace.h"
+#include "breakpoint.h"
+#include "dwarf_helper.h"
+#include "elf_helper.h"
+#include "itree.h"
+#include "region.h"
+#include "tracer.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/* Allocator functions. */
+#define HP_MALLOC  0
+#define HP_CALLOC  1
+#define HP_REALLOC 2
+#define HP_FREE    3
+#define HP_NFUNCS  4
+
+static const char *const hp_func_names[HP_NFUNCS] = {
+	"malloc", "calloc", "realloc", "free"
+};
+
+/**
+ * @brief Watched heap block.
+ */
+struct hp_block
+{
+	uintptr_t addr;   /* Block address.       */
+	size_t size;      /* Block size.          */
+	char *shadow;     /* Last known contents. */
+};
+
+/**
+ * @brief Allocator call in progress, i.e: already entered
+ * but not returned yet.
+ */
+struct hp_call
+{
+	pid_t tid;        /* Calling thread, 0 if free slot. */
+	int func;         /* HP_MALLOC, HP_CALLOC...         */
+	size_t size;      /* Requested size.                 */
+	uintptr_t old;    /* Old block, if realloc.          */
+	uintptr_t ret;    /* Return address.                 */
+	uintptr_t sp;     /* Stack pointer at the entry.     */
+	int track;        /* Track the returned block.       */
+};
+
+/**
+ * @brief Function whose allocations are always watched.
+ */
+struct hp_site
+{
+	char *name;       /* Function name.       */
+	uintptr_t low;    /* Start address.       */
+	uintptr_t high;   /* End address.         */
+};
+
+/* Live blocks. */
+static struct itree *blocks;
+
+/* Element format. */
+static size_t hp_elem_size = 1;
+static int hp_encoding = ENC_UNSIGNED;
+
+/* Allocator sites. */
+static struct hp_site sites[HP_MAX_SITES];
+static int nsites;
+
+/* Calls in progress. */
+static struct hp_call calls[HP_MAX_CALLS];
+
+/* Breakpoints: entry point, allocators and return addresses. */
+static struct hashtable *breakpoints;
+static struct hashtable *hp_bps;
+static uintptr_t hp_entry;
+static uintptr_t hp_funcs[HP_NFUNCS];
+
+/* Breakpoint kinds, as hp_bps values. */
+static int hp_owned = HP_OWNED;
+static int hp_shared = HP_NONE;
+
+/* Stop scratch data. */
+static struct
+{
+	struct iovec iov[HP_IOV_MAX];       /* Areas to be read.     */
+	int niov;                           /* Amount of areas.      */
+	struct hp_block *blk[HP_BATCH_MAX]; /* Blocks, in order.     */
+	size_t off[HP_BATCH_MAX];           /* Offsets into buf.     */
+	int n;                              /* Amount of blocks.     */
+	char *buf;                          /* Contents read.        */
+	size_t buf_size;                    /* Buffer capacity.      */
+	size_t used;                        /* Buffer used.          */
+	struct hp_block **dead;             /* Unreadable blocks.    */
+	size_t ndead;                       /* Amount of dead.       */
+	size_t dead_cap;                    /* Dead capacity.        */
+	pid_t child;                        /* Child process.        */
+	unsigned line_no;                   /* Line number.          */
+	int depth;                          /* Function depth.       */
+	int changes;                        /* Changes found.        */
+} st;
+
+/* Serializes everything when tracing multiple threads. */
+static pthread_mutex_t hp_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Sets the element size and encoding used to compare
+ * and show the heap blocks.
+ *
+ * @param spec elemsize[:encoding], as in --watch-region.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int hp_set_format(const char *spec)
+{
+	if (rg_parse_elem(spec, &hp_elem_size, &hp_encoding) < 0)
+	{
+		fprintf(stderr, "PBD: --watch-heap: invalid format (%s), expected: "
+			"elemsize[:s|u|f|x]\n", spec);
+		return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Adds a function whose allocations (made directly from
+ * it) are always watched, even outside the analyzed function.
+ *
+ * @param function Function name.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int hp_add_site(const char *function)
+{
+	if (nsites == HP_MAX_SITES)
+	{
+		fprintf(stderr, "PBD: --heap-site: too many sites (max: %d)\n",
+			HP_MAX_SITES);
+		return (-1);
+	}
+
+	sites[nsites].name = malloc(sizeof(char) * (strlen(function) + 1));
+	if (sites[nsites].name == NULL)
+		return (-1);
+
+	strcpy(sites[nsites].name, function);
+	nsites++;
+	return (0);
+}
+
+/**
+ * @brief Creates a breakpoint at @p addr, remembering if it
+ * belongs only to the heap watch or is also a line breakpoint.
+ *
+ * @param addr Breakpoint address.
+ * @param child Child process.
+ */
+static void hp_breakpoint(uintptr_t addr, pid_t child)
+{
+	int created;
+
+	if (hashtable_get(&hp_bps, (void *)addr) != NULL)
+		return;
+
+	tr_wrlock();
+		created = (bp_createbreakpoint(addr, breakpoints, child) == 0);
+	tr_unlock();
+
+	hashtable_add(&hp_bps, (void *)addr, created ? &hp_owned : &hp_shared);
+}
+
+/**
+ * @brief Initializes the heap watch: resolves the --heap-site
+ * functions and sets a breakpoint at the executable entry point,
+ * where the libc is already loaded.
+ *
+ * @param child Child process.
+ * @param file Executable file.
+ * @param bps Breakpoints list.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int hp_init(pid_t child, const char *file, struct hashtable *bps)
+{
+	struct elf_symbol sym;
+	struct elf_file ef;
+
+	if (elf_open(&ef, file) < 0)
+	{
+		fprintf(stderr, "PBD: --watch-heap: unable to read %s\n", file);
+		return (-1);
+	}
+
+	for (int i = 0; i < nsites; i++)
+	{
+		if (elf_lookup_symbol(&ef, SHT_SYMTAB, sites[i].name, &sym) < 0 &&
+			elf_lookup_symbol(&ef, SHT_DYNSYM, sites[i].name, &sym) < 0)
+		{
+			fprintf(stderr, "PBD: --heap-site: function %s not found!\n",
+				sites[i].name);
+			elf_close(&ef);
+			return (-1);
+		}
+		sites[i].low  = sym.value;
+		sites[i].high = sym.value + (sym.size ? sym.size : 1);
+	}
+
+	hp_entry = ef.entry;
+	elf_close(&ef);
+
+	if (itree_init(&blocks) < 0 || hashtable_init(&hp_bps, NULL) < 0)
+		return (-1);
+
+	breakpoints = bps;
+	hp_breakpoint(hp_entry, child);
+	return (0);
+}
+
+/**
+ * @brief Finds the allocators in the ELF file @p file, loaded
+ * at @p bias.
+ *
+ * @param file ELF file.
+ * @param sh_type Symbol table type.
+ * @param bias Load bias.
+ *
+ * @return Returns 0 if all of them were found and a negative
+ * number otherwise.
+ */
+static int hp_lookup_funcs(const char *file, uint32_t sh_type, uintptr_t bias)
+{
+	struct elf_symbol sym;
+	struct elf_file ef;
+	int ret;
+
+	if (elf_open(&ef, file) < 0)
+		return (-1);
+
+	ret = 0;
+	for (int i = 0; i < HP_NFUNCS; i++)
+	{
+		if (elf_lookup_symbol(&ef, sh_type, hp_func_names[i], &sym) < 0)
+		{
+			ret = -1;
+			break;
+		}
+		hp_funcs[i] = bias + sym.value;
+	}
+
+	elf_close(&ef);
+	return (ret);
+}
+
+/**
+ * @brief Resolves the allocators in the child libc, through its
+ * dynamic symbol table, or in the executable itself, if static,
+ * and sets a breakpoint on each one.
+ *
+ * @param child Child process.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int hp_resolve_allocators(pid_t child)
+{
+	char path[64];
+	char line[4096];
+	int found;
+	FILE *fp;
+
+	found = 0;
+	snprintf(path, sizeof path, "/proc/%d/maps", (int)child);
+	if ((fp = fopen(path, "r")) == NULL)
+		return (-1);
+
+	while (!found && fgets(line, sizeof line, fp) != NULL)
+	{
+		struct elf_file ef;
+		uintptr_t start;
+		uint64_t offset;
+		uint64_t vaddr;
+		char *pathname;
+		char *base_name;
+		int off;
+
+		if (sscanf(line, "%" SCNxPTR "-%*x %*s %" SCNx64 " %*s %*s%n",
+			&start, &offset, &off) != 2 || offset != 0)
+			continue;
+
+		pathname = line + off;
+		pathname += strspn(pathname, " ");
+		pathname[strcspn(pathname, "\n")] = '\0';
+		base_name = strrchr(pathname, '/');
+		base_name = base_name ? base_name + 1 : pathname;
+
+		if (strncmp(base_name, "libc.", 5) && strncmp(base_name, "libc-", 5) &&
+			strncmp(base_name, "ld-musl", 7))
+			continue;
+
+		/* Load bias: the file start is mapped at 'start'. */
+		if (elf_open(&ef, pathname) < 0)
+			continue;
+		if (elf_offset_to_vaddr(&ef, 0, &vaddr) < 0)
+			vaddr = 0;
+		elf_close(&ef);
+
+		found = (hp_lookup_funcs(pathname, SHT_DYNSYM, start - vaddr) == 0);
+	}
+	fclose(fp);
+
+	/* Static executable, maybe. */
+	if (!found)
+	{
+		snprintf(path, sizeof path, "/proc/%d/exe", (int)child);
+		if (hp_lookup_funcs(path, SHT_SYMTAB, 0) < 0)
+		{
+			fprintf(stderr, "PBD: --watch-heap: allocator functions not "
+				"found, heap watch disabled!\n");
+			return (-1);
+		}
+	}
+
+	for (int i = 0; i < HP_NFUNCS; i++)
+		hp_breakpoint(hp_funcs[i], child);
+
+	return (0);
+}
+
+/**
+ * @brief Gets the allocator call in progress for the thread @p tid.
+ *
+ * @param tid Thread id.
+ *
+ * @return Returns the call, or NULL if none.
+ */
+static struct hp_call *hp_get_call(pid_t tid)
+{
+	for (int i = 0; i < HP_MAX_CALLS; i++)
+		if (calls[i].tid == tid)
+			return (&calls[i]);
+	return (NULL);
+}
+
+/**
+ * @brief Checks if the return address @p ret belongs to one
+ * of the --heap-site functions.
+ *
+ * @param ret Return address.
+ *
+ * @return Returns 1 if so, 0 otherwise.
+ */
+static int hp_from_site(uintptr_t ret)
+{
+	for (int i = 0; i < nsites; i++)
+		if (ret >= sites[i].low && ret < sites[i].high)
+			return (1);
+	return (0);
+}
+
+/**
+ * @brief Deallocates a heap block.
+ *
+ * @param value Heap block.
+ */
+static void hp_block_free(void *value)
+{
+	struct hp_block *b = value;
+	free(b->shadow);
+	free(b);
+}
+
+/**
+ * @brief Stops watching the block at @p addr, if watched.
+ *
+ * @param addr Block address.
+ */
+static void hp_untrack(uintptr_t addr)
+{
+	struct hp_block *b;
+	if ((b = itree_remove(&blocks, addr)) != NULL)
+		hp_block_free(b);
+}
+
+/**
+ * @brief Starts watching the block [@p addr, @p addr + @p size).
+ *
+ * Any block overlapping it is obviously gone (its free was
+ * missed, e.g: freed inside the libc), and is dropped.
+ *
+ * @param child Child process.
+ * @param addr Block address.
+ * @param size Block size.
+ */
+static void hp_track(pid_t child, uintptr_t addr, size_t size)
+{
+	struct hp_block *b;
+	uintptr_t start;
+
+	while (itree_overlap(&blocks, addr, addr + size, &start) != NULL)
+		hp_untrack(start);
+
+	/* Only whole elements are compared. */
+	size -= size % hp_elem_size;
+	if (!size)
+		return;
+
+	if ((b = malloc(sizeof(struct hp_block))) == NULL)
+		return;
+
+	b->addr   = addr;
+	b->size   = size;
+	b->shadow = malloc(size);
+
+	if (b->shadow == NULL ||
+		pt_readmemory_buf(child, addr, b->shadow, size) < 0 ||
+		itree_insert(&blocks, addr, addr + size, b) < 0)
+	{
+		hp_block_free(b);
+	}
+}
+
+/**
+ * @brief Allocator entry: saves its arguments and sets a breakpoint
+ * at its return address, so the block returned can be known.
+ *
+ * @param tid Thread id.
+ * @param func Allocator function.
+ * @param depth Function depth, for the thread.
+ */
+static void hp_enter(pid_t tid, int func, int depth)
+{
+	struct hp_call *c;
+	uintptr_t sp;
+	uintptr_t a0, a1;
+
+	sp = pt_readregister_sp(tid);
+	a0 = pt_readcall_arg(tid, 0);
+
+	/*
+	 * Allocators called from inside another allocator (e.g: realloc
+	 * with NULL) are ignored, unless the previous call was unwound
+	 * without returning (e.g: longjmp).
+	 */
+	if ((c = hp_get_call(tid)) != NULL)
+	{
+		if (sp < c->sp)
+		{
+			if (func == HP_FREE && a0)
+				hp_untrack(a0);
+			return;
+		}
+		c->tid = 0;
+	}
+
+	if (func == HP_FREE)
+	{
+		if (a0)
+			hp_untrack(a0);
+		return;
+	}
+
+	if ((c = hp_get_call(0)) == NULL)
+		return;
+
+	c->tid  = tid;
+	c->func = func;
+	c->ret  = pt_readreturn_address(tid);
+	c->sp   = sp;
+	c->old  = 0;
+
+	switch (func)
+	{
+		case HP_MALLOC:
+			c->size = a0;
+			break;
+		case HP_CALLOC:
+			a1 = pt_readcall_arg(tid, 1);
+			c->size = (a1 && a0 > SIZE_MAX / a1) ? 0 : a0 * a1;
+			break;
+		case HP_REALLOC:
+			c->old  = a0;
+			c->size = pt_readcall_arg(tid, 1);
+			break;
+	}
+
+	c->track = depth > 0 || hp_from_site(c->ret) ||
+		(c->old && itree_get(&blocks, c->old) != NULL);
+
+	hp_breakpoint(c->ret, tid);
+}
+
+/**
+ * @brief Allocator return: watches the block returned, if
+ * requested.
+ *
+ * @param tid Thread id.
+ * @param pc Return address.
+ */
+static void hp_return(pid_t tid, uintptr_t pc)
+{
+	struct hp_call *c;
+	uintptr_t ptr;
+
+	/* The caller frame must be the same one. */
+	if ((c = hp_get_call(tid)) == NULL || c->ret != pc ||
+		pt_readregister_sp(tid) != c->sp + sizeof(uintptr_t))
+		return;
+
+	c->tid = 0;
+	ptr = pt_readreturn_value(tid);
+
+	/* Realloc: the old block is gone, unless it failed. */
+	if (c->func == HP_REALLOC && c->old && (ptr || !c->size))
+		hp_untrack(c->old);
+
+	if (c->track && ptr && c->size)
+		hp_track(tid, ptr, c->size);
+}
+
+/**
+ * @brief Handles a breakpoint that might belong to the heap
+ * watch, i.e: the entry point, the allocators or their return
+ * addresses.
+ *
+ * @param tid Thread id.
+ * @param pc Breakpoint address.
+ * @param depth Function depth, for the thread.
+ *
+ * @return Returns HP_OWNED if the breakpoint only belongs to the
+ * heap watch, and HP_NONE otherwise.
+ */
+int hp_trap(pid_t tid, uintptr_t pc, int depth)
+{
+	int *kind;
+
+	pthread_mutex_lock(&hp_mutex);
+
+	if ((kind = hashtable_get(&hp_bps, (void *)pc)) == NULL)
+	{
+		pthread_mutex_unlock(&hp_mutex);
+		return (HP_NONE);
+	}
+
+	if (pc == hp_entry && !hp_funcs[HP_MALLOC])
+		hp_resolve_allocators(tid);
+
+	for (int i = 0; i < HP_NFUNCS; i++)
+	{
+		if (pc == hp_funcs[i])
+		{
+			hp_enter(tid, i, depth);
+			goto out;
+		}
+	}
+
+	hp_return(tid, pc);
+out:
+	pthread_mutex_unlock(&hp_mutex);
+	return (*kind);
+}
+
+/**
+ * @brief Compares the blocks read in the current batch and
+ * resets it.
+ *
+ * @param nread Amount of bytes read for the batch.
+ */
+static void hp_flush(ssize_t nread)
+{
+	char name[24];
+
+	for (int i = 0; i < st.n; i++)
+	{
+		struct hp_block *b = st.blk[i];
+		char *cur = st.buf + st.off[i];
+
+		/* Not read together with the others, try alone. */
+		if (nread < 0 || st.off[i] + b->size > (size_t)nread)
+		{
+			if (pt_readmemory_buf(st.child, b->addr, cur, b->size) < 0)
+			{
+				if (st.ndead == st.dead_cap)
+				{
+					struct hp_block **d;
+					d = realloc(st.dead, sizeof(*d) * (st.dead_cap * 2 + 16));
+					if (d == NULL)
+						continue;
+					st.dead = d;
+					st.dead_cap = st.dead_cap * 2 + 16;
+				}
+				st.dead[st.ndead++] = b;
+				continue;
+			}
+		}
+
+		if (memcmp(b->shadow, cur, b->size))
+		{
+			snprintf(name, sizeof name, "0x%" PRIxPTR, b->addr);
+			st.changes += rg_diff("heap", name, 0, b->shadow, cur, b->size,
+				hp_elem_size, hp_encoding, st.line_no, st.depth);
+		}
+	}
+
+	st.n = 0;
+	st.niov = 0;
+	st.used = 0;
+}
+
+/**
+ * @brief Reads and compares the current batch, if any.
+ */
+static inline void hp_read_batch(void)
+{
+	if (st.n)
+		hp_flush(pt_readmemory_iov(st.child, st.iov, st.niov, st.buf));
+}
+
+/**
+ * @brief Adds the block @p value to the current batch, reading
+ * and comparing the batch when full.
+ *
+ * Blocks close to each other (which is the usual for heap blocks)
+ * are read as a single area, gap included, since reading a few
+ * more bytes is way cheaper than an additional area.
+ *
+ * @return Always 0.
+ */
+static int hp_batch(uintptr_t start, uintptr_t end, void *value, void *data)
+{
+	struct hp_block *b = value;
+	struct iovec *last;
+	size_t gap;
+	((void)start);
+	((void)end);
+	((void)data);
+
+	/* Merge with the previous area? */
+	gap  = 0;
+	last = NULL;
+	if (st.niov)
+	{
+		last = &st.iov[st.niov - 1];
+		gap  = b->addr - ((uintptr_t)last->iov_base + last->iov_len);
+		if (gap > HP_MERGE_GAP)
+		{
+			last = NULL;
+			gap  = 0;
+		}
+	}
+
+	if (st.n == HP_BATCH_MAX ||
+		(last == NULL && st.niov == HP_IOV_MAX) ||
+		st.used + gap + b->size > st.buf_size)
+	{
+		hp_read_batch();
+		last = NULL;
+		gap  = 0;
+	}
+
+	/* Bigger than the whole buffer. */
+	if (b->size > st.buf_size)
+	{
+		char *buf = realloc(st.buf, b->size);
+		if (buf == NULL)
+			return (0);
+		st.buf = buf;
+		st.buf_size = b->size;
+	}
+
+	if (last != NULL)
+		last->iov_len += gap + b->size;
+	else
+	{
+		st.iov[st.niov].iov_base = (void *)b->addr;
+		st.iov[st.niov].iov_len  = b->size;
+		st.niov++;
+	}
+
+	st.used += gap;
+	st.blk[st.n] = b;
+	st.off[st.n] = st.used;
+	st.used += b->size;
+	st.n++;
+	return (0);
+}
+
+/**
+ * @brief Checks if there is a change in any of the watched
+ * heap blocks, if so, exhibits the changed elements.
+ *
+ * Blocks are visited in address order and read in batches,
+ * with a single system call per batch.
+ *
+ * @param child Child process.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns the amount of changes found.
+ */
+int hp_check_changes(pid_t child, unsigned line_no, int depth)
+{
+	int changes;
+
+	pthread_mutex_lock(&hp_mutex);
+
+	if (!itree_size(&blocks))
+	{
+		pthread_mutex_unlock(&hp_mutex);
+		return (0);
+	}
+
+	if (st.buf == NULL)
+	{
+		if ((st.buf = malloc(HP_SCRATCH_MIN)) == NULL)
+		{
+			pthread_mutex_unlock(&hp_mutex);
+			return (0);
+		}
+		st.buf_size = HP_SCRATCH_MIN;
+	}
+
+	st.child   = child;
+	st.line_no = line_no;
+	st.depth   = depth;
+	st.changes = 0;
+	st.n       = 0;
+	st.niov    = 0;
+	st.used    = 0;
+	st.ndead   = 0;
+
+	itree_foreach(&blocks, hp_batch, NULL);
+	hp_read_batch();
+
+	/* Blocks no longer readable, e.g: unmapped. */
+	for (size_t i = 0; i < st.ndead; i++)
+		hp_untrack(st.dead[i]->addr);
+
+	changes = st.changes;
+	pthread_mutex_unlock(&hp_mutex);
+	return (changes);
+}
+
+/**
+ * @brief Deallocates everything related to the heap watch.
+ */
+void hp_finish(void)
+{
+	itree_finish(&blocks, hp_block_free);
+
+	if (hp_bps != NULL)
+		hashtable_finish(&hp_bps, 0);
+
+	for (int i = 0; i < nsites; i++)
+		free(sites[i].name);
+
+	free(st.buf);
+	free(st.dead);
+	memset(&st, 0, sizeof st);
+	nsites = 0;
+}
@@ -0,0 +1,495 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "heatmap.h"
+#include "pbd.h"
+#include "variable.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Shades, from cold to hot, of the text rendering. */
+static const char hm_shades[] = " .:-=+*#%@";
+
+/**
+ * Change counters of an array.
+ */
+struct hm_var
+{
+	char *name;                /* Variable name.            */
+	int scope;                 /* Variable scope.           */
+	int dimensions;            /* Amount of dimensions.     */
+	int elements_per_dimension[MATRIX_MAX_DIMENSIONS];
+	size_t nelements;          /* Amount of elements.       */
+	size_t bucket;             /* Elements per counter.     */
+	size_t ncounters;          /* Amount of counters.       */
+	uint32_t *counters;        /* Change counters.          */
+	uint64_t changes;          /* Amount of changes.        */
+};
+
+/* Heatmaps, indexed by dw_variable::heat. */
+static struct hm_var *hm_vars;
+static int hm_nvars;
+
+/* Hottest indexes listed and PGM images prefix, if any. */
+static int hm_top;
+static const char *hm_pgm;
+
+/**
+ * @brief Initializes the heatmaps for the arrays of @p vars, of
+ * the first function context: since the contexts created
+ * afterwards copy these variables, all of them share the same
+ * counters.
+ *
+ * @param vars Variables list.
+ * @param top Amount of hottest indexes listed.
+ * @param pgm_prefix Prefix of the PGM images of 2-D arrays,
+ *        or NULL if none.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int hm_init(struct array *vars, int top, const char *pgm_prefix)
+{
+	struct dw_variable *v; /* Current variable. */
+	struct hm_var *h;      /* Heatmap.          */
+	int n;                 /* Variables amount. */
+
+	hm_top = top;
+	hm_pgm = pgm_prefix;
+
+	n = (int) array_size(&vars);
+	if (!n)
+		return (0);
+
+	if ((hm_vars = calloc(n, sizeof(struct hm_var))) == NULL)
+		return (-1);
+
+	for (int i = 0; i < n; i++)
+	{
+		v = array_get(&vars, i, NULL);
+		v->heat = -1;
+
+		if (v->type.var_type != TARRAY ||
+			!(v->type.array.var_type & (TBASE_TYPE|TENUM|TPOINTER)) ||
+			!v->type.array.size_per_element)
+			continue;
+
+		h = &hm_vars[hm_nvars];
+		h->name = malloc(sizeof(char) * (strlen(v->name) + 1));
+		if (h->name == NULL)
+			return (-1);
+
+		strcpy(h->name, v->name);
+		h->scope      = v->scope;
+		h->dimensions = v->type.array.dimensions;
+		memcpy(h->elements_per_dimension, v->type.array.elements_per_dimension,
+			sizeof(h->elements_per_dimension));
+
+		/* Huge arrays: a counter per bucket of elements. */
+		h->nelements = v->byte_size / v->type.array.size_per_element;
+		h->bucket    = (h->nelements + HM_MAX_COUNTERS - 1) / HM_MAX_COUNTERS;
+		if (!h->bucket)
+			h->bucket = 1;
+		h->ncounters = (h->nelements + h->bucket - 1) / h->bucket;
+
+		if ((h->counters = calloc(h->ncounters + 1, sizeof(uint32_t))) == NULL)
+			return (-1);
+
+		v->heat = hm_nvars++;
+	}
+	return (0);
+}
+
+/**
+ * @brief Accounts a change of the element @p index (flattened)
+ * of the array @p v.
+ *
+ * @param v Changed array.
+ * @param index Element index, as if the array had a single
+ *        dimension.
+ */
+void hm_update(struct dw_variable *v, size_t index)
+{
+	struct hm_var *h;
+
+	if (v->heat < 0 || v->heat >= hm_nvars)
+		return;
+
+	h = &hm_vars[v->heat];
+	if (index >= h->nelements)
+		return;
+
+	__atomic_add_fetch(&h->counters[index / h->bucket], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->changes, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Accounts every element that differs between @p before
+ * and @p after, for the arrays reported at once (bitmaps and
+ * strings), that are not diffed element-wise.
+ *
+ * @param v Changed array.
+ * @param before Elements before.
+ * @param after Elements after.
+ * @param first Flattened index of the first element.
+ * @param size Size, in bytes.
+ */
+void hm_update_range(struct dw_variable *v, char *before, char *after,
+	size_t first, size_t size)
+{
+	size_t size_per_element; /* Element size.   */
+	int64_t byte_offset;     /* Change offset.  */
+	size_t off;              /* Current offset. */
+
+	if (v->heat < 0 || v->heat >= hm_nvars)
+		return;
+
+	size_per_element = v->type.array.size_per_element;
+	off = 0;
+
+	while (off < size && (byte_offset = offmemcmp(before + off, after + off,
+		size_per_element, size - off)) >= 0)
+	{
+		off += byte_offset;
+		hm_update(v, first + off / size_per_element);
+		off += size_per_element;
+	}
+}
+
+/**
+ * @brief Converts the flattened index @p index into the indexes
+ * of each dimension of @p h.
+ *
+ * @param h Heatmap.
+ * @param index Flattened index.
+ * @param idxs Indexes, per dimension.
+ */
+static void hm_indexes(struct hm_var *h, size_t index, int *idxs)
+{
+	for (int j = h->dimensions - 1; j >= 0; j--)
+	{
+		idxs[j] = index % h->elements_per_dimension[j];
+		index /= h->elements_per_dimension[j];
+	}
+}
+
+/**
+ * @brief Prints the indexes of the element @p index, as in:
+ * [i][j]...
+ *
+ * @param out Output file.
+ * @param h Heatmap.
+ * @param index Flattened index.
+ */
+static void hm_print_index(FILE *out, struct hm_var *h, size_t index)
+{
+	int idxs[MATRIX_MAX_DIMENSIONS];
+
+	hm_indexes(h, index, idxs);
+	for (int j = 0; j < h->dimensions; j++)
+		fprintf(out, "[%d]", idxs[j]);
+}
+
+/**
+ * @brief Prints the counter @p c of @p h: an element or, for
+ * buckets, its first and last elements.
+ *
+ * @param out Output file.
+ * @param h Heatmap.
+ * @param c Counter index.
+ */
+static void hm_print_counter(FILE *out, struct hm_var *h, size_t c)
+{
+	size_t last;
+
+	hm_print_index(out, h, c * h->bucket);
+	if (h->bucket == 1)
+		return;
+
+	last = (c + 1) * h->bucket;
+	if (last > h->nelements)
+		last = h->nelements;
+
+	fputs("..", out);
+	hm_print_index(out, h, last - 1);
+}
+
+/**
+ * @brief Prints the changes of each dimension of @p h, summed
+ * over the others, in up to HM_BINS bins.
+ *
+ * @param out Output file.
+ * @param h Heatmap.
+ */
+static void hm_report_dimensions(FILE *out, struct hm_var *h)
+{
+	uint64_t bins[MATRIX_MAX_DIMENSIONS][HM_BINS]; /* Marginal sums. */
+	int width[MATRIX_MAX_DIMENSIONS];              /* Bin width.     */
+	int idxs[MATRIX_MAX_DIMENSIONS];               /* Indexes.       */
+	int nbins;                                     /* Bins used.     */
+	int lo, hi;                                    /* Bin range.     */
+
+	memset(bins, 0, sizeof(bins));
+	for (int d = 0; d < h->dimensions; d++)
+		width[d] = (h->elements_per_dimension[d] + HM_BINS - 1) / HM_BINS;
+
+	for (size_t c = 0; c < h->ncounters; c++)
+	{
+		if (!h->counters[c])
+			continue;
+
+		hm_indexes(h, c * h->bucket, idxs);
+		for (int d = 0; d < h->dimensions; d++)
+			bins[d][idxs[d] / width[d]] += h->counters[c];
+	}
+
+	for (int d = 0; d < h->dimensions; d++)
+	{
+		fprintf(out, "    dimension %d (%d):", d, h->elements_per_dimension[d]);
+
+		nbins = (h->elements_per_dimension[d] + width[d] - 1) / width[d];
+		for (int b = 0; b < nbins; b++)
+		{
+			lo = b * width[d];
+			hi = lo + width[d] - 1;
+			if (hi >= h->elements_per_dimension[d])
+				hi = h->elements_per_dimension[d] - 1;
+
+			if (lo == hi)
+				fprintf(out, " [%d]: %" PRIu64, lo, bins[d][b]);
+			else
+				fprintf(out, " [%d-%d]: %" PRIu64, lo, hi, bins[d][b]);
+		}
+		fputc('\n', out);
+	}
+}
+
+/**
+ * @brief Prints the @p top hottest counters of @p h.
+ *
+ * @param out Output file.
+ * @param h Heatmap.
+ */
+static void hm_report_top(FILE *out, struct hm_var *h)
+{
+	size_t *best; /* Hottest counters, descending. */
+	int nbest;    /* Counters found.               */
+	int j;
+
+	if (!hm_top || (best = malloc(sizeof(size_t) * hm_top)) == NULL)
+		return;
+
+	nbest = 0;
+	for (size_t c = 0; c < h->ncounters; c++)
+	{
+		if (!h->counters[c] || (nbest == hm_top &&
+			h->counters[c] <= h->counters[best[nbest - 1]]))
+			continue;
+
+		if (nbest < hm_top)
+			nbest++;
+
+		for (j = nbest - 1; j > 0 && h->counters[best[j - 1]] < h->counters[c];
+			j--)
+		{
+			best[j] = best[j - 1];
+		}
+		best[j] = c;
+	}
+
+	fprintf(out, "    top %d:", nbest);
+	for (j = 0; j < nbest; j++)
+	{
+		fputs(j ? ", " : " ", out);
+		hm_print_counter(out, h, best[j]);
+		fprintf(out, ": %" PRIu32, h->counters[best[j]]);
+	}
+	fputc('\n', out);
+	free(best);
+}
+
+/**
+ * @brief Gets the counter of the element at row @p r and column
+ * @p col of the 2-D array @p h.
+ */
+static inline uint32_t hm_cell(struct hm_var *h, size_t r, size_t col)
+{
+	return (h->counters[(r * h->elements_per_dimension[1] + col) / h->bucket]);
+}
+
+/**
+ * @brief Renders the 2-D array @p h as text, downsampled to at
+ * most HM_TEXT_ROWS x HM_TEXT_COLS.
+ *
+ * @param out Output file.
+ * @param h Heatmap.
+ */
+static void hm_report_text(FILE *out, struct hm_var *h)
+{
+	uint64_t grid[HM_TEXT_ROWS][HM_TEXT_COLS]; /* Downsampled. */
+	uint64_t max;                              /* Hottest.     */
+	size_t rows, cols;                         /* Array size.  */
+	size_t gr, gc;                             /* Grid size.   */
+	int level;                                 /* Shade.       */
+
+	rows = h->elements_per_dimension[0];
+	cols = h->elements_per_dimension[1];
+	gr   = rows < HM_TEXT_ROWS ? rows : HM_TEXT_ROWS;
+	gc   = cols < HM_TEXT_COLS ? cols : HM_TEXT_COLS;
+
+	memset(grid, 0, sizeof(grid));
+	max = 0;
+	for (size_t r = 0; r < rows; r++)
+	{
+		for (size_t c = 0; c < cols; c++)
+		{
+			uint64_t *cell = &grid[r * gr / rows][c * gc / cols];
+			*cell += hm_cell(h, r, c);
+			if (*cell > max)
+				max = *cell;
+		}
+	}
+
+	fprintf(out, "    map (%zux%zu, shades: '%s'):\n", gr, gc, hm_shades);
+	for (size_t r = 0; r < gr; r++)
+	{
+		fputs("      |", out);
+		for (size_t c = 0; c < gc; c++)
+		{
+			level = 0;
+			if (grid[r][c])
+				level = 1 + (int)((grid[r][c] * (sizeof(hm_shades) - 3)) / max);
+			fputc(hm_shades[level], out);
+		}
+		fputs("|\n", out);
+	}
+}
+
+/**
+ * @brief Writes the 2-D array @p h as a binary PGM image, one
+ * pixel per element.
+ *
+ * @param out Report output.
+ * @param h Heatmap.
+ */
+static void hm_write_pgm(FILE *out, struct hm_var *h)
+{
+	uint32_t max;      /* Hottest counter. */
+	size_t rows, cols; /* Image size.      */
+	char *path;        /* Image path.      */
+	FILE *fp;          /* Image file.      */
+
+	path = malloc(sizeof(char) * (strlen(hm_pgm) + strlen(h->name) + 5));
+	if (path == NULL)
+		return;
+
+	strcpy(path, hm_pgm);
+	strcat(path, h->name);
+	strcat(path, ".pgm");
+
+	if ((fp = fopen(path, "wb")) == NULL)
+	{
+		fprintf(stderr, "PBD: --heatmap-pgm: unable to create %s\n", path);
+		free(path);
+		return;
+	}
+
+	max = 0;
+	for (size_t c = 0; c < h->ncounters; c++)
+		if (h->counters[c] > max)
+			max = h->counters[c];
+
+	rows = h->elements_per_dimension[0];
+	cols = h->elements_per_dimension[1];
+	fprintf(fp, "P5\n%zu %zu\n255\n", cols, rows);
+
+	for (size_t r = 0; r < rows; r++)
+		for (size_t c = 0; c < cols; c++)
+			fputc(max ? (int)(((uint64_t)hm_cell(h, r, c) * 255) / max) : 0, fp);
+
+	fclose(fp);
+	fprintf(out, "    image: %s\n", path);
+	free(path);
+}
+
+/**
+ * @brief Writes the heatmaps of all the arrays changed.
+ *
+ * @param out Output file.
+ */
+void hm_report(FILE *out)
+{
+	struct hm_var *h; /* Heatmap.          */
+	size_t changed;   /* Counters changed. */
+
+	fprintf(out, "\nHeatmap:\n");
+	for (int i = 0; i < hm_nvars; i++)
+	{
+		h = &hm_vars[i];
+
+		changed = 0;
+		for (size_t c = 0; c < h->ncounters; c++)
+			changed += (h->counters[c] != 0);
+
+		fprintf(out, "  [%s] (%s): %" PRIu64 " changes, %zu/%zu %s changed",
+			(h->scope == VGLOBAL ? "global" : "local"), h->name, h->changes,
+			changed, h->ncounters, h->bucket == 1 ? "elements" : "buckets");
+
+		if (h->bucket > 1)
+			fprintf(out, " (%zu elements per bucket)", h->bucket);
+		fputc('\n', out);
+
+		if (!h->changes)
+			continue;
+
+		hm_report_dimensions(out, h);
+		hm_report_top(out, h);
+
+		if (h->dimensions != 2)
+			continue;
+
+		hm_report_text(out, h);
+		if (hm_pgm != NULL)
+			hm_write_pgm(out, h);
+	}
+	fprintf(out, "\n");
+}
+
+/**
+ * @brief Deallocates the heatmaps.
+ */
+void hm_finish(void)
+{
+	for (int i = 0; i < hm_nvars; i++)
+	{
+		free(hm_vars[i].name);
+		free(hm_vars[i].counters);
+	}
+
+	free(hm_vars);
+	hm_vars = NULL;
+	hm_nvars = 0;
+}
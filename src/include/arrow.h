@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ARROW_H
+#define ARROW_H
+
+	#include "array.h"
+	#include "dwarf_helper.h"
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/*
+	 * Arrow IPC stream output (--arrow).
+	 *
+	 * Instead of text, the change events are written as Apache
+	 * Arrow record batches (IPC streaming format, metadata V5),
+	 * built in columnar buffers while tracing and flushed every
+	 * AR_BATCH_ROWS events or AR_FLUSH_MS milliseconds. Columns:
+	 *
+	 *   seq          uint64           event sequence, from 1
+	 *   time         timestamp[ns]    CLOCK_REALTIME, UTC
+	 *   depth        int32            function depth
+	 *   line         uint32           line number
+	 *   var_id       int32            variable id
+	 *   name         dictionary<int32, utf8>, by var_id
+	 *   global       bool             global or local
+	 *   index        list<int32>      array indexes, null if none
+	 *   before_int,   after_int       int64, signed values
+	 *   before_uint,  after_uint      uint64, unsigned/pointers
+	 *   before_float, after_float     float64, floating point
+	 *
+	 * Only the value columns of the variable encoding are set, the
+	 * others are null. The dictionary (all the variables names) is
+	 * written once, right after the schema.
+	 *
+	 * The metadata are FlatBuffers, built by a small back-to-front
+	 * builder, so there are no external dependencies.
+	 */
+
+	/* Flush thresholds. */
+	#define AR_BATCH_ROWS (64 << 10)
+	#define AR_FLUSH_MS   1000
+
+	/* Maximum fields per FlatBuffers table. */
+	#define AR_FB_SLOTS 8
+
+	extern int ar_init(const char *file, struct array *vars);
+	extern void ar_printer(int depth, unsigned line_no,
+		struct dw_variable *v, union var_value *v_before,
+		union var_value *v_after, int *array_idxs);
+	extern void ar_tick(void);
+	extern void ar_finish(void);
+
+#endif /* ARROW_H */
@@ -0,0 +1,60 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+	#include "array.h"
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/*
+	 * Bitmap encoding.
+	 *
+	 * Integer variables and arrays marked as bitmaps (by name or
+	 * name pattern, see --bitmap) are reported by the bits set and
+	 * cleared, like: +{5,17,32-63} -{9}, instead of before/after
+	 * values for every element.
+	 */
+
+	/* Maximum amount of --bitmap patterns. */
+	#define BM_MAX_PATTERNS 16
+
+	/* Output buffer size, for both bits lists. */
+	#define BM_BS 544
+
+	/* Bits set/cleared count pointer, see select_cpu(). */
+	extern size_t (*bitcount)(
+		void *old, void *new, size_t length, uint64_t *counts);
+
+	extern size_t bitcount_generic(void *old, void *new, size_t length,
+		uint64_t *counts);
+
+	extern int bm_add_pattern(const char *pattern);
+	extern void bm_mark(struct array *vars);
+	extern char *bm_format(char *buffer, size_t size, const void *old,
+		const void *new, size_t len);
+	extern void bm_finish(void);
+
+#endif /* BITMAP_H */
@@ -0,0 +1,50 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CORE_H
+#define CORE_H
+
+	#include "array.h"
+	#include "dwarf_helper.h"
+
+	/*
+	 * Post-mortem mode (--core).
+	 *
+	 * Instead of tracing a live process, the watched variables
+	 * are read from a series of ELF core files (e.g: taken with
+	 * gcore) and consecutive snapshots are compared. Globals are
+	 * always available, locals only if the target function is
+	 * on the stack of some thread of the core.
+	 */
+
+	/* Maximum amount of frames walked, per thread. */
+	#define CR_MAX_FRAMES 4096
+
+	/* Stack scanned, when the frame pointers are not enough. */
+	#define CR_STACK_SCAN (64 << 10)
+
+	extern int cr_run(struct array *cores, struct array *vars,
+		struct dw_function *func, struct array *lines);
+
+#endif /* CORE_H */
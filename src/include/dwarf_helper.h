@@ -39,6 +39,7 @@
 	#include <libdwarf.h>
 
 	#include "array.h"
+	#include "dwarf_reader.h"
 
 	/* Variables. */
 	#define VLOCAL  0x1
@@ -135,6 +136,17 @@
 		Dwarf_Die cu_die;
 		Dwarf_Die fn_die;
 
+		/*
+		 * Internal DWARF reader, used instead of libdwarf
+		 * whenever it is able to read the file. If not, the
+		 * libdwarf is initialized (as a fallback) with the
+		 * same file and function.
+		 */
+		int internal;
+		struct dwr reader;
+		const char *file;
+		const char *func;
+
 		/*
 		 * dw_function structure
 		 */
@@ -196,6 +208,48 @@
 		 */
 		int initialized;
 
+		/*
+		 * Flag indicating that the variable should be reported
+		 * as a bitmap, i.e: by the bits changed.
+		 */
+		int bitmap;
+
+		/*
+		 * Flag indicating that the variable (a char array) should
+		 * be reported as a string, i.e: as a whole, once per stop.
+		 */
+		int string;
+
+		/*
+		 * Index of the variable statistics, in --summary
+		 * mode, shared by all the contexts.
+		 */
+		int stats;
+
+		/*
+		 * Index of the array heatmap, in --heatmap mode,
+		 * shared by all the contexts (-1 if none).
+		 */
+		int heat;
+
+		/*
+		 * Index of the variable in the Arrow names dictionary,
+		 * in --arrow mode, shared by all the contexts.
+		 */
+		int arrow;
+
+		/*
+		 * Index of the enum transition matrix, in --transitions
+		 * mode, shared by all the contexts (-1 if none).
+		 */
+		int trans;
+
+		/*
+		 * Flag indicating that the variable (a large array) is
+		 * compared in a snapshot of the child, in background.
+		 */
+		int offload;
+
 		/*
 		 * If the variable is global or static,
 		 * the address should be used, if local,
@@ -230,6 +284,27 @@
 		} type;
 	};
 
+	/**
+	 * Enumerator (DW_TAG_enumerator) of an enumeration type.
+	 */
+	struct dw_enumerator
+	{
+		char *name;
+		uint64_t value; /* Sign-extended, if negative. */
+	};
+
+	/**
+	 * Structure member, as seen through a pointer variable.
+	 */
+	struct dw_member
+	{
+		char *name;
+		size_t offset;
+		size_t byte_size;
+		int var_type;
+		int encoding;
+	};
+
 	extern int *dw_init(const char *file, struct dw_utils *dw);
 
 	extern void dw_finish(struct dw_utils *dw);
@@ -250,4 +325,14 @@
 
 	extern void dw_lines_array_free(struct array *lines);
 
+	extern struct dw_variable *dw_get_struct_pointer(struct dw_utils *dw,
+		const char *name, struct array **members, size_t *struct_size);
+
+	extern void dw_members_free(struct array *members);
+
+	extern struct array *dw_get_enumerators(struct dw_utils *dw,
+		const char *name);
+
+	extern void dw_enumerators_free(struct array *enums);
+
 #endif /* DWARF_UTILS_H */
@@ -0,0 +1,122 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DWARF_READER_H
+#define DWARF_READER_H
+
+	#include "array.h"
+	#include "elf_helper.h"
+
+	struct dw_function;
+	struct dw_variable;
+
+	/**
+	 * @brief Compile Unit, as read from the .debug_info header.
+	 */
+	struct dwr_cu
+	{
+		uint64_t offset;        /* Unit header offset.       */
+		uint64_t die_offset;    /* First DIE offset.         */
+		uint64_t end;           /* Offset past the unit.     */
+		uint64_t abbrev_offset; /* Abbreviation table.       */
+		uint16_t version;       /* DWARF version (2, 3, 4).  */
+		uint8_t addr_size;      /* Target address size.      */
+		uint8_t offset_size;    /* 4 (32-bit) or 8 (64-bit). */
+	};
+
+	/**
+	 * @brief Debugging Information Entry.
+	 *
+	 * Nothing here is allocated: the DIE only points to its
+	 * abbreviation and attributes inside the mapped file.
+	 */
+	struct dwr_die
+	{
+		uint64_t offset;        /* DIE offset.                  */
+		uint64_t tag;           /* DW_TAG_*.                    */
+		int has_children;       /* DW_CHILDREN_yes?             */
+		const uint8_t *spec;    /* Abbreviation attribute spec. */
+		const uint8_t *attrs;   /* Attribute values.            */
+		uint64_t after_attrs;   /* Offset right after the DIE.  */
+		uint64_t sibling;       /* DW_AT_sibling, if any, or 0. */
+	};
+
+	/**
+	 * @brief Attribute value, form-agnostic.
+	 */
+	struct dwr_attr
+	{
+		uint64_t form;
+		const uint8_t *ptr;
+	};
+
+	/**
+	 * @brief Internal DWARF reader context.
+	 */
+	struct dwr
+	{
+		struct elf_file elf;
+
+		/* Debug sections. */
+		struct elf_section info;
+		struct elf_section abbrev;
+		struct elf_section line;
+		struct elf_section str;
+		struct elf_section loc;
+
+		/* Abbreviation table cache (code -> attribute spec). */
+		const uint8_t **abbrevs;
+		size_t abbrevs_size;
+		uint64_t abbrevs_offset;
+		int abbrevs_valid;
+
+		/* Target Compile Unit and function. */
+		struct dwr_cu cu;
+		uint64_t cu_die;
+		uint64_t fn_die;
+	};
+
+	extern int dwr_init(struct dwr *r, const char *file);
+	extern void dwr_finish(struct dwr *r);
+
+	extern int dwr_get_address_by_function(struct dwr *r, const char *func,
+		struct dw_function *dw_func);
+
+	extern int dwr_is_c_language(struct dwr *r);
+
+	extern struct array *dwr_get_all_variables(struct dwr *r,
+		struct dw_function *dw_func);
+
+	extern struct array *dwr_get_all_lines(struct dwr *r,
+		struct dw_function *dw_func);
+
+	extern char *dwr_get_source_file(struct dwr *r);
+
+	extern struct dw_variable *dwr_get_struct_pointer(struct dwr *r,
+		struct dw_function *dw_func, const char *name,
+		struct array **members, size_t *struct_size);
+
+	extern struct array *dwr_get_enumerators(struct dwr *r, const char *name);
+
+#endif /* DWARF_READER_H */
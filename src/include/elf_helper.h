@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ELF_HELPER_H
+#define ELF_HELPER_H
+
+	#include <elf.h>
+	#include <inttypes.h>
+	#include <stdlib.h>
+	#include <sys/types.h>
+
+	/**
+	 * @brief Memory-mapped ELF file.
+	 *
+	 * The whole file is mapped read-only and every structure
+	 * returned by the routines below points directly into the
+	 * mapping, so nothing needs to be freed except the file
+	 * itself, with elf_close().
+	 */
+	struct elf_file
+	{
+		int fd;
+		uint8_t *map;
+		size_t size;
+		int elf_class;  /* ELFCLASS32 or ELFCLASS64.  */
+		uint16_t type;  /* ET_EXEC, ET_DYN, ET_CORE.  */
+		uint64_t entry; /* Entry point.               */
+
+		/* Program headers. */
+		const uint8_t *phdrs;
+		size_t phnum;
+		size_t phentsize;
+
+		/* Section headers. */
+		const uint8_t *shdrs;
+		size_t shnum;
+		size_t shentsize;
+		const char *shstrtab;
+		size_t shstrtab_size;
+	};
+
+	/**
+	 * @brief ELF section, as seen by PBD.
+	 */
+	struct elf_section
+	{
+		const uint8_t *data;
+		size_t size;
+		uint64_t addr;
+		uint32_t type;
+		uint32_t link;
+		uint64_t entsize;
+	};
+
+	/**
+	 * @brief ELF symbol, already converted to 64-bit.
+	 */
+	struct elf_symbol
+	{
+		const char *name;
+		uint64_t value;
+		uint64_t size;
+		int type;
+	};
+
+	/**
+	 * @brief ELF segment (program header), already converted
+	 * to 64-bit.
+	 */
+	struct elf_segment
+	{
+		uint32_t type;
+		uint64_t offset;
+		uint64_t vaddr;
+		uint64_t filesz;
+		uint64_t memsz;
+	};
+
+	extern int elf_open(struct elf_file *ef, const char *file);
+	extern void elf_close(struct elf_file *ef);
+
+	extern int elf_get_section(struct elf_file *ef, const char *name,
+		struct elf_section *sec);
+
+	extern int elf_get_section_by_index(struct elf_file *ef, size_t idx,
+		struct elf_section *sec);
+
+	extern int elf_symbols_iter(struct elf_file *ef, uint32_t sh_type,
+		int (*cb)(const struct elf_symbol *sym, void *data), void *data);
+
+	extern int elf_lookup_symbol(struct elf_file *ef, uint32_t sh_type,
+		const char *name, struct elf_symbol *sym);
+
+	extern int elf_offset_to_vaddr(struct elf_file *ef, uint64_t off,
+		uint64_t *vaddr);
+
+	extern int elf_get_segment(struct elf_file *ef, size_t idx,
+		struct elf_segment *seg);
+
+	extern int elf_read_vaddr(struct elf_file *ef, uint64_t vaddr,
+		void *buf, size_t len);
+
+	extern int elf_notes_iter(struct elf_file *ef, uint32_t type,
+		int (*cb)(const uint8_t *desc, size_t size, void *data), void *data);
+
+#endif /* ELF_HELPER_H */
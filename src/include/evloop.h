@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+	#include <stdint.h>
+	#include <sys/types.h>
+	#include <sys/epoll.h>
+
+	/*
+	 * Event loop.
+	 *
+	 * A small epoll-based loop: file descriptors (output, timers,
+	 * tracees...) are registered together with a callback, that
+	 * is invoked whenever the descriptor is ready.
+	 */
+
+	/* Maximum amount of event sources. */
+	#define EV_MAX_SOURCES 16
+
+	/* Event callback. */
+	typedef void (*ev_callback)(int fd, uint32_t events, void *data);
+
+	extern int ev_init(void);
+	extern int ev_add(int fd, uint32_t events, ev_callback cb, void *data);
+	extern int ev_mod(int fd, uint32_t events);
+	extern int ev_del(int fd);
+	extern int ev_timer(int period_ms, ev_callback cb, void *data);
+	extern void ev_timer_ack(int fd);
+	extern int ev_tracee_open(pid_t pid);
+	extern void ev_tracee_ack(int fd);
+	extern int ev_tracee_wait(pid_t pid, int *exited);
+	extern int ev_run(void);
+	extern void ev_stop(void);
+	extern void ev_finish(void);
+
+#endif /* EVLOOP_H */
@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+	#include "hashtable.h"
+	#include <sys/types.h>
+
+	/*
+	 * Heap watch.
+	 *
+	 * malloc/calloc/realloc/free of the tracee libc (resolved
+	 * through its dynamic symbol table) are intercepted with
+	 * breakpoints, and the blocks allocated while inside the
+	 * analyzed function, or directly from the chosen functions
+	 * (--heap-site), are kept in an interval tree and diffed
+	 * at every stop, until freed.
+	 */
+
+	/* Maximum amount of --heap-site functions. */
+	#define HP_MAX_SITES 16
+
+	/* Maximum amount of allocator calls in progress. */
+	#define HP_MAX_CALLS 64
+
+	/*
+	 * Blocks are read in batches at each stop: at most HP_BATCH_MAX
+	 * blocks, in HP_IOV_MAX areas (blocks up to HP_MERGE_GAP bytes
+	 * apart share the same area), into a HP_SCRATCH_MIN buffer.
+	 */
+	#define HP_BATCH_MAX   16384
+	#define HP_IOV_MAX     1024
+	#define HP_MERGE_GAP   256
+	#define HP_SCRATCH_MIN (1 << 20)
+
+	/* hp_trap() return values. */
+	#define HP_NONE  0  /* Not an heap breakpoint.            */
+	#define HP_OWNED 1  /* Heap only, should be just skipped. */
+
+	extern int hp_set_format(const char *spec);
+	extern int hp_add_site(const char *function);
+	extern int hp_init(pid_t child, const char *file,
+		struct hashtable *breakpoints);
+	extern int hp_trap(pid_t tid, uintptr_t pc, int depth);
+	extern int hp_check_changes(pid_t child, unsigned line_no, int depth);
+	extern void hp_finish(void);
+
+#endif /* HEAP_H */
@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+	#include "array.h"
+	#include "dwarf_helper.h"
+	#include <stdio.h>
+
+	/*
+	 * Per-index change heatmaps (--heatmap).
+	 *
+	 * Every watched array keeps a change counter per element or,
+	 * for huge arrays, per bucket of contiguous elements. At exit,
+	 * the counters are summarized per dimension, the hottest
+	 * indexes are listed and 2-D arrays are rendered as text and,
+	 * optionally, as PGM images.
+	 */
+
+	/* Maximum amount of counters per array, buckets beyond that. */
+	#define HM_MAX_COUNTERS (1 << 20)
+
+	/* Default amount of hottest indexes listed. */
+	#define HM_TOP_DEFAULT 10
+
+	/* Bins per dimension, in the dimensions summary. */
+	#define HM_BINS 16
+
+	/* Text rendering size, for 2-D arrays. */
+	#define HM_TEXT_ROWS 24
+	#define HM_TEXT_COLS 64
+
+	extern int hm_init(struct array *vars, int top, const char *pgm_prefix);
+	extern void hm_update(struct dw_variable *v, size_t index);
+	extern void hm_update_range(struct dw_variable *v, char *before,
+		char *after, size_t first, size_t size);
+	extern void hm_report(FILE *out);
+	extern void hm_finish(void);
+
+#endif /* HEATMAP_H */
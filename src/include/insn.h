@@ -0,0 +1,66 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef INSN_H
+#define INSN_H
+
+	#include <inttypes.h>
+	#include <stddef.h>
+
+	/* Decoding modes. */
+	#define INSN_MODE32 0
+	#define INSN_MODE64 1
+
+	/* Instruction flags. */
+	#define INSN_BRANCH    0x01 /* Any control transfer (jmp/jcc/call/ret). */
+	#define INSN_COND      0x02 /* Conditional branch (jcc, loop, jrcxz).   */
+	#define INSN_CALL      0x04 /* Call instruction.                        */
+	#define INSN_RET       0x08 /* Return instruction.                      */
+	#define INSN_INDIRECT  0x10 /* Indirect (register/memory) target.       */
+	#define INSN_RELATIVE  0x20 /* Relative target, see 'target'.           */
+	#define INSN_RIPREL    0x40 /* RIP-relative memory operand.             */
+
+	/* Max x86 instruction size. */
+	#define INSN_MAX_LEN 15
+
+	/**
+	 * @brief Decoded instruction.
+	 *
+	 * This is not a disassembler: only the length and the
+	 * properties that matter to relocate or to follow the
+	 * control flow of an instruction are decoded.
+	 */
+	struct insn
+	{
+		uintptr_t addr;     /* Instruction address.               */
+		uint8_t length;     /* Instruction length, in bytes.      */
+		uint8_t disp_off;   /* RIP-relative displacement offset.  */
+		int flags;          /* INSN_* flags.                      */
+		uintptr_t target;   /* Branch target, if INSN_RELATIVE.   */
+	};
+
+	extern int insn_decode(const uint8_t *code, size_t size, uintptr_t addr,
+		int mode, struct insn *insn);
+
+#endif /* INSN_H */
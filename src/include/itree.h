@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ITREE_H
+#define ITREE_H
+
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/**
+	 * @brief Interval tree node, for the half-open interval
+	 * [start, end).
+	 */
+	struct itree_node
+	{
+		uintptr_t start;           /* Interval start.              */
+		uintptr_t end;             /* Interval end (exclusive).    */
+		uintptr_t max;             /* Max end within this subtree. */
+		int height;                /* Subtree height.              */
+		void *value;               /* Entry value.                 */
+		struct itree_node *left;   /* Left subtree.                */
+		struct itree_node *right;  /* Right subtree.               */
+	};
+
+	/**
+	 * @brief Interval tree structure.
+	 *
+	 * AVL tree keyed by the interval start and augmented with
+	 * the max end of each subtree, so that overlap queries are
+	 * O(log n), even with lots of entries.
+	 */
+	struct itree
+	{
+		struct itree_node *root;  /* Root node.        */
+		size_t elements;          /* Current elements. */
+	};
+
+	/* ==================== External functions ==================== */
+	extern int itree_init(struct itree **t);
+	extern int itree_insert(struct itree **t, uintptr_t start, uintptr_t end,
+		void *value);
+	extern void *itree_remove(struct itree **t, uintptr_t start);
+	extern void *itree_get(struct itree **t, uintptr_t start);
+	extern void *itree_overlap(struct itree **t, uintptr_t start,
+		uintptr_t end, uintptr_t *ostart);
+	extern int itree_foreach(struct itree **t,
+		int (*cb)(uintptr_t start, uintptr_t end, void *value, void *data),
+		void *data);
+	extern size_t itree_size(struct itree **t);
+	extern void itree_finish(struct itree **t, void (*dealloc)(void *value));
+
+#endif /* ITREE_H */
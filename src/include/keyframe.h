@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef KEYFRAME_H
+#define KEYFRAME_H
+
+	#include "array.h"
+	#include <stddef.h>
+	#include <stdint.h>
+
+	/*
+	 * Keyframes (--keyframe-every/--keyframe-bytes).
+	 *
+	 * The change events only carry deltas, so the full state at
+	 * a given event would require replaying the whole output. A
+	 * keyframe is the full state of the watched variables, written
+	 * in the output every N change events and/or every M bytes of
+	 * output, as in:
+	 *
+	 *   [Keyframe: 3] event: 3000, depth: 1
+	 *   [Keyframe] [global] (gi8) = 127
+	 *   [Keyframe] [global] (arr[2][0..63]) = 0
+	 *   [Keyframe] [depth: 1] [local] (i) = 10
+	 *
+	 * Runs of equal elements, along the last dimension of arrays,
+	 * share a single line. If the output is a file (-o), an index
+	 * (<file>.kfi: keyframe, event and file offset, per line) is
+	 * also written, so that --reconstruct seeks straight to the
+	 * nearest keyframe and only applies the events that follow.
+	 */
+
+	/* Index file extension. */
+	#define KF_INDEX_EXT ".kfi"
+
+	extern int kf_init(int every, size_t bytes, const char *output_file);
+	extern void kf_event(void);
+	extern void kf_check(struct array *context, int depth);
+	extern void kf_finish(void);
+	extern void kf_reconstruct(const char *arg);
+
+#endif /* KEYFRAME_H */
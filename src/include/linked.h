@@ -0,0 +1,66 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LINKED_H
+#define LINKED_H
+
+	#include "dwarf_helper.h"
+	#include <sys/types.h>
+
+	/*
+	 * Linked data structures watch (--watch-linked).
+	 *
+	 * A spec like 'head->next*{val,key}:max=10000' follows the
+	 * pointer 'head' and then each node 'next' member, using the
+	 * structure member offsets from the debug info. The watched
+	 * members (all of them, if none given) of each node are then
+	 * compared against the previous traversal and the nodes are
+	 * reported as inserted, removed or modified.
+	 *
+	 * The nodes already known are read again in bulk and, if the
+	 * kernel keeps the soft-dirty bits, only the ones whose pages
+	 * were written since the last stop.
+	 */
+
+	/* Maximum amount of watched structures. */
+	#define LK_MAX 16
+
+	/* Maximum amount of members watched per node. */
+	#define LK_MAX_FIELDS 16
+
+	/* Default maximum amount of nodes followed per traversal. */
+	#define LK_DEFAULT_MAX 10000
+
+	/* Nodes read per bulk read. */
+	#define LK_IOV_MAX 1024
+
+	/* Maximum span, in pages, of the nodes pagemap read at once. */
+	#define LK_PAGEMAP_MAX (1 << 16)
+
+	extern int lk_add(const char *spec);
+	extern int lk_resolve(struct dw_utils *dw);
+	extern int lk_check_changes(pid_t child, unsigned line_no, int depth);
+	extern void lk_finish(void);
+
+#endif /* LINKED_H */
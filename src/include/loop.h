@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LOOP_H
+#define LOOP_H
+
+	#include "array.h"
+	#include "breakpoint.h"
+	#include "dwarf_helper.h"
+
+	/*
+	 * Loop-structured summaries (--loop-summary).
+	 *
+	 * The loops of the analyzed function are found statically,
+	 * by its back-edges: relative branches whose target lies
+	 * before the branch itself. While a loop executes, the
+	 * changes are only accounted, and when the loop exits, a
+	 * single record is emitted with the amount of iterations
+	 * and the net effect of the loop on each variable changed.
+	 * Optionally (--loop-detail), the changes of the first and
+	 * last iterations are also shown.
+	 */
+
+	/* Maximum amount of array elements listed per record. */
+	#define LP_MAX_ELEMENTS 8
+
+	extern int lp_init(const char *file, struct dw_function *func,
+		struct array *lines, int detail);
+	extern void lp_step(struct array *vars, struct breakpoint *bp, int depth);
+	extern int lp_change(struct dw_variable *v, int depth, unsigned line_no,
+		union var_value *v_before, union var_value *v_after, int *array_idxs);
+	extern void lp_end(int depth);
+	extern void lp_dump(void);
+	extern void lp_finish(void);
+
+#endif /* LOOP_H */
@@ -0,0 +1,58 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LZ_H
+#define LZ_H
+
+	#include <stddef.h>
+	#include <stdint.h>
+	#include <stdio.h>
+
+	/*
+	 * Fast LZ codec, used to compress the rotated output files
+	 * when zlib is not available.
+	 *
+	 * Blocks are compressed with a greedy LZ77 (LZ4-like sequences:
+	 * token, literals, 16-bit offset, match length) and written as:
+	 *   magic (LZ_MAGIC), and then, per block:
+	 *   raw size (u32 LE), stored size (u32 LE), data
+	 * If both sizes are equal, the block is stored uncompressed.
+	 */
+
+	#define LZ_MAGIC     "PBDLZ1\n"
+	#define LZ_MAGIC_LEN 7
+
+	/* Block size. */
+	#define LZ_BLOCK (256 << 10)
+
+	/* Compressed size upper bound. */
+	#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+	extern size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst);
+	extern int lz_decompress(const uint8_t *src, size_t len, uint8_t *dst,
+		size_t cap);
+	extern int lz_compress_file(FILE *in, FILE *out);
+	extern int lz_decompress_file(FILE *in, FILE *out);
+
+#endif /* LZ_H */
@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+	#include <stdio.h>
+	#include <stddef.h>
+
+	/*
+	 * Non-blocking output.
+	 *
+	 * The PBD output stream is replaced by a stream that writes
+	 * into a memory buffer, which is written to the real output
+	 * file descriptor whenever possible (in non-blocking mode,
+	 * through a private open file description, not shared with
+	 * the child).
+	 * If the output cannot keep up (a slow pipe or terminal),
+	 * the buffer grows up to OUT_HIGH_WATERMARK bytes, and then
+	 * the event loop should stop handling the tracee (i.e: keep
+	 * it stopped) until the buffer drops below OUT_LOW_WATERMARK.
+	 */
+
+	/* Output buffer limits. */
+	#define OUT_HIGH_WATERMARK (8 << 20)
+	#define OUT_LOW_WATERMARK  (1 << 20)
+
+	/* Amount of bytes that triggers a write. */
+	#define OUT_WRITE_THRESHOLD (64 << 10)
+
+	/* Output statistics. */
+	struct out_stats
+	{
+		size_t written;   /* Bytes written.           */
+		size_t pending;   /* Bytes buffered.          */
+		size_t stalls;    /* Writes that would block. */
+	};
+
+	extern int out_init(FILE **stream);
+	extern int out_fd(void);
+	extern int out_pollable(void);
+	extern size_t out_pending(void);
+	extern int out_flush(int block);
+	extern size_t out_offset(void);
+	extern void out_get_stats(struct out_stats *st);
+	extern int out_rotate(const char *path, size_t max_size, int keep);
+	extern void out_finish(FILE **stream);
+
+#endif /* OUTPUT_H */
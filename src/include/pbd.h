@@ -26,6 +26,7 @@
 #define PBD_H
 
 	#include <stdio.h>
+	#include <sys/types.h>
 
 	/* Current version. */
 	#define MAJOR_VERSION 0
@@ -43,9 +44,42 @@
 	#define FLG_SYNTAX_HIGHLIGHT 0x80
 	#define FLG_STATIC_ANALYSIS  0x100
 	#define FLG_SANALYSIS_SETSTD 0x200
+	#define FLG_FAST_TRACEPOINTS 0x400
+	#define FLG_VERIFY           0x800
+	#define FLG_VERIFY_RANDOM    0x1000
+	#define FLG_PLUGIN           0x2000
+	#define FLG_STATS            0x4000
+	#define FLG_WATCH_REGION     0x8000
+	#define FLG_WATCH_HEAP       0x10000
+	#define FLG_BITMAP           0x20000
+	#define FLG_SUMMARY          0x40000
+	#define FLG_CORE             0x80000
+	#define FLG_POLL             0x100000
+	#define FLG_POLL_DOUBLE      0x200000
+	#define FLG_FORK_SNAPSHOT    0x400000
+	#define FLG_LIBDWARF         0x800000
+	#define FLG_LOOP_SUMMARY     0x1000000
+	#define FLG_LOOP_DETAIL      0x2000000
+	#define FLG_WATCH_LINKED     0x4000000
+	#define FLG_HEATMAP          0x8000000
+	#define FLG_KEYFRAMES        0x10000000
+	#define FLG_ARROW            0x20000000
+	#define FLG_TRANSITIONS      0x40000000
+	#define FLG_STRINGS          0x80000000
+
+	/*
+	 * Thread local storage.
+	 *
+	 * When tracing multi-threaded executables (--threads), each
+	 * tracer thread has its own output stream and scratch buffers.
+	 *
+	 * Note that pbd_output starts as NULL in every new thread, so
+	 * each thread must set its own stream explicitly.
+	 */
+	#define PBD_TLS __thread
 
 	/* PBD default output file. */
-	extern FILE *pbd_output;
+	extern PBD_TLS FILE *pbd_output;
 
 	/* Experimental features.
 	 *
@@ -57,7 +91,7 @@
 	/* Program arguments. */
 	struct args
 	{
-		uint16_t flags;
+		uint32_t flags;
 		int context;
 		struct iw_list
 		{
@@ -69,6 +103,23 @@
 		char *theme_file;
 		char *output_file;
 		char **argv;
+		int threads;
+		int verify_rate;
+		char *self_profile;
+		struct array *cores;
+		int poll_interval;
+		pid_t poll_pid;
+		int snapshot_min;
+		size_t output_max_size;
+		int output_keep;
+		int heatmap_top;
+		char *heatmap_pgm;
+		int keyframe_every;
+		size_t keyframe_bytes;
+		char *arrow_file;
+		char *transitions_dot;
+		int strings_max;
+		int strings_edit;
 	};
 
 	extern struct args args;
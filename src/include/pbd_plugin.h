@@ -0,0 +1,202 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PBD_PLUGIN_H
+#define PBD_PLUGIN_H
+
+	/*
+	 * PBD plugin ABI.
+	 *
+	 * A plugin is a shared object, loaded with --plugin, that
+	 * exports the function:
+	 *
+	 *   const struct pbd_plugin *pbd_plugin_init(int abi);
+	 *
+	 * which receives the ABI version supported by PBD and returns
+	 * its callbacks (or NULL, if the version is not supported).
+	 * Every callback is optional.
+	 *
+	 * Changes are delivered raw, before any formatting, so a
+	 * plugin may filter (suppress) or aggregate them at native
+	 * speed. When tracing with --threads, the callbacks may be
+	 * invoked concurrently by different tracer threads.
+	 *
+	 * This header is self-contained, and only grows: new fields
+	 * are always appended and a new ABI version is released
+	 * whenever an existing one changes.
+	 */
+
+	#include <stddef.h>
+	#include <stdint.h>
+	#include <sys/types.h>
+
+	/* Current ABI version. */
+	#define PBD_PLUGIN_ABI 1
+
+	/* Change callback return values. */
+	#define PBD_PLUGIN_EMIT     0
+	#define PBD_PLUGIN_SUPPRESS 1
+
+	/* Variable scope. */
+	#define PBD_VAR_LOCAL  0x1
+	#define PBD_VAR_GLOBAL 0x2
+
+	/* Variable types. */
+	#define PBD_TYPE_BASE    0x1
+	#define PBD_TYPE_ARRAY   0x2
+	#define PBD_TYPE_ENUM    0x10
+	#define PBD_TYPE_POINTER 0x20
+
+	/* Variable encodings. */
+	#define PBD_ENC_UNKNOWN  0x1
+	#define PBD_ENC_SIGNED   0x2
+	#define PBD_ENC_UNSIGNED 0x4
+	#define PBD_ENC_FLOAT    0x10
+	#define PBD_ENC_POINTER  0x20
+
+	/**
+	 * @brief Raw variable value, as read from the tracee.
+	 *
+	 * For arrays, @p p points to the whole array contents.
+	 */
+	union pbd_value
+	{
+		uint8_t u8[16];
+		uint64_t u64[2];
+		long double ld;
+		double d;
+		float f;
+		char *p;
+	};
+
+	/**
+	 * @brief Variable metadata.
+	 */
+	struct pbd_var
+	{
+		const char *name;          /* Variable name.              */
+		int scope;                 /* PBD_VAR_LOCAL/GLOBAL.       */
+		int type;                  /* PBD_TYPE_*.                 */
+		int encoding;              /* PBD_ENC_*, base types.      */
+		size_t byte_size;          /* Size, in bytes.             */
+
+		/*
+		 * Global variables: absolute address. Local variables:
+		 * offset relative to the frame pointer.
+		 */
+		intptr_t location;
+
+		/* Arrays only. */
+		int elem_type;             /* Element type.               */
+		int elem_encoding;         /* Element encoding.           */
+		size_t elem_size;          /* Element size.               */
+		int dimensions;            /* Amount of dimensions.       */
+		const int *elems_per_dim;  /* Elements per dimension.     */
+	};
+
+	/**
+	 * @brief Variable change.
+	 */
+	struct pbd_change
+	{
+		pid_t tid;                     /* Thread.                       */
+		int depth;                     /* Function depth.               */
+		unsigned line_no;              /* Line that changed it.         */
+		const struct pbd_var *var;     /* Variable.                     */
+		const union pbd_value *before; /* Previous value.               */
+		const union pbd_value *after;  /* Current value.                */
+
+		/*
+		 * Arrays only: the indexes (one per dimension) of the
+		 * changed element, NULL otherwise. @p before and @p after
+		 * then hold only the element value.
+		 */
+		const int *idxs;
+	};
+
+	/**
+	 * @brief Session information.
+	 */
+	struct pbd_session
+	{
+		pid_t pid;                     /* Traced process.               */
+		const char *executable;        /* Executable file.              */
+		const char *function;          /* Function being analyzed.      */
+		const char *source;            /* Source file, if known.        */
+		int nvars;                     /* Amount of variables watched.  */
+	};
+
+	/**
+	 * @brief Services provided by PBD to the plugins.
+	 */
+	struct pbd_host
+	{
+		int abi;
+
+		/*
+		 * Reads @p len bytes at @p addr of the tracee memory.
+		 * Returns 0 if success and a negative number otherwise.
+		 */
+		int (*read_memory)(pid_t tid, uintptr_t addr, void *buf, size_t len);
+
+		/* Frame pointer of the stopped thread @p tid. */
+		uintptr_t (*frame_pointer)(pid_t tid);
+
+		/* Writes into the PBD output, printf-like. */
+		int (*emit)(const char *fmt, ...);
+	};
+
+	/**
+	 * @brief Plugin callbacks.
+	 */
+	struct pbd_plugin
+	{
+		int abi;                       /* PBD_PLUGIN_ABI.               */
+		const char *name;              /* Plugin name.                  */
+
+		/*
+		 * Session start, the tracee is already loaded and stopped.
+		 * @p data may be set to an opaque pointer, passed to the
+		 * other callbacks. A non-zero return unloads the plugin.
+		 */
+		int (*session_start)(const struct pbd_host *host,
+			const struct pbd_session *session, void **data);
+
+		/*
+		 * Line stop: called right before checking the changes
+		 * made by the line @p line_no.
+		 */
+		void (*stop)(void *data, pid_t tid, unsigned line_no, int depth);
+
+		/* Variable change: PBD_PLUGIN_EMIT or PBD_PLUGIN_SUPPRESS. */
+		int (*change)(void *data, const struct pbd_change *change);
+
+		/* Session end. */
+		void (*session_end)(void *data);
+	};
+
+	/* Plugin entry point. */
+	typedef const struct pbd_plugin *(*pbd_plugin_init_fn)(int abi);
+
+#endif /* PBD_PLUGIN_H */
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef POLLER_H
+#define POLLER_H
+
+	#include "array.h"
+	#include <sys/types.h>
+
+	/*
+	 * Stop-free polling (--poll).
+	 *
+	 * The target is never stopped (nor traced, whenever the
+	 * permissions allow): the watched globals are read at each
+	 * interval with process_vm_readv(), while the target keeps
+	 * running, and the changes are reported with timestamps
+	 * instead of line numbers.
+	 *
+	 * Since the reads race with the target, a variable may be
+	 * read in the middle of an update (torn read); the optional
+	 * double-read check reads everything twice and re-reads the
+	 * variables that differ, until two reads agree.
+	 */
+
+	/* Re-reads, per poll, until two reads agree. */
+	#define PL_MAX_RETRIES 4
+
+	/* Maximum areas per process_vm_readv() call. */
+	#define PL_IOV_MAX 1024
+
+	extern pid_t pl_spawnprocess(const char *file, char **argv);
+	extern int pl_run(pid_t pid, int spawned, int interval_ms,
+		int double_read, struct array *vars);
+
+#endif /* POLLER_H */
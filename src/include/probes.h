@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+	/*
+	 * Static tracepoints (USDT).
+	 *
+	 * When <sys/sdt.h> is available (systemtap-sdt-dev), the PBD
+	 * hot paths are annotated with static probes, under the
+	 * 'pbd' provider, that can be listed and traced with perf or
+	 * bpftrace, e.g:
+	 *
+	 *   $ bpftrace -l 'usdt:./pbd:pbd:*'
+	 *   $ bpftrace -e 'usdt:./pbd:pbd:var_read_start { @s[tid] = nsecs; }
+	 *       usdt:./pbd:pbd:var_read_end /@s[tid]/ {
+	 *           @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+	 *
+	 * A probe not enabled is a single 'nop' instruction, but its
+	 * arguments are still computed, so they should be kept cheap
+	 * (no calls). Without <sys/sdt.h>, the macros below expand
+	 * to nothing.
+	 *
+	 * Probes available:
+	 *   stop           (pid, pc)
+	 *   bp_lookup      (pid, pc, line, -1 if not found)
+	 *   var_read_start (pid, name, bytes)
+	 *   var_read_end   (pid, name, bytes, -1 if error)
+	 *   var_change     (line, name, bytes)
+	 *   func_entry     (pid, depth)
+	 *   func_return    (pid, depth)
+	 *   context_push   (depth)
+	 *   context_pop    (depth)
+	 *   output_merge   (records, bytes), --threads only
+	 *   output_flush   (bytes written, bytes pending)
+	 */
+
+#ifdef HAVE_SDT
+	#include <sys/sdt.h>
+
+	#define PBD_PROBE1(name, a) \
+		DTRACE_PROBE1(pbd, name, a)
+	#define PBD_PROBE2(name, a, b) \
+		DTRACE_PROBE2(pbd, name, a, b)
+	#define PBD_PROBE3(name, a, b, c) \
+		DTRACE_PROBE3(pbd, name, a, b, c)
+#else
+	#define PBD_PROBE1(name, a) \
+		do { ((void)(a)); } while (0)
+	#define PBD_PROBE2(name, a, b) \
+		do { ((void)(a)); ((void)(b)); } while (0)
+	#define PBD_PROBE3(name, a, b, c) \
+		do { ((void)(a)); ((void)(b)); ((void)(c)); } while (0)
+#endif
+
+#endif /* PROBES_H */
@@ -0,0 +1,48 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+	/*
+	 * Self-profiler.
+	 *
+	 * Samples the PBD own stacks with ITIMER_PROF, by walking
+	 * the frame pointers of the interrupted thread, and writes
+	 * them, symbolized, in the 'collapsed stacks' format, i.e:
+	 * 'main;handle_trap;var_check_changes 42', ready to be used
+	 * by flamegraph tools.
+	 */
+
+	/* Sampling frequency (Hz). */
+	#define PROF_FREQ 997
+
+	/* Maximum amount of frames per sample. */
+	#define PROF_MAX_DEPTH 64
+
+	extern int prof_start(const char *file);
+	extern void prof_thread_init(void);
+	extern void prof_stop(void);
+
+#endif /* PROFILER_H */
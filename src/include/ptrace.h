@@ -41,22 +41,36 @@
 	#include <string.h>
 	#include <stdlib.h>
 
+	struct iovec;
+
 	/* Child Exit Signal. */
 	#define PT_CHILD_EXIT 1
 
 	extern int pt_spawnprocess(const char *file, char **argv);
 	extern int pt_waitchild(void);
+	extern int pt_waittracee(pid_t tid);
 	extern int pt_continue(pid_t child);
 	extern int pt_continue_single_step(pid_t child);
+	extern int pt_step_insn(pid_t tid);
+	extern pid_t pt_fork(pid_t child);
 	extern uintptr_t pt_readregister_pc(pid_t child);
 	extern void pt_setregister_pc(pid_t child, uintptr_t pc);
 	extern uintptr_t pt_readregister_bp(pid_t child);
 	extern uintptr_t pt_readreturn_address(pid_t child);
+	extern uintptr_t pt_readregister_sp(pid_t child);
+	extern uintptr_t pt_readcall_arg(pid_t child, int idx);
+	extern uintptr_t pt_readreturn_value(pid_t child);
 	extern char *pt_readmemory(pid_t child, uintptr_t addr, size_t len);
+	extern int pt_readmemory_buf(pid_t child, uintptr_t addr, void *buf,
+		size_t len);
+	extern ssize_t pt_readmemory_iov(pid_t child, const struct iovec *remote,
+		int n, void *buf);
 	extern void pt_writememory(pid_t child, uintptr_t addr, char *data, size_t len);
 	extern long pt_readmemory_long(pid_t child, uintptr_t addr);
 	extern void pt_writememory_long(pid_t child, uintptr_t addr, long data);
 	extern uint64_t pt_readmemory64(pid_t child, uintptr_t addr);
 	extern void pt_writememory64(pid_t child, uintptr_t addr, uint64_t data);
+	extern long pt_syscall(pid_t child, long number, long arg1, long arg2,
+		long arg3, long arg4, long arg5, long arg6);
 
 #endif /* PTRACE_H */
@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef REGION_H
+#define REGION_H
+
+	#include <stddef.h>
+	#include <stdint.h>
+	#include <sys/types.h>
+
+	/*
+	 * Raw memory watch.
+	 *
+	 * Address ranges (--watch-region) and named mappings from
+	 * /proc/<pid>/maps (--watch-mapping) that have no debug info
+	 * attached, but are diffed at every stop just like arrays,
+	 * and whose changes are reported as offsets.
+	 */
+
+	/* Maximum amount of watched regions. */
+	#define RG_MAX 32
+
+	/*
+	 * Minimum region size (in pages) to use the soft-dirty
+	 * bits to filter the pages read at each stop.
+	 */
+	#define RG_SOFTDIRTY_MIN_PAGES 16
+
+	extern int rg_parse_elem(const char *spec, size_t *elem_size,
+		int *encoding);
+	extern int rg_diff(const char *kind, const char *name, uintptr_t offset,
+		char *old, char *new, size_t size, size_t elem_size, int encoding,
+		unsigned line_no, int depth);
+	extern int rg_add_range(const char *spec);
+	extern int rg_add_mapping(const char *name);
+	extern void rg_resolve(pid_t child);
+	extern int rg_check_changes(pid_t child, unsigned line_no, int depth);
+	extern void rg_finish(void);
+	extern int rg_softdirty_supported(void);
+
+#endif /* REGION_H */
@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ROTATE_H
+#define ROTATE_H
+
+	#include <stddef.h>
+
+	/*
+	 * Size-capped rotating output (--output-max-size).
+	 *
+	 * The output data is handed to a writer thread, through a
+	 * ring buffer, so the tracing loop never waits for the disk.
+	 * Whenever the output file reaches the maximum size (at a
+	 * line boundary), it is renamed to <file>.<N> (N = 1, 2...)
+	 * and a new one is created. The rotated segments are then
+	 * compressed by another thread, into <file>.<N>.gz (zlib)
+	 * or <file>.<N>.lz (internal codec, see lz.h), and only the
+	 * last --output-keep segments are kept.
+	 */
+
+	/* Ring buffer size. */
+	#define RO_RING_SIZE (8 << 20)
+
+	/* Compressed segments extension. */
+#ifdef HAVE_ZLIB
+	#define RO_EXT ".gz"
+#else
+	#define RO_EXT ".lz"
+#endif
+
+	extern int ro_init(int fd, const char *path, size_t max_size, int keep);
+	extern size_t ro_write(const char *data, size_t len, int block);
+	extern void ro_finish(void);
+
+#endif /* ROTATE_H */
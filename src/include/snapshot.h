@@ -0,0 +1,64 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+	#include "array.h"
+	#include "dwarf_helper.h"
+	#include <sys/types.h>
+
+	/*
+	 * Fork-snapshot offload (--fork-snapshot).
+	 *
+	 * Large arrays are not compared while the child is stopped:
+	 * instead, a copy-on-write copy of the child is created at
+	 * the stop (see pt_fork()), the child is resumed right away
+	 * and worker threads compare the frozen copy in background.
+	 * The changes are attributed to the line of the stop.
+	 *
+	 * Up to SS_MAX_SNAPSHOTS copies may be queued: meanwhile, the
+	 * output of the following stops is held, and written (in
+	 * order) after the changes of the copy, as soon as it is
+	 * compared. The queue is only waited for when full, when the
+	 * function returns and at the end.
+	 */
+
+	/* Amount of bytes compared per work item. */
+	#define SS_CHUNK (1 << 20)
+
+	/* Maximum amount of worker threads. */
+	#define SS_MAX_THREADS 16
+
+	/* Maximum amount of snapshots queued. */
+	#define SS_MAX_SNAPSHOTS 8
+
+	extern int ss_mark(struct array *vars, size_t min_size);
+	extern int ss_start(pid_t child, struct array *vars, unsigned line_no,
+		int depth);
+	extern int ss_flush(void);
+	extern int ss_join(void);
+	extern void ss_finish(void);
+
+#endif /* SNAPSHOT_H */
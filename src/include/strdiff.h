@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STRDIFF_H
+#define STRDIFF_H
+
+	#include "array.h"
+	#include <stddef.h>
+
+	/*
+	 * String-aware diffing (--strings).
+	 *
+	 * Char arrays (1-byte integer elements, one dimension) are
+	 * reported once per stop, as a whole, instead of one event
+	 * per byte changed: either by the NUL-terminated strings
+	 * before and after, escaped, like: before: "foo", after:
+	 * "foo\tbar", or by a compact edit, with the range changed
+	 * and its new content, like: edit: [3-6] = "\tbar". Changes
+	 * past the NUL terminator only are not reported.
+	 */
+
+	/* Default and maximum amount of characters shown. */
+	#define SD_MAX_DEFAULT 64
+	#define SD_MAX_LENGTH  1024
+
+	/* Output buffer size, for both strings. */
+	#define SD_BS (2 * (4 * SD_MAX_LENGTH + 8) + 64)
+
+	extern void sd_mark(struct array *vars, int max, int edit);
+	extern int sd_changed(const char *old, const char *new, size_t len);
+	extern char *sd_format(char *buffer, size_t size, const char *old,
+		const char *new, size_t len);
+
+#endif /* STRDIFF_H */
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+	#include "array.h"
+	#include "dwarf_helper.h"
+	#include <stdio.h>
+
+	/*
+	 * Statistics-only mode (--summary).
+	 *
+	 * Instead of reporting each change, every watched variable
+	 * (scalars and arrays, whose elements are accounted together)
+	 * keeps constant-memory online statistics: amount of changes,
+	 * min/max, mean/variance, distinct values (HyperLogLog) and
+	 * quantiles (P²). The report is written at exit or whenever
+	 * PBD receives SIGUSR1.
+	 */
+
+	/* HyperLogLog precision: 2^SM_HLL_P registers (~3% error). */
+	#define SM_HLL_P 10
+	#define SM_HLL_M (1 << SM_HLL_P)
+
+	/* Quantiles estimated. */
+	#define SM_QUANTILES 3
+
+	extern int sm_init(struct array *vars);
+	extern void sm_update(struct dw_variable *v, union var_value *value);
+	extern int sm_requested(void);
+	extern void sm_report(FILE *out);
+	extern void sm_finish(void);
+
+#endif /* SUMMARY_H */
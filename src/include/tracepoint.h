@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TRACEPOINT_H
+#define TRACEPOINT_H
+
+	#include "array.h"
+	#include "breakpoint.h"
+	#include "hashtable.h"
+
+	/*
+	 * Fast tracepoints.
+	 *
+	 * Instead of trapping at every line, the first instruction(s)
+	 * of each eligible line are replaced by a jmp into a small
+	 * stub, injected in the child process, that compares all the
+	 * watched variables against a shadow copy and only raises an
+	 * int3 if something has changed. See tracepoint_amd64.c for
+	 * more details.
+	 */
+#if defined(__x86_64__)
+	extern int tp_init(pid_t child, struct hashtable *breakpoints,
+		struct array *vars, uintptr_t low_pc, uintptr_t high_pc);
+
+	extern struct breakpoint *tp_find(uintptr_t pc);
+	extern struct breakpoint *tp_last_line(pid_t child);
+	extern void tp_force(pid_t child, struct breakpoint *bp);
+	extern void tp_update(pid_t child, struct array *vars,
+		struct breakpoint *bp, int dirty);
+	extern int tp_check_shadow(pid_t child, struct array *vars);
+	extern void tp_finish(void);
+#else
+	/* Not supported on other architectures, yet. */
+	inline static int tp_init(pid_t child, struct hashtable *breakpoints,
+		struct array *vars, uintptr_t low_pc, uintptr_t high_pc)
+	{
+		((void)child); ((void)breakpoints); ((void)vars);
+		((void)low_pc); ((void)high_pc);
+		return (-1);
+	}
+	inline static struct breakpoint *tp_find(uintptr_t pc)
+	{
+		((void)pc);
+		return (NULL);
+	}
+	inline static struct breakpoint *tp_last_line(pid_t child)
+	{
+		((void)child);
+		return (NULL);
+	}
+	inline static void tp_force(pid_t child, struct breakpoint *bp)
+	{
+		((void)child); ((void)bp);
+	}
+	inline static void tp_update(pid_t child, struct array *vars,
+		struct breakpoint *bp, int dirty)
+	{
+		((void)child); ((void)vars); ((void)bp); ((void)dirty);
+	}
+	inline static int tp_check_shadow(pid_t child, struct array *vars)
+	{
+		((void)child); ((void)vars);
+		return (-1);
+	}
+	inline static void tp_finish(void) {}
+#endif
+
+#endif /* TRACEPOINT_H */
@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+	#include "array.h"
+	#include "breakpoint.h"
+	#include "ptrace.h"
+
+	/*
+	 * Sharded tracer.
+	 *
+	 * ptrace binds each traced thread to a single tracer thread,
+	 * so instead of serializing every stop of a multi-threaded
+	 * executable, PBD may run a pool of tracer threads (shards),
+	 * each one with its own wait loop and output buffer. Each
+	 * traced thread is owned by exactly one shard.
+	 */
+
+	/* Maximum amount of tracer threads. */
+	#define TR_MAX_THREADS 64
+
+	/**
+	 * @brief Traced thread state.
+	 */
+	struct tracee
+	{
+		pid_t tid;                  /* Thread id.                */
+		struct array *context;      /* Function context list.    */
+		struct breakpoint *prev_bp; /* Previous breakpoint.      */
+		int init_vars;              /* Initialize vars flag.     */
+		int depth;                  /* Current function depth.   */
+	};
+
+	/**
+	 * @brief Tracer callbacks.
+	 */
+	struct tracer_ops
+	{
+		/* A new thread is being traced, initialize it. */
+		void (*attach)(struct tracee *t);
+
+		/* The thread hit a breakpoint, handle and resume it. */
+		void (*trap)(struct tracee *t);
+
+		/* The thread has exited, release its resources. */
+		void (*detach)(struct tracee *t);
+	};
+
+	extern int tr_run(pid_t child, int nthreads,
+		const struct tracer_ops *ops, FILE *output, uintptr_t near);
+
+	extern int tr_step_over(struct breakpoint *bp, pid_t tid);
+
+	extern int tr_live_threads(void);
+
+	extern void tr_rdlock(void);
+	extern void tr_wrlock(void);
+	extern void tr_unlock(void);
+
+#endif /* TRACER_H */
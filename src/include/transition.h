@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+	#include "array.h"
+	#include "dwarf_helper.h"
+	#include <stdio.h>
+
+	/*
+	 * Enum state-transition matrices (--transitions).
+	 *
+	 * Every watched enum variable (scalars and arrays, whose
+	 * elements are accounted together) keeps a from->to counter
+	 * matrix, indexed by the enumerators values, and the line
+	 * where each transition first occurred. Values that match no
+	 * enumerator are accounted as a single '?' state. Instead of
+	 * reporting each change, the matrices are written at exit,
+	 * as tables and, optionally, as a DOT graph.
+	 */
+
+	/* Unknown state: values that match no enumerator. */
+	#define TM_UNKNOWN "?"
+
+	extern int tm_init(struct dw_utils *dw, struct array *vars,
+		const char *dot_file);
+	extern void tm_update(struct dw_variable *v, unsigned line_no,
+		union var_value *v_before, union var_value *v_after);
+	extern void tm_report(FILE *out);
+	extern void tm_finish(void);
+
+#endif /* TRANSITION_H */
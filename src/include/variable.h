@@ -55,7 +55,7 @@
 
 	extern void var_initialize(struct array *vars, pid_t child);
 
-	extern void var_check_changes(struct breakpoint *bp, struct array *vars,
+	extern int var_check_changes(struct breakpoint *bp, struct array *vars,
 		pid_t child, int depth);
 
 	extern void var_array_free(struct array *vars);
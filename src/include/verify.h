@@ -0,0 +1,53 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+	#include "array.h"
+	#include "breakpoint.h"
+	#include "dwarf_helper.h"
+
+	/*
+	 * Shadow verification.
+	 *
+	 * On sampled stops, all the watched variables are also checked
+	 * by an exhaustive (and slow) engine, i.e: var_read() + memcmp()
+	 * for every variable, and the changes found (line, variable,
+	 * element and value, in order) are compared against the ones
+	 * reported by the regular (fast) path.
+	 */
+
+	extern void vf_init(int rate, int random);
+	extern int vf_sample(void);
+	extern void vf_begin(struct breakpoint *bp, struct array *vars,
+		pid_t child);
+	extern void vf_note(struct dw_variable *v, unsigned line_no,
+		union var_value *v_after, int *array_idxs);
+	extern void vf_end(void);
+	extern void vf_check_shadow(struct breakpoint *bp, struct array *vars,
+		pid_t child);
+	extern void vf_finish(void);
+
+#endif /* VERIFY_H */
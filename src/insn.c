@@ -0,0 +1,503 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * x86/x86_64 instruction length decoder.
+ *
+ * PBD does not need to fully disassemble anything, it only needs
+ * to know where each instruction ends and whether it transfers
+ * control (and where to) or references memory relative to RIP,
+ * so it can be safely moved elsewhere.
+ */
+
+#include "insn.h"
+
+/* One-byte opcode properties. */
+#define OP_M    0x01 /* ModR/M byte follows.         */
+#define OP_I8   0x02 /* 8-bit immediate.             */
+#define OP_IZ   0x04 /* 16/32-bit immediate.         */
+#define OP_I16  0x08 /* 16-bit immediate.            */
+#define OP_X    0x80 /* Invalid in 64-bit mode.      */
+
+/**
+ * One-byte opcode map, as seen in 64-bit mode. The differences
+ * found in 32-bit mode are handled in insn_decode().
+ */
+static const uint8_t op_table[256] = {
+	/*        0     1     2     3     4     5     6     7  */
+	/*        8     9     A     B     C     D     E     F  */
+	/* 00 */ OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, OP_X, OP_X,
+	         OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, OP_X, 0,
+	/* 10 */ OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, OP_X, OP_X,
+	         OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, OP_X, OP_X,
+	/* 20 */ OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, 0, OP_X,
+	         OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, 0, OP_X,
+	/* 30 */ OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, 0, OP_X,
+	         OP_M, OP_M, OP_M, OP_M, OP_I8, OP_IZ, 0, OP_X,
+	/* 40 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 50 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 60 */ OP_X, OP_X, OP_X, OP_M, 0, 0, 0, 0,
+	         OP_IZ, OP_M|OP_IZ, OP_I8, OP_M|OP_I8, 0, 0, 0, 0,
+	/* 70 */ OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8,
+	         OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8,
+	/* 80 */ OP_M|OP_I8, OP_M|OP_IZ, OP_X, OP_M|OP_I8, OP_M, OP_M, OP_M, OP_M,
+	         OP_M, OP_M, OP_M, OP_M, OP_M, OP_M, OP_M, OP_M,
+	/* 90 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, OP_X, 0, 0, 0, 0, 0,
+	/* A0 */ 0, 0, 0, 0, 0, 0, 0, 0, OP_I8, OP_IZ, 0, 0, 0, 0, 0, 0,
+	/* B0 */ OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8,
+	         OP_IZ, OP_IZ, OP_IZ, OP_IZ, OP_IZ, OP_IZ, OP_IZ, OP_IZ,
+	/* C0 */ OP_M|OP_I8, OP_M|OP_I8, OP_I16, 0, 0, 0, OP_M|OP_I8, OP_M|OP_IZ,
+	         OP_I16|OP_I8, 0, OP_I16, 0, 0, OP_I8, OP_X, 0,
+	/* D0 */ OP_M, OP_M, OP_M, OP_M, OP_X, OP_X, OP_X, 0,
+	         OP_M, OP_M, OP_M, OP_M, OP_M, OP_M, OP_M, OP_M,
+	/* E0 */ OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8, OP_I8,
+	         OP_IZ, OP_IZ, OP_X, OP_I8, 0, 0, 0, 0,
+	/* F0 */ 0, 0, 0, 0, 0, 0, OP_M, OP_M, 0, 0, 0, 0, 0, 0, OP_M, OP_M,
+};
+
+/**
+ * @brief Checks if the two-byte opcode (0F xx) @p op have
+ * a ModR/M byte.
+ */
+static inline int op2_has_modrm(uint8_t op)
+{
+	switch (op)
+	{
+		case 0x05: case 0x06: case 0x07: case 0x08:
+		case 0x09: case 0x0B: case 0x0E: case 0x77:
+		case 0xA0: case 0xA1: case 0xA2: case 0xA8:
+		case 0xA9: case 0xAA:
+			return (0);
+		default:
+			break;
+	}
+
+	/* wrmsr/rdtsc/sysenter..., jcc rel32 and bswap. */
+	if ((op >= 0x30 && op <= 0x37) || (op >= 0x80 && op <= 0x8F) ||
+		(op >= 0xC8 && op <= 0xCF))
+		return (0);
+
+	return (1);
+}
+
+/**
+ * @brief Checks if the two-byte opcode (0F xx) @p op have
+ * an 8-bit immediate.
+ */
+static inline int op2_has_imm8(uint8_t op)
+{
+	return ((op >= 0x70 && op <= 0x73) || op == 0x0F || op == 0xA4 ||
+		op == 0xAC || op == 0xBA || op == 0xC2 || (op >= 0xC4 && op <= 0xC6));
+}
+
+/**
+ * @brief Decodes the ModR/M (and SIB/displacement, if any) bytes.
+ *
+ * @param p Current position.
+ * @param end Buffer end.
+ * @param mode Decoding mode.
+ * @param addr16 16-bit addressing?
+ * @param insn Instruction being decoded.
+ * @param start Instruction start.
+ * @param modrm Returned ModR/M byte.
+ *
+ * @return Returns the position after the ModR/M operand or NULL
+ * if out of bounds.
+ */
+static const uint8_t *decode_modrm(const uint8_t *p, const uint8_t *end,
+	int mode, int addr16, struct insn *insn, const uint8_t *start,
+	uint8_t *modrm)
+{
+	uint8_t mod; /* Mod field. */
+	uint8_t rm;  /* R/M field. */
+
+	if (p >= end)
+		return (NULL);
+
+	*modrm = *p++;
+	mod = *modrm >> 6;
+	rm  = *modrm & 7;
+
+	if (mod == 3)
+		return (p);
+
+	/* 16-bit addressing, only in 32-bit mode. */
+	if (addr16)
+	{
+		if (mod == 0 && rm == 6)
+			p += 2;
+		else if (mod == 1)
+			p += 1;
+		else if (mod == 2)
+			p += 2;
+		return (p <= end ? p : NULL);
+	}
+
+	/* SIB. */
+	if (rm == 4)
+	{
+		if (p >= end)
+			return (NULL);
+		if (mod == 0 && (*p & 7) == 5)
+			p += 4;
+		p++;
+	}
+
+	/* RIP-relative (or absolute disp32 in 32-bit mode). */
+	else if (mod == 0 && rm == 5)
+	{
+		if (mode == INSN_MODE64)
+		{
+			insn->flags |= INSN_RIPREL;
+			insn->disp_off = p - start;
+		}
+		p += 4;
+	}
+
+	if (mod == 1)
+		p += 1;
+	else if (mod == 2)
+		p += 4;
+
+	return (p <= end ? p : NULL);
+}
+
+/**
+ * @brief Decodes a single x86 instruction.
+ *
+ * @param code Instruction bytes.
+ * @param size Amount of bytes available in @p code.
+ * @param addr Instruction address, used to compute branch
+ * targets.
+ * @param mode Decoding mode: INSN_MODE32 or INSN_MODE64.
+ * @param insn Decoded instruction.
+ *
+ * @return Returns the instruction length or a negative number
+ * if the instruction could not be decoded.
+ */
+int insn_decode(const uint8_t *code, size_t size, uintptr_t addr,
+	int mode, struct insn *insn)
+{
+	const uint8_t *p;    /* Current position.    */
+	const uint8_t *end;  /* Buffer end.          */
+	uint8_t op;          /* Opcode.              */
+	uint8_t modrm;       /* ModR/M byte.         */
+	uint8_t props;       /* Opcode properties.   */
+	int opsize16;        /* 0x66 prefix.         */
+	int addrsize;        /* 0x67 prefix.         */
+	int rex_w;           /* REX.W.               */
+	int imm;             /* Immediate size.      */
+	int rel;             /* Relative disp. size. */
+	int map;             /* Opcode map.          */
+
+	p   = code;
+	end = code + (size < INSN_MAX_LEN ? size : INSN_MAX_LEN);
+
+	insn->addr     = addr;
+	insn->length   = 0;
+	insn->disp_off = 0;
+	insn->flags    = 0;
+	insn->target   = 0;
+
+	opsize16 = 0;
+	addrsize = 0;
+	rex_w    = 0;
+	imm      = 0;
+	rel      = 0;
+	modrm    = 0;
+
+	/* Prefixes. */
+	for (;;)
+	{
+		if (p >= end)
+			return (-1);
+
+		op = *p;
+		if (op == 0x66)
+			opsize16 = 1;
+		else if (op == 0x67)
+			addrsize = 1;
+		else if (op == 0xF0 || op == 0xF2 || op == 0xF3 || op == 0x2E ||
+			op == 0x36 || op == 0x3E || op == 0x26 || op == 0x64 || op == 0x65)
+			;
+		else if (mode == INSN_MODE64 && (op & 0xF0) == 0x40)
+		{
+			rex_w = (op >> 3) & 1;
+			p++;
+
+			/* REX must be the last prefix. */
+			if (p < end && (*p == 0x66 || *p == 0x67 || *p == 0xF0 ||
+				*p == 0xF2 || *p == 0xF3))
+			{
+				rex_w = 0;
+				continue;
+			}
+			break;
+		}
+		else
+			break;
+		p++;
+	}
+
+	if (p >= end)
+		return (-1);
+
+	op = *p++;
+
+	/* VEX/EVEX/XOP encoded instructions. */
+	if ((op == 0xC4 || op == 0xC5 || op == 0x62 || op == 0x8F) && p < end &&
+		(mode == INSN_MODE64 ? op != 0x8F || (*p & 0x1F) >= 8 :
+		(op == 0x8F ? (*p & 0x1F) >= 8 : (*p & 0xC0) == 0xC0)))
+	{
+		if (op == 0xC5)
+		{
+			map = 1;
+			p += 1;
+		}
+		else if (op == 0x62)
+		{
+			map = *p & 3;
+			p += 3;
+		}
+		else
+		{
+			map = *p & 0x1F;
+			p += 2;
+		}
+
+		if (p >= end)
+			return (-1);
+
+		op = *p++;
+
+		/* vzeroupper/vzeroall. */
+		if (map == 1 && op == 0x77)
+			goto out;
+
+		if ((p = decode_modrm(p, end, mode, 0, insn, code, &modrm)) == NULL)
+			return (-1);
+
+		if (map == 3 || map == 8 || (map == 1 && op2_has_imm8(op)))
+			imm = 1;
+		else if (map == 0xA)
+			imm = 4;
+
+		goto out;
+	}
+
+	/* Two- and three-byte opcodes. */
+	if (op == 0x0F)
+	{
+		if (p >= end)
+			return (-1);
+
+		op = *p++;
+
+		/* 0F 38 xx and 0F 3A xx. */
+		if (op == 0x38 || op == 0x3A)
+		{
+			if (p >= end)
+				return (-1);
+			p++;
+			imm = (op == 0x3A);
+
+			if ((p = decode_modrm(p, end, mode, addrsize && mode == INSN_MODE32,
+				insn, code, &modrm)) == NULL)
+				return (-1);
+			goto out;
+		}
+
+		/* Jcc rel16/32. */
+		if (op >= 0x80 && op <= 0x8F)
+		{
+			insn->flags |= INSN_BRANCH|INSN_COND|INSN_RELATIVE;
+			rel = (opsize16 && mode == INSN_MODE32) ? 2 : 4;
+			goto out;
+		}
+
+		if (op2_has_modrm(op))
+		{
+			if ((p = decode_modrm(p, end, mode, addrsize && mode == INSN_MODE32,
+				insn, code, &modrm)) == NULL)
+				return (-1);
+		}
+
+		if (op2_has_imm8(op))
+			imm = 1;
+
+		goto out;
+	}
+
+	props = op_table[op];
+
+	/* Opcodes that differ in 32-bit mode. */
+	if (mode == INSN_MODE32)
+	{
+		switch (op)
+		{
+			case 0x06: case 0x07: case 0x0E: case 0x16: case 0x17:
+			case 0x1E: case 0x1F: case 0x27: case 0x2F: case 0x37:
+			case 0x3F: case 0x60: case 0x61: case 0xCE: case 0xD6:
+				props = 0;
+				break;
+			case 0x62: case 0xC4: case 0xC5:
+				props = OP_M;
+				break;
+			case 0x82:
+				props = OP_M|OP_I8;
+				break;
+			case 0xD4: case 0xD5:
+				props = OP_I8;
+				break;
+			case 0x9A: case 0xEA:
+				insn->flags |= INSN_BRANCH|INSN_INDIRECT;
+				if (op == 0x9A)
+					insn->flags |= INSN_CALL;
+				imm = (opsize16 ? 2 : 4) + 2;
+				goto out;
+			default:
+				break;
+		}
+	}
+
+	if (props & OP_X)
+		return (-1);
+
+	/* Control transfer. */
+	switch (op)
+	{
+		/* Jcc rel8, loop*, jcxz. */
+		case 0x70: case 0x71: case 0x72: case 0x73:
+		case 0x74: case 0x75: case 0x76: case 0x77:
+		case 0x78: case 0x79: case 0x7A: case 0x7B:
+		case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+		case 0xE0: case 0xE1: case 0xE2: case 0xE3:
+			insn->flags |= INSN_BRANCH|INSN_COND|INSN_RELATIVE;
+			rel = 1;
+			goto out;
+
+		/* call/jmp rel16/32. */
+		case 0xE8: case 0xE9:
+			insn->flags |= INSN_BRANCH|INSN_RELATIVE;
+			if (op == 0xE8)
+				insn->flags |= INSN_CALL;
+			rel = (opsize16 && mode == INSN_MODE32) ? 2 : 4;
+			goto out;
+
+		/* jmp rel8. */
+		case 0xEB:
+			insn->flags |= INSN_BRANCH|INSN_RELATIVE;
+			rel = 1;
+			goto out;
+
+		/* ret, retf, iret. */
+		case 0xC2: case 0xC3: case 0xCA: case 0xCB: case 0xCF:
+			insn->flags |= INSN_BRANCH|INSN_RET;
+			break;
+
+		/* mov al/ax/eax/rax, moffs (and vice-versa). */
+		case 0xA0: case 0xA1: case 0xA2: case 0xA3:
+			if (mode == INSN_MODE64)
+				imm = addrsize ? 4 : 8;
+			else
+				imm = addrsize ? 2 : 4;
+			goto out;
+
+		default:
+			break;
+	}
+
+	/* ModR/M. */
+	if (props & OP_M)
+	{
+		if ((p = decode_modrm(p, end, mode, addrsize && mode == INSN_MODE32,
+			insn, code, &modrm)) == NULL)
+			return (-1);
+
+		/* test r/m, imm. */
+		if ((op == 0xF6 || op == 0xF7) && ((modrm >> 3) & 7) < 2)
+			props |= (op == 0xF6) ? OP_I8 : OP_IZ;
+
+		/* Indirect call/jmp. */
+		if (op == 0xFF)
+		{
+			switch ((modrm >> 3) & 7)
+			{
+				case 2: case 3:
+					insn->flags |= INSN_BRANCH|INSN_CALL|INSN_INDIRECT;
+					break;
+				case 4: case 5:
+					insn->flags |= INSN_BRANCH|INSN_INDIRECT;
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	/* Immediates. */
+	if (props & OP_I8)
+		imm += 1;
+	if (props & OP_I16)
+		imm += 2;
+	if (props & OP_IZ)
+	{
+		/* mov r64, imm64. */
+		if (op >= 0xB8 && op <= 0xBF && rex_w)
+			imm += 8;
+		else
+			imm += (opsize16 && !rex_w) ? 2 : 4;
+	}
+
+out:
+	p += imm;
+
+	/* Relative branches. */
+	if (rel)
+	{
+		int64_t disp;
+		const uint8_t *d;
+
+		d = p;
+		p += rel;
+		if (p > end)
+			return (-1);
+
+		if (rel == 1)
+			disp = (int8_t)d[0];
+		else if (rel == 2)
+			disp = (int16_t)(d[0] | (d[1] << 8));
+		else
+			disp = (int32_t)((uint32_t)d[0] | ((uint32_t)d[1] << 8) |
+				((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24));
+
+		insn->target = addr + (p - code) + disp;
+	}
+
+	if (p > end)
+		return (-1);
+
+	insn->length = p - code;
+	return (insn->length);
+}
@@ -0,0 +1,454 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "itree.h"
+#include <stdlib.h>
+
+#define ITREE_HEIGHT(n) ((n) ? (n)->height : 0)
+#define ITREE_MAX(n)    ((n) ? (n)->max : 0)
+
+/**
+ * @brief Recomputes the height and max end of the node @p n,
+ * from its children.
+ *
+ * @param n Node to be updated.
+ */
+static inline void itree_update(struct itree_node *n)
+{
+	int hl, hr;
+
+	hl = ITREE_HEIGHT(n->left);
+	hr = ITREE_HEIGHT(n->right);
+	n->height = (hl > hr ? hl : hr) + 1;
+
+	n->max = n->end;
+	if (ITREE_MAX(n->left) > n->max)
+		n->max = n->left->max;
+	if (ITREE_MAX(n->right) > n->max)
+		n->max = n->right->max;
+}
+
+/**
+ * @brief Rotates the subtree @p n to the right.
+ *
+ * @param n Subtree root.
+ *
+ * @return Returns the new subtree root.
+ */
+static struct itree_node *itree_rotate_right(struct itree_node *n)
+{
+	struct itree_node *l = n->left;
+	n->left  = l->right;
+	l->right = n;
+	itree_update(n);
+	itree_update(l);
+	return (l);
+}
+
+/**
+ * @brief Rotates the subtree @p n to the left.
+ *
+ * @param n Subtree root.
+ *
+ * @return Returns the new subtree root.
+ */
+static struct itree_node *itree_rotate_left(struct itree_node *n)
+{
+	struct itree_node *r = n->right;
+	n->right = r->left;
+	r->left  = n;
+	itree_update(n);
+	itree_update(r);
+	return (r);
+}
+
+/**
+ * @brief Updates and rebalances the subtree @p n.
+ *
+ * @param n Subtree root.
+ *
+ * @return Returns the new subtree root.
+ */
+static struct itree_node *itree_balance(struct itree_node *n)
+{
+	int bf;
+
+	itree_update(n);
+	bf = ITREE_HEIGHT(n->left) - ITREE_HEIGHT(n->right);
+
+	if (bf > 1)
+	{
+		if (ITREE_HEIGHT(n->left->left) < ITREE_HEIGHT(n->left->right))
+			n->left = itree_rotate_left(n->left);
+		return (itree_rotate_right(n));
+	}
+	else if (bf < -1)
+	{
+		if (ITREE_HEIGHT(n->right->right) < ITREE_HEIGHT(n->right->left))
+			n->right = itree_rotate_right(n->right);
+		return (itree_rotate_left(n));
+	}
+	return (n);
+}
+
+/**
+ * @brief Inserts the node @p new into the subtree @p n.
+ *
+ * @param n Subtree root.
+ * @param new New node.
+ * @param ret Set to -1 if the start already exists.
+ *
+ * @return Returns the new subtree root.
+ */
+static struct itree_node *itree_insert_node(struct itree_node *n,
+	struct itree_node *new, int *ret)
+{
+	if (n == NULL)
+		return (new);
+
+	if (new->start < n->start)
+		n->left = itree_insert_node(n->left, new, ret);
+	else if (new->start > n->start)
+		n->right = itree_insert_node(n->right, new, ret);
+	else
+	{
+		*ret = -1;
+		return (n);
+	}
+	return (itree_balance(n));
+}
+
+/**
+ * @brief Unlinks the smallest node of the subtree @p n.
+ *
+ * @param n Subtree root.
+ * @param min Smallest node found.
+ *
+ * @return Returns the new subtree root.
+ */
+static struct itree_node *itree_unlink_min(struct itree_node *n,
+	struct itree_node **min)
+{
+	if (n->left == NULL)
+	{
+		*min = n;
+		return (n->right);
+	}
+	n->left = itree_unlink_min(n->left, min);
+	return (itree_balance(n));
+}
+
+/**
+ * @brief Removes the node that starts at @p start from the
+ * subtree @p n.
+ *
+ * @param n Subtree root.
+ * @param start Interval start.
+ * @param removed Removed node, if any.
+ *
+ * @return Returns the new subtree root.
+ */
+static struct itree_node *itree_remove_node(struct itree_node *n,
+	uintptr_t start, struct itree_node **removed)
+{
+	struct itree_node *min;
+
+	if (n == NULL)
+		return (NULL);
+
+	if (start < n->start)
+		n->left = itree_remove_node(n->left, start, removed);
+	else if (start > n->start)
+		n->right = itree_remove_node(n->right, start, removed);
+	else
+	{
+		*removed = n;
+		if (n->left == NULL)
+			return (n->right);
+		if (n->right == NULL)
+			return (n->left);
+
+		/* Replace by its successor. */
+		n->right  = itree_unlink_min(n->right, &min);
+		min->left  = n->left;
+		min->right = n->right;
+		return (itree_balance(min));
+	}
+	return (itree_balance(n));
+}
+
+/**
+ * @brief Initializes the interval tree.
+ *
+ * @param t Interval tree structure pointer to be initialized.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int itree_init(struct itree **t)
+{
+	struct itree *out;
+	out = calloc(1, sizeof(struct itree));
+	if (out == NULL)
+		return (-1);
+
+	*t = out;
+	return (0);
+}
+
+/**
+ * @brief Inserts the interval [@p start, @p end) into the tree.
+ *
+ * @param t Interval tree.
+ * @param start Interval start.
+ * @param end Interval end (exclusive).
+ * @param value Entry value.
+ *
+ * @return Returns 0 if success and a negative number otherwise,
+ * i.e: if there is already an interval starting at @p start.
+ */
+int itree_insert(struct itree **t, uintptr_t start, uintptr_t end,
+	void *value)
+{
+	struct itree_node *n;
+	int ret;
+
+	if (t == NULL || *t == NULL || end <= start)
+		return (-1);
+
+	if ((n = malloc(sizeof(struct itree_node))) == NULL)
+		return (-1);
+
+	n->start  = start;
+	n->end    = end;
+	n->max    = end;
+	n->height = 1;
+	n->value  = value;
+	n->left   = NULL;
+	n->right  = NULL;
+
+	ret = 0;
+	(*t)->root = itree_insert_node((*t)->root, n, &ret);
+	if (ret < 0)
+	{
+		free(n);
+		return (-1);
+	}
+
+	(*t)->elements++;
+	return (0);
+}
+
+/**
+ * @brief Removes the interval that starts at @p start.
+ *
+ * @param t Interval tree.
+ * @param start Interval start.
+ *
+ * @return Returns the entry value if found, or NULL otherwise.
+ */
+void *itree_remove(struct itree **t, uintptr_t start)
+{
+	struct itree_node *removed;
+	void *value;
+
+	if (t == NULL || *t == NULL)
+		return (NULL);
+
+	removed = NULL;
+	(*t)->root = itree_remove_node((*t)->root, start, &removed);
+	if (removed == NULL)
+		return (NULL);
+
+	value = removed->value;
+	free(removed);
+	(*t)->elements--;
+	return (value);
+}
+
+/**
+ * @brief Gets the interval that starts at @p start.
+ *
+ * @param t Interval tree.
+ * @param start Interval start.
+ *
+ * @return Returns the entry value if found, or NULL otherwise.
+ */
+void *itree_get(struct itree **t, uintptr_t start)
+{
+	struct itree_node *n;
+
+	if (t == NULL || *t == NULL)
+		return (NULL);
+
+	n = (*t)->root;
+	while (n != NULL && n->start != start)
+		n = (start < n->start) ? n->left : n->right;
+
+	return (n ? n->value : NULL);
+}
+
+/**
+ * @brief Finds an interval that overlaps [@p start, @p end).
+ *
+ * @param t Interval tree.
+ * @param start Query start.
+ * @param end Query end (exclusive).
+ * @param ostart Start of the interval found, if not NULL.
+ *
+ * @return Returns the entry value of the leftmost overlapping
+ * interval, or NULL if none.
+ */
+void *itree_overlap(struct itree **t, uintptr_t start, uintptr_t end,
+	uintptr_t *ostart)
+{
+	struct itree_node *n;
+	struct itree_node *found;
+
+	if (t == NULL || *t == NULL)
+		return (NULL);
+
+	n = (*t)->root;
+	found = NULL;
+
+	while (n != NULL)
+	{
+		/* Nothing on the left ends after start, go right. */
+		if (n->left != NULL && n->left->max > start)
+		{
+			if (n->start < end && start < n->end)
+				found = n;
+			n = n->left;
+			continue;
+		}
+
+		if (n->start < end && start < n->end)
+		{
+			found = n;
+			break;
+		}
+
+		/* Everything on the right starts after the end. */
+		if (n->start >= end)
+			break;
+
+		n = n->right;
+	}
+
+	if (found == NULL)
+		return (NULL);
+
+	if (ostart != NULL)
+		*ostart = found->start;
+	return (found->value);
+}
+
+/**
+ * @brief Iterates the subtree @p n in order.
+ *
+ * @return Returns the first non-zero value returned by @p cb.
+ */
+static int itree_foreach_node(struct itree_node *n,
+	int (*cb)(uintptr_t start, uintptr_t end, void *value, void *data),
+	void *data)
+{
+	int ret;
+
+	if (n == NULL)
+		return (0);
+
+	if ((ret = itree_foreach_node(n->left, cb, data)) != 0)
+		return (ret);
+	if ((ret = cb(n->start, n->end, n->value, data)) != 0)
+		return (ret);
+	return (itree_foreach_node(n->right, cb, data));
+}
+
+/**
+ * @brief Calls @p cb for every interval, in ascending order,
+ * until @p cb returns non-zero.
+ *
+ * @param t Interval tree.
+ * @param cb Callback.
+ * @param data Callback data.
+ *
+ * @return Returns the first non-zero value returned by @p cb,
+ * or 0.
+ *
+ * @note The tree must not be modified inside @p cb.
+ */
+int itree_foreach(struct itree **t,
+	int (*cb)(uintptr_t start, uintptr_t end, void *value, void *data),
+	void *data)
+{
+	if (t == NULL || *t == NULL)
+		return (0);
+
+	return (itree_foreach_node((*t)->root, cb, data));
+}
+
+/**
+ * @brief Returns the amount of intervals in the tree.
+ *
+ * @param t Interval tree.
+ *
+ * @return Returns the amount of elements.
+ */
+size_t itree_size(struct itree **t)
+{
+	if (t == NULL || *t == NULL)
+		return (0);
+	return ((*t)->elements);
+}
+
+/**
+ * @brief Deallocates the subtree @p n.
+ */
+static void itree_free_node(struct itree_node *n,
+	void (*dealloc)(void *value))
+{
+	if (n == NULL)
+		return;
+
+	itree_free_node(n->left, dealloc);
+	itree_free_node(n->right, dealloc);
+	if (dealloc != NULL)
+		dealloc(n->value);
+	free(n);
+}
+
+/**
+ * @brief Deallocates the interval tree.
+ *
+ * @param t Interval tree.
+ * @param dealloc Value deallocator, if any.
+ */
+void itree_finish(struct itree **t, void (*dealloc)(void *value))
+{
+	if (t == NULL || *t == NULL)
+		return;
+
+	itree_free_node((*t)->root, dealloc);
+	free(*t);
+	*t = NULL;
+}
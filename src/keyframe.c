@@ -0,0 +1,670 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "keyframe.h"
+#include "function.h"
+#include "hashtable.h"
+#include "line.h"
+#include "output.h"
+#include "pbd.h"
+#include "util.h"
+#include "variable.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Keyframes state. */
+static struct kf
+{
+	int every;         /* Events between keyframes.    */
+	size_t bytes;      /* Bytes between keyframes.     */
+	int count;         /* Keyframes written.           */
+	uint64_t events;   /* Change events so far.        */
+	uint64_t last;     /* Events at the last keyframe. */
+	size_t last_off;   /* Output offset after it.      */
+	FILE *index;       /* Index file, if any.          */
+} kf;
+
+/**
+ * @brief Initializes the keyframes.
+ *
+ * @param every Change events between keyframes, 0 if none.
+ * @param bytes Output bytes between keyframes, 0 if none.
+ * @param output_file Output file, whose index is written, or
+ *        NULL if none.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int kf_init(int every, size_t bytes, const char *output_file)
+{
+	char *path;
+
+	kf.every = every;
+	kf.bytes = bytes;
+
+	if (output_file == NULL)
+		return (0);
+
+	path = malloc(sizeof(char) * (strlen(output_file) +
+		sizeof(KF_INDEX_EXT)));
+	if (path == NULL)
+		return (-1);
+
+	strcpy(path, output_file);
+	strcat(path, KF_INDEX_EXT);
+
+	if ((kf.index = fopen(path, "w")) == NULL)
+		fprintf(stderr, "PBD: unable to create the keyframes index %s!\n", path);
+
+	free(path);
+	return (0);
+}
+
+/**
+ * @brief Accounts a change event written in the output.
+ */
+void kf_event(void)
+{
+	kf.events++;
+}
+
+/**
+ * @brief Writes the scope of a keyframe line, for the variable
+ * @p v.
+ *
+ * @param v Variable.
+ * @param depth Function depth, for locals.
+ */
+static void kf_prefix(struct dw_variable *v, int depth)
+{
+	if (v->scope == VGLOBAL)
+		fputs("[Keyframe] [global] ", pbd_output);
+	else
+		fprintf(pbd_output, "[Keyframe] [depth: %d] [local] ", depth);
+}
+
+/**
+ * @brief Writes the current value of @p v, with a line per run
+ * of equal elements (along the last dimension), if array.
+ *
+ * @param v Variable.
+ * @param depth Function depth, for locals.
+ */
+static void kf_write_var(struct dw_variable *v, int depth)
+{
+	char value[BS];                  /* Formatted value. */
+	int idxs[MATRIX_MAX_DIMENSIONS]; /* Run indexes.     */
+	union var_value elem;            /* Array element.   */
+	size_t size_per_element;         /* Element size.    */
+	size_t nelements;                /* Elements.        */
+	size_t row;                      /* Last dimension.  */
+	size_t i, j, idx;
+	int dims;
+	char *p;
+
+	/* Base types. */
+	if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+	{
+		kf_prefix(v, depth);
+		fprintf(pbd_output, "(%s) = %s\n", v->name,
+			var_format_value(value, &v->value, v->type.encoding, v->byte_size));
+		return;
+	}
+
+	if (v->type.var_type != TARRAY || v->value.p_value == NULL ||
+		!(v->type.array.var_type & (TBASE_TYPE|TENUM|TPOINTER)))
+	{
+		return;
+	}
+
+	size_per_element = v->type.array.size_per_element;
+	if (!size_per_element || size_per_element > sizeof(elem.u8_value))
+		return;
+
+	dims      = v->type.array.dimensions;
+	row       = v->type.array.elements_per_dimension[dims - 1];
+	nelements = v->byte_size / size_per_element;
+	p         = v->value.p_value;
+
+	for (i = 0; i < nelements; i = j)
+	{
+		/* Run of equal elements, in the same row. */
+		for (j = i + 1; j < nelements && (j % row) && !memcmp(p + j *
+			size_per_element, p + i * size_per_element, size_per_element); j++)
+			;
+
+		idx = i;
+		for (int d = dims - 1; d >= 0; d--)
+		{
+			idxs[d] = idx % v->type.array.elements_per_dimension[d];
+			idx /= v->type.array.elements_per_dimension[d];
+		}
+
+		kf_prefix(v, depth);
+		fprintf(pbd_output, "(%s", v->name);
+		for (int d = 0; d < dims - 1; d++)
+			fprintf(pbd_output, "[%d]", idxs[d]);
+
+		if (j - i == 1)
+			fprintf(pbd_output, "[%d]", idxs[dims - 1]);
+		else
+			fprintf(pbd_output, "[%d..%d]", idxs[dims - 1],
+				idxs[dims - 1] + (int)(j - i - 1));
+
+		memset(&elem, 0, sizeof(elem));
+		memcpy(elem.u8_value, p + i * size_per_element, size_per_element);
+		fprintf(pbd_output, ") = %s\n", var_format_value(value, &elem,
+			v->type.encoding, size_per_element));
+	}
+}
+
+/**
+ * @brief Writes a keyframe: the globals and the locals of each
+ * function depth.
+ *
+ * @param context Function contexts.
+ * @param depth Current function depth.
+ */
+static void kf_write(struct array *context, int depth)
+{
+	struct dw_variable *v; /* Current variable. */
+	struct function *f;    /* Function context. */
+	size_t off;            /* Keyframe offset.  */
+	int nvars;
+
+	off = out_offset();
+	fprintf(pbd_output, "[Keyframe: %d] event: %" PRIu64 ", depth: %d\n",
+		kf.count, kf.events, depth);
+
+	/* Globals, as seen by the current depth. */
+	f = array_get(&context, depth - 1, NULL);
+	nvars = (int) array_size(&f->vars);
+	for (int i = 0; i < nvars; i++)
+	{
+		v = array_get(&f->vars, i, NULL);
+		if (v->scope == VGLOBAL)
+			kf_write_var(v, 0);
+	}
+
+	/*
+	 * Locals, of each depth. Locals not yet initialized are left
+	 * out: they hold stack garbage and were never reported, so a
+	 * replay from the start would not know about them either.
+	 */
+	for (int d = 1; d <= depth; d++)
+	{
+		f = array_get(&context, d - 1, NULL);
+		nvars = (int) array_size(&f->vars);
+		for (int i = 0; i < nvars; i++)
+		{
+			v = array_get(&f->vars, i, NULL);
+			if (v->scope == VLOCAL && v->initialized)
+				kf_write_var(v, d);
+		}
+	}
+
+	if (kf.index != NULL)
+	{
+		fprintf(kf.index, "%d %" PRIu64 " %zu\n", kf.count, kf.events, off);
+		fflush(kf.index);
+	}
+
+	kf.count++;
+	kf.last     = kf.events;
+	kf.last_off = out_offset();
+}
+
+/**
+ * @brief Writes a keyframe if this is the first one, or if
+ * enough events (or output bytes) were written since the
+ * last one.
+ *
+ * @param context Function contexts.
+ * @param depth Current function depth.
+ */
+void kf_check(struct array *context, int depth)
+{
+	if (depth < 1)
+		return;
+
+	if (kf.count)
+	{
+		if (kf.events == kf.last)
+			return;
+
+		if (!(kf.every && kf.events - kf.last >= (uint64_t)kf.every) &&
+			!(kf.bytes && out_offset() - kf.last_off >= kf.bytes))
+		{
+			return;
+		}
+	}
+
+	kf_write(context, depth);
+}
+
+/**
+ * @brief Closes the keyframes index, if any.
+ */
+void kf_finish(void)
+{
+	if (kf.index != NULL)
+		fclose(kf.index);
+	kf.index = NULL;
+}
+
+/* ------------------------------------------------------------------*
+ * Reconstruction (--reconstruct)                                    *
+ * ------------------------------------------------------------------*/
+
+/**
+ * Reconstructed value.
+ */
+struct kf_entry
+{
+	char *key;   /* Scope and name, as in: [global] (x). */
+	char *value; /* Value, NULL if out of scope.         */
+};
+
+/* Reconstructed state, in order of appearance, and its index. */
+static struct array *kf_entries;
+static struct hashtable *kf_keys;
+
+/**
+ * @brief Duplicates the first @p len characters of @p s.
+ */
+static char *kf_copy(const char *s, size_t len)
+{
+	char *c;
+
+	if ((c = malloc(sizeof(char) * (len + 1))) == NULL)
+		QUIT(EXIT_FAILURE, "out of memory!\n");
+
+	memcpy(c, s, len);
+	c[len] = '\0';
+	return (c);
+}
+
+/**
+ * @brief Sets the value of @p key.
+ *
+ * @param key Scope and name.
+ * @param value New value, or NULL if out of scope.
+ */
+static void kf_set(const char *key, const char *value)
+{
+	struct kf_entry *e;
+
+	if ((e = hashtable_get(&kf_keys, (void *)key)) == NULL)
+	{
+		if ((e = calloc(1, sizeof(struct kf_entry))) == NULL)
+			QUIT(EXIT_FAILURE, "out of memory!\n");
+
+		e->key = kf_copy(key, strlen(key));
+		array_add(&kf_entries, e);
+		hashtable_add(&kf_keys, e->key, e);
+	}
+
+	free(e->value);
+	e->value = (value != NULL) ? kf_copy(value, strlen(value)) : NULL;
+}
+
+/**
+ * @brief Sets the value of all the keys that start with
+ * @p prefix, or of all keys, if NULL.
+ *
+ * @param prefix Key prefix.
+ * @param value New value, or NULL if out of scope.
+ */
+static void kf_set_prefix(const char *prefix, const char *value)
+{
+	struct kf_entry *e;
+	size_t n;
+
+	n = array_size(&kf_entries);
+	for (size_t i = 0; i < n; i++)
+	{
+		e = array_get(&kf_entries, i, NULL);
+		if (e->value == NULL ||
+			(prefix != NULL && strncmp(e->key, prefix, strlen(prefix))))
+		{
+			continue;
+		}
+
+		free(e->value);
+		e->value = (value != NULL) ? kf_copy(value, strlen(value)) : NULL;
+	}
+}
+
+/**
+ * @brief Applies a keyframe line: (name) = value, where the
+ * last index of arrays may be a run: [first..last].
+ *
+ * @param scope Key scope, as in: '[global] '.
+ * @param s Line, after the scope.
+ */
+static void kf_apply_keyframe(const char *scope, const char *s)
+{
+	char key[512];    /* Element key.        */
+	const char *end;  /* End of name.        */
+	const char *run;  /* Run, if any.        */
+	int first, last;  /* Run range.          */
+	int len;          /* Name length.        */
+
+	if (*s != '(' || (end = strstr(s, ") = ")) == NULL)
+		return;
+
+	/* Single element or variable. */
+	len = (int)(end - s - 1);
+	run = memchr(s, '.', len + 1);
+
+	if (run == NULL || sscanf(run, "..%d]", &last) != 1)
+	{
+		snprintf(key, sizeof(key), "%s(%.*s)", scope, len, s + 1);
+		kf_set(key, end + 4);
+		return;
+	}
+
+	/* Run of elements. */
+	while (run > s && *run != '[')
+		run--;
+
+	if (sscanf(run, "[%d..", &first) != 1)
+		return;
+
+	for (int i = first; i <= last; i++)
+	{
+		snprintf(key, sizeof(key), "%s(%.*s[%d])", scope,
+			(int)(run - s - 1), s + 1, i);
+		kf_set(key, end + 4);
+	}
+}
+
+/**
+ * @brief Applies a change event line, after its line number:
+ * [global|local] (name) has changed!, before: x, after: y.
+ *
+ * @param s Line, after the line number.
+ * @param depth Current function depth.
+ *
+ * @return Returns 1 if the line is a change event, 0 otherwise.
+ */
+static int kf_apply_event(const char *s, int depth)
+{
+	char scope[32];   /* Key scope.   */
+	char key[512];    /* Key.         */
+	const char *name; /* Name start.  */
+	const char *end;  /* Name end.    */
+	const char *val;  /* Value.       */
+
+	if (!strncmp(s, "[global] (", 10))
+	{
+		strcpy(scope, "[global] ");
+		name = s + 10;
+	}
+	else if (!strncmp(s, "[local] (", 9))
+	{
+		snprintf(scope, sizeof(scope), "[depth: %d] [local] ", depth);
+		name = s + 9;
+	}
+	else
+		return (0);
+
+	if ((end = strstr(name, ") has changed!, ")) == NULL &&
+		(end = strstr(name, ") initialized!, ")) == NULL)
+	{
+		return (0);
+	}
+
+	/* Regular values. */
+	if ((val = strstr(end, ", after: ")) != NULL)
+	{
+		snprintf(key, sizeof(key), "%s(%.*s)", scope, (int)(end - name), name);
+		kf_set(key, val + 9);
+		return (1);
+	}
+
+	/* Bitmaps: only the bits changed are known. */
+	if (strstr(end, ", bits: ") != NULL)
+	{
+		snprintf(key, sizeof(key), "%s(%.*s)", scope, (int)(end - name), name);
+		if (hashtable_get(&kf_keys, key) != NULL)
+			kf_set(key, "?");
+
+		snprintf(key, sizeof(key), "%s(%.*s[", scope, (int)(end - name), name);
+		kf_set_prefix(key, "?");
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Finds the nearest keyframe at or before @p target,
+ * through the index, if any, or scanning the keyframe headers.
+ *
+ * @param fp Trace file.
+ * @param trace Trace file name.
+ * @param target Event.
+ *
+ * @return Returns the keyframe offset, or 0 if none.
+ */
+static size_t kf_find(FILE *fp, const char *trace, uint64_t target)
+{
+	char *line;     /* Current line.     */
+	size_t cap;     /* Line capacity.    */
+	size_t off;     /* Keyframe offset.  */
+	size_t cur;     /* Line offset.      */
+	uint64_t ev;    /* Keyframe event.   */
+	FILE *index;    /* Index file.       */
+	char *path;     /* Index path.       */
+	int n;
+
+	off = 0;
+
+	/* Index. */
+	path = malloc(sizeof(char) * (strlen(trace) + sizeof(KF_INDEX_EXT)));
+	if (path == NULL)
+		QUIT(EXIT_FAILURE, "out of memory!\n");
+
+	strcpy(path, trace);
+	strcat(path, KF_INDEX_EXT);
+	index = fopen(path, "r");
+	free(path);
+
+	if (index != NULL)
+	{
+		while (fscanf(index, "%d %" SCNu64 " %zu", &n, &ev, &cur) == 3 &&
+			ev <= target)
+		{
+			off = cur;
+		}
+		fclose(index);
+		return (off);
+	}
+
+	/* Keyframe headers. */
+	line = NULL;
+	cap  = 0;
+	cur  = 0;
+	while (getline(&line, &cap, fp) > 0)
+	{
+		if (sscanf(line, "[Keyframe: %d] event: %" SCNu64, &n, &ev) == 2)
+		{
+			if (ev > target)
+				break;
+			off = cur;
+		}
+		cur = (size_t)ftell(fp);
+	}
+	free(line);
+	return (off);
+}
+
+/**
+ * @brief Reconstructs, from a trace, the state of the watched
+ * variables at a given event and prints it to stdout.
+ *
+ * @param arg Trace file and event, as in: trace.txt:1234.
+ */
+void kf_reconstruct(const char *arg)
+{
+	struct kf_entry *e; /* State entry.        */
+	uint64_t target;    /* Event wanted.       */
+	uint64_t events;    /* Events applied.     */
+	uint64_t kf_ev;     /* Keyframe event.     */
+	char *trace;        /* Trace file.         */
+	char *line;         /* Current line.       */
+	size_t cap;         /* Line capacity.      */
+	ssize_t len;        /* Line length.        */
+	const char *colon;  /* Event separator.    */
+	char *s, *end;
+	int depth, kfn, d;
+	FILE *fp;
+
+	if ((colon = strrchr(arg, ':')) == NULL || colon == arg)
+		QUIT(EXIT_FAILURE, "--reconstruct: expected <file>:<event>!\n");
+
+	target = strtoull(colon + 1, &end, 10);
+	if (*end != '\0' || end == colon + 1)
+		QUIT(EXIT_FAILURE, "--reconstruct: invalid event (%s)!\n", colon + 1);
+
+	trace = kf_copy(arg, (size_t)(colon - arg));
+	if ((fp = fopen(trace, "r")) == NULL)
+		QUIT(EXIT_FAILURE, "cannot open %s to read!\n", trace);
+
+	array_init(&kf_entries);
+	hashtable_init(&kf_keys, hashtable_sdbm_setup);
+
+	/* Seek to the nearest keyframe. */
+	if (fseek(fp, (long)kf_find(fp, trace, target), SEEK_SET) < 0)
+		QUIT(EXIT_FAILURE, "%s: invalid keyframes index!\n", trace);
+
+	line   = NULL;
+	cap    = 0;
+	events = 0;
+	kf_ev  = 0;
+	depth  = 0;
+	kfn    = -1;
+
+	while ((len = getline(&line, &cap, fp)) > 0)
+	{
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		for (s = line; *s == ' '; s++);
+
+		/* Keyframe header: full state from now on. */
+		if (sscanf(s, "[Keyframe: %d] event: %" SCNu64 ", depth: %d", &kfn,
+			&kf_ev, &depth) == 3)
+		{
+			if (kf_ev > target)
+				break;
+
+			kf_set_prefix(NULL, NULL);
+			events = kf_ev;
+			continue;
+		}
+
+		if (!strncmp(s, "[Keyframe] ", 11))
+		{
+			s += 11;
+			if (!strncmp(s, "[global] ", 9))
+				kf_apply_keyframe("[global] ", s + 9);
+
+			else if (sscanf(s, "[depth: %d] [local] ", &d) == 1)
+			{
+				char scope[32];
+				snprintf(scope, sizeof(scope), "[depth: %d] [local] ", d);
+				if ((s = strstr(s, "[local] ")) != NULL)
+					kf_apply_keyframe(scope, s + 8);
+			}
+			continue;
+		}
+
+		/* Function entries and returns. */
+		if (sscanf(s, "[depth: %d]", &d) == 1)
+		{
+			if (strstr(s, "Entering function") != NULL)
+				depth = d;
+
+			else if (strstr(s, "Returning to function") != NULL)
+			{
+				char scope[32];
+				snprintf(scope, sizeof(scope), "[depth: %d] ", d);
+				kf_set_prefix(scope, NULL);
+				depth = d - 1;
+			}
+			continue;
+		}
+
+		/*
+		 * Change events: everything up to the next event is applied,
+		 * just like the keyframes, written after the stop.
+		 */
+		if (!strncmp(s, "[Line: ", 7) && (s = strstr(s, "] ")) != NULL)
+		{
+			if (events == target && (!strncmp(s + 2, "[global] (", 10) ||
+				!strncmp(s + 2, "[local] (", 9)))
+			{
+				break;
+			}
+			events += kf_apply_event(s + 2, depth);
+		}
+	}
+
+	if (kfn >= 0)
+		printf("State at event %" PRIu64 " (keyframe %d, at event %" PRIu64
+			", + %" PRIu64 " events):\n", events, kfn, kf_ev, events - kf_ev);
+	else
+		printf("State at event %" PRIu64 " (no keyframe, from the start):\n",
+			events);
+
+	if (events < target)
+		printf("(the trace ends at event %" PRIu64 ")\n", events);
+
+	for (size_t i = 0; i < array_size(&kf_entries); i++)
+	{
+		e = array_get(&kf_entries, i, NULL);
+		if (e->value != NULL)
+			printf("  %s = %s\n", e->key, e->value);
+	}
+
+	for (size_t i = 0; i < array_size(&kf_entries); i++)
+	{
+		e = array_get(&kf_entries, i, NULL);
+		free(e->key);
+		free(e->value);
+		free(e);
+	}
+
+	hashtable_finish(&kf_keys, 0);
+	array_finish(&kf_entries);
+	free(line);
+	free(trace);
+	fclose(fp);
+	fflush(stdout);
+	exit(EXIT_SUCCESS);
+}
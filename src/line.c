@@ -27,6 +27,8 @@
 #include "highlight.h"
 #include "dwarf_helper.h"
 #include "pbd.h"
+#include "bitmap.h"
+#include "strdiff.h"
 #include <ctype.h>
 #include <libgen.h>
 #include <math.h>
@@ -40,10 +42,37 @@ struct array *source_lines_highlighted = NULL;
  *
  * This buffer holds the value from before and
  * after the value is changed for a single
- * TBASE_TYPE, TENUM and TPOINTER.
+ * TBASE_TYPE, TENUM and TPOINTER. Each tracer
+ * thread has its own copy.
  */
-static char before[BS];
-static char after[BS];
+static PBD_TLS char before[BS];
+static PBD_TLS char after[BS];
+
+/* Bits changed, for bitmap variables. */
+static PBD_TLS char bits[BM_BS];
+
+/* Strings before and after, for char arrays. */
+static PBD_TLS char strs[SD_BS];
+
+/**
+ * @brief Formats the bits changed of the bitmap variable @p v.
+ *
+ * @param v Variable analized.
+ * @param v_before Value before, or the old buffer, if array.
+ * @param v_after Value after, or the new buffer, if array.
+ *
+ * @return Returns the formatted bits.
+ */
+static char *line_format_bits(struct dw_variable *v,
+	union var_value *v_before, union var_value *v_after)
+{
+	if (v->type.var_type == TARRAY)
+		return (bm_format(bits, BM_BS, v_before->p_value, v_after->p_value,
+			v->byte_size));
+
+	return (bm_format(bits, BM_BS, v_before->u8_value, v_after->u8_value,
+		v->byte_size));
+}
 
 /* Current function pointer. */
 void (*line_output)(
@@ -323,8 +352,35 @@ void line_default_printer(int depth, unsigned line_no,
 	struct dw_variable *v, union var_value *v_before,
 	union var_value *v_after, int *array_idxs)
 {
+	/* Bitmaps, whole variable at once. */
+	if (v->bitmap)
+	{
+		fn_printf(depth, 0,
+			"[Line: %d] [%s] (%s) %s!, bits: %s\n",
+			line_no,
+			(v->scope == VGLOBAL) ? "global" : "local",
+			v->name,
+			(!v->initialized ? "initialized" : "has changed"),
+			line_format_bits(v, v_before, v_after)
+		);
+	}
+
+	/* Strings, whole array at once. */
+	else if (v->string)
+	{
+		fn_printf(depth, 0,
+			"[Line: %d] [%s] (%s) %s!, %s\n",
+			line_no,
+			(v->scope == VGLOBAL) ? "global" : "local",
+			v->name,
+			(!v->initialized ? "initialized" : "has changed"),
+			sd_format(strs, SD_BS, v_before->p_value, v_after->p_value,
+				v->byte_size)
+		);
+	}
+
 	/* If base type. */
-	if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+	else if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
 	{
 		fn_printf(depth, 0,
 			"[Line: %d] [%s] (%s) %s!, before: %s, after: %s\n",
@@ -441,8 +497,29 @@ void line_detailed_printer(int depth, unsigned line_no,
 		/* Line changed. */
 		fn_printf(depth, 0, "[%s:%d]:%s", base_file_name, line_no, line);
 
+		/* Bitmaps, whole variable at once. */
+		if (v->bitmap)
+		{
+			fn_printf(depth, predicted_offset,
+				"^----- (%s) bits: %s\n",
+				v->name,
+				line_format_bits(v, v_before, v_after)
+			);
+		}
+
+		/* Strings, whole array at once. */
+		else if (v->string)
+		{
+			fn_printf(depth, predicted_offset,
+				"^----- (%s) %s\n",
+				v->name,
+				sd_format(strs, SD_BS, v_before->p_value, v_after->p_value,
+					v->byte_size)
+			);
+		}
+
 		/* If not array, lets proceed normally. */
-		if (v->type.var_type != TARRAY)
+		else if (v->type.var_type != TARRAY)
 		{
 			fn_printf(depth, predicted_offset,
 				"^----- (%s) before: %s, after: %s\n",
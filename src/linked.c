@@ -0,0 +1,887 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "linked.h"
+#include "pbd.h"
+#include "ptrace.h"
+#include "array.h"
+#include "function.h"
+#include "hashtable.h"
+#include "line.h"
+#include "region.h"
+#include "variable.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* Soft-dirty and present/swapped bits, in a pagemap entry. */
+#define PM_SOFT_DIRTY (1ULL << 55)
+#define PM_SWAPPED    (1ULL << 62)
+#define PM_PRESENT    (1ULL << 63)
+
+/* Traversal state. */
+#define LK_OK        0
+#define LK_CYCLE     1
+#define LK_TRUNCATED 2
+#define LK_FAULT     3
+
+/**
+ * @brief Node found in a traversal.
+ */
+struct lk_node
+{
+	uintptr_t addr;     /* Node address.                    */
+	char *cur;          /* Contents, at the last read.      */
+	char *old;          /* Contents, at the previous read.  */
+	unsigned stamp;     /* Last traversal that reached it.  */
+	int pos;            /* Position, in the last traversal. */
+	int fresh;          /* Found at this traversal.         */
+	int reread;         /* Read again at this stop.         */
+	int fault;          /* Unable to read it again.         */
+};
+
+/**
+ * @brief Watched linked structure.
+ */
+struct lk_watch
+{
+	/* Spec. */
+	char *name;                        /* 'root->link', as shown.   */
+	char *root_name;                   /* Root pointer.             */
+	char *link_name;                   /* Link member.              */
+	char *field_names[LK_MAX_FIELDS];  /* Watched members.          */
+	int nfield_names;
+	int max;                           /* Maximum amount of nodes.  */
+
+	/* Debug info. */
+	struct dw_variable *root;          /* Root pointer variable.    */
+	struct array *members;             /* All the members.          */
+	struct dw_member *link;            /* Link member.              */
+	struct dw_member *fields[LK_MAX_FIELDS];
+	int nfields;
+	size_t node_size;                  /* Node (structure) size.    */
+
+	/* Last traversal. */
+	struct lk_node **nodes;            /* Nodes, in order.          */
+	int nnodes;
+	struct hashtable *index;           /* Address -> node.          */
+	unsigned stamp;                    /* Traversal number.         */
+	int state;                         /* LK_* state.               */
+	int initialized;                   /* Baseline already read.    */
+};
+
+/* Watched structures. */
+static struct lk_watch watches[LK_MAX];
+static int nwatches;
+
+/* Soft-dirty support, -1 if not checked yet. */
+static int lk_softdirty = -1;
+static int pagemap_fd = -1;
+static int clear_refs_fd = -1;
+static uint64_t *lk_pagemap;
+static size_t lk_pagemap_size;
+
+/* Bulk read staging buffer. */
+static char *lk_staging;
+static size_t lk_staging_size;
+
+/**
+ * @brief Duplicates the first @p len characters of @p str.
+ *
+ * @param str String to be duplicated.
+ * @param len String length.
+ *
+ * @return Returns the new string.
+ */
+static char *lk_strndup(const char *str, size_t len)
+{
+	char *s;
+	if ((s = malloc(sizeof(char) * (len + 1))) == NULL)
+		return (NULL);
+
+	memcpy(s, str, len);
+	s[len] = '\0';
+	return (s);
+}
+
+/**
+ * @brief Reads an identifier from @p p.
+ *
+ * @param p String.
+ *
+ * @return Returns the identifier length.
+ */
+static size_t lk_ident(const char *p)
+{
+	size_t len;
+	for (len = 0; isalnum((unsigned char)p[len]) || p[len] == '_'; len++);
+	return (len);
+}
+
+/**
+ * @brief Adds a linked structure to be watched, from a spec
+ * like: root->link*{member1,member2}:max=N, where the members
+ * and max are optional.
+ *
+ * @param spec Watch spec.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int lk_add(const char *spec)
+{
+	struct lk_watch *w; /* New watch.         */
+	const char *p;      /* Current position.  */
+	size_t len;         /* Identifier length. */
+	char *end;          /* Number end.        */
+	long max;           /* Maximum nodes.     */
+
+	if (nwatches == LK_MAX)
+	{
+		fprintf(stderr, "PBD: --watch-linked: too many structures (max: %d)\n",
+			LK_MAX);
+		return (-1);
+	}
+
+	w = &watches[nwatches];
+	memset(w, 0, sizeof(*w));
+	w->max = LK_DEFAULT_MAX;
+	p = spec;
+
+	/* root->link*. */
+	if (!(len = lk_ident(p)))
+		goto err;
+	w->root_name = lk_strndup(p, len);
+	p += len;
+
+	if (strncmp(p, "->", 2))
+		goto err;
+	p += 2;
+
+	if (!(len = lk_ident(p)) || p[len] != '*')
+		goto err;
+	w->link_name = lk_strndup(p, len);
+	p += len + 1;
+
+	/* {members}. */
+	if (*p == '{')
+	{
+		do
+		{
+			p++;
+			if (!(len = lk_ident(p)) || w->nfield_names == LK_MAX_FIELDS)
+				goto err;
+			w->field_names[w->nfield_names++] = lk_strndup(p, len);
+			p += len;
+		} while (*p == ',');
+
+		if (*p++ != '}')
+			goto err;
+	}
+
+	/* :max=N. */
+	if (!strncmp(p, ":max=", 5))
+	{
+		max = strtol(p + 5, &end, 10);
+		if (end == p + 5 || max <= 0 || max > INT32_MAX)
+			goto err;
+		w->max = (int)max;
+		p = end;
+	}
+
+	if (*p != '\0')
+		goto err;
+
+	w->name = lk_strndup(spec, strlen(w->root_name) + 2 +
+		strlen(w->link_name));
+
+	nwatches++;
+	return (0);
+err:
+	fprintf(stderr, "PBD: --watch-linked: invalid spec (%s), expected:\n"
+		"  root->link*{member1,member2,...}:max=N\n", spec);
+
+	free(w->root_name);
+	free(w->link_name);
+	for (int i = 0; i < w->nfield_names; i++)
+		free(w->field_names[i]);
+	memset(w, 0, sizeof(*w));
+	return (-1);
+}
+
+/**
+ * @brief Finds the member @p name of the watch @p w.
+ *
+ * @param w Linked structure watch.
+ * @param name Member name.
+ *
+ * @return Returns the member or NULL if not found.
+ */
+static struct dw_member *lk_member(struct lk_watch *w, const char *name)
+{
+	struct dw_member *m;
+	for (size_t i = 0; i < array_size(&w->members); i++)
+	{
+		m = array_get(&w->members, i, NULL);
+		if (!strcmp(m->name, name))
+			return (m);
+	}
+	return (NULL);
+}
+
+/**
+ * @brief Resolves, from the debug info, the root pointer and
+ * the members of all the watched structures.
+ *
+ * @param dw Dwarf Utils structure, already pointing to the
+ * target function.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int lk_resolve(struct dw_utils *dw)
+{
+	struct lk_watch *w;  /* Current watch.  */
+	struct dw_member *m; /* Current member. */
+
+	for (int i = 0; i < nwatches; i++)
+	{
+		w = &watches[i];
+		w->root = dw_get_struct_pointer(dw, w->root_name, &w->members,
+			&w->node_size);
+
+		if (w->root == NULL)
+		{
+			fprintf(stderr, "PBD: --watch-linked: %s is not a pointer to a "
+				"structure!\n", w->root_name);
+			return (-1);
+		}
+
+		w->link = lk_member(w, w->link_name);
+		if (w->link == NULL || w->link->var_type != TPOINTER)
+		{
+			fprintf(stderr, "PBD: --watch-linked: %s is not a pointer member "
+				"of %s!\n", w->link_name, w->root_name);
+			return (-1);
+		}
+
+		/* All the members but the link, if none given. */
+		if (!w->nfield_names)
+		{
+			for (size_t j = 0; j < array_size(&w->members) &&
+				w->nfields < LK_MAX_FIELDS; j++)
+			{
+				m = array_get(&w->members, j, NULL);
+				if (m != w->link)
+					w->fields[w->nfields++] = m;
+			}
+			continue;
+		}
+
+		for (int j = 0; j < w->nfield_names; j++)
+		{
+			if ((m = lk_member(w, w->field_names[j])) == NULL)
+			{
+				fprintf(stderr, "PBD: --watch-linked: member %s not found in "
+					"%s!\n", w->field_names[j], w->root_name);
+				return (-1);
+			}
+			w->fields[w->nfields++] = m;
+		}
+	}
+	return (0);
+}
+
+/**
+ * @brief Enables the soft-dirty bits for the child @p child, if
+ * the kernel supports them.
+ *
+ * The bits are shared with the region watch, which also clears
+ * them at every stop, so they are not used together.
+ *
+ * @param child Child process.
+ */
+static void lk_softdirty_open(pid_t child)
+{
+	char path[64];
+
+	lk_softdirty = 0;
+	if ((args.flags & FLG_WATCH_REGION) || !rg_softdirty_supported())
+		return;
+
+	snprintf(path, sizeof path, "/proc/%d/pagemap", (int)child);
+	pagemap_fd = open(path, O_RDONLY);
+	snprintf(path, sizeof path, "/proc/%d/clear_refs", (int)child);
+	clear_refs_fd = open(path, O_WRONLY);
+
+	if (pagemap_fd < 0 || clear_refs_fd < 0 ||
+		write(clear_refs_fd, "4", 1) != 1)
+	{
+		if (pagemap_fd >= 0)
+			close(pagemap_fd);
+		if (clear_refs_fd >= 0)
+			close(clear_refs_fd);
+		pagemap_fd = clear_refs_fd = -1;
+		return;
+	}
+	lk_softdirty = 1;
+}
+
+/**
+ * @brief Marks the nodes of the last traversal of @p w to be
+ * read again: all of them or, with soft-dirty, the ones whose
+ * pages were written since the last stop.
+ *
+ * @param w Linked structure watch.
+ */
+static void lk_mark_dirty(struct lk_watch *w)
+{
+	uintptr_t first, last; /* Pages span.     */
+	uintptr_t p1, p2;      /* Node pages.     */
+	uint64_t *entries;     /* Pagemap span.   */
+	long page_size;        /* Page size.      */
+	size_t npages;         /* Pages in span.  */
+	ssize_t len;           /* Bytes read.     */
+
+	for (int i = 0; i < w->nnodes; i++)
+		w->nodes[i]->reread = 1;
+
+	if (!lk_softdirty || !w->nnodes)
+		return;
+
+	/* Nodes span, read at once. */
+	page_size = sysconf(_SC_PAGESIZE);
+	first = UINTPTR_MAX;
+	last  = 0;
+	for (int i = 0; i < w->nnodes; i++)
+	{
+		p1 = w->nodes[i]->addr / page_size;
+		p2 = (w->nodes[i]->addr + w->node_size - 1) / page_size;
+		first = (p1 < first) ? p1 : first;
+		last  = (p2 > last)  ? p2 : last;
+	}
+
+	npages = last - first + 1;
+	if (npages > LK_PAGEMAP_MAX)
+		return;
+
+	if (npages > lk_pagemap_size)
+	{
+		if ((entries = realloc(lk_pagemap, sizeof(uint64_t) * npages)) == NULL)
+			return;
+		lk_pagemap = entries;
+		lk_pagemap_size = npages;
+	}
+
+	len = pread(pagemap_fd, lk_pagemap, sizeof(uint64_t) * npages,
+		first * sizeof(uint64_t));
+	if (len != (ssize_t)(sizeof(uint64_t) * npages))
+		return;
+
+	/* Pages neither present nor swapped are read again, and fail. */
+	for (int i = 0; i < w->nnodes; i++)
+	{
+		struct lk_node *n = w->nodes[i];
+		n->reread = 0;
+
+		p1 = n->addr / page_size - first;
+		p2 = (n->addr + w->node_size - 1) / page_size - first;
+		for (uintptr_t p = p1; p <= p2; p++)
+		{
+			if ((lk_pagemap[p] & PM_SOFT_DIRTY) ||
+				!(lk_pagemap[p] & (PM_PRESENT|PM_SWAPPED)))
+			{
+				n->reread = 1;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Reads again, in bulk, the nodes of the last traversal
+ * marked by lk_mark_dirty(). The previous contents are kept, to
+ * be compared.
+ *
+ * @param w Linked structure watch.
+ * @param child Child process.
+ */
+static void lk_refresh(struct lk_watch *w, pid_t child)
+{
+	struct iovec remote[LK_IOV_MAX]; /* Nodes to be read. */
+	struct lk_node *batch[LK_IOV_MAX];
+	struct lk_node *n;               /* Current node.     */
+	size_t needed;                   /* Staging size.     */
+	ssize_t ret;                     /* Bytes read.       */
+	char *tmp;                       /* Swap buffer.      */
+	int count;                       /* Batch size.       */
+	int done;                        /* Nodes read.       */
+	int i;                           /* Node index.       */
+
+	needed = w->node_size * LK_IOV_MAX;
+	if (needed > lk_staging_size)
+	{
+		if ((tmp = realloc(lk_staging, needed)) == NULL)
+			return;
+		lk_staging = tmp;
+		lk_staging_size = needed;
+	}
+
+	i = 0;
+	while (i < w->nnodes)
+	{
+		/* Next batch. */
+		for (count = 0; i < w->nnodes && count < LK_IOV_MAX; i++)
+		{
+			n = w->nodes[i];
+			n->fault = 0;
+			if (!n->reread)
+				continue;
+
+			remote[count].iov_base = (void *)n->addr;
+			remote[count].iov_len  = w->node_size;
+			batch[count++] = n;
+		}
+
+		/*
+		 * A partial read stops at the first node that could not
+		 * be read: it is marked and the remaining are read again.
+		 */
+		done = 0;
+		while (done < count)
+		{
+			ret = pt_readmemory_iov(child, remote + done, count - done,
+				lk_staging);
+			if (ret < 0)
+				ret = 0;
+
+			for (int j = 0; j < (int)(ret / w->node_size); j++)
+			{
+				n = batch[done + j];
+				tmp = n->old;
+				n->old = n->cur;
+				n->cur = tmp;
+				memcpy(n->cur, lk_staging + j * w->node_size, w->node_size);
+			}
+
+			done += ret / w->node_size;
+			if (done < count)
+				batch[done++]->fault = 1;
+		}
+	}
+}
+
+/**
+ * @brief Allocates a new node for the address @p addr and reads
+ * its contents.
+ *
+ * @param w Linked structure watch.
+ * @param child Child process.
+ * @param addr Node address.
+ *
+ * @return Returns the new node or NULL if the node could not
+ * be read.
+ */
+static struct lk_node *lk_node_new(struct lk_watch *w, pid_t child,
+	uintptr_t addr)
+{
+	struct lk_node *n;
+
+	if ((n = calloc(1, sizeof(struct lk_node))) == NULL)
+		return (NULL);
+
+	n->addr = addr;
+	n->cur  = malloc(w->node_size);
+	n->old  = malloc(w->node_size);
+
+	if (!n->cur || !n->old ||
+		pt_readmemory_buf(child, addr, n->cur, w->node_size) < 0)
+	{
+		free(n->cur);
+		free(n->old);
+		free(n);
+		return (NULL);
+	}
+
+	n->fresh = 1;
+	return (n);
+}
+
+/**
+ * @brief Deallocates the node @p n.
+ *
+ * @param n Node to be freed.
+ */
+static void lk_node_free(struct lk_node *n)
+{
+	free(n->cur);
+	free(n->old);
+	free(n);
+}
+
+/**
+ * @brief Reads the member @p m of the node contents @p data.
+ *
+ * @param m Member.
+ * @param data Node contents.
+ * @param value Member value.
+ */
+static inline void lk_member_value(struct dw_member *m, const char *data,
+	union var_value *value)
+{
+	memset(value, 0, sizeof(*value));
+	memcpy(value->u8_value, data + m->offset,
+		m->byte_size < sizeof(value->u8_value) ?
+		m->byte_size : sizeof(value->u8_value));
+}
+
+/**
+ * @brief Prints the watched members of the node contents
+ * @p data, as in: ', member1: value1, member2: value2'.
+ *
+ * @param w Linked structure watch.
+ * @param data Node contents.
+ */
+static void lk_print_members(struct lk_watch *w, const char *data)
+{
+	union var_value value; /* Member value. */
+	char buf[BS];          /* Formatted.    */
+
+	for (int i = 0; i < w->nfields; i++)
+	{
+		lk_member_value(w->fields[i], data, &value);
+		fprintf(pbd_output, ", %s: %s", w->fields[i]->name,
+			var_format_value(buf, &value, w->fields[i]->encoding,
+				w->fields[i]->byte_size));
+	}
+	fputc('\n', pbd_output);
+}
+
+/**
+ * @brief Compares the watched members of the node @p n, between
+ * its previous and current contents.
+ *
+ * @param w Linked structure watch.
+ * @param n Node.
+ * @param pos Node position.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns the amount of members changed.
+ */
+static int lk_diff_node(struct lk_watch *w, struct lk_node *n, int pos,
+	unsigned line_no, int depth)
+{
+	union var_value value1; /* Before.    */
+	union var_value value2; /* After.     */
+	char before[BS];        /* Formatted. */
+	char after[BS];         /* Formatted. */
+	struct dw_member *m;    /* Member.    */
+	int changes;
+
+	changes = 0;
+	for (int i = 0; i < w->nfields; i++)
+	{
+		m = w->fields[i];
+		if (!memcmp(n->old + m->offset, n->cur + m->offset, m->byte_size))
+			continue;
+
+		lk_member_value(m, n->old, &value1);
+		lk_member_value(m, n->cur, &value2);
+
+		fn_printf(depth, 0,
+			"[Line: %d] [linked] (%s[%d].%s) has changed!, "
+			"before: %s, after: %s\n",
+			line_no, w->name, pos, m->name,
+			var_format_value(before, &value1, m->encoding, m->byte_size),
+			var_format_value(after,  &value2, m->encoding, m->byte_size)
+		);
+		changes++;
+	}
+	return (changes);
+}
+
+/**
+ * @brief Reports the traversal state @p state of the watch
+ * @p w, if it has changed.
+ *
+ * @return Returns 1 if reported, 0 otherwise.
+ */
+static int lk_report_state(struct lk_watch *w, int state, int nnodes,
+	uintptr_t addr, unsigned line_no, int depth)
+{
+	if (state == w->state)
+		return (0);
+
+	if (state == LK_CYCLE)
+		fn_printf(depth, 0, "[Line: %d] [linked] (%s) cycle found!, node %d "
+			"points back to 0x%" PRIxPTR "\n", line_no, w->name, nnodes - 1,
+			addr);
+	else if (state == LK_TRUNCATED)
+		fn_printf(depth, 0, "[Line: %d] [linked] (%s) truncated!, more than "
+			"%d nodes\n", line_no, w->name, w->max);
+	else if (state == LK_FAULT)
+		fn_printf(depth, 0, "[Line: %d] [linked] (%s[%d]) unreadable!, "
+			"address: 0x%" PRIxPTR "\n", line_no, w->name, nnodes, addr);
+	else
+		fn_printf(depth, 0, "[Line: %d] [linked] (%s) ends normally now, "
+			"%d nodes\n", line_no, w->name, nnodes);
+
+	return (1);
+}
+
+/**
+ * @brief Traverses the linked structure @p w and compares it
+ * with the previous traversal.
+ *
+ * @param w Linked structure watch.
+ * @param child Child process.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns the amount of changes found.
+ */
+static int lk_check(struct lk_watch *w, pid_t child, unsigned line_no,
+	int depth)
+{
+	struct lk_node **nodes;  /* New traversal.      */
+	struct lk_node **tmp;    /* Reallocated nodes.  */
+	struct hashtable *index; /* New address index.  */
+	struct lk_node *n;       /* Current node.       */
+	union var_value value;   /* Root value.         */
+	uintptr_t addr;          /* Next node address.  */
+	int report;              /* Report the changes. */
+	int changes;             /* Changes found.      */
+	int nnodes;              /* Nodes found.        */
+	int capacity;            /* Nodes allocated.    */
+	int state;               /* Traversal state.    */
+
+	report   = w->initialized;
+	changes  = 0;
+	nnodes   = 0;
+	state    = LK_OK;
+	capacity = w->nnodes + 16;
+
+	if ((nodes = malloc(sizeof(struct lk_node *) * capacity)) == NULL ||
+		hashtable_init(&index, NULL) < 0)
+	{
+		free(nodes);
+		return (0);
+	}
+
+	/* Known nodes, in bulk. */
+	lk_mark_dirty(w);
+	lk_refresh(w, child);
+
+	w->stamp++;
+	memset(&value, 0, sizeof(value));
+	if (var_read(&value, w->root, child))
+		addr = 0;
+	else
+		addr = (uintptr_t)value.u64_value[0];
+
+	/* Walk. */
+	while (addr)
+	{
+		if (nnodes == w->max)
+		{
+			state = LK_TRUNCATED;
+			break;
+		}
+
+		if (hashtable_get(&index, (void *)addr) != NULL)
+		{
+			state = LK_CYCLE;
+			break;
+		}
+
+		if (nnodes == capacity)
+		{
+			if ((tmp = realloc(nodes, sizeof(struct lk_node *) *
+				capacity * 2)) == NULL)
+			{
+				state = LK_TRUNCATED;
+				break;
+			}
+			nodes = tmp;
+			capacity *= 2;
+		}
+
+		n = (w->index != NULL) ? hashtable_get(&w->index, (void *)addr) : NULL;
+		if (n == NULL)
+			n = lk_node_new(w, child, addr);
+
+		if (n == NULL || n->fault)
+		{
+			state = LK_FAULT;
+			break;
+		}
+
+		n->stamp = w->stamp;
+		nodes[nnodes++] = n;
+		hashtable_add(&index, (void *)addr, n);
+
+		addr = 0;
+		memcpy(&addr, n->cur + w->link->offset,
+			w->link->byte_size < sizeof(addr) ? w->link->byte_size : sizeof(addr));
+	}
+
+	/* Removed nodes. */
+	for (int i = 0; i < w->nnodes; i++)
+	{
+		n = w->nodes[i];
+		if (n->stamp == w->stamp)
+			continue;
+
+		if (report)
+		{
+			fn_printf(depth, 0, "[Line: %d] [linked] (%s[%d]) removed!",
+				line_no, w->name, n->pos);
+			lk_print_members(w, n->cur);
+			changes++;
+		}
+		lk_node_free(n);
+	}
+
+	/* Inserted and modified nodes. */
+	for (int i = 0; i < nnodes; i++)
+	{
+		n = nodes[i];
+		if (report && n->fresh)
+		{
+			fn_printf(depth, 0, "[Line: %d] [linked] (%s[%d]) inserted!",
+				line_no, w->name, i);
+			lk_print_members(w, n->cur);
+			changes++;
+		}
+		else if (report && n->reread)
+			changes += lk_diff_node(w, n, i, line_no, depth);
+
+		n->pos    = i;
+		n->fresh  = 0;
+		n->reread = 0;
+	}
+
+	if (report)
+		changes += lk_report_state(w, state, nnodes, addr, line_no, depth);
+
+	/* Keep the new traversal. */
+	free(w->nodes);
+	if (w->index != NULL)
+		hashtable_finish(&w->index, 0);
+
+	w->nodes  = nodes;
+	w->nnodes = nnodes;
+	w->index  = index;
+	w->state  = state;
+	w->initialized = 1;
+	return (changes);
+}
+
+/**
+ * @brief Checks if there is a change for all the watched
+ * linked structures, if so, exhibits the nodes inserted,
+ * removed and modified.
+ *
+ * The first check only reads the structures, as the baseline
+ * for the next ones.
+ *
+ * @param child Child process.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns the amount of changes found.
+ */
+int lk_check_changes(pid_t child, unsigned line_no, int depth)
+{
+	int changes;
+
+	if (lk_softdirty < 0)
+		lk_softdirty_open(child);
+
+	changes = 0;
+	for (int i = 0; i < nwatches; i++)
+		changes += lk_check(&watches[i], child, line_no, depth);
+
+	/* Pages written from now on. */
+	if (lk_softdirty && write(clear_refs_fd, "4", 1) != 1)
+	{
+		fprintf(stderr, "PBD: unable to clear soft-dirty bits (%s), "
+			"reading all the nodes from now on\n", strerror(errno));
+		lk_softdirty = 0;
+	}
+
+	return (changes);
+}
+
+/**
+ * @brief Releases all the linked structure watches.
+ */
+void lk_finish(void)
+{
+	struct lk_watch *w;
+
+	for (int i = 0; i < nwatches; i++)
+	{
+		w = &watches[i];
+		for (int j = 0; j < w->nnodes; j++)
+			lk_node_free(w->nodes[j]);
+
+		if (w->index != NULL)
+			hashtable_finish(&w->index, 0);
+
+		if (w->root != NULL)
+		{
+			free(w->root->name);
+			free(w->root);
+		}
+
+		for (int j = 0; j < w->nfield_names; j++)
+			free(w->field_names[j]);
+
+		dw_members_free(w->members);
+		free(w->nodes);
+		free(w->name);
+		free(w->root_name);
+		free(w->link_name);
+	}
+
+	if (pagemap_fd >= 0)
+		close(pagemap_fd);
+	if (clear_refs_fd >= 0)
+		close(clear_refs_fd);
+
+	free(lk_pagemap);
+	free(lk_staging);
+	nwatches = 0;
+	lk_softdirty = -1;
+	pagemap_fd = clear_refs_fd = -1;
+	lk_pagemap = NULL;
+	lk_staging = NULL;
+	lk_pagemap_size = lk_staging_size = 0;
+}
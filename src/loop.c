@@ -0,0 +1,676 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "loop.h"
+#include "pbd.h"
+#include "elf_helper.h"
+#include "function.h"
+#include "insn.h"
+#include "line.h"
+#include "variable.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Loop found in the analyzed function.
+ */
+struct lp_loop
+{
+	uintptr_t start;     /* First address.                 */
+	uintptr_t end;       /* Last address, exclusive.       */
+	uintptr_t head;      /* First line address, per iter.  */
+	unsigned first_line; /* Lowest line number.            */
+	unsigned last_line;  /* Highest line number.           */
+};
+
+/**
+ * Loop being executed, per function depth.
+ */
+struct lp_state
+{
+	int loop;                  /* Loop index, or -1 if none.  */
+	unsigned long iterations;  /* Amount of iterations.       */
+	struct array *vars;        /* Variables of the context.   */
+	union var_value *before;   /* Values at the loop entry.   */
+	int *changes;              /* Amount of changes, per var. */
+	FILE *first;               /* First iteration output.     */
+	char *first_buf;
+	size_t first_size;
+	FILE *last;                /* Last iteration output.      */
+	char *last_buf;
+	size_t last_size;
+};
+
+/* Loops found. */
+static struct lp_loop *lp_loops;
+static int lp_nloops;
+
+/* Loop states, indexed by depth. */
+static struct lp_state *lp_states;
+static int lp_nstates;
+
+/* Keep the first and last iterations. */
+static int lp_detail;
+
+/* Value buffers. */
+static char lp_before[BS];
+static char lp_after[BS];
+
+/**
+ * @brief Compares two loops accordingly with their first
+ * address.
+ *
+ * @param a First loop.
+ * @param b Second loop.
+ *
+ * @return Returns a negative, zero or positive number if
+ * the first loop starts before, at or after the second one.
+ */
+static int lp_cmp(const void *a, const void *b)
+{
+	const struct lp_loop *l1 = a;
+	const struct lp_loop *l2 = b;
+
+	if (l1->start != l2->start)
+		return (l1->start < l2->start ? -1 : 1);
+	return (0);
+}
+
+/**
+ * @brief Finds the back-edges of the code @p code, loaded at
+ * @p addr, and adds one loop per back-edge found.
+ *
+ * @param code Function code.
+ * @param size Code size.
+ * @param addr Function address.
+ * @param mode Decoding mode.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int lp_find_back_edges(const uint8_t *code, size_t size,
+	uintptr_t addr, int mode)
+{
+	struct lp_loop *loops; /* Reallocated loops. */
+	struct insn insn;      /* Instruction.       */
+	size_t off;            /* Code offset.       */
+
+	off = 0;
+	while (off < size)
+	{
+		/* Unknown instruction, resync at the next byte. */
+		if (insn_decode(code + off, size - off, addr + off, mode, &insn) < 0)
+		{
+			off++;
+			continue;
+		}
+		off += insn.length;
+
+		/* Relative jumps to a previous address. */
+		if (!(insn.flags & INSN_RELATIVE) || (insn.flags & INSN_CALL) ||
+			insn.target < addr || insn.target > insn.addr)
+		{
+			continue;
+		}
+
+		loops = realloc(lp_loops, sizeof(struct lp_loop) * (lp_nloops + 1));
+		if (loops == NULL)
+			return (-1);
+
+		lp_loops = loops;
+		lp_loops[lp_nloops].start = insn.target;
+		lp_loops[lp_nloops].end   = insn.addr + insn.length;
+		lp_nloops++;
+	}
+	return (0);
+}
+
+/**
+ * @brief Merges the overlapping loops, so only the outermost
+ * loops remain, and sets the lines of each loop. Loops without
+ * lines are discarded.
+ *
+ * @param lines Lines list.
+ */
+static void lp_merge(struct array *lines)
+{
+	struct dw_line *l; /* Current line.     */
+	int n;             /* Loops remaining.  */
+
+	qsort(lp_loops, lp_nloops, sizeof(struct lp_loop), lp_cmp);
+
+	/* Outermost loops. */
+	n = 0;
+	for (int i = 0; i < lp_nloops; i++)
+	{
+		if (n > 0 && lp_loops[i].start < lp_loops[n - 1].end)
+		{
+			if (lp_loops[i].end > lp_loops[n - 1].end)
+				lp_loops[n - 1].end = lp_loops[i].end;
+			continue;
+		}
+		lp_loops[n++] = lp_loops[i];
+	}
+
+	/* Lines of each loop. */
+	lp_nloops = 0;
+	for (int i = 0; i < n; i++)
+	{
+		struct lp_loop *lp = &lp_loops[i];
+		lp->head       = 0;
+		lp->first_line = 0;
+		lp->last_line  = 0;
+
+		for (size_t j = 0; j < array_size(&lines); j++)
+		{
+			l = array_get(&lines, j, NULL);
+			if (l->addr < lp->start || l->addr >= lp->end)
+				continue;
+
+			if (!lp->head || l->addr < lp->head)
+				lp->head = l->addr;
+			if (!lp->first_line || l->line_no < lp->first_line)
+				lp->first_line = l->line_no;
+			if (l->line_no > lp->last_line)
+				lp->last_line = l->line_no;
+		}
+
+		if (lp->head)
+			lp_loops[lp_nloops++] = *lp;
+	}
+}
+
+/**
+ * @brief Finds all the loops of the function @p func.
+ *
+ * The loops are identified by their back-edges, i.e: the
+ * relative jumps to a previous address of the function. Each
+ * loop spans from the back-edge target to the back-edge, and
+ * its first line (the lowest line address of the loop) is
+ * executed once per iteration.
+ *
+ * @param file Executable file.
+ * @param func Analyzed function.
+ * @param lines Lines list.
+ * @param detail If not zero, the first and last iterations
+ *        of each loop execution are also shown.
+ *
+ * @return Returns the amount of loops found or a negative
+ * number if error.
+ */
+int lp_init(const char *file, struct dw_function *func,
+	struct array *lines, int detail)
+{
+	struct elf_file ef; /* Executable.     */
+	uint8_t *code;      /* Function code.  */
+	size_t size;        /* Code size.      */
+	int mode;           /* Decoding mode.  */
+	int ret;            /* Return code.    */
+
+	lp_detail = detail;
+	size = func->high_pc - func->low_pc + 1;
+
+	if (elf_open(&ef, file) < 0)
+	{
+		fprintf(stderr, "PBD: --loop-summary: unable to read %s\n", file);
+		return (-1);
+	}
+
+	if ((code = malloc(size)) == NULL ||
+		elf_read_vaddr(&ef, func->low_pc, code, size) < 0)
+	{
+		fprintf(stderr, "PBD: --loop-summary: unable to read the function"
+			" code!\n");
+		elf_close(&ef);
+		free(code);
+		return (-1);
+	}
+
+	mode = (ef.elf_class == ELFCLASS64) ? INSN_MODE64 : INSN_MODE32;
+	elf_close(&ef);
+
+	ret = lp_find_back_edges(code, size, func->low_pc, mode);
+	free(code);
+
+	if (ret < 0)
+		return (-1);
+
+	lp_merge(lines);
+	return (lp_nloops);
+}
+
+/**
+ * @brief Finds the loop that contains the address @p addr.
+ *
+ * @param addr Address to be found.
+ *
+ * @return Returns the loop index or -1 if not in a loop.
+ */
+static int lp_find(uintptr_t addr)
+{
+	for (int i = 0; i < lp_nloops; i++)
+		if (addr >= lp_loops[i].start && addr < lp_loops[i].end)
+			return (i);
+	return (-1);
+}
+
+/**
+ * @brief Gets the loop state of the depth @p depth, allocating
+ * it if needed.
+ *
+ * @param depth Function depth.
+ *
+ * @return Returns the state or NULL if error.
+ */
+static struct lp_state *lp_get_state(int depth)
+{
+	struct lp_state *states;
+
+	if (depth < lp_nstates)
+		return (&lp_states[depth]);
+
+	states = realloc(lp_states, sizeof(struct lp_state) * (depth + 1));
+	if (states == NULL)
+		return (NULL);
+
+	lp_states = states;
+	memset(lp_states + lp_nstates, 0,
+		sizeof(struct lp_state) * (depth + 1 - lp_nstates));
+
+	for (int i = lp_nstates; i <= depth; i++)
+		lp_states[i].loop = -1;
+
+	lp_nstates = depth + 1;
+	return (&lp_states[depth]);
+}
+
+/**
+ * @brief Starts the loop @p loop: the current value of each
+ * variable of @p vars is saved, to be compared when the loop
+ * exits.
+ *
+ * @param s Loop state.
+ * @param loop Loop index.
+ * @param vars Variables list, for current context.
+ */
+static void lp_begin(struct lp_state *s, int loop, struct array *vars)
+{
+	struct dw_variable *v; /* Current variable. */
+	size_t nvars;          /* Variables amount. */
+
+	nvars        = array_size(&vars);
+	s->loop      = loop;
+	s->vars      = vars;
+	s->iterations = 0;
+	s->before    = calloc(nvars + 1, sizeof(union var_value));
+	s->changes   = calloc(nvars + 1, sizeof(int));
+
+	for (size_t i = 0; i < nvars && s->before; i++)
+	{
+		v = array_get(&vars, i, NULL);
+
+		if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+		{
+			s->before[i] = v->initialized ? v->value : v->scratch_value;
+			continue;
+		}
+
+		if (v->type.var_type != TARRAY || v->value.p_value == NULL)
+			continue;
+
+		if ((s->before[i].p_value = malloc(v->byte_size)) != NULL)
+			memcpy(s->before[i].p_value, v->value.p_value, v->byte_size);
+	}
+
+	if (lp_detail)
+		s->first = open_memstream(&s->first_buf, &s->first_size);
+}
+
+/**
+ * @brief Finishes the iteration output @p f, if any.
+ */
+static void lp_close_output(FILE **f)
+{
+	if (*f == NULL)
+		return;
+
+	fclose(*f);
+	*f = NULL;
+}
+
+/**
+ * @brief Releases the loop state @p s, without reporting it.
+ *
+ * @param s Loop state.
+ */
+static void lp_release(struct lp_state *s)
+{
+	struct dw_variable *v; /* Current variable. */
+
+	lp_close_output(&s->first);
+	lp_close_output(&s->last);
+
+	for (size_t i = 0; i < array_size(&s->vars) && s->before; i++)
+	{
+		v = array_get(&s->vars, i, NULL);
+		if (v->type.var_type == TARRAY)
+			free(s->before[i].p_value);
+	}
+
+	free(s->before);
+	free(s->changes);
+	free(s->first_buf);
+	free(s->last_buf);
+	memset(s, 0, sizeof(*s));
+	s->loop = -1;
+}
+
+/**
+ * @brief Prints the elements of the array @p v changed since
+ * the loop entry, up to LP_MAX_ELEMENTS.
+ *
+ * @param v Array variable.
+ * @param old Array contents at the loop entry.
+ * @param depth Function depth.
+ */
+static void lp_print_elements(struct dw_variable *v, char *old, int depth)
+{
+	union var_value value1;  /* Element before.    */
+	union var_value value2;  /* Element after.     */
+	size_t size_per_element; /* Element size.      */
+	int64_t byte_offset;     /* Difference offset. */
+	size_t off;              /* Current offset.    */
+	int printed;             /* Elements printed.  */
+	int remaining;           /* Elements left.     */
+	int idx;                 /* Element index.     */
+	int dim_idx[MATRIX_MAX_DIMENSIONS];
+
+	size_per_element = v->type.array.size_per_element;
+	printed   = 0;
+	remaining = 0;
+	off       = 0;
+
+	while (off < v->byte_size && (byte_offset = offmemcmp(old + off,
+		v->value.p_value + off, size_per_element, v->byte_size - off)) >= 0)
+	{
+		off += byte_offset;
+
+		if (printed == LP_MAX_ELEMENTS)
+		{
+			remaining++;
+			off += size_per_element;
+			continue;
+		}
+
+		memcpy(value1.u8_value, old + off, size_per_element);
+		memcpy(value2.u8_value, v->value.p_value + off, size_per_element);
+
+		/* Indexes, the last dimension varies faster. */
+		idx = off / size_per_element;
+		for (int j = v->type.array.dimensions - 1; j >= 0; j--)
+		{
+			dim_idx[j] = idx % v->type.array.elements_per_dimension[j];
+			idx /= v->type.array.elements_per_dimension[j];
+		}
+
+		fn_printf(depth, FUNCTION_INDENT_LEVEL * 2, "(%s", v->name);
+		for (int j = 0; j < v->type.array.dimensions; j++)
+			fprintf(pbd_output, "[%d]", dim_idx[j]);
+
+		fprintf(pbd_output, ") before: %s, after: %s\n",
+			var_format_value(lp_before, &value1, v->type.encoding,
+				size_per_element),
+			var_format_value(lp_after, &value2, v->type.encoding,
+				size_per_element)
+		);
+
+		printed++;
+		off += size_per_element;
+	}
+
+	if (remaining)
+		fn_printf(depth, FUNCTION_INDENT_LEVEL * 2, "... %d more\n", remaining);
+}
+
+/**
+ * @brief Ends the loop being executed at the depth @p depth,
+ * if any, and emits its record: the amount of iterations and,
+ * for each variable changed inside the loop, the amount of
+ * changes and its values at the loop entry and exit.
+ *
+ * @param depth Function depth.
+ */
+void lp_end(int depth)
+{
+	struct dw_variable *v; /* Current variable.  */
+	struct lp_state *s;    /* Loop state.        */
+	struct lp_loop *lp;    /* Loop.              */
+	size_t nvars;          /* Variables amount.  */
+	int changed;           /* Variables changed. */
+
+	if (depth < 0 || depth >= lp_nstates || lp_states[depth].loop < 0)
+		return;
+
+	s     = &lp_states[depth];
+	lp    = &lp_loops[s->loop];
+	nvars = array_size(&s->vars);
+
+	lp_close_output(&s->first);
+	lp_close_output(&s->last);
+
+	changed = 0;
+	for (size_t i = 0; i < nvars; i++)
+		changed += (s->changes && s->changes[i] > 0);
+
+	fn_printf(depth, 0,
+		"[Loop: lines %u-%u] %lu iterations, %d variables changed\n",
+		lp->first_line, lp->last_line, s->iterations, changed);
+
+	for (size_t i = 0; i < nvars && changed; i++)
+	{
+		if (!s->changes[i])
+			continue;
+
+		v = array_get(&s->vars, i, NULL);
+
+		if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+		{
+			fn_printf(depth, FUNCTION_INDENT_LEVEL,
+				"[%s] (%s) changed %d times, before: %s, after: %s\n",
+				(v->scope == VGLOBAL) ? "global" : "local",
+				v->name,
+				s->changes[i],
+				var_format_value(lp_before, &s->before[i], v->type.encoding,
+					v->byte_size),
+				var_format_value(lp_after, &v->value, v->type.encoding,
+					v->byte_size)
+			);
+			continue;
+		}
+
+		fn_printf(depth, FUNCTION_INDENT_LEVEL, "[%s] (%s) changed %d times\n",
+			(v->scope == VGLOBAL) ? "global" : "local",
+			v->name,
+			s->changes[i]
+		);
+
+		if (s->before && s->before[i].p_value && v->value.p_value)
+			lp_print_elements(v, s->before[i].p_value, depth);
+	}
+
+	/* First and last iterations. */
+	if (s->first_buf != NULL)
+	{
+		fn_printf(depth, FUNCTION_INDENT_LEVEL, "first iteration:\n");
+		fwrite(s->first_buf, 1, s->first_size, pbd_output);
+	}
+	if (s->last_buf != NULL)
+	{
+		fn_printf(depth, FUNCTION_INDENT_LEVEL, "last iteration:\n");
+		fwrite(s->last_buf, 1, s->last_size, pbd_output);
+	}
+	fputc('\n', pbd_output);
+
+	lp_release(s);
+}
+
+/**
+ * @brief Follows the loops for the line that just executed,
+ * @p bp: a loop starts when one of its lines executes, each
+ * execution of its first line is a new iteration, and the
+ * loop ends when a line outside of it executes.
+ *
+ * Should be called before checking the changes of @p bp.
+ *
+ * @param vars Variables list, for current context.
+ * @param bp Line that just executed.
+ * @param depth Function depth.
+ */
+void lp_step(struct array *vars, struct breakpoint *bp, int depth)
+{
+	struct lp_state *s; /* Loop state. */
+	int loop;           /* Loop index. */
+
+	if ((s = lp_get_state(depth)) == NULL)
+		return;
+
+	loop = lp_find(bp->addr);
+
+	/* Left the loop. */
+	if (s->loop >= 0 && s->loop != loop)
+		lp_end(depth);
+
+	if (loop < 0)
+		return;
+
+	/* Entered the loop. */
+	if (s->loop < 0)
+		lp_begin(s, loop, vars);
+
+	if (bp->addr != lp_loops[loop].head)
+		return;
+
+	/*
+	 * New iteration: the first one is kept as is, the last one
+	 * is replaced at every iteration.
+	 */
+	s->iterations++;
+	if (!lp_detail || s->iterations < 2)
+		return;
+
+	lp_close_output(&s->first);
+	lp_close_output(&s->last);
+	free(s->last_buf);
+	s->last_buf = NULL;
+	s->last = open_memstream(&s->last_buf, &s->last_size);
+}
+
+/**
+ * @brief Accounts a change found inside a loop, instead of
+ * reporting it.
+ *
+ * @param v Variable changed.
+ * @param depth Function depth.
+ * @param line_no Line number.
+ * @param v_before Value before being changed.
+ * @param v_after Value after being changed.
+ * @param array_idxs Computed index, only applicable
+ *        if variable is an array.
+ *
+ * @return Returns 1 if the change was accounted and should
+ * not be reported, 0 otherwise.
+ */
+int lp_change(struct dw_variable *v, int depth, unsigned line_no,
+	union var_value *v_before, union var_value *v_after, int *array_idxs)
+{
+	struct lp_state *s; /* Loop state.      */
+	FILE *out;          /* Iteration output. */
+	FILE *prev;         /* Previous output. */
+
+	if (depth >= lp_nstates || lp_states[depth].loop < 0)
+		return (0);
+
+	s = &lp_states[depth];
+	for (size_t i = 0; i < array_size(&s->vars) && s->changes; i++)
+	{
+		if (array_get(&s->vars, i, NULL) == v)
+		{
+			s->changes[i]++;
+			break;
+		}
+	}
+
+	/* Iteration detail, written with the current printer. */
+	out = s->last ? s->last : s->first;
+	if (out != NULL)
+	{
+		prev = pbd_output;
+		pbd_output = out;
+			line_output(depth, line_no, v, v_before, v_after, array_idxs);
+		pbd_output = prev;
+	}
+	return (1);
+}
+
+/**
+ * @brief Dumps all the loops found.
+ */
+void lp_dump(void)
+{
+	for (int i = 0; i < lp_nloops; i++)
+	{
+		fprintf(pbd_output,
+			"    Loop #%02d, lines: %u-%u / range: %" PRIxPTR "-%" PRIxPTR
+			" / head: %" PRIxPTR "\n",
+			i,
+			lp_loops[i].first_line,
+			lp_loops[i].last_line,
+			lp_loops[i].start,
+			lp_loops[i].end,
+			lp_loops[i].head
+		);
+	}
+}
+
+/**
+ * @brief Releases all the loops and loop states. Loops still
+ * being executed are discarded without being reported, see
+ * lp_end().
+ */
+void lp_finish(void)
+{
+	for (int i = 0; i < lp_nstates; i++)
+		if (lp_states[i].loop >= 0)
+			lp_release(&lp_states[i]);
+
+	free(lp_states);
+	free(lp_loops);
+	lp_states  = NULL;
+	lp_loops   = NULL;
+	lp_nstates = 0;
+	lp_nloops  = 0;
+}
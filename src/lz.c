@@ -0,0 +1,413 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "lz.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Hash table size (log2). */
+#define LZ_HASH_LOG 14
+
+/* Minimum match length. */
+#define LZ_MIN_MATCH 4
+
+/* Maximum offset. */
+#define LZ_MAX_OFFSET 65535
+
+/**
+ * @brief Reads an unaligned 32-bit word.
+ *
+ * @param p Source.
+ *
+ * @return Returns the word read.
+ */
+static inline uint32_t lz_read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return (v);
+}
+
+/**
+ * @brief Hashes the 4 bytes @p v.
+ *
+ * @param v Word.
+ *
+ * @return Returns the hash table index.
+ */
+static inline uint32_t lz_hash(uint32_t v)
+{
+	return ((v * 2654435761U) >> (32 - LZ_HASH_LOG));
+}
+
+/**
+ * @brief Writes a length (beyond the 15 of the token) as a
+ * sequence of 255's.
+ *
+ * @param op Output.
+ * @param len Remaining length.
+ *
+ * @return Returns the new output position.
+ */
+static inline uint8_t *lz_put_length(uint8_t *op, size_t len)
+{
+	while (len >= 255)
+	{
+		*op++ = 255;
+		len  -= 255;
+	}
+	*op++ = (uint8_t)len;
+	return (op);
+}
+
+/**
+ * @brief Writes a single sequence: literals and, if @p mlen is
+ * not 0, a match.
+ *
+ * @param op Output.
+ * @param lit Literals.
+ * @param nlit Amount of literals.
+ * @param off Match offset.
+ * @param mlen Match length (0 if none).
+ *
+ * @return Returns the new output position.
+ */
+static uint8_t *lz_put_sequence(uint8_t *op, const uint8_t *lit, size_t nlit,
+	size_t off, size_t mlen)
+{
+	uint8_t *token;
+
+	token = op++;
+	*token = (nlit >= 15 ? 15 : nlit) << 4;
+	if (nlit >= 15)
+		op = lz_put_length(op, nlit - 15);
+
+	memcpy(op, lit, nlit);
+	op += nlit;
+
+	if (!mlen)
+		return (op);
+
+	*op++ = off & 0xFF;
+	*op++ = off >> 8;
+
+	mlen -= LZ_MIN_MATCH;
+	*token |= (mlen >= 15 ? 15 : mlen);
+	if (mlen >= 15)
+		op = lz_put_length(op, mlen - 15);
+
+	return (op);
+}
+
+/**
+ * @brief Compresses the block @p src.
+ *
+ * @param src Data to be compressed.
+ * @param len Data length.
+ * @param dst Output, at least LZ_BOUND(@p len) bytes.
+ *
+ * @return Returns the compressed size.
+ */
+size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst)
+{
+	uint32_t *table; /* Last position (+1) per hash. */
+	size_t anchor;   /* First pending literal.       */
+	size_t ip;       /* Current position.            */
+	uint8_t *op;     /* Output position.             */
+
+	op = dst;
+	anchor = 0;
+	ip = 0;
+
+	if ((table = calloc(1 << LZ_HASH_LOG, sizeof(uint32_t))) == NULL)
+		return (lz_put_sequence(op, src, len, 0, 0) - dst);
+
+	while (len >= LZ_MIN_MATCH && ip <= len - LZ_MIN_MATCH)
+	{
+		uint32_t seq;
+		uint32_t h;
+		size_t ref;
+		size_t mlen;
+
+		seq = lz_read32(src + ip);
+		h   = lz_hash(seq);
+		ref = table[h];
+		table[h] = ip + 1;
+
+		/* No candidate, too far or just a collision. */
+		if (!ref || ip - (ref - 1) > LZ_MAX_OFFSET ||
+			lz_read32(src + (ref - 1)) != seq)
+		{
+			ip++;
+			continue;
+		}
+
+		ref--;
+		mlen = LZ_MIN_MATCH;
+		while (ip + mlen < len && src[ref + mlen] == src[ip + mlen])
+			mlen++;
+
+		op = lz_put_sequence(op, src + anchor, ip - anchor, ip - ref, mlen);
+		ip += mlen;
+		anchor = ip;
+	}
+
+	/* Last literals. */
+	op = lz_put_sequence(op, src + anchor, len - anchor, 0, 0);
+
+	free(table);
+	return (op - dst);
+}
+
+/**
+ * @brief Reads a length (beyond the 15 of the token).
+ *
+ * @param ip Input position, updated.
+ * @param end Input end.
+ * @param len Length, updated.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static inline int lz_get_length(const uint8_t **ip, const uint8_t *end,
+	size_t *len)
+{
+	uint8_t b;
+	do
+	{
+		if (*ip >= end)
+			return (-1);
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return (0);
+}
+
+/**
+ * @brief Decompresses the block @p src.
+ *
+ * @param src Compressed data.
+ * @param len Compressed length.
+ * @param dst Output.
+ * @param cap Output capacity.
+ *
+ * @return Returns the decompressed size, or a negative number
+ * if the data is corrupted.
+ */
+int lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap)
+{
+	const uint8_t *ip;   /* Input position.  */
+	const uint8_t *end;  /* Input end.       */
+	size_t op;           /* Output position. */
+	size_t nlit;         /* Literals.        */
+	size_t mlen;         /* Match length.    */
+	size_t off;          /* Match offset.    */
+	uint8_t token;       /* Sequence token.  */
+
+	ip  = src;
+	end = src + len;
+	op  = 0;
+
+	while (ip < end)
+	{
+		token = *ip++;
+
+		nlit = token >> 4;
+		if (nlit == 15 && lz_get_length(&ip, end, &nlit) < 0)
+			return (-1);
+
+		if (nlit > (size_t)(end - ip) || nlit > cap - op)
+			return (-1);
+
+		memcpy(dst + op, ip, nlit);
+		ip += nlit;
+		op += nlit;
+
+		/* Last sequence, literals only. */
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return (-1);
+
+		off = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		mlen = token & 15;
+		if (mlen == 15 && lz_get_length(&ip, end, &mlen) < 0)
+			return (-1);
+		mlen += LZ_MIN_MATCH;
+
+		if (!off || off > op || mlen > cap - op)
+			return (-1);
+
+		/* Byte by byte, matches may overlap. */
+		for (size_t i = 0; i < mlen; i++, op++)
+			dst[op] = dst[op - off];
+	}
+
+	return ((int)op);
+}
+
+/**
+ * @brief Writes a 32-bit little-endian word.
+ *
+ * @param v Word.
+ * @param out Output file.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int lz_put32(uint32_t v, FILE *out)
+{
+	uint8_t b[4] = {v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, v >> 24};
+	return (fwrite(b, 1, 4, out) == 4 ? 0 : -1);
+}
+
+/**
+ * @brief Reads a 32-bit little-endian word.
+ *
+ * @param v Word read.
+ * @param in Input file.
+ *
+ * @return Returns 1 if read, 0 if end of file and a negative
+ * number if error.
+ */
+static int lz_get32(uint32_t *v, FILE *in)
+{
+	uint8_t b[4];
+	size_t n;
+
+	if ((n = fread(b, 1, 4, in)) == 0)
+		return (0);
+	if (n != 4)
+		return (-1);
+
+	*v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+	return (1);
+}
+
+/**
+ * @brief Compresses the whole file @p in into @p out.
+ *
+ * @param in Input file.
+ * @param out Output file.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int lz_compress_file(FILE *in, FILE *out)
+{
+	uint8_t *raw;   /* Raw block.        */
+	uint8_t *comp;  /* Compressed block. */
+	size_t n;       /* Raw size.         */
+	size_t c;       /* Compressed size.  */
+	int ret;        /* Return code.      */
+
+	ret  = -1;
+	raw  = malloc(LZ_BLOCK);
+	comp = malloc(LZ_BOUND(LZ_BLOCK));
+	if (!raw || !comp)
+		goto out;
+
+	if (fwrite(LZ_MAGIC, 1, LZ_MAGIC_LEN, out) != LZ_MAGIC_LEN)
+		goto out;
+
+	while ((n = fread(raw, 1, LZ_BLOCK, in)) > 0)
+	{
+		c = lz_compress(raw, n, comp);
+
+		/* Not worth, store it. */
+		if (c >= n)
+		{
+			if (lz_put32(n, out) || lz_put32(n, out) ||
+				fwrite(raw, 1, n, out) != n)
+				goto out;
+		}
+		else
+		{
+			if (lz_put32(n, out) || lz_put32(c, out) ||
+				fwrite(comp, 1, c, out) != c)
+				goto out;
+		}
+	}
+
+	if (!ferror(in))
+		ret = 0;
+out:
+	free(raw);
+	free(comp);
+	return (ret);
+}
+
+/**
+ * @brief Decompresses the whole file @p in into @p out.
+ *
+ * @param in Input file, compressed with lz_compress_file().
+ * @param out Output file.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int lz_decompress_file(FILE *in, FILE *out)
+{
+	char magic[LZ_MAGIC_LEN]; /* File magic.       */
+	uint8_t *raw;             /* Raw block.        */
+	uint8_t *comp;            /* Compressed block. */
+	uint32_t n;               /* Raw size.         */
+	uint32_t c;               /* Stored size.      */
+	int ret;                  /* Return code.      */
+	int r;                    /* Read status.      */
+
+	ret  = -1;
+	raw  = malloc(LZ_BLOCK);
+	comp = malloc(LZ_BOUND(LZ_BLOCK));
+	if (!raw || !comp)
+		goto out;
+
+	if (fread(magic, 1, LZ_MAGIC_LEN, in) != LZ_MAGIC_LEN ||
+		memcmp(magic, LZ_MAGIC, LZ_MAGIC_LEN))
+		goto out;
+
+	while ((r = lz_get32(&n, in)) > 0)
+	{
+		if (lz_get32(&c, in) <= 0 || n > LZ_BLOCK || c > LZ_BOUND(LZ_BLOCK))
+			goto out;
+
+		if (fread(comp, 1, c, in) != c)
+			goto out;
+
+		if (c == n)
+			memcpy(raw, comp, n);
+		else if (lz_decompress(comp, c, raw, LZ_BLOCK) != (int)n)
+			goto out;
+
+		if (fwrite(raw, 1, n, out) != n)
+			goto out;
+	}
+
+	if (!r)
+		ret = 0;
+out:
+	free(raw);
+	free(comp);
+	return (ret);
+}
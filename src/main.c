@@ -26,7 +26,10 @@
 #include <sys/types.h>
 #include <signal.h>
 #include <ctype.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
 
 #include "analysis.h"
 #include "breakpoint.h"
@@ -39,6 +42,30 @@
 #include "hashtable.h"
 #include "line.h"
 #include "highlight.h"
+#include "tracepoint.h"
+#include "tracer.h"
+#include "verify.h"
+#include "profiler.h"
+#include "probes.h"
+#include "plugin.h"
+#include "region.h"
+#include "heap.h"
+#include "bitmap.h"
+#include "summary.h"
+#include "core.h"
+#include "poller.h"
+#include "snapshot.h"
+#include "evloop.h"
+#include "output.h"
+#include "lz.h"
+#include "rotate.h"
+#include "loop.h"
+#include "linked.h"
+#include "heatmap.h"
+#include "keyframe.h"
+#include "arrow.h"
+#include "transition.h"
+#include "strdiff.h"
 
 #define OPTPARSE_IMPLEMENTATION
 #include "optparse.h"
@@ -46,10 +73,7 @@
 #include "pbd.h"
 
 /* PBD outputfile. */
-FILE *pbd_output;
-
-/* Depth, useful for recursive analysis. */
-int depth;
+PBD_TLS FILE *pbd_output;
 
 /* Dwarf Utils current context. */
 struct dw_utils dw;
@@ -67,10 +91,68 @@ static struct array *context;
 static char *filename;
 
 /* Arguments list. */
-struct args args = {0,0,{0,0},0,0,0,0,0};
+struct args args = {0,0,{0,0},0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+
+/* Event loop periods (ms). */
+#define OUTPUT_FLUSH_PERIOD 100
+#define STATS_PERIOD        1000
+
+/* Tracing statistics. */
+static struct stats
+{
+	uint64_t stops;       /* Stops handled.       */
+	uint64_t changes;     /* Changes reported.    */
+	uint64_t last_stops;  /* Stops, last report.  */
+	uint64_t pauses;      /* Output backpressure. */
+	uint64_t unsafe;      /* In place steps.      */
+} stats;
+
+/* Start of the current setup phase, in --stats mode. */
+static struct timespec phase_start;
+static long phase_maxrss;
+
+/* Event loop state. */
+static int tracee_fd = -1;
+static int tracee_paused;
 
 /* Forward definition. */
 extern int str2int(int *out, char *s);
+static void print_stats(int final);
+
+/**
+ * @brief Reports the wall time and the peak RSS growth of the
+ * setup phase that just ended, in --stats mode, and starts the
+ * next one.
+ *
+ * The peak RSS is process-wide, so a phase only accounts the
+ * amount it grew while the phase ran (0 if the phase did not
+ * use more memory than a previous one).
+ *
+ * @param phase Name of the phase that just ended, or NULL
+ * to only start the first one.
+ */
+static void setup_phase(const char *phase)
+{
+	struct timespec now; /* Current time.     */
+	struct rusage ru;    /* Resources usage. */
+
+	if (!(args.flags & FLG_STATS))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (getrusage(RUSAGE_SELF, &ru) < 0)
+		ru.ru_maxrss = phase_maxrss;
+
+	if (phase != NULL)
+	{
+		fprintf(stderr, "PBD: stats: setup: %s, %.6f s, +%ld KiB peak RSS\n",
+			phase, (now.tv_sec - phase_start.tv_sec) +
+			(now.tv_nsec - phase_start.tv_nsec) / 1e9,
+			ru.ru_maxrss - phase_maxrss);
+	}
+	phase_start  = now;
+	phase_maxrss = ru.ru_maxrss;
+}
 
 /**
  * @brief Parses all the lines and variables for the target
@@ -84,10 +166,13 @@ int setup(const char *file, const char *function)
 	struct function *f; /* First function context. */
 
 	/* Initializes dwarf. */
+	setup_phase(NULL);
 	dw_init(file, &dw);
+	setup_phase("dw_init");
 
 	/* Searches for the target function */
 	dw_get_address_by_function(&dw, function);
+	setup_phase("function");
 
 	/* Ensure we're debugging a C program. */
 	if (!dw_is_c_language(&dw))
@@ -105,8 +190,62 @@ int setup(const char *file, const char *function)
 
 	/* Parses all variables, lines and filename. */
 	f->vars  = dw_get_all_variables(&dw);
+	setup_phase("variables");
 	lines    = dw_get_all_lines(&dw);
 	filename = dw_get_source_file(&dw);
+	setup_phase("lines");
+
+	/* Variables reported as bitmaps. */
+	if (args.flags & FLG_BITMAP)
+		bm_mark(f->vars);
+
+	/* Char arrays reported as strings. */
+	if (args.flags & FLG_STRINGS)
+		sd_mark(f->vars, args.strings_max, args.strings_edit);
+
+	/* Large arrays compared in background, if any. */
+	if ((args.flags & FLG_FORK_SNAPSHOT) &&
+		!ss_mark(f->vars, args.snapshot_min))
+	{
+		args.flags &= ~FLG_FORK_SNAPSHOT;
+	}
+
+	/* Loops of the function, for the loop records. */
+	if ((args.flags & FLG_LOOP_SUMMARY) && lp_init(file, &dw.dw_func, lines,
+		args.flags & FLG_LOOP_DETAIL) < 0)
+	{
+		QUIT(EXIT_FAILURE, "unable to find the function loops!\n");
+	}
+
+	/* Linked structures: root pointers and node members. */
+	if ((args.flags & FLG_WATCH_LINKED) && lk_resolve(&dw) < 0)
+		QUIT(EXIT_FAILURE, "unable to resolve the linked structures!\n");
+
+	/* Statistics-only mode. */
+	if ((args.flags & FLG_SUMMARY) && sm_init(f->vars) < 0)
+		QUIT(EXIT_FAILURE, "unable to initialize the summary!\n");
+
+	/* Per-index change counters of the arrays. */
+	if ((args.flags & FLG_HEATMAP) && hm_init(f->vars, args.heatmap_top,
+		args.heatmap_pgm) < 0)
+	{
+		QUIT(EXIT_FAILURE, "unable to initialize the heatmaps!\n");
+	}
+
+	/* Enum state-transition matrices. */
+	if ((args.flags & FLG_TRANSITIONS) && tm_init(&dw, f->vars,
+		args.transitions_dot) < 0)
+	{
+		QUIT(EXIT_FAILURE, "unable to initialize the transition matrices!\n");
+	}
+
+	/* Columnar output: the changes are written as record batches. */
+	if (args.flags & FLG_ARROW)
+	{
+		if (ar_init(args.arrow_file, f->vars) < 0)
+			QUIT(EXIT_FAILURE, "unable to create %s!\n", args.arrow_file);
+		line_output = ar_printer;
+	}
 
 	/* Should we read the source?. */
 	if (args.flags & FLG_SHOW_LINES)
@@ -121,6 +260,7 @@ int setup(const char *file, const char *function)
 			exit(EXIT_FAILURE);
 		}
 		line_output = line_detailed_printer;
+		setup_phase("source");
 	}
 
 	/* Check if static analysis enabled. */
@@ -133,8 +273,6 @@ int setup(const char *file, const char *function)
 		exit(EXIT_FAILURE);
 	}
 
-	depth = 0;
-
 	/*
 	 * Since all dwarf analysis are static, when the analysis
 	 * is over, we can already free the dwarf context.
@@ -148,9 +286,31 @@ int setup(const char *file, const char *function)
  */
 void finish(void)
 {
+	/* Pending background comparisons, if any. */
+	if (args.flags & FLG_FORK_SNAPSHOT)
+	{
+		__atomic_add_fetch(&stats.changes, ss_join(), __ATOMIC_RELAXED);
+		ss_finish();
+	}
+
+	/* End the plugins session, if any. */
+	if (args.flags & FLG_PLUGIN)
+		plugin_session_end();
+
+	/* Stop the self-profiler and write its output, if any. */
+	if (args.self_profile != NULL)
+	{
+		prof_stop();
+		free(args.self_profile);
+		args.self_profile = NULL;
+	}
+
 	/* Free dwarf structures. */
 	dw_finish(&dw);
 
+	/* Deallocate loops. */
+	lp_finish();
+
 	/* Deallocate variables. */
 	fn_free( array_get(&context, 0, NULL) );
 
@@ -176,6 +336,75 @@ void finish(void)
 	/* Deallocate static analysis data structures. */
 	static_analysis_finish();
 
+	/* Deallocate fast tracepoints, if any. */
+	tp_finish();
+
+	/* Deallocate watched regions and heap blocks, if any. */
+	rg_finish();
+	hp_finish();
+	lk_finish();
+	kf_finish();
+
+	/* Deallocate bitmap patterns, if any. */
+	bm_finish();
+
+	/* Deallocate the core files list, if any. */
+	if (args.cores != NULL)
+		array_finish(&args.cores);
+
+	/* Variables statistics, if any. */
+	if (args.flags & FLG_SUMMARY)
+	{
+		sm_report(pbd_output);
+		sm_finish();
+	}
+
+	/* Arrays heatmaps, if any. */
+	if (args.flags & FLG_HEATMAP)
+	{
+		hm_report(pbd_output);
+		hm_finish();
+		free(args.heatmap_pgm);
+		args.heatmap_pgm = NULL;
+	}
+
+	/* Enum transition matrices, if any. */
+	if (args.flags & FLG_TRANSITIONS)
+	{
+		tm_report(pbd_output);
+		tm_finish();
+		free(args.transitions_dot);
+		args.transitions_dot = NULL;
+	}
+
+	/* Pending record batch and end of stream, if any. */
+	if (args.flags & FLG_ARROW)
+	{
+		ar_finish();
+		free(args.arrow_file);
+		args.arrow_file = NULL;
+	}
+
+	/* Statistics, if any, after everything has been written. */
+	if (args.flags & FLG_STATS)
+	{
+		out_flush(1);
+		print_stats(1);
+	}
+
+	/* Lines possibly missed by the other threads, if any. */
+	if (stats.unsafe && !(args.flags & FLG_STATS))
+		fprintf(stderr, "PBD: warning: %" PRIu64 " breakpoints stepped over "
+			"in place, other threads may have missed lines!\n", stats.unsafe);
+
+	/* Verification summary, if any. */
+	if (args.flags & FLG_VERIFY)
+		vf_finish();
+
+	/* Release the event loop and write the pending output. */
+	ev_finish();
+	out_finish(&pbd_output);
+
 	/* Deallocate and close output, if any. */
 	if (args.output_file)
 	{
@@ -184,6 +413,490 @@ void finish(void)
 	}
 }
 
+/**
+ * @brief Steps the thread @p tid over the breakpoint @p bp,
+ * executing it out of line when tracing multiple threads.
+ *
+ * @param bp Breakpoint.
+ * @param tid Thread stopped at @p bp.
+ *
+ * @return Returns PT_CHILD_EXIT if the thread has exited while
+ * stepped, and thus must not be resumed, otherwise, returns 0.
+ */
+static int skip_breakpoint(struct breakpoint *bp, pid_t tid)
+{
+	int ret; /* Step result. */
+
+	if (args.threads && (ret = tr_step_over(bp, tid)) >= 0)
+		return (ret);
+
+	/*
+	 * The breakpoint is removed from memory while stepping over
+	 * it, and the other threads (that are not stopped) may run
+	 * through it unnoticed, so count it.
+	 */
+	if (args.threads && tr_live_threads() > 1)
+		__atomic_add_fetch(&stats.unsafe, 1, __ATOMIC_RELAXED);
+
+	tr_wrlock();
+		bp_skipbreakpoint(bp, tid);
+	tr_unlock();
+	return (0);
+}
+
+/**
+ * @brief Handles a single trap of the thread @p t and
+ * resumes its execution.
+ *
+ * @param t Traced thread.
+ */
+static void handle_trap(struct tracee *t)
+{
+	int current_depth;
+	uintptr_t pc;
+	struct breakpoint *bp;
+	struct function *f;
+	int fast_trap;
+	int changes;
+	int verify;
+	int dirty;
+
+	f  = array_get_last(&t->context, NULL);
+	pc = pt_readregister_pc(t->tid) - 1;
+	current_depth = array_size(&t->context);
+	fast_trap = 0;
+	changes = 0;
+	verify = 0;
+	dirty = 0;
+
+	__atomic_add_fetch(&stats.stops, 1, __ATOMIC_RELAXED);
+
+	PBD_PROBE2(stop, t->tid, pc);
+
+	/* Changes of the previous stops, already compared in background. */
+	if (args.flags & FLG_FORK_SNAPSHOT)
+		__atomic_add_fetch(&stats.changes, ss_flush(), __ATOMIC_RELAXED);
+
+	tr_rdlock();
+		bp = bp_findbreakpoint(pc, breakpoints);
+	tr_unlock();
+
+	PBD_PROBE3(bp_lookup, t->tid, pc, bp ? (int)bp->line_no : -1);
+
+	/* Allocators and their return addresses, for the heap watch. */
+	if (bp != NULL && (args.flags & FLG_WATCH_HEAP) &&
+		hp_trap(t->tid, pc, t->depth) == HP_OWNED)
+	{
+		if (!skip_breakpoint(bp, t->tid))
+			pt_continue(t->tid);
+		return;
+	}
+
+	/*
+	 * Fast tracepoints only trap when something has changed (or
+	 * when a check is forced), and they do not need to be skipped.
+	 */
+	if (bp == NULL && (args.flags & FLG_FAST_TRACEPOINTS))
+		fast_trap = ((bp = tp_find(pc)) != NULL);
+
+	/* If not valid breakpoint, continues. */
+	if (bp == NULL)
+	{
+		pt_continue(t->tid);
+		return;
+	}
+
+	/*
+	 * Since we are the very first instruction of the
+	 * function, there is nothing to analyze here, yet.
+	 */
+	if (pc == dw.dw_func.low_pc)
+	{
+		/* Allocates a new function context. */
+		if (current_depth > 0 && t->depth > 0)
+		{
+			var_new_context(
+				array_get(&t->context, current_depth - 1, NULL),
+				&f,
+				t->context
+			);
+		}
+
+		/*
+		 * It is important to set a breakpoint on the next instruction
+		 * right after returning from the function, so it is easier
+		 * to know when to enter or exit the function. Especially useful
+		 * for recursive analysis.
+		 */
+		tr_wrlock();
+			bp_createbreakpoint(f->return_addr = pt_readreturn_address(t->tid),
+				breakpoints, t->tid);
+		tr_unlock();
+
+		/* Executes that breakpoint. */
+		if (skip_breakpoint(bp, t->tid))
+			return;
+
+		t->depth++;
+		t->prev_bp = bp;
+		t->init_vars = 1;
+
+		PBD_PROBE2(func_entry, t->tid, t->depth);
+
+		/* Mappings may only exist from now on (e.g: [heap]). */
+		if (args.flags & FLG_WATCH_REGION)
+			rg_resolve(t->tid);
+
+		/* New context, the next line needs to be checked anyway. */
+		if (args.flags & FLG_FAST_TRACEPOINTS)
+			tp_force(t->tid, bp);
+
+		pt_continue(t->tid);
+		return;
+	}
+
+	/*
+	 * Not inside the function (yet), nothing to analyze. This
+	 * only happens with multiple threads, i.e: a thread that
+	 * has not entered the function but reached a breakpoint
+	 * created by another thread, or that missed the function
+	 * entry while another thread was stepping over it.
+	 */
+	if (t->depth == 0)
+	{
+		t->prev_bp = NULL;
+
+		if (!skip_breakpoint(bp, t->tid))
+			pt_continue(t->tid);
+		return;
+	}
+
+	/*
+	 * Returning from a previous call.
+	 */
+	if (pc == f->return_addr)
+	{
+		fn_printf(current_depth, 0, "[depth: %d] Returning to function...\n\n",
+			current_depth);
+
+		/* Loop still running when returning. */
+		if (args.flags & FLG_LOOP_SUMMARY)
+			lp_end(current_depth);
+
+		/*
+		 * Since we're returning from an previous call, we also
+		 * need to free all (possible) arrays allocated first,
+		 * once no snapshot compares them anymore.
+		 */
+		if (args.flags & FLG_FORK_SNAPSHOT)
+			__atomic_add_fetch(&stats.changes, ss_join(), __ATOMIC_RELAXED);
+
+		var_deallocate_context(f->vars, t->context, current_depth);
+
+		/* Decrements the context and continues. */
+		t->depth--;
+
+		PBD_PROBE2(func_return, t->tid, t->depth);
+
+		if (args.flags & FLG_FAST_TRACEPOINTS)
+			tp_force(t->tid, NULL);
+
+		if (!skip_breakpoint(bp, t->tid))
+			pt_continue(t->tid);
+		return;
+	}
+
+	/*
+	 * If init_vars is set, means that its time to finally
+	 * initialize the vars right after the prologue in the
+	 * previous iteration.
+	 *
+	 * Even if the values are 'wrong', this ensures that we
+	 * have a knowlable value in beforehand before start
+	 * comparing values.
+	 */
+	if (t->init_vars)
+	{
+		fputc('\n', pbd_output);
+		fn_printf(current_depth, 0, "[depth: %d] Entering function...\n",
+			current_depth);
+
+		t->init_vars = 0;
+		var_initialize(f->vars, t->tid);
+
+		/* New values, but not changes: only the shadow copy. */
+		dirty = 1;
+
+		/* The very first keyframe: the state at the entry. */
+		if (args.flags & FLG_KEYFRAMES)
+			kf_check(t->context, current_depth);
+	}
+
+	/*
+	 * Lines executed through fast tracepoints do not stop, so
+	 * the previous line should be asked to the child.
+	 */
+	if (args.flags & FLG_FAST_TRACEPOINTS)
+		t->prev_bp = tp_last_line(t->tid);
+
+	/* Do something. */
+	if (t->prev_bp != NULL)
+	{
+		if (args.flags & FLG_PLUGIN)
+			plugin_stop(t->tid, t->prev_bp->line_no, current_depth);
+
+		verify = (args.flags & FLG_VERIFY) && vf_sample();
+		if (verify)
+			vf_begin(t->prev_bp, f->vars, t->tid);
+
+		if (args.flags & FLG_LOOP_SUMMARY)
+			lp_step(f->vars, t->prev_bp, current_depth);
+
+		changes += var_check_changes(t->prev_bp, f->vars, t->tid, current_depth);
+
+		if (args.flags & FLG_WATCH_REGION)
+			changes += rg_check_changes(t->tid, t->prev_bp->line_no,
+				current_depth);
+
+		if (args.flags & FLG_WATCH_HEAP)
+			changes += hp_check_changes(t->tid, t->prev_bp->line_no,
+				current_depth);
+
+		if (args.flags & FLG_WATCH_LINKED)
+			changes += lk_check_changes(t->tid, t->prev_bp->line_no,
+				current_depth);
+
+		if ((args.flags & FLG_FORK_SNAPSHOT) && ss_start(t->tid, f->vars,
+			t->prev_bp->line_no, current_depth) < 0)
+		{
+			fprintf(stderr, "PBD: unable to compare the snapshot of line %d!\n",
+				t->prev_bp->line_no);
+		}
+
+		if (verify)
+			vf_end();
+	}
+
+	__atomic_add_fetch(&stats.changes, changes, __ATOMIC_RELAXED);
+
+	/* Full state, every N events or M bytes of output. */
+	if (args.flags & FLG_KEYFRAMES)
+		kf_check(t->context, current_depth);
+
+	/* Statistics asked on demand (SIGUSR1). */
+	if ((args.flags & FLG_SUMMARY) && sm_requested())
+		sm_report(pbd_output);
+
+	/* Update shadow copy and the last line. */
+	if (args.flags & FLG_FAST_TRACEPOINTS)
+	{
+		tp_update(t->tid, f->vars, fast_trap ? NULL : bp, dirty || changes);
+
+		/* The shadow copy should now match the child memory. */
+		if (verify)
+			vf_check_shadow(t->prev_bp, f->vars, t->tid);
+	}
+
+	t->prev_bp = bp;
+
+	/* Executes that breakpoint. */
+	if (!fast_trap && skip_breakpoint(bp, t->tid))
+		return;
+
+	/* Continue. */
+	pt_continue(t->tid);
+}
+
+/**
+ * @brief Prints the tracing statistics.
+ *
+ * @param final If set, prints the totals, otherwise, the
+ * statistics since the last report.
+ */
+static void print_stats(int final)
+{
+	struct out_stats ost;  /* Output statistics. */
+	uint64_t stops;        /* Stops handled.     */
+
+	out_get_stats(&ost);
+	stops = __atomic_load_n(&stats.stops, __ATOMIC_RELAXED);
+
+	if (final)
+	{
+		fprintf(stderr, "PBD: stats: %" PRIu64 " stops, %" PRIu64 " changes, "
+			"%zu bytes written, %zu output stalls, %" PRIu64 " pauses\n",
+			stops, stats.changes, ost.written, ost.stalls, stats.pauses);
+
+		if (args.threads)
+			fprintf(stderr, "PBD: stats: %" PRIu64 " breakpoints stepped over "
+				"in place (lines possibly missed by other threads)\n",
+				stats.unsafe);
+	}
+	else
+		fprintf(stderr, "PBD: stats: %" PRIu64 " stops/s, %" PRIu64 " stops, %"
+			PRIu64 " changes, %zu bytes pending%s\n", stops - stats.last_stops,
+			stops, stats.changes, ost.pending,
+			tracee_paused ? " (paused)" : "");
+
+	stats.last_stops = stops;
+}
+
+/**
+ * @brief Handles all the pending state changes of the tracee,
+ * as long as the output keeps up.
+ *
+ * @param fd Tracee file descriptor.
+ * @param events Events.
+ * @param data Traced thread.
+ */
+static void on_tracee(int fd, uint32_t events, void *data)
+{
+	struct tracee *t;  /* Traced thread.  */
+	int exited;        /* Tracee exited?. */
+	((void)events);
+
+	t = data;
+	ev_tracee_ack(fd);
+
+	while (!tracee_paused && ev_tracee_wait(t->tid, &exited) > 0)
+	{
+		if (exited)
+		{
+			ev_stop();
+			return;
+		}
+
+		handle_trap(t);
+
+		/*
+		 * Backpressure: the output cannot keep up, so keep the
+		 * tracee stopped (at its next stop) until it drains.
+		 */
+		if (out_pending() > OUT_HIGH_WATERMARK)
+		{
+			tracee_paused = 1;
+			stats.pauses++;
+			ev_mod(tracee_fd, 0);
+			ev_mod(out_fd(), EPOLLOUT);
+		}
+	}
+}
+
+/**
+ * @brief Writes the pending output and resumes the tracee
+ * handling, if paused and the output has drained enough.
+ *
+ * @param t Traced thread.
+ */
+static void output_update(struct tracee *t)
+{
+	int pending; /* Pending bytes. */
+
+	if ((pending = out_flush(0)) < 0)
+		pending = 0;
+
+	/* Wait until writable, only if needed. */
+	if (out_pollable())
+		ev_mod(out_fd(), pending ? EPOLLOUT : 0);
+
+	if (tracee_paused && pending < OUT_LOW_WATERMARK)
+	{
+		tracee_paused = 0;
+		ev_mod(tracee_fd, EPOLLIN);
+
+		/* SIGCHLD was already consumed, so check it now. */
+		on_tracee(tracee_fd, EPOLLIN, t);
+	}
+}
+
+/**
+ * @brief Output writable (or error).
+ *
+ * @param fd Output file descriptor.
+ * @param events Events.
+ * @param data Traced thread.
+ */
+static void on_output(int fd, uint32_t events, void *data)
+{
+	/* Nobody is reading, give up the non-blocking output. */
+	if (events & (EPOLLERR|EPOLLHUP))
+		ev_del(fd);
+
+	output_update(data);
+}
+
+/**
+ * @brief Output flush timer.
+ *
+ * @param fd Timer file descriptor.
+ * @param events Events.
+ * @param data Traced thread.
+ */
+static void on_flush_timer(int fd, uint32_t events, void *data)
+{
+	((void)events);
+	ev_timer_ack(fd);
+	output_update(data);
+
+	if (args.flags & FLG_ARROW)
+		ar_tick();
+}
+
+/**
+ * @brief Statistics timer.
+ *
+ * @param fd Timer file descriptor.
+ * @param events Events.
+ * @param data Unused.
+ */
+static void on_stats_timer(int fd, uint32_t events, void *data)
+{
+	((void)events);
+	((void)data);
+	ev_timer_ack(fd);
+	print_stats(0);
+}
+
+/**
+ * @brief Initializes the function context of a new thread,
+ * by copying the variables of the first context.
+ *
+ * @param t New thread.
+ */
+static void tracee_attach(struct tracee *t)
+{
+	struct function *f;
+
+	array_init(&t->context);
+	var_new_context(array_get(&context, 0, NULL), &f, t->context);
+}
+
+/**
+ * @brief Deallocates all the function contexts of a
+ * terminated thread.
+ *
+ * @param t Terminated thread.
+ */
+static void tracee_detach(struct tracee *t)
+{
+	/* Loops not finished yet, if the thread exits inside them. */
+	if (args.flags & FLG_LOOP_SUMMARY)
+		for (int d = (int)array_size(&t->context); d > 0; d--)
+			lp_end(d);
+
+	while (array_size(&t->context) > 0)
+		fn_free( array_remove_last(&t->context, NULL) );
+
+	array_finish(&t->context);
+}
+
+/* Tracer callbacks, for multi-threaded analysis. */
+static const struct tracer_ops tracee_ops = {
+	tracee_attach,
+	handle_trap,
+	tracee_detach
+};
+
 /**
  * Main routine
  *
@@ -193,9 +906,8 @@ void finish(void)
 void do_analysis(const char *file, const char *function, char **argv)
 {
 	pid_t child;                /* Spawned child process. */
-	int init_vars;              /* Initialize vars flags. */
-	struct breakpoint *prev_bp; /* Previous breakpoint.   */
 	struct function *f;         /* Context function.      */
+	struct tracee t;            /* Main thread.           */
 
 	/*
 	 * Setup everything and get ready to analyze.
@@ -205,6 +917,7 @@ void do_analysis(const char *file, const char *function, char **argv)
 	setup(file, function);
 
 	/* Tries to spawn the process. */
+	setup_phase(NULL);
 	if ((child = pt_spawnprocess(file, argv)) < 0)
 		QUIT(EXIT_FAILURE, "error while spawning the child process!\n");
 
@@ -214,6 +927,7 @@ void do_analysis(const char *file, const char *function, char **argv)
 		finish();
 		exit(EXIT_FAILURE);
 	}
+	setup_phase("spawn");
 
 	/*
 	 * Create the breakpoint list accordingly with the analysis type:
@@ -223,14 +937,31 @@ void do_analysis(const char *file, const char *function, char **argv)
 	breakpoints = (args.flags & FLG_STATIC_ANALYSIS) ?
 		static_analysis(filename, function, lines, dw.dw_func.low_pc) :
 		bp_createlist(lines);
+	setup_phase("breakpoints");
 
 	/* Insert them. */
 	bp_insertbreakpoints(breakpoints, child);
 
-	/* Proceed execution. */
-	pt_continue_single_step(child);
-	init_vars = 0;
-	prev_bp = NULL;
+	/* Heap watch, breakpoints at the entry point and the allocators. */
+	if ((args.flags & FLG_WATCH_HEAP) &&
+		hp_init(child, file, breakpoints) < 0)
+	{
+		kill(child, SIGKILL);
+		QUIT(EXIT_FAILURE, "unable to initialize the heap watch!\n");
+	}
+
+	/* Replace the eligible breakpoints by fast tracepoints. */
+	if (args.flags & FLG_FAST_TRACEPOINTS)
+	{
+		f = array_get(&context, 0, NULL);
+		if (tp_init(child, breakpoints, f->vars, dw.dw_func.low_pc,
+			dw.dw_func.high_pc) < 0)
+		{
+			fprintf(stderr, "PBD: fast tracepoints disabled, using regular "
+				"breakpoints!\n");
+			args.flags &= ~FLG_FAST_TRACEPOINTS;
+		}
+	}
 
 	fprintf(pbd_output, "PBD (Printf Based Debugger) v%d.%d%s\n", MAJOR_VERSION, MINOR_VERSION,
 		RLSE_VERSION);
@@ -238,115 +969,147 @@ void do_analysis(const char *file, const char *function, char **argv)
 
 	fprintf(pbd_output, "Debugging function %s:\n", function);
 
-	/* Main loop. */
-	while (pt_waitchild() != PT_CHILD_EXIT)
+	/* Plugins. */
+	if (args.flags & FLG_PLUGIN)
 	{
-		int current_depth;
-		uintptr_t pc;
-		struct breakpoint *bp;
-
-		f  = array_get_last(&context, NULL);
-		pc = pt_readregister_pc(child) - 1;
-		bp = bp_findbreakpoint(pc, breakpoints);
-		current_depth = array_size(&context);
+		f = array_get(&context, 0, NULL);
+		plugin_session_start(child, file, function, filename, f->vars);
+	}
 
-		/* If not valid breakpoint, continues. */
-		if (bp == NULL)
+	/* Multi-threaded analysis. */
+	if (args.threads)
+	{
+		fflush(pbd_output);
+		if (tr_run(child, args.threads, &tracee_ops, pbd_output,
+			dw.dw_func.low_pc) < 0)
 		{
-			pt_continue(child);
-			continue;
+			kill(child, SIGKILL);
+			QUIT(EXIT_FAILURE, "unable to trace the child threads!\n");
 		}
+		finish();
+		return;
+	}
 
-		/*
-		 * Since we are the very first instruction of the
-		 * function, there is nothing to analyze here, yet.
-		 */
-		if (pc == dw.dw_func.low_pc)
-		{
-			/* Allocates a new function context. */
-			if (current_depth > 0 && depth > 0)
-			{
-				var_new_context(
-					array_get(&context, current_depth - 1, NULL),
-					&f,
-					context
-				);
-			}
+	/*
+	 * Event loop: the tracee must be registered before being
+	 * resumed, so that no state change is lost.
+	 */
+	if (ev_init() < 0 || (tracee_fd = ev_tracee_open(child)) < 0)
+		QUIT(EXIT_FAILURE, "unable to initialize the event loop!\n");
 
-			/*
-			 * It is important to set a breakpoint on the next instruction
-			 * right after returning from the function, so it is easier
-			 * to know when to enter or exit the function. Especially useful
-			 * for recursive analysis.
-			 */
-			bp_createbreakpoint(f->return_addr = pt_readreturn_address(child),
-				breakpoints, child);
+	if (out_init(&pbd_output) < 0)
+		QUIT(EXIT_FAILURE, "unable to initialize the output!\n");
 
-			/* Executes that breakpoint. */
-			bp_skipbreakpoint(bp, child);
+	/* Size-capped output, rotated and compressed in background. */
+	if (args.output_max_size && out_rotate(args.output_file,
+		args.output_max_size, args.output_keep) < 0)
+	{
+		QUIT(EXIT_FAILURE, "unable to rotate the output!\n");
+	}
 
-			depth++;
-			prev_bp = bp;
-			init_vars = 1;
-			pt_continue(child);
-			continue;
-		}
+	/* Keyframes, indexed if the output is a single file. */
+	if ((args.flags & FLG_KEYFRAMES) && kf_init(args.keyframe_every,
+		args.keyframe_bytes, args.output_max_size ? NULL : args.output_file) < 0)
+	{
+		QUIT(EXIT_FAILURE, "unable to initialize the keyframes!\n");
+	}
 
-		/*
-		 * Returning from a previous call.
-		 */
-		if (pc == f->return_addr)
-		{
-			fn_printf(current_depth, 0, "[depth: %d] Returning to function...\n\n",
-				current_depth);
+	/* Proceed execution. */
+	pt_continue_single_step(child);
 
-			/*
-			 * Since we're returning from an previous call, we also
-			 * need to free all (possible) arrays allocated first.
-			 */
-			var_deallocate_context(f->vars, context, current_depth);
+	t.tid = child;
+	t.context = context;
+	t.prev_bp = NULL;
+	t.init_vars = 0;
+	t.depth = 0;
 
-			/* Decrements the context and continues. */
-			depth--;
-			bp_skipbreakpoint(bp, child);
-			pt_continue(child);
-			continue;
-		}
+	if (ev_add(tracee_fd, EPOLLIN, on_tracee, &t) < 0 ||
+		ev_timer(OUTPUT_FLUSH_PERIOD, on_flush_timer, &t) < 0)
+		QUIT(EXIT_FAILURE, "unable to initialize the event loop!\n");
 
-		/*
-		 * If init_vars is set, means that its time to finally
-		 * initialize the vars right after the prologue in the
-		 * previous iteration.
-		 *
-		 * Even if the values are 'wrong', this ensures that we
-		 * have a knowlable value in beforehand before start
-		 * comparing values.
-		 */
-		if (init_vars)
-		{
-			fputc('\n', pbd_output);
-			fn_printf(current_depth, 0, "[depth: %d] Entering function...\n",
-				current_depth);
+	/* Regular files are never polled, they are always writable. */
+	if (out_pollable())
+		ev_add(out_fd(), 0, on_output, &t);
 
-			init_vars = 0;
-			var_initialize(f->vars, child);
-		}
+	if (args.flags & FLG_STATS)
+		ev_timer(STATS_PERIOD, on_stats_timer, NULL);
 
-		/* Do something. */
-		if (prev_bp != NULL)
-			var_check_changes(prev_bp, f->vars, child, current_depth);
+	/* Main loop. */
+	if (ev_run() < 0)
+		QUIT(EXIT_FAILURE, "event loop error!\n");
 
-		prev_bp = bp;
+	/* Finish everything. */
+	finish();
+}
 
-		/* Executes that breakpoint. */
-		bp_skipbreakpoint(bp, child);
+/**
+ * @brief Analyzes the target @p function along the series of
+ * core files given, instead of a live process.
+ *
+ * @param file Executable file.
+ * @param function Target function.
+ */
+static void core_analysis(const char *file, const char *function)
+{
+	struct function *f; /* Context function. */
+	int errors;         /* Unreadable cores. */
 
-		/* Continue. */
-		pt_continue(child);
-	}
+	setup(file, function);
+	select_cpu();
+
+	fprintf(pbd_output, "PBD (Printf Based Debugger) v%d.%d%s\n", MAJOR_VERSION,
+		MINOR_VERSION, RLSE_VERSION);
+	fprintf(pbd_output, "---------------------------------------\n");
+	fprintf(pbd_output, "Analyzing function %s, %zu core files:\n\n", function,
+		array_size(&args.cores));
+
+	f = array_get(&context, 0, NULL);
+	errors = cr_run(args.cores, f->vars, &dw.dw_func, lines);
 
-	/* Finish everything. */
 	finish();
+	exit(errors ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/**
+ * @brief Periodically reads the global variables of the target
+ * while it keeps running, without ever stopping it.
+ *
+ * @param file Executable file.
+ * @param function Target function.
+ * @param argv Arguments list.
+ */
+static void poll_analysis(const char *file, const char *function,
+	char **argv)
+{
+	struct function *f; /* Context function. */
+	int spawned;        /* Spawned by PBD?.  */
+	pid_t pid;          /* Target process.   */
+	int ret;
+
+	setup(file, function);
+	select_cpu();
+
+	/* Already running or a new (untraced) process. */
+	spawned = !args.poll_pid;
+	pid = args.poll_pid;
+	if (spawned && (pid = pl_spawnprocess(file, argv)) < 0)
+		QUIT(EXIT_FAILURE, "error while spawning the child process!\n");
+
+	fprintf(pbd_output, "PBD (Printf Based Debugger) v%d.%d%s\n", MAJOR_VERSION,
+		MINOR_VERSION, RLSE_VERSION);
+	fprintf(pbd_output, "---------------------------------------\n");
+	fprintf(pbd_output, "Polling the globals of %s (pid %d), every %d ms:\n\n",
+		function, (int)pid, args.poll_interval);
+
+	f = array_get(&context, 0, NULL);
+	ret = pl_run(pid, spawned, args.poll_interval,
+		args.flags & FLG_POLL_DOUBLE, f->vars);
+
+	if (ret < 0 && spawned)
+		kill(pid, SIGKILL);
+
+	finish();
+	exit(ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
 }
 
 /**
@@ -371,11 +1134,13 @@ static void dump_all(const char *prg_name)
 
 	/* Setup and spawns cihld. */
 	setup(args.executable, args.function);
+	setup_phase(NULL);
 	if ((child = pt_spawnprocess(args.executable, NULL)) < 0)
 		QUIT(EXIT_FAILURE, "error while spawning the child process!\n");
 
 	/* Wait for child process. */
 	pt_waitchild();
+	setup_phase("spawn");
 
 	fprintf(pbd_output, "PBD (Printf Based Debugger) v%d.%d%s\n", MAJOR_VERSION,
 		MINOR_VERSION, RLSE_VERSION);
@@ -392,11 +1157,22 @@ static void dump_all(const char *prg_name)
 	fprintf(pbd_output, "Lines:\n");
 	dw_lines_dump(lines);
 
+	/* Dump loops. */
+	if (args.flags & FLG_LOOP_SUMMARY)
+	{
+		fprintf(pbd_output, "\nLoops:\n");
+		lp_dump();
+	}
+
 	/* Break point list. */
 	fprintf(pbd_output, "\nBreakpoint list:\n");
+
+	/* Printing is not part of the setup, restart the timer. */
+	setup_phase(NULL);
 	breakpoints = (args.flags & FLG_STATIC_ANALYSIS) ?
 		static_analysis(filename, args.function, lines, dw.dw_func.low_pc) :
 		bp_createlist(lines);
+	setup_phase("breakpoints");
 
 	i = 0;
 	HASHTABLE_FOREACH(breakpoints, b_k, b_v,
@@ -468,35 +1244,234 @@ void usage(int retcode, const char *prg_name)
 	printf("                             are: c89, gnu89, c99, gnu99, c11 and gnu11.\n");
 	printf("                             (Default: gnu11)\n");
 
-	printf("\nSyntax highlighting options:\n");
-	printf("----------------------------\n");
-	printf("  -c --color                 Enables syntax highlight, this option only takes\n");
-	printf("                             effect while used together with --show-lines, Also\n");
-	printf("                             note that this option requires a 256-color\n");
-	printf("                             compatible terminal\n");
-	printf("\n");
-	printf("  -t  --theme <theme-file>   Select a theme file for the highlighting\n");
+	printf("\nSyntax highlighting options:\n");
+	printf("----------------------------\n");
+	printf("  -c --color                 Enables syntax highlight, this option only takes\n");
+	printf("                             effect while used together with --show-lines, Also\n");
+	printf("                             note that this option requires a 256-color\n");
+	printf("                             compatible terminal\n");
+	printf("\n");
+	printf("  -t  --theme <theme-file>   Select a theme file for the highlighting\n");
+
+	printf("\nNotes:\n");
+	printf("------\n");
+	printf("  - Options -i and -w are mutually exclusive!\n\n");
+	printf("  - The executable *must* be built without any optimization and with at\n"
+		   "    least -gdwarf-2 and no PIE! (if PIE enabled by default)");
+
+	printf("\n\nThe following options are for PBD internals:\n");
+	printf("  -d --dump-all    Dump all information gathered by the executable\n");
+
+	printf("\n\n'Unsafe' options:\n");
+	printf("-----------------\n");
+	printf("  The options below are meant to be used with caution, since they could lead\n"
+		   "  to wrong output.\n\n");
+
+	printf("  --avoid-equal-statements  If enabled, PBD will ignore all line statements\n"
+		   "                            that are 'duplicated', i.e: belongs to the same\n"
+		   "                            liner number, regardless its address.\n\n");
+
+	printf("  --fast-tracepoints        Replaces (when possible) the line breakpoints by\n"
+		   "                            jumps to code injected in the executable, that\n"
+		   "                            only stops when a variable changes. (x86_64 only)\n\n");
+
+	printf("  --threads <num>           Traces all the executable threads by using <num>\n"
+		   "                            tracer threads. Note that a thread may miss a line\n"
+		   "                            while another one is stepping over it in place;\n"
+		   "                            these steps are counted and reported at the end.\n\n");
+
+	printf("  --verify <N>              Checks 1 out of <N> stops with an exhaustive (and\n"
+		   "                            slow) comparison of all variables and reports any\n"
+		   "                            difference found against the regular output.\n"
+		   "                            With --fast-tracepoints, only the lines that trap\n"
+		   "                            are checked.\n\n");
+
+	printf("  --verify-random           Samples the stops of --verify randomly instead of\n"
+		   "                            every <N>th stop.\n\n");
+
+	printf("  --self-profile <file>     Samples the PBD own stacks while running and saves\n"
+		   "                            them into <file> as collapsed stacks, suitable for\n"
+		   "                            flamegraphs.\n\n");
+
+	printf("  --plugin <file.so>        Loads a native plugin, that receives all the changes\n"
+		   "                            before being printed and may suppress them or do\n"
+		   "                            its own output (see pbd_plugin.h). May be repeated.\n\n");
+
+	printf("  --stats                   Prints tracing statistics (stops/s, changes, output\n"
+		   "                            stalls...) every second and at the end, to stderr.\n\n");
+
+	printf("  --watch-region <spec>     Watches the raw memory range <spec>, in the form:\n"
+		   "                            addr:len[:elemsize[:s|u|f|x]], and reports the\n"
+		   "                            changed elements by its offset. May be repeated.\n\n");
+
+	printf("  --watch-mapping <spec>    Same as --watch-region, but for the writable\n"
+		   "                            segments of a mapping from /proc/<pid>/maps, e.g:\n"
+		   "                            [heap] or libfoo.so[:elemsize[:s|u|f|x]].\n\n");
+
+	printf("  --watch-heap[=<format>]   Intercepts malloc/calloc/realloc/free and watches\n"
+		   "                            the blocks allocated inside the function, until\n"
+		   "                            freed. <format> is elemsize[:s|u|f|x].\n\n");
+
+	printf("  --heap-site <function>    Also watches the blocks allocated directly from\n"
+		   "                            <function>, anywhere. May be repeated.\n\n");
+
+	printf("  --watch-linked <spec>     Watches a linked structure, like a list or tree,\n"
+		   "                            e.g: 'head->next*{val,key}:max=10000', and reports\n"
+		   "                            the nodes inserted, removed and modified. May be\n"
+		   "                            repeated.\n\n");
+
+	printf("  --bitmap <pattern>        Reports the integer variables (and arrays) whose\n"
+		   "                            names match <pattern> by its bits changed, like:\n"
+		   "                            +{5,17} -{9}. 'auto' matches names like *flag*,\n"
+		   "                            *mask* and *bitmap*. May be repeated.\n\n");
+
+	printf("  --strings[=<max>]         Reports the char arrays once per stop, as a whole,\n"
+		   "                            by its strings before and after (escaped, up to\n"
+		   "                            <max> characters, default: %d), instead of each\n"
+		   "                            byte changed.\n\n", SD_MAX_DEFAULT);
+
+	printf("  --strings-edit            Reports the strings by the range changed and its\n"
+		   "                            new content, instead. Implies --strings.\n\n");
+
+	printf("  --summary                 Instead of reporting each change, keeps statistics\n"
+		   "                            per variable (changes, min/max, mean, stddev,\n"
+		   "                            distinct values and quantiles), printed at the end\n"
+		   "                            or when PBD receives SIGUSR1.\n\n");
+
+	printf("  --heatmap[=<K>]           Counts the changes of each array element (or of\n"
+		   "                            each bucket, for huge arrays) and prints, at the\n"
+		   "                            end, the changes per dimension, the <K> hottest\n"
+		   "                            indexes (default: %d) and a text map of the 2-D\n"
+		   "                            arrays.\n\n", HM_TOP_DEFAULT);
+
+	printf("  --heatmap-pgm <prefix>    Also writes the heatmap of each 2-D array as a\n"
+		   "                            PGM image: <prefix><name>.pgm. Implies\n"
+		   "                            --heatmap.\n\n");
+
+	printf("  --transitions             Instead of reporting each change, counts the\n"
+		   "                            transitions between the enumerators of each enum\n"
+		   "                            variable, and prints, at the end, the transition\n"
+		   "                            matrices and where each transition first occurred.\n\n");
+
+	printf("  --transitions-dot <file>  Also writes the transitions as a DOT graph into\n"
+		   "                            <file>. Implies --transitions.\n\n");
+
+	printf("  --core <file> [file...]   Post-mortem mode: instead of running the\n"
+		   "                            executable, compares the variables along a\n"
+		   "                            series of core files (e.g: from gcore), e.g:\n"
+		   "                            --core a.core b.core <executable> <function>.\n"
+		   "                            Locals are read only if the function is on the\n"
+		   "                            stack.\n\n");
+
+	printf("  --poll <interval>         Stop-free mode: the target is never stopped nor\n"
+		   "                            traced, its globals are read every <interval> ms\n"
+		   "                            (with process_vm_readv) and the changes are\n"
+		   "                            reported with timestamps.\n\n");
+
+	printf("  --poll-pid <pid>          Polls the already running process <pid>, instead\n"
+		   "                            of running the executable.\n\n");
+
+	printf("  --poll-double-read        Reads the globals twice per poll, skipping the\n"
+		   "                            ones that keep changing between reads (torn).\n\n");
+
+	printf("  --fork-snapshot <bytes>   Arrays with at least <bytes> are compared in a\n"
+		   "                            forked (copy-on-write) copy of the executable, by\n"
+		   "                            worker threads, while it keeps running.\n\n");
 
-	printf("\nNotes:\n");
-	printf("------\n");
-	printf("  - Options -i and -w are mutually exclusive!\n\n");
-	printf("  - The executable *must* be built without any optimization and with at\n"
-		   "    least -gdwarf-2 and no PIE! (if PIE enabled by default)");
+	printf("  --libdwarf                Reads the debug information with libdwarf,\n"
+		   "                            instead of the internal DWARF reader.\n\n");
 
-	printf("\n\nThe following options are for PBD internals:\n");
-	printf("  -d --dump-all    Dump all information gathered by the executable\n");
+	printf("  --output-max-size <size>  Rotates the output file (-o) every <size> bytes\n"
+		   "                            (suffixes k, M and G allowed): <file>.1, .2...\n"
+		   "                            compressed in background (" RO_EXT ").\n\n");
 
-	printf("\n\n'Unsafe' options:\n");
-	printf("-----------------\n");
-	printf("  The options below are meant to be used with caution, since they could lead\n"
-		   "  to wrong output.\n\n");
+	printf("  --output-keep <N>         Keeps only the last <N> rotated files.\n\n");
 
-	printf("  --avoid-equal-statements  If enabled, PBD will ignore all line statements\n"
-		   "                            that are 'duplicated', i.e: belongs to the same\n"
-		   "                            liner number, regardless its address.\n\n");
+	printf("  --lz-decompress <file>    Decompresses a rotated .lz file to stdout.\n\n");
+
+	printf("  --keyframe-every <N>      Writes a keyframe (the full state of the watched\n"
+		   "                            variables) every <N> change events. With -o, also\n"
+		   "                            writes an index: <file>" KF_INDEX_EXT ".\n\n");
+
+	printf("  --keyframe-bytes <size>   Writes a keyframe every <size> bytes of output\n"
+		   "                            (suffixes k, M and G allowed).\n\n");
+
+	printf("  --arrow <file>            Writes the changes into <file>, as Apache Arrow\n"
+		   "                            record batches (IPC stream), instead of text.\n\n");
+
+	printf("  --reconstruct <file>:<N>  Prints the state of the watched variables at the\n"
+		   "                            change event <N> of the output <file>, from its\n"
+		   "                            nearest keyframe.\n\n");
+
+	printf("  --loop-summary            Reports each loop execution once, when the loop\n"
+		   "                            exits: iterations and variables changed, with\n"
+		   "                            their values at the loop entry and exit.\n\n");
+
+	printf("  --loop-detail             Also shows the changes of the first and last\n"
+		   "                            iterations of each loop (--loop-summary).\n\n");
 	exit(retcode);
 }
 
+/**
+ * @brief Converts the string @p s into a size, in bytes, with
+ * an optional suffix: k, M or G.
+ *
+ * @param out Size converted.
+ * @param s String to be converted.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int str2size(size_t *out, const char *s)
+{
+	unsigned long long size;
+	char *end;
+
+	if (!isdigit((unsigned char)s[0]))
+		return (-1);
+
+	errno = 0;
+	size = strtoull(s, &end, 10);
+	if (errno == ERANGE)
+		return (-1);
+
+	switch (*end)
+	{
+		case 'k': case 'K': size <<= 10; end++; break;
+		case 'm': case 'M': size <<= 20; end++; break;
+		case 'g': case 'G': size <<= 30; end++; break;
+		default: break;
+	}
+
+	if (*end != '\0' || size == 0 || size > SIZE_MAX)
+		return (-1);
+
+	*out = (size_t)size;
+	return (0);
+}
+
+/**
+ * @brief Decompresses the rotated output @p file (.lz) into
+ * the standard output and exits.
+ *
+ * @param file Compressed file.
+ */
+static void lz_cat(const char *file)
+{
+	FILE *in;
+	int ret;
+
+	if ((in = fopen(file, "rb")) == NULL)
+		QUIT(EXIT_FAILURE, "cannot open %s to read!\n", file);
+
+	ret = lz_decompress_file(in, stdout);
+	fclose(in);
+	fflush(stdout);
+
+	if (ret < 0)
+		QUIT(EXIT_FAILURE, "%s: invalid or corrupted file!\n", file);
+	exit(EXIT_SUCCESS);
+}
+
 /**
  * Program version.
  */
@@ -589,6 +1564,41 @@ static void readargs(int argc, char **argv)
 		{"theme",                  't', OPTPARSE_REQUIRED},
 		{"dump-all",               'd',     OPTPARSE_NONE},
 		{"avoid-equal-statements", 255,     OPTPARSE_NONE},
+		{"fast-tracepoints",       252,     OPTPARSE_NONE},
+		{"threads",                251, OPTPARSE_REQUIRED},
+		{"verify",                 250, OPTPARSE_REQUIRED},
+		{"verify-random",          249,     OPTPARSE_NONE},
+		{"self-profile",           248, OPTPARSE_REQUIRED},
+		{"plugin",                 247, OPTPARSE_REQUIRED},
+		{"stats",                  246,     OPTPARSE_NONE},
+		{"watch-region",           245, OPTPARSE_REQUIRED},
+		{"watch-mapping",          244, OPTPARSE_REQUIRED},
+		{"watch-heap",             243, OPTPARSE_OPTIONAL},
+		{"heap-site",              242, OPTPARSE_REQUIRED},
+		{"bitmap",                 241, OPTPARSE_REQUIRED},
+		{"strings",                219, OPTPARSE_OPTIONAL},
+		{"strings-edit",           218,     OPTPARSE_NONE},
+		{"summary",                240,     OPTPARSE_NONE},
+		{"core",                   239, OPTPARSE_REQUIRED},
+		{"poll",                   238, OPTPARSE_REQUIRED},
+		{"poll-pid",               237, OPTPARSE_REQUIRED},
+		{"poll-double-read",       236,     OPTPARSE_NONE},
+		{"fork-snapshot",          235, OPTPARSE_REQUIRED},
+		{"libdwarf",               234,     OPTPARSE_NONE},
+		{"output-max-size",        233, OPTPARSE_REQUIRED},
+		{"output-keep",            232, OPTPARSE_REQUIRED},
+		{"lz-decompress",          231, OPTPARSE_REQUIRED},
+		{"loop-summary",           230,     OPTPARSE_NONE},
+		{"loop-detail",            229,     OPTPARSE_NONE},
+		{"watch-linked",           228, OPTPARSE_REQUIRED},
+		{"heatmap",                227, OPTPARSE_OPTIONAL},
+		{"heatmap-pgm",            226, OPTPARSE_REQUIRED},
+		{"keyframe-every",         225, OPTPARSE_REQUIRED},
+		{"keyframe-bytes",         224, OPTPARSE_REQUIRED},
+		{"reconstruct",            223, OPTPARSE_REQUIRED},
+		{"arrow",                  222, OPTPARSE_REQUIRED},
+		{"transitions",            221,     OPTPARSE_NONE},
+		{"transitions-dot",        220, OPTPARSE_REQUIRED},
 		{0,0,0}
 	};
 
@@ -765,6 +1775,309 @@ static void readargs(int argc, char **argv)
 				args.flags |= FLG_IGNR_EQSTAT;
 				break;
 
+			/* Fast tracepoints, i.e: jump-patched lines. */
+			case 252:
+#if !defined(__x86_64__)
+				fprintf(stderr, "%s: --fast-tracepoints is only supported "
+					"on x86_64!\n\n", argv[0]);
+				usage(EXIT_FAILURE, argv[0]);
+#endif
+				args.flags |= FLG_FAST_TRACEPOINTS;
+				break;
+
+			/* Amount of tracer threads, for multi-threaded executables. */
+			case 251:
+				if (str2int(&args.threads, options.optarg) < 0 ||
+					args.threads < 1 || args.threads > TR_MAX_THREADS)
+				{
+					fprintf(stderr, "%s: --threads: number (%s) should be "
+						"between 1 and %d!\n", argv[0], options.optarg,
+						TR_MAX_THREADS);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				break;
+
+			/* Shadow verification, 1 out of N stops. */
+			case 250:
+				if (str2int(&args.verify_rate, options.optarg) < 0 ||
+					args.verify_rate < 1)
+				{
+					fprintf(stderr, "%s: --verify: rate (%s) should be a "
+						"positive number!\n", argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.flags |= FLG_VERIFY;
+				break;
+
+			/* Random sampling for verification. */
+			case 249:
+				args.flags |= FLG_VERIFY_RANDOM;
+				break;
+
+			/* Tracing statistics. */
+			case 246:
+				args.flags |= FLG_STATS;
+				break;
+
+			/* Native plugin. */
+			case 247:
+				if (plugin_load(options.optarg) < 0)
+					usage(EXIT_FAILURE, argv[0]);
+				args.flags |= FLG_PLUGIN;
+				break;
+
+			/* Raw address range. */
+			case 245:
+				if (rg_add_range(options.optarg) < 0)
+					usage(EXIT_FAILURE, argv[0]);
+				args.flags |= FLG_WATCH_REGION;
+				break;
+
+			/* Named mapping. */
+			case 244:
+				if (rg_add_mapping(options.optarg) < 0)
+					usage(EXIT_FAILURE, argv[0]);
+				args.flags |= FLG_WATCH_REGION;
+				break;
+
+			/* Heap blocks. */
+			case 243:
+				if (options.optarg && hp_set_format(options.optarg) < 0)
+					usage(EXIT_FAILURE, argv[0]);
+				args.flags |= FLG_WATCH_HEAP;
+				break;
+
+			/* Functions whose allocations are always watched. */
+			case 242:
+				if (hp_add_site(options.optarg) < 0)
+					usage(EXIT_FAILURE, argv[0]);
+				args.flags |= FLG_WATCH_HEAP;
+				break;
+
+			/* Linked structures. */
+			case 228:
+				if (lk_add(options.optarg) < 0)
+					usage(EXIT_FAILURE, argv[0]);
+				args.flags |= FLG_WATCH_LINKED;
+				break;
+
+			/* Stop-free polling, interval in ms. */
+			case 238:
+				if (str2int(&args.poll_interval, options.optarg) < 0 ||
+					args.poll_interval < 1)
+				{
+					fprintf(stderr, "%s: --poll: interval (%s) should be a "
+						"positive number of milliseconds!\n", argv[0],
+						options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.flags |= FLG_POLL;
+				break;
+
+			/* Polls an already running process. */
+			case 237:
+			{
+				int pid;
+				if (str2int(&pid, options.optarg) < 0 || pid < 1)
+				{
+					fprintf(stderr, "%s: --poll-pid: invalid pid (%s)!\n",
+						argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.poll_pid = pid;
+				break;
+			}
+
+			/* Double-read check, while polling. */
+			case 236:
+				args.flags |= FLG_POLL_DOUBLE;
+				break;
+
+			/* Large arrays compared in a forked copy. */
+			case 235:
+				if (str2int(&args.snapshot_min, options.optarg) < 0 ||
+					args.snapshot_min < 1)
+				{
+					fprintf(stderr, "%s: --fork-snapshot: size (%s) should be a "
+						"positive number of bytes!\n", argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.flags |= FLG_FORK_SNAPSHOT;
+				break;
+
+			/* Rotating output. */
+			case 233:
+				if (str2size(&args.output_max_size, options.optarg) < 0)
+				{
+					fprintf(stderr, "%s: --output-max-size: invalid size (%s)!\n",
+						argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				break;
+
+			/* Keyframes, every N events. */
+			case 225:
+				if (str2int(&args.keyframe_every, options.optarg) < 0 ||
+					args.keyframe_every < 1)
+				{
+					fprintf(stderr, "%s: --keyframe-every: number (%s) should be "
+						"positive!\n", argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.flags |= FLG_KEYFRAMES;
+				break;
+
+			/* Keyframes, every M bytes. */
+			case 224:
+				if (str2size(&args.keyframe_bytes, options.optarg) < 0 ||
+					!args.keyframe_bytes)
+				{
+					fprintf(stderr, "%s: --keyframe-bytes: invalid size (%s)!\n",
+						argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.flags |= FLG_KEYFRAMES;
+				break;
+
+			/* Columnar output file. */
+			case 222:
+				if (args.arrow_file != NULL)
+					free(args.arrow_file);
+
+				args.arrow_file = malloc(sizeof(char) *
+					(strlen(options.optarg) + 1));
+
+				strcpy(args.arrow_file, options.optarg);
+				args.flags |= FLG_ARROW;
+				break;
+
+			/* State at a given event. */
+			case 223:
+				kf_reconstruct(options.optarg);
+				break;
+
+			/* Rotated files kept. */
+			case 232:
+				if (str2int(&args.output_keep, options.optarg) < 0 ||
+					args.output_keep < 1)
+				{
+					fprintf(stderr, "%s: --output-keep: number (%s) should be "
+						"positive!\n", argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				break;
+
+			/* Decompress a rotated file. */
+			case 231:
+				lz_cat(options.optarg);
+				break;
+
+			/* Loop records. */
+			case 230:
+				args.flags |= FLG_LOOP_SUMMARY;
+				break;
+
+			case 229:
+				args.flags |= FLG_LOOP_DETAIL;
+				break;
+
+			/* Always use libdwarf. */
+			case 234:
+				args.flags |= FLG_LIBDWARF;
+				break;
+
+			/* Post-mortem mode, core files. */
+			case 239:
+				if (args.cores == NULL)
+					array_init(&args.cores);
+				array_add(&args.cores, options.optarg);
+				args.flags |= FLG_CORE;
+				break;
+
+			/* Statistics-only mode. */
+			case 240:
+				args.flags |= FLG_SUMMARY;
+				break;
+
+			/* Arrays heatmaps, hottest indexes listed. */
+			case 227:
+				if (options.optarg && (str2int(&args.heatmap_top,
+					options.optarg) < 0 || args.heatmap_top < 1))
+				{
+					fprintf(stderr, "%s: --heatmap: number (%s) should be "
+						"positive!\n", argv[0], options.optarg);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.flags |= FLG_HEATMAP;
+				break;
+
+			/* Enum transition matrices. */
+			case 221:
+				args.flags |= FLG_TRANSITIONS;
+				break;
+
+			/* Transitions DOT graph. */
+			case 220:
+				if (args.transitions_dot != NULL)
+					free(args.transitions_dot);
+
+				args.transitions_dot = malloc(sizeof(char) *
+					(strlen(options.optarg) + 1));
+
+				strcpy(args.transitions_dot, options.optarg);
+				args.flags |= FLG_TRANSITIONS;
+				break;
+
+			/* Heatmaps images prefix. */
+			case 226:
+				if (args.heatmap_pgm != NULL)
+					free(args.heatmap_pgm);
+
+				args.heatmap_pgm = malloc(sizeof(char) *
+					(strlen(options.optarg) + 1));
+
+				strcpy(args.heatmap_pgm, options.optarg);
+				args.flags |= FLG_HEATMAP;
+				break;
+
+			/* Variables reported as bitmaps. */
+			case 241:
+				if (bm_add_pattern(options.optarg) < 0)
+					usage(EXIT_FAILURE, argv[0]);
+				args.flags |= FLG_BITMAP;
+				break;
+
+			/* Char arrays reported as strings, characters shown. */
+			case 219:
+				if (options.optarg && (str2int(&args.strings_max,
+					options.optarg) < 0 || args.strings_max < 1 ||
+					args.strings_max > SD_MAX_LENGTH))
+				{
+					fprintf(stderr, "%s: --strings: number (%s) should be "
+						"between 1 and %d!\n", argv[0], options.optarg,
+						SD_MAX_LENGTH);
+					usage(EXIT_FAILURE, argv[0]);
+				}
+				args.flags |= FLG_STRINGS;
+				break;
+
+			/* Strings reported by the range changed. */
+			case 218:
+				args.strings_edit = 1;
+				args.flags |= FLG_STRINGS;
+				break;
+
+			/* Self-profiler output file. */
+			case 248:
+				if (args.self_profile != NULL)
+					free(args.self_profile);
+
+				args.self_profile = malloc(sizeof(char) *
+					(strlen(options.optarg) + 1));
+
+				strcpy(args.self_profile, options.optarg);
+				break;
+
 			/* Unknown command. */
 			case '?':
 				fprintf(stderr, "%s: %s\n\n", argv[0], options.errmsg);
@@ -789,6 +2102,140 @@ out:
 		usage(EXIT_FAILURE, argv[0]);
 	}
 
+	/* Fast tracepoints keep a single 'last line' for the whole process. */
+	if (args.threads && (args.flags & FLG_FAST_TRACEPOINTS))
+	{
+		fprintf(stderr, "%s: options --threads and --fast-tracepoints are "
+			"mutually exclusive!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/* Fast tracepoints only stop when a variable has changed. */
+	if ((args.flags & (FLG_WATCH_REGION|FLG_WATCH_HEAP|FLG_WATCH_LINKED)) &&
+		(args.flags & FLG_FAST_TRACEPOINTS))
+	{
+		fprintf(stderr, "%s: options --watch-region/--watch-mapping/"
+			"--watch-heap/--watch-linked and --fast-tracepoints are mutually "
+			"exclusive!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/* Linked structures keep a single traversal. */
+	if ((args.flags & FLG_WATCH_LINKED) && args.threads)
+	{
+		fprintf(stderr, "%s: options --watch-linked and --threads are "
+			"mutually exclusive!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/*
+	 * The snapshot copy is created with clone(), which would be
+	 * seen as a new thread, and arrays compared in background are
+	 * not seen by the fast tracepoints nor by the verification.
+	 */
+	if ((args.flags & FLG_FORK_SNAPSHOT) && (args.threads ||
+		(args.flags & (FLG_FAST_TRACEPOINTS|FLG_VERIFY))))
+	{
+		fprintf(stderr, "%s: option --fork-snapshot is mutually exclusive "
+			"with --threads, --fast-tracepoints and --verify!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/*
+	 * Keyframes are written per stop, in the default output
+	 * format, along with the changes they account.
+	 */
+	if ((args.flags & FLG_KEYFRAMES) && (args.threads ||
+		(args.flags & (FLG_SHOW_LINES|FLG_SUMMARY|FLG_LOOP_SUMMARY|
+		FLG_FORK_SNAPSHOT|FLG_CORE|FLG_POLL|FLG_STRINGS))))
+	{
+		fprintf(stderr, "%s: keyframes are mutually exclusive with -s, "
+			"--threads, --summary, --loop-summary, --fork-snapshot, --core, "
+			"--poll and --strings!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/* The Arrow output replaces the per-change line printer. */
+	if ((args.flags & FLG_ARROW) &&
+		(args.flags & (FLG_SHOW_LINES|FLG_SUMMARY|FLG_LOOP_SUMMARY)))
+	{
+		fprintf(stderr, "%s: option --arrow is mutually exclusive with -s, "
+			"--summary and --loop-summary!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/* Transitions are accounted instead of reporting each change. */
+	if ((args.flags & FLG_TRANSITIONS) &&
+		(args.flags & (FLG_SHOW_LINES|FLG_SUMMARY|FLG_LOOP_SUMMARY|
+		FLG_ARROW|FLG_KEYFRAMES|FLG_CORE)))
+	{
+		fprintf(stderr, "%s: option --transitions is mutually exclusive with "
+			"-s, --summary, --loop-summary, --arrow, keyframes and --core!"
+			"\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/* Strings: default amount of characters shown. */
+	if ((args.flags & FLG_STRINGS) && !args.strings_max)
+		args.strings_max = SD_MAX_DEFAULT;
+
+	/* Heatmaps: default amount of hottest indexes. */
+	if ((args.flags & FLG_HEATMAP) && !args.heatmap_top)
+		args.heatmap_top = HM_TOP_DEFAULT;
+
+	/* Rotation requires an output file. */
+	if (args.output_max_size && args.output_file == NULL)
+	{
+		fprintf(stderr, "%s: option --output-max-size only works if used"
+			" together with -o!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	if (args.output_keep && !args.output_max_size)
+	{
+		fprintf(stderr, "%s: option --output-keep only works if used"
+			" together with --output-max-size!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/*
+	 * Loops are followed line by line, per function context, so
+	 * every line should stop and every change should be seen by
+	 * the tracer itself.
+	 */
+	if ((args.flags & FLG_LOOP_SUMMARY) && (args.threads ||
+		(args.flags & (FLG_FAST_TRACEPOINTS|FLG_SUMMARY|FLG_FORK_SNAPSHOT))))
+	{
+		fprintf(stderr, "%s: option --loop-summary is mutually exclusive "
+			"with --threads, --fast-tracepoints, --summary and "
+			"--fork-snapshot!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	if ((args.flags & FLG_LOOP_DETAIL) && !(args.flags & FLG_LOOP_SUMMARY))
+	{
+		fprintf(stderr, "%s: option --loop-detail only works if used"
+			" together with --loop-summary!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/* Polling options require --poll. */
+	if ((args.poll_pid || (args.flags & FLG_POLL_DOUBLE)) &&
+		!(args.flags & FLG_POLL))
+	{
+		fprintf(stderr, "%s: options --poll-pid and --poll-double-read only "
+			"work if used together with --poll!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
+	/* Random sampling requires verification. */
+	if ((args.flags & FLG_VERIFY_RANDOM) && !(args.flags & FLG_VERIFY))
+	{
+		fprintf(stderr, "%s: option --verify-random only works if used"
+			" together with --verify!\n\n", argv[0]);
+		usage(EXIT_FAILURE, argv[0]);
+	}
+
 	/* Check if context enabled. */
 	if (args.context != 0 && !(args.flags & FLG_SHOW_LINES))
 	{
@@ -797,10 +2244,34 @@ out:
 		usage(EXIT_FAILURE, argv[0]);
 	}
 
+	/*
+	 * Post-mortem mode: the last two arguments are the executable
+	 * and function, everything before them are more core files.
+	 */
+	if (args.flags & FLG_CORE)
+	{
+		char *arg;
+		while ((arg = optparse_arg(&options)) != NULL)
+			array_add(&args.cores, arg);
+
+		if (array_size(&args.cores) < 3)
+		{
+			fprintf(stderr, "%s: option --core expects: --core <core-file> "
+				"[core-file...] <executable> <function>\n\n", argv[0]);
+			usage(EXIT_FAILURE, argv[0]);
+		}
+
+		args.function = array_remove_last(&args.cores, NULL);
+		args.executable = array_remove_last(&args.cores, NULL);
+	}
+
 	/* Print remaining arguments. */
-	args.executable = optparse_arg(&options);
-	args.function = optparse_arg(&options);
-	args.argv = options.argv + options.optind - 1;
+	else
+	{
+		args.executable = optparse_arg(&options);
+		args.function = optparse_arg(&options);
+		args.argv = options.argv + options.optind - 1;
+	}
 
 	/*
 	 * Reverse arguments order.
@@ -815,6 +2286,10 @@ out:
 	if ( !(args.flags & (FLG_ONLY_GLOBALS|FLG_ONLY_LOCALS)) )
 		args.flags |= FLG_ONLY_GLOBALS|FLG_ONLY_LOCALS;
 
+	/* Shadow verification. */
+	if (args.flags & FLG_VERIFY)
+		vf_init(args.verify_rate, args.flags & FLG_VERIFY_RANDOM);
+
 	/* If ignore list, lets parse each variable. */
 	if (args.flags & (FLG_IGNR_LIST|FLG_WATCH_LIST))
 		args.iw_list.ht_list = parse_list(args.iw_list.list);
@@ -859,6 +2334,21 @@ int main(int argc, char **argv)
 		usage(EXIT_FAILURE, argv[0]);
 	}
 
+	/*
+	 * Profile PBD itself?, for all the modes: they all stop the
+	 * profiler at finish().
+	 */
+	if (args.self_profile != NULL && prof_start(args.self_profile) < 0)
+		fprintf(stderr, "PBD: unable to start the self-profiler!\n");
+
+	/* Post-mortem analysis. */
+	if (args.flags & FLG_CORE)
+		core_analysis(args.executable, args.function);
+
+	/* Stop-free polling. */
+	if (args.flags & FLG_POLL)
+		poll_analysis(args.executable, args.function, args.argv);
+
 	/* CPU dispatcher. */
 	select_cpu();
 
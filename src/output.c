@@ -0,0 +1,377 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include "output.h"
+#include "probes.h"
+#include "rotate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Output state. */
+static struct out
+{
+	FILE *orig;        /* Original stream.            */
+	FILE *stream;      /* Buffered stream.            */
+	int fd;            /* Output file descriptor.     */
+	int private_fd;    /* Own open file description?. */
+	int pollable;      /* Pipe, socket or terminal?.  */
+	int rotate;        /* Rotating output?.           */
+	char *buf;         /* Pending data.               */
+	size_t start;      /* First pending byte.         */
+	size_t end;        /* Last pending byte + 1.      */
+	size_t cap;        /* Buffer capacity.            */
+	size_t written;    /* Bytes written.              */
+	size_t stalls;     /* Writes that would block.    */
+	off_t base;        /* File offset at init.        */
+} out = {.fd = -1};
+
+/**
+ * @brief Writes as much pending data as possible into the
+ * output file descriptor.
+ *
+ * @param block If set, waits until everything is written.
+ *
+ * @return Returns the amount of bytes still pending, or a
+ * negative number if error (the pending data is discarded).
+ */
+static int out_drain(int block)
+{
+	struct pollfd pfd; /* Poll fd.        */
+	size_t written;    /* Total written.  */
+	ssize_t n;         /* Bytes written.  */
+
+	written = out.written;
+
+	while (out.start < out.end)
+	{
+		/* The writer thread does the actual writes. */
+		if (out.rotate)
+		{
+			n = ro_write(out.buf + out.start, out.end - out.start, block);
+			out.start   += n;
+			out.written += n;
+			if (out.start < out.end)
+				out.stalls++;
+			break;
+		}
+
+		n = write(out.fd, out.buf + out.start, out.end - out.start);
+		if (n > 0)
+		{
+			out.start   += n;
+			out.written += n;
+			continue;
+		}
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			out.stalls++;
+			if (!block)
+				break;
+
+			pfd.fd = out.fd;
+			pfd.events = POLLOUT;
+			poll(&pfd, 1, -1);
+			continue;
+		}
+
+		/* Unrecoverable error, e.g: EPIPE. */
+		out.start = out.end = 0;
+		return (-1);
+	}
+
+	if (out.written != written)
+		PBD_PROBE2(output_flush, out.written - written, out.end - out.start);
+
+	if (out.start == out.end)
+		out.start = out.end = 0;
+
+	return ((int)(out.end - out.start));
+}
+
+/**
+ * @brief Buffered stream write function: appends @p data
+ * into the pending buffer.
+ *
+ * @param cookie Unused.
+ * @param data Data to be written.
+ * @param len Data length.
+ *
+ * @return Returns @p len, or -1 if out of memory.
+ */
+static ssize_t out_write(void *cookie, const char *data, size_t len)
+{
+	size_t pending; /* Pending bytes. */
+	((void)cookie);
+
+	pending = out.end - out.start;
+
+	/* Reclaim the space already written, or grow. */
+	if (out.end + len > out.cap)
+	{
+		if (out.start)
+		{
+			memmove(out.buf, out.buf + out.start, pending);
+			out.start = 0;
+			out.end   = pending;
+		}
+
+		if (out.end + len > out.cap)
+		{
+			size_t cap = out.cap ? out.cap : OUT_WRITE_THRESHOLD;
+			char *buf;
+
+			while (out.end + len > cap)
+				cap *= 2;
+
+			if ((buf = realloc(out.buf, cap)) == NULL)
+				return (-1);
+
+			out.buf = buf;
+			out.cap = cap;
+		}
+	}
+
+	memcpy(out.buf + out.end, data, len);
+	out.end += len;
+
+	/*
+	 * Regular files never block, so there is no need to wait for
+	 * the event loop.
+	 */
+	if (out.end - out.start >= OUT_WRITE_THRESHOLD)
+		out_drain(!out.pollable && !out.rotate);
+
+	return (len);
+}
+
+/**
+ * @brief Opens a private (non-blocking) open file description
+ * of the output file descriptor @p fd.
+ *
+ * O_NONBLOCK belongs to the open file description, and not to
+ * the file descriptor, and the description of the PBD output
+ * (i.e: the same pipe or terminal) is likely shared with the
+ * child, which would then see its own writes failing with
+ * EAGAIN. A new description, opened through /proc, is not.
+ *
+ * @param fd Output file descriptor.
+ *
+ * @return Returns the new file descriptor, or a negative
+ * number if not possible (e.g: sockets).
+ */
+static int out_open_private(int fd)
+{
+	char path[32]; /* /proc path. */
+
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	return (open(path, O_WRONLY|O_NONBLOCK|O_CLOEXEC));
+}
+
+/**
+ * @brief Replaces the output stream @p stream by a buffered,
+ * non-blocking, stream.
+ *
+ * @param stream Output stream, changed in place.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int out_init(FILE **stream)
+{
+	cookie_io_functions_t io; /* Stream functions. */
+	struct stat st;           /* Output status.    */
+	int fd;                   /* Private fd.       */
+
+	fflush(*stream);
+	out.fd = fileno(*stream);
+	if (out.fd < 0 || fstat(out.fd, &st) < 0)
+		return (-1);
+
+	memset(&io, 0, sizeof(io));
+	io.write = out_write;
+	if ((out.stream = fopencookie(NULL, "w", io)) == NULL)
+		return (-1);
+
+	/* Only pipes, sockets and terminals may block. */
+	out.pollable = S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) ||
+		S_ISCHR(st.st_mode);
+
+	/* Regular files: data written before, e.g: the header. */
+	out.base = lseek(out.fd, 0, SEEK_CUR);
+	if (out.base < 0)
+		out.base = 0;
+
+	/*
+	 * If a private description cannot be opened, the output is
+	 * written in blocking mode, like regular files.
+	 */
+	if (out.pollable)
+	{
+		if ((fd = out_open_private(out.fd)) >= 0)
+		{
+			out.fd = fd;
+			out.private_fd = 1;
+		}
+		else
+			out.pollable = 0;
+	}
+
+	out.orig = *stream;
+	*stream  = out.stream;
+	return (0);
+}
+
+/**
+ * @brief Output file descriptor.
+ *
+ * @return Returns the output file descriptor.
+ */
+int out_fd(void)
+{
+	return (out.fd);
+}
+
+/**
+ * @brief Checks if the output may block, i.e: if it should
+ * be polled.
+ *
+ * @return Returns 1 if pollable and 0 otherwise.
+ */
+int out_pollable(void)
+{
+	return (out.pollable);
+}
+
+/**
+ * @brief Amount of bytes waiting to be written.
+ *
+ * @return Returns the amount of pending bytes.
+ */
+size_t out_pending(void)
+{
+	return (out.end - out.start);
+}
+
+/**
+ * @brief Flushes the buffered stream and writes the pending
+ * data.
+ *
+ * @param block If set, waits until everything is written.
+ *
+ * @return Returns the amount of bytes still pending, or a
+ * negative number if error.
+ */
+int out_flush(int block)
+{
+	if (out.stream == NULL)
+		return (0);
+
+	fflush(out.stream);
+	return (out_drain(block || (!out.pollable && !out.rotate)));
+}
+
+/**
+ * @brief Offset, in the output file, of the next byte written
+ * to the stream, i.e: after everything buffered.
+ *
+ * @return Returns the output offset.
+ */
+size_t out_offset(void)
+{
+	if (out.stream == NULL)
+		return (0);
+
+	fflush(out.stream);
+	return ((size_t)out.base + out.written + (out.end - out.start));
+}
+
+/**
+ * @brief Rotates the output file @p path (already the output)
+ * every @p max_size bytes, see rotate.h.
+ *
+ * @param path Output file.
+ * @param max_size Maximum size, per file.
+ * @param keep Amount of rotated files kept, 0 means all.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int out_rotate(const char *path, size_t max_size, int keep)
+{
+	/* Only regular files. */
+	if (out.stream == NULL || out.pollable)
+		return (-1);
+
+	if (ro_init(out.fd, path, max_size, keep) < 0)
+		return (-1);
+
+	out.rotate = 1;
+	return (0);
+}
+
+/**
+ * @brief Output statistics.
+ *
+ * @param st Statistics structure to be filled.
+ */
+void out_get_stats(struct out_stats *st)
+{
+	st->written = out.written;
+	st->pending = out.end - out.start;
+	st->stalls  = out.stalls;
+}
+
+/**
+ * @brief Writes everything and restores the original stream.
+ *
+ * @param stream Output stream, changed in place.
+ */
+void out_finish(FILE **stream)
+{
+	if (out.stream == NULL)
+		return;
+
+	out_flush(1);
+	fclose(out.stream);
+
+	if (out.rotate)
+		ro_finish();
+
+	if (out.private_fd)
+		close(out.fd);
+
+	*stream = out.orig;
+	free(out.buf);
+	memset(&out, 0, sizeof(out));
+	out.fd = -1;
+}
@@ -0,0 +1,276 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Native plugins.
+ *
+ * Plugins (see pbd_plugin.h) are loaded with dlopen() and
+ * receive the changes right before the formatting, so they
+ * may suppress, or aggregate, them.
+ */
+
+#define _GNU_SOURCE
+#include "plugin.h"
+#include "pbd_plugin.h"
+#include "pbd.h"
+#include "ptrace.h"
+
+#include <dlfcn.h>
+#include <stdarg.h>
+
+/*
+ * The values are handed to the plugins as-is, so both unions
+ * must have the same layout.
+ */
+typedef char plugin_value_size_check[
+	(sizeof(union pbd_value) == sizeof(union var_value)) ? 1 : -1];
+
+/**
+ * @brief Loaded plugin.
+ */
+struct plugin
+{
+	void *handle;                    /* dlopen() handle.    */
+	const struct pbd_plugin *ops;    /* Plugin callbacks.   */
+	void *data;                      /* Plugin data.        */
+	int started;                     /* Session started?.   */
+};
+
+/* Loaded plugins. */
+static struct plugin plugins[PLUGIN_MAX];
+static int nplugins;
+
+/**
+ * @brief Reads @p len bytes from the tracee memory.
+ *
+ * @param tid Thread id.
+ * @param addr Tracee address.
+ * @param buf Destination buffer.
+ * @param len Amount of bytes to be read.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int plugin_read_memory(pid_t tid, uintptr_t addr, void *buf,
+	size_t len)
+{
+	return (pt_readmemory_buf(tid, addr, buf, len));
+}
+
+/**
+ * @brief Writes into the PBD output.
+ *
+ * @param fmt Format.
+ *
+ * @return Returns the amount of characters written.
+ */
+static int plugin_emit(const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = vfprintf(pbd_output, fmt, ap);
+	va_end(ap);
+	return (ret);
+}
+
+/* PBD services. */
+static const struct pbd_host host = {
+	.abi           = PBD_PLUGIN_ABI,
+	.read_memory   = plugin_read_memory,
+	.frame_pointer = pt_readregister_bp,
+	.emit          = plugin_emit
+};
+
+/**
+ * @brief Loads the plugin @p file.
+ *
+ * @param file Shared object path.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int plugin_load(const char *file)
+{
+	pbd_plugin_init_fn init;  /* Entry point.  */
+	struct plugin *p;         /* New plugin.   */
+
+	if (nplugins == PLUGIN_MAX)
+	{
+		fprintf(stderr, "PBD: too many plugins, max: %d\n", PLUGIN_MAX);
+		return (-1);
+	}
+
+	p = &plugins[nplugins];
+	if ((p->handle = dlopen(file, RTLD_NOW|RTLD_LOCAL)) == NULL)
+	{
+		fprintf(stderr, "PBD: unable to load plugin: %s\n", dlerror());
+		return (-1);
+	}
+
+	*(void **)(&init) = dlsym(p->handle, "pbd_plugin_init");
+	if (init == NULL)
+	{
+		fprintf(stderr, "PBD: plugin %s: pbd_plugin_init() not found!\n",
+			file);
+		goto err0;
+	}
+
+	p->ops = init(PBD_PLUGIN_ABI);
+	if (p->ops == NULL || p->ops->abi != PBD_PLUGIN_ABI)
+	{
+		fprintf(stderr, "PBD: plugin %s: unsupported ABI version, expected:"
+			" %d\n", file, PBD_PLUGIN_ABI);
+		goto err0;
+	}
+
+	nplugins++;
+	return (0);
+
+err0:
+	dlclose(p->handle);
+	p->handle = NULL;
+	return (-1);
+}
+
+/**
+ * @brief Starts the session for all plugins.
+ *
+ * @param pid Traced process.
+ * @param executable Executable file.
+ * @param function Function being analyzed.
+ * @param source Source file, if known.
+ * @param vars Variables list.
+ */
+void plugin_session_start(pid_t pid, const char *executable,
+	const char *function, const char *source, struct array *vars)
+{
+	struct pbd_session session;  /* Session info. */
+
+	session.pid        = pid;
+	session.executable = executable;
+	session.function   = function;
+	session.source     = source;
+	session.nvars      = (int) array_size(&vars);
+
+	for (int i = 0; i < nplugins; i++)
+	{
+		struct plugin *p = &plugins[i];
+		if (p->ops->session_start &&
+			p->ops->session_start(&host, &session, &p->data))
+		{
+			fprintf(stderr, "PBD: plugin %s refused to start, ignoring...\n",
+				p->ops->name ? p->ops->name : "(unnamed)");
+			continue;
+		}
+		p->started = 1;
+	}
+}
+
+/**
+ * @brief Notifies all plugins about a line stop.
+ *
+ * @param tid Stopped thread.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ */
+void plugin_stop(pid_t tid, unsigned line_no, int depth)
+{
+	for (int i = 0; i < nplugins; i++)
+		if (plugins[i].started && plugins[i].ops->stop)
+			plugins[i].ops->stop(plugins[i].data, tid, line_no, depth);
+}
+
+/**
+ * @brief Notifies all plugins about a variable change.
+ *
+ * @param tid Thread id.
+ * @param depth Function depth.
+ * @param line_no Line number.
+ * @param v Changed variable.
+ * @param v_before Value before.
+ * @param v_after Value after.
+ * @param array_idxs Element indexes, if array, NULL otherwise.
+ *
+ * @return Returns PBD_PLUGIN_SUPPRESS if any plugin has
+ * suppressed the change, PBD_PLUGIN_EMIT otherwise.
+ */
+int plugin_change(pid_t tid, int depth, unsigned line_no,
+	struct dw_variable *v, union var_value *v_before,
+	union var_value *v_after, int *array_idxs)
+{
+	struct pbd_change change;  /* Change.     */
+	struct pbd_var var;        /* Variable.   */
+	int ret;                   /* Decision.   */
+
+	var.name          = v->name;
+	var.scope         = v->scope;
+	var.type          = v->type.var_type;
+	var.encoding      = v->type.encoding;
+	var.byte_size     = v->byte_size;
+	var.location      = (v->scope == VGLOBAL) ?
+		(intptr_t)v->location.address : (intptr_t)v->location.fp_offset;
+	var.elem_type     = v->type.array.var_type;
+	var.elem_encoding = v->type.encoding;
+	var.elem_size     = v->type.array.size_per_element;
+	var.dimensions    = v->type.array.dimensions;
+	var.elems_per_dim = v->type.array.elements_per_dimension;
+
+	change.tid     = tid;
+	change.depth   = depth;
+	change.line_no = line_no;
+	change.var     = &var;
+	change.before  = (const union pbd_value *)v_before;
+	change.after   = (const union pbd_value *)v_after;
+	change.idxs    = array_idxs;
+
+	ret = PBD_PLUGIN_EMIT;
+	for (int i = 0; i < nplugins; i++)
+	{
+		if (!plugins[i].started || !plugins[i].ops->change)
+			continue;
+
+		if (plugins[i].ops->change(plugins[i].data, &change) ==
+			PBD_PLUGIN_SUPPRESS)
+			ret = PBD_PLUGIN_SUPPRESS;
+	}
+	return (ret);
+}
+
+/**
+ * @brief Ends the session and unloads all plugins.
+ */
+void plugin_session_end(void)
+{
+	for (int i = 0; i < nplugins; i++)
+	{
+		struct plugin *p = &plugins[i];
+		if (p->started && p->ops->session_end)
+			p->ops->session_end(p->data);
+
+		dlclose(p->handle);
+		p->handle = NULL;
+		p->started = 0;
+	}
+	nplugins = 0;
+}
@@ -0,0 +1,705 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ptrace.h"
+#include "poller.h"
+#include "arrow.h"
+#include "pbd.h"
+#include "bitmap.h"
+#include "strdiff.h"
+#include "evloop.h"
+#include "function.h"
+#include "heatmap.h"
+#include "line.h"
+#include "summary.h"
+#include "transition.h"
+#include "util.h"
+#include "variable.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Polled variable.
+ */
+struct pl_var
+{
+	struct dw_variable *v;  /* Variable.                     */
+	size_t offset;          /* Offset, in the snapshots.     */
+	int valid;              /* Previous value available?.    */
+	int readable;           /* Read in the current poll?.    */
+};
+
+/* Polled variables and its areas. */
+static struct pl_var *pl_vars;
+static struct iovec *pl_remote;
+static struct iovec *pl_local;
+static int pl_nvars;
+
+/* Snapshots: previous, current and double-read check. */
+static char *pl_prev;
+static char *pl_cur;
+static char *pl_chk;
+static size_t pl_size;
+
+/* Target. */
+static pid_t pl_pid;
+static int pl_spawned;
+static int pl_double;
+static int pl_memfd = -1;
+static int pl_sigfd = -1;
+
+/* Statistics. */
+static struct timespec pl_start;
+static uint64_t pl_polls;
+static uint64_t pl_torn;
+
+/* Output buffers. */
+static char before[BS];
+static char after[BS];
+static char bits[BM_BS];
+static char strs[SD_BS];
+
+/**
+ * @brief Spawns the process @p file, without tracing it.
+ *
+ * Only returns once the child is running the new image, since
+ * its globals cannot be read before that: the child holds the
+ * write end of a close-on-exec pipe, so the read returns at the
+ * exec, or with its errno, if the exec fails.
+ *
+ * @param file Executable.
+ * @param argv Arguments.
+ *
+ * @return Returns the child pid, or a negative number if error.
+ */
+pid_t pl_spawnprocess(const char *file, char **argv)
+{
+	pid_t child; /* Child Process.    */
+	int fds[2];  /* Exec status pipe. */
+	ssize_t ret; /* Bytes read.       */
+	int err;     /* Exec error.       */
+
+	if (pipe2(fds, O_CLOEXEC) < 0)
+		return (-1);
+
+	child = fork();
+	if (child == 0)
+	{
+		close(fds[0]);
+		execv(file, (char *const *)argv);
+		err = errno;
+		ret = write(fds[1], &err, sizeof(err));
+		((void)ret);
+		QUIT(EXIT_FAILURE, "unable to execute %s: %s\n", file,
+			strerror(err));
+	}
+
+	close(fds[1]);
+	if (child < 0)
+	{
+		close(fds[0]);
+		return (-1);
+	}
+
+	while ((ret = read(fds[0], &err, sizeof(err))) < 0 && errno == EINTR)
+		;
+	close(fds[0]);
+
+	/* Exec failed, already reported by the child. */
+	if (ret == sizeof(err))
+	{
+		while (waitpid(child, NULL, 0) < 0 && errno == EINTR)
+			;
+		return (-1);
+	}
+
+	return (child);
+}
+
+/**
+ * @brief Reads @p len bytes at the address @p addr of the target
+ * into @p buf, through /proc/<pid>/mem, if opened, or
+ * process_vm_readv().
+ *
+ * @param addr Target address.
+ * @param buf Destination buffer.
+ * @param len Amount of bytes.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int pl_read_one(uintptr_t addr, void *buf, size_t len)
+{
+	struct iovec local;
+	struct iovec remote;
+
+	if (pl_memfd >= 0)
+		return (pread(pl_memfd, buf, len, (off_t)addr) == (ssize_t)len ? 0 : -1);
+
+	local.iov_base  = buf;
+	local.iov_len   = len;
+	remote.iov_base = (void *)addr;
+	remote.iov_len  = len;
+	return (process_vm_readv(pl_pid, &local, 1, &remote, 1, 0) ==
+		(ssize_t)len ? 0 : -1);
+}
+
+/**
+ * @brief Reads all the polled variables into the snapshot
+ * @p buf, with as few system calls as possible.
+ *
+ * @param buf Snapshot buffer.
+ *
+ * @return Returns 0 if success and a negative number if the
+ * target is gone.
+ */
+static int pl_read_all(char *buf)
+{
+	ssize_t ret;         /* Bytes read.     */
+	ssize_t len;         /* Bytes expected. */
+	int n;               /* Areas, chunk.   */
+
+	for (int i = 0; i < pl_nvars; i += n)
+	{
+		n = (pl_nvars - i) < PL_IOV_MAX ? (pl_nvars - i) : PL_IOV_MAX;
+		len = 0;
+
+		for (int j = i; j < i + n; j++)
+		{
+			pl_local[j].iov_base = buf + pl_vars[j].offset;
+			pl_local[j].iov_len  = pl_remote[j].iov_len;
+			len += pl_remote[j].iov_len;
+		}
+
+		if (pl_memfd < 0)
+		{
+			ret = process_vm_readv(pl_pid, &pl_local[i], n, &pl_remote[i], n, 0);
+			if (ret < 0 && errno == ESRCH)
+				return (-1);
+
+			if (ret == len)
+			{
+				for (int j = i; j < i + n; j++)
+					pl_vars[j].readable = 1;
+				continue;
+			}
+		}
+
+		/* Partial read (or /proc/<pid>/mem): one by one. */
+		for (int j = i; j < i + n; j++)
+		{
+			pl_vars[j].readable = !pl_read_one(
+				(uintptr_t)pl_remote[j].iov_base, buf + pl_vars[j].offset,
+				pl_remote[j].iov_len);
+		}
+
+		if (kill(pl_pid, 0) < 0 && errno == ESRCH)
+			return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Re-reads the variables whose two reads disagree, until
+ * they agree, or gives up after PL_MAX_RETRIES reads.
+ */
+static void pl_check_torn(void)
+{
+	struct pl_var *p;
+	char *cur, *chk;
+	size_t len;
+	int tries;
+
+	for (int i = 0; i < pl_nvars; i++)
+	{
+		p   = &pl_vars[i];
+		cur = pl_cur + p->offset;
+		chk = pl_chk + p->offset;
+		len = pl_remote[i].iov_len;
+
+		if (!p->readable)
+			continue;
+
+		for (tries = 0; tries < PL_MAX_RETRIES && memcmp(cur, chk, len); tries++)
+		{
+			memcpy(cur, chk, len);
+			if (pl_read_one((uintptr_t)pl_remote[i].iov_base, chk, len) < 0)
+				break;
+		}
+
+		/* Still changing: skip it in this poll. */
+		if (memcmp(cur, chk, len))
+		{
+			p->readable = 0;
+			pl_torn++;
+		}
+	}
+}
+
+/**
+ * @brief Returns the time elapsed since the first poll, in
+ * seconds.
+ *
+ * @return Returns the elapsed time.
+ */
+static double pl_elapsed(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec - pl_start.tv_sec) +
+		(now.tv_nsec - pl_start.tv_nsec) / 1e9);
+}
+
+/**
+ * @brief Reports a change of the variable @p v, at the time
+ * @p t.
+ *
+ * @param t Time, in seconds.
+ * @param v Changed variable.
+ * @param v_before Value before.
+ * @param v_after Value after.
+ * @param array_idxs Element indexes, if array, NULL otherwise.
+ */
+static void pl_report(double t, struct dw_variable *v,
+	union var_value *v_before, union var_value *v_after, int *array_idxs)
+{
+	size_t size;
+
+	/* Statistics-only mode. */
+	if (args.flags & FLG_SUMMARY)
+	{
+		sm_update(v, v_after);
+		return;
+	}
+
+	/* Enum transitions, no line numbers either. */
+	if (args.flags & FLG_TRANSITIONS)
+	{
+		tm_update(v, 0, v_before, v_after);
+		return;
+	}
+
+	/* Columnar output, no line numbers. */
+	if (args.flags & FLG_ARROW)
+	{
+		ar_printer(1, 0, v, v_before, v_after, array_idxs);
+		return;
+	}
+
+	if (v->bitmap)
+	{
+		if (v->type.var_type == TARRAY)
+			bm_format(bits, sizeof(bits), v_before->p_value, v_after->p_value,
+				v->byte_size);
+		else
+			bm_format(bits, sizeof(bits), v_before->u8_value, v_after->u8_value,
+				v->byte_size);
+
+		fn_printf(1, 0, "[Time: %.6f] [global] (%s) has changed!, bits: %s\n",
+			t, v->name, bits);
+		return;
+	}
+
+	if (v->string)
+	{
+		fn_printf(1, 0, "[Time: %.6f] [global] (%s) has changed!, %s\n",
+			t, v->name, sd_format(strs, sizeof(strs), v_before->p_value,
+			v_after->p_value, v->byte_size));
+		return;
+	}
+
+	fn_printf(1, 0, "[Time: %.6f] [global] (%s", t, v->name);
+
+	size = v->byte_size;
+	if (array_idxs)
+	{
+		for (int j = 0; j < v->type.array.dimensions; j++)
+			fprintf(pbd_output, "[%d]", array_idxs[j]);
+		size = v->type.array.size_per_element;
+	}
+
+	fprintf(pbd_output, ") has changed!, before: %s, after: %s\n",
+		var_format_value(before, v_before, v->type.encoding, size),
+		var_format_value(after, v_after, v->type.encoding, size));
+}
+
+/**
+ * @brief Compares the variable @p p between the previous and
+ * current snapshots and reports its changes.
+ *
+ * @param t Time, in seconds.
+ * @param p Polled variable.
+ *
+ * @return Returns the amount of changes.
+ */
+static int pl_diff(double t, struct pl_var *p)
+{
+	int idxs[MATRIX_MAX_DIMENSIONS] = {0}; /* Element indexes. */
+	union var_value value1, value2;        /* Values.          */
+	struct dw_variable *v;                 /* Variable.        */
+	size_t size_per_element;               /* Element size.    */
+	int64_t byte_offset;                   /* Change offset.   */
+	char *old, *new;                       /* Snapshots.       */
+	size_t off, elem;                      /* Offsets.         */
+	int changes;
+
+	v   = p->v;
+	old = pl_prev + p->offset;
+	new = pl_cur + p->offset;
+
+	/* Base types, bitmap arrays and strings, at once. */
+	if (!(v->type.var_type == TARRAY) || v->bitmap || v->string)
+	{
+		if (!memcmp(old, new, v->byte_size))
+			return (0);
+
+		/* Only past the NUL: same string, nothing to report. */
+		if (v->string && !sd_changed(old, new, v->byte_size))
+			return (0);
+
+		if (v->type.var_type == TARRAY)
+		{
+			if (args.flags & FLG_HEATMAP)
+				hm_update_range(v, old, new, 0, v->byte_size);
+
+			value1.p_value = old;
+			value2.p_value = new;
+		}
+		else
+		{
+			memset(&value1, 0, sizeof(value1));
+			memset(&value2, 0, sizeof(value2));
+			memcpy(value1.u8_value, old, v->byte_size);
+			memcpy(value2.u8_value, new, v->byte_size);
+		}
+
+		pl_report(t, v, &value1, &value2, NULL);
+		return (1);
+	}
+
+	/* Arrays, element by element. */
+	size_per_element = v->type.array.size_per_element;
+	changes = 0;
+	off = 0;
+
+	while (off < v->byte_size &&
+		(byte_offset = offmemcmp(old + off, new + off, size_per_element,
+		v->byte_size - off)) >= 0)
+	{
+		off += byte_offset;
+
+		memcpy(value1.u8_value, old + off, size_per_element);
+		memcpy(value2.u8_value, new + off, size_per_element);
+
+		elem = off / size_per_element;
+		if (args.flags & FLG_HEATMAP)
+			hm_update(v, elem);
+
+		for (int j = v->type.array.dimensions - 1; j >= 0; j--)
+		{
+			idxs[j] = elem % v->type.array.elements_per_dimension[j];
+			elem /= v->type.array.elements_per_dimension[j];
+		}
+
+		pl_report(t, v, &value1, &value2, idxs);
+		changes++;
+		off += size_per_element;
+	}
+	return (changes);
+}
+
+/**
+ * @brief Polls all the variables once, reporting the changes
+ * since the previous poll.
+ *
+ * @return Returns 0 if success and a negative number if the
+ * target is gone.
+ */
+static int pl_poll(void)
+{
+	char *tmp;
+	double t;
+
+	if (pl_read_all(pl_cur) < 0)
+		return (-1);
+
+	/* Double-read check, against torn reads. */
+	if (pl_double)
+	{
+		for (int i = 0; i < pl_nvars; i++)
+		{
+			if (pl_vars[i].readable)
+				pl_vars[i].readable = !pl_read_one(
+					(uintptr_t)pl_remote[i].iov_base, pl_chk + pl_vars[i].offset,
+					pl_remote[i].iov_len);
+		}
+		pl_check_torn();
+	}
+
+	t = pl_elapsed();
+	pl_polls++;
+
+	for (int i = 0; i < pl_nvars; i++)
+	{
+		struct pl_var *p = &pl_vars[i];
+
+		/*
+		 * Unreadable (or torn) variables keep its previous
+		 * value, for the next poll.
+		 */
+		if (!p->readable)
+		{
+			memcpy(pl_cur + p->offset, pl_prev + p->offset,
+				pl_remote[i].iov_len);
+			continue;
+		}
+
+		if (p->valid)
+			pl_diff(t, p);
+		p->valid = 1;
+	}
+
+	fflush(pbd_output);
+
+	tmp = pl_prev;
+	pl_prev = pl_cur;
+	pl_cur = tmp;
+	return (0);
+}
+
+/**
+ * @brief Poll timer.
+ *
+ * @param fd Timer file descriptor.
+ * @param events Events.
+ * @param data Unused.
+ */
+static void on_poll_timer(int fd, uint32_t events, void *data)
+{
+	int status;
+	((void)events);
+	((void)data);
+
+	ev_timer_ack(fd);
+
+	if (pl_poll() < 0)
+		ev_stop();
+
+	/* The spawned child should be reaped. */
+	else if (pl_spawned && waitpid(pl_pid, &status, WNOHANG) == pl_pid &&
+		(WIFEXITED(status) || WIFSIGNALED(status)))
+		ev_stop();
+}
+
+/**
+ * @brief SIGINT/SIGTERM/SIGCHLD: stops polling, if the target
+ * has exited or PBD was asked to.
+ *
+ * @param fd Signal file descriptor.
+ * @param events Events.
+ * @param data Unused.
+ */
+static void on_signal(int fd, uint32_t events, void *data)
+{
+	struct signalfd_siginfo si;
+	int status;
+	((void)events);
+	((void)data);
+
+	while (read(fd, &si, sizeof(si)) == sizeof(si))
+	{
+		if (si.ssi_signo != SIGCHLD)
+			ev_stop();
+		else if (pl_spawned && waitpid(pl_pid, &status, WNOHANG) == pl_pid &&
+			(WIFEXITED(status) || WIFSIGNALED(status)))
+			ev_stop();
+	}
+}
+
+/**
+ * @brief Initializes the polled variables (globals only) from
+ * @p vars.
+ *
+ * @param vars Variables list.
+ *
+ * @return Returns the amount of variables to be polled, or a
+ * negative number if error.
+ */
+static int pl_init_vars(struct array *vars)
+{
+	struct dw_variable *v;
+
+	pl_vars   = calloc(array_size(&vars), sizeof(struct pl_var));
+	pl_remote = calloc(array_size(&vars), sizeof(struct iovec));
+	pl_local  = calloc(array_size(&vars), sizeof(struct iovec));
+	if (!pl_vars || !pl_remote || !pl_local)
+		return (-1);
+
+	pl_size = 0;
+	for (int i = 0; i < (int) array_size(&vars); i++)
+	{
+		v = array_get(&vars, i, NULL);
+
+		if (v->scope != VGLOBAL)
+			continue;
+
+		if (!(v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER)) &&
+			!(v->type.var_type == TARRAY &&
+			(v->type.array.var_type & (TBASE_TYPE|TENUM|TPOINTER))))
+			continue;
+
+		pl_vars[pl_nvars].v = v;
+		pl_vars[pl_nvars].offset = pl_size;
+		pl_remote[pl_nvars].iov_base = (void *)v->location.address;
+		pl_remote[pl_nvars].iov_len  = v->byte_size;
+		pl_nvars++;
+
+		/* offmemcmp() expects aligned buffers, as from malloc(). */
+		pl_size += (v->byte_size + 15) & ~(size_t)15;
+	}
+
+	if (!pl_nvars)
+		return (0);
+
+	pl_prev = calloc(1, pl_size);
+	pl_cur  = calloc(1, pl_size);
+	pl_chk  = calloc(1, pl_size);
+	if (!pl_prev || !pl_cur || !pl_chk)
+		return (-1);
+
+	return (pl_nvars);
+}
+
+/**
+ * @brief Chooses how the target memory is read: by default,
+ * process_vm_readv(), and if not available, /proc/<pid>/mem.
+ * None of them requires the target to be stopped or traced.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int pl_init_reader(void)
+{
+	char path[64];
+	char byte;
+
+	if (pl_read_one((uintptr_t)pl_remote[0].iov_base, &byte, 1) == 0)
+		return (0);
+
+	if (errno != ENOSYS)
+	{
+		fprintf(stderr, "PBD: unable to read the process %d memory: %s\n",
+			(int)pl_pid, strerror(errno));
+		return (-1);
+	}
+
+	snprintf(path, sizeof(path), "/proc/%d/mem", (int)pl_pid);
+	if ((pl_memfd = open(path, O_RDONLY|O_CLOEXEC)) < 0 ||
+		pl_read_one((uintptr_t)pl_remote[0].iov_base, &byte, 1) < 0)
+	{
+		fprintf(stderr, "PBD: unable to read %s: %s\n", path, strerror(errno));
+		return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Polls the global variables of @p vars in the process
+ * @p pid, each @p interval_ms milliseconds, until the process
+ * exits or PBD receives SIGINT/SIGTERM.
+ *
+ * @param pid Target process.
+ * @param spawned If set, @p pid is a child of PBD.
+ * @param interval_ms Interval, in milliseconds.
+ * @param double_read If set, enables the double-read check.
+ * @param vars Variables list.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int pl_run(pid_t pid, int spawned, int interval_ms, int double_read,
+	struct array *vars)
+{
+	sigset_t mask;
+	int ret;
+
+	pl_pid     = pid;
+	pl_spawned = spawned;
+	pl_double  = double_read;
+	ret = -1;
+
+	if ((ret = pl_init_vars(vars)) <= 0)
+	{
+		if (!ret)
+			fprintf(stderr, "PBD: no global variables to be polled!\n");
+		ret = -1;
+		goto out;
+	}
+
+	if (pl_init_reader() < 0)
+		goto out;
+
+	/* Stop on SIGINT/SIGTERM and when the child exits. */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0 ||
+		(pl_sigfd = signalfd(-1, &mask, SFD_NONBLOCK|SFD_CLOEXEC)) < 0)
+		goto out;
+
+	if (ev_init() < 0 || ev_add(pl_sigfd, EPOLLIN, on_signal, NULL) < 0 ||
+		ev_timer(interval_ms, on_poll_timer, NULL) < 0)
+		goto out;
+
+	/* Initial values. */
+	clock_gettime(CLOCK_MONOTONIC, &pl_start);
+	if (pl_poll() < 0 || ev_run() < 0)
+		goto out;
+
+	fprintf(stderr, "PBD: poll: %" PRIu64 " polls, %" PRIu64 " torn reads "
+		"skipped\n", pl_polls, pl_torn);
+	ret = 0;
+
+out:
+	if (pl_sigfd >= 0)
+	{
+		ev_del(pl_sigfd);
+		close(pl_sigfd);
+		sigprocmask(SIG_UNBLOCK, &mask, NULL);
+	}
+	if (pl_memfd >= 0)
+		close(pl_memfd);
+
+	free(pl_vars);
+	free(pl_remote);
+	free(pl_local);
+	free(pl_prev);
+	free(pl_cur);
+	free(pl_chk);
+	return (ret);
+}
@@ -0,0 +1,521 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Self-profiler.
+ *
+ * The signal handler only walks the frame pointers and appends
+ * the raw addresses into a pre-allocated arena (lock-free, via
+ * an atomic bump pointer), so the cost per sample is a few
+ * dozen loads. All the expensive work (symbolization and
+ * aggregation) is done only once, by prof_stop().
+ *
+ * Since a bad frame pointer could lead to an invalid read,
+ * frames are only followed while they lie between the
+ * interrupted stack pointer and the top of the thread stack,
+ * known through prof_thread_init(). Threads not registered
+ * only have their program counter sampled.
+ */
+
+#define _GNU_SOURCE
+#include "profiler.h"
+#include "elf_helper.h"
+#include "pbd.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+/* Arena size, in words (64 MiB in 64-bit, reserved lazily). */
+#define PROF_ARENA_WORDS (1 << 23)
+
+/* Registers. */
+#if defined(__x86_64__)
+	#define PROF_REG_PC REG_RIP
+	#define PROF_REG_FP REG_RBP
+	#define PROF_REG_SP REG_RSP
+#else
+	#define PROF_REG_PC REG_EIP
+	#define PROF_REG_FP REG_EBP
+	#define PROF_REG_SP REG_ESP
+#endif
+
+/* Samples arena: [depth, pc0 (leaf), pc1, ...], [depth, ...]... */
+static uintptr_t *prof_arena;
+static size_t prof_used;
+static uint64_t prof_samples;
+static uint64_t prof_dropped;
+
+/* Output file. */
+static char *prof_file;
+
+/* Previous SIGPROF action. */
+static struct sigaction prof_old_act;
+
+/* Top of the current thread stack, 0 if unknown. */
+static PBD_TLS uintptr_t prof_stack_top;
+
+/**
+ * @brief Executable mapping of the PBD address space.
+ */
+struct prof_map
+{
+	uintptr_t start;           /* Start address.          */
+	uintptr_t end;             /* End address.            */
+	uint64_t offset;           /* File offset.            */
+	char *path;                /* Mapped file.            */
+	struct prof_module *mod;   /* Module, if ELF.         */
+};
+
+/**
+ * @brief Symbolized ELF file.
+ */
+struct prof_module
+{
+	struct elf_file ef;        /* ELF file.               */
+	struct elf_symbol *syms;   /* Functions, sorted.      */
+	size_t nsyms;              /* Amount of functions.    */
+	size_t cap;                /* Symbols capacity.       */
+	const char *name;          /* Module base name.       */
+};
+
+/**
+ * @brief SIGPROF handler: walks the frame pointers of the
+ * interrupted thread and saves its addresses.
+ *
+ * @param sig Signal number.
+ * @param si Signal info.
+ * @param uctx Interrupted context.
+ */
+static void prof_handler(int sig, siginfo_t *si, void *uctx)
+{
+	uintptr_t pcs[PROF_MAX_DEPTH]; /* Stack addresses.  */
+	uintptr_t *frame;              /* Current frame.    */
+	uintptr_t fp, sp;              /* Frame/stack ptr.  */
+	ucontext_t *uc;                /* Context.          */
+	size_t off;                    /* Arena offset.     */
+	int saved_errno;               /* errno.            */
+	int n;                         /* Amount of frames. */
+
+	((void)sig);
+	((void)si);
+
+	saved_errno = errno;
+	uc = uctx;
+	n  = 0;
+
+	pcs[n++] = (uintptr_t)uc->uc_mcontext.gregs[PROF_REG_PC];
+	fp = (uintptr_t)uc->uc_mcontext.gregs[PROF_REG_FP];
+	sp = (uintptr_t)uc->uc_mcontext.gregs[PROF_REG_SP];
+
+	while (n < PROF_MAX_DEPTH && fp >= sp &&
+		fp + 2 * sizeof(uintptr_t) <= prof_stack_top &&
+		!(fp & (sizeof(uintptr_t) - 1)))
+	{
+		frame = (uintptr_t *)fp;
+		if (!frame[1])
+			break;
+
+		pcs[n++] = frame[1];
+
+		/* Stacks grow downwards, so callers are always above. */
+		if (frame[0] <= fp)
+			break;
+		fp = frame[0];
+	}
+
+	off = __atomic_fetch_add(&prof_used, n + 1, __ATOMIC_RELAXED);
+	if (off + n + 1 > PROF_ARENA_WORDS)
+		__atomic_add_fetch(&prof_dropped, 1, __ATOMIC_RELAXED);
+	else
+	{
+		prof_arena[off] = n;
+		memcpy(prof_arena + off + 1, pcs, n * sizeof(uintptr_t));
+		__atomic_add_fetch(&prof_samples, 1, __ATOMIC_RELAXED);
+	}
+
+	errno = saved_errno;
+}
+
+/**
+ * @brief Registers the stack bounds of the calling thread,
+ * so that its stacks can be fully unwound.
+ */
+void prof_thread_init(void)
+{
+	pthread_attr_t attr; /* Thread attributes. */
+	void *addr;          /* Stack address.     */
+	size_t size;         /* Stack size.        */
+
+	if (prof_file == NULL)
+		return;
+
+	if (pthread_getattr_np(pthread_self(), &attr))
+		return;
+
+	if (!pthread_attr_getstack(&attr, &addr, &size))
+		prof_stack_top = (uintptr_t)addr + size;
+
+	pthread_attr_destroy(&attr);
+}
+
+/**
+ * @brief Starts the self-profiler, that will write its output
+ * into @p file when stopped.
+ *
+ * @param file Output file.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int prof_start(const char *file)
+{
+	struct sigaction sa;   /* Signal action. */
+	struct itimerval it;   /* Timer.         */
+
+	prof_arena = mmap(NULL, PROF_ARENA_WORDS * sizeof(uintptr_t),
+		PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	if (prof_arena == MAP_FAILED)
+	{
+		prof_arena = NULL;
+		return (-1);
+	}
+
+	prof_file = strdup(file);
+	prof_thread_init();
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = prof_handler;
+	sa.sa_flags = SA_SIGINFO|SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGPROF, &sa, &prof_old_act) < 0)
+		goto err0;
+
+	it.it_interval.tv_sec  = 0;
+	it.it_interval.tv_usec = 1000000 / PROF_FREQ;
+	it.it_value = it.it_interval;
+	if (setitimer(ITIMER_PROF, &it, NULL) < 0)
+	{
+		sigaction(SIGPROF, &prof_old_act, NULL);
+		goto err0;
+	}
+
+	return (0);
+
+err0:
+	munmap(prof_arena, PROF_ARENA_WORDS * sizeof(uintptr_t));
+	prof_arena = NULL;
+	free(prof_file);
+	prof_file = NULL;
+	return (-1);
+}
+
+/**
+ * @brief Symbol comparison, by address.
+ */
+static int prof_sym_cmp(const void *a, const void *b)
+{
+	const struct elf_symbol *s1 = a;
+	const struct elf_symbol *s2 = b;
+	return ((s1->value > s2->value) - (s1->value < s2->value));
+}
+
+/**
+ * @brief Saves all the functions found in the module.
+ */
+static int prof_sym_add(const struct elf_symbol *sym, void *data)
+{
+	struct prof_module *mod = data;
+
+	if (sym->type != STT_FUNC || !sym->value)
+		return (0);
+
+	if (mod->nsyms == mod->cap)
+	{
+		struct elf_symbol *tmp;
+		mod->cap = mod->cap ? mod->cap * 2 : 256;
+		if ((tmp = realloc(mod->syms, mod->cap * sizeof(struct elf_symbol)))
+			== NULL)
+			return (1);
+		mod->syms = tmp;
+	}
+
+	mod->syms[mod->nsyms++] = *sym;
+	return (0);
+}
+
+/**
+ * @brief Reads all the executable mappings of PBD and
+ * loads the symbols of each mapped file.
+ *
+ * @param nmaps Amount of mappings read.
+ *
+ * @return Returns the mapping list, or NULL if error.
+ */
+static struct prof_map *prof_read_maps(size_t *nmaps)
+{
+	struct prof_map *maps;   /* Mappings.         */
+	unsigned long start;     /* Start address.    */
+	unsigned long end;       /* End address.      */
+	unsigned long long off;  /* File offset.      */
+	char perms[8];           /* Permissions.      */
+	char path[4096];         /* Mapped file.      */
+	char line[4352];         /* Current line.     */
+	size_t cap;              /* Maps capacity.    */
+	FILE *fp;                /* /proc/self/maps.  */
+
+	if ((fp = fopen("/proc/self/maps", "r")) == NULL)
+		return (NULL);
+
+	maps   = NULL;
+	cap    = 0;
+	*nmaps = 0;
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		path[0] = '\0';
+		if (sscanf(line, "%lx-%lx %7s %llx %*s %*s %4095s", &start, &end,
+			perms, &off, path) < 4 || perms[2] != 'x' || path[0] != '/')
+			continue;
+
+		if (*nmaps == cap)
+		{
+			struct prof_map *tmp;
+			cap = cap ? cap * 2 : 32;
+			if ((tmp = realloc(maps, cap * sizeof(struct prof_map))) == NULL)
+				break;
+			maps = tmp;
+		}
+
+		maps[*nmaps].start  = start;
+		maps[*nmaps].end    = end;
+		maps[*nmaps].offset = off;
+		maps[*nmaps].path   = strdup(path);
+		maps[*nmaps].mod    = NULL;
+
+		/* Same file already loaded?. */
+		for (size_t i = 0; i < *nmaps; i++)
+		{
+			if (!strcmp(maps[i].path, path))
+			{
+				maps[*nmaps].mod = maps[i].mod;
+				break;
+			}
+		}
+
+		if (maps[*nmaps].mod == NULL)
+		{
+			struct prof_module *mod = calloc(1, sizeof(struct prof_module));
+			if (mod != NULL && !elf_open(&mod->ef, path))
+			{
+				/* Prefer the full symbol table, if not stripped. */
+				if (elf_symbols_iter(&mod->ef, SHT_SYMTAB, prof_sym_add,
+					mod) < 0 || !mod->nsyms)
+					elf_symbols_iter(&mod->ef, SHT_DYNSYM, prof_sym_add, mod);
+
+				qsort(mod->syms, mod->nsyms, sizeof(struct elf_symbol),
+					prof_sym_cmp);
+
+				mod->name = strrchr(maps[*nmaps].path, '/') + 1;
+				maps[*nmaps].mod = mod;
+			}
+			else
+				free(mod);
+		}
+		(*nmaps)++;
+	}
+
+	fclose(fp);
+	return (maps);
+}
+
+/**
+ * @brief Symbolizes the address @p pc.
+ *
+ * @param maps Mappings list.
+ * @param nmaps Amount of mappings.
+ * @param pc Address to be symbolized.
+ *
+ * @return Returns the function name, or the module name
+ * between brackets (or '[unknown]') if not found.
+ */
+static const char *prof_symbolize(struct prof_map *maps, size_t nmaps,
+	uintptr_t pc)
+{
+	struct prof_module *mod;  /* Module.             */
+	uint64_t vaddr;           /* Address, in file.   */
+	size_t lo, hi, mid;       /* Binary search.      */
+
+	for (size_t i = 0; i < nmaps; i++)
+	{
+		if (pc < maps[i].start || pc >= maps[i].end)
+			continue;
+
+		if ((mod = maps[i].mod) == NULL)
+			return ("[unknown]");
+
+		if (elf_offset_to_vaddr(&mod->ef, pc - maps[i].start +
+			maps[i].offset, &vaddr) < 0)
+			return (mod->name);
+
+		/* Last symbol whose address is <= vaddr. */
+		lo = 0;
+		hi = mod->nsyms;
+		while (lo < hi)
+		{
+			mid = lo + (hi - lo) / 2;
+			if (mod->syms[mid].value <= vaddr)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo && (!mod->syms[lo - 1].size ||
+			vaddr < mod->syms[lo - 1].value + mod->syms[lo - 1].size))
+			return (mod->syms[lo - 1].name);
+
+		return (mod->name);
+	}
+	return ("[unknown]");
+}
+
+/**
+ * @brief Collapsed stacks comparison.
+ */
+static int prof_str_cmp(const void *a, const void *b)
+{
+	return (strcmp(*(char * const *)a, *(char * const *)b));
+}
+
+/**
+ * @brief Stops the self-profiler and writes the collapsed
+ * stacks into the output file.
+ */
+void prof_stop(void)
+{
+	struct prof_map *maps;    /* Mappings.          */
+	struct itimerval it;      /* Timer.             */
+	size_t nmaps;             /* Amount of maps.    */
+	size_t nstacks;           /* Amount of stacks.  */
+	size_t used;              /* Arena words used.  */
+	char **stacks;            /* Collapsed stacks.  */
+	FILE *out;                /* Output file.       */
+
+	if (prof_file == NULL)
+		return;
+
+	/* Stop sampling. */
+	memset(&it, 0, sizeof(it));
+	setitimer(ITIMER_PROF, &it, NULL);
+	sigaction(SIGPROF, &prof_old_act, NULL);
+
+	used = __atomic_load_n(&prof_used, __ATOMIC_SEQ_CST);
+	if (used > PROF_ARENA_WORDS)
+		used = PROF_ARENA_WORDS;
+
+	maps    = prof_read_maps(&nmaps);
+	stacks  = calloc(prof_samples + 1, sizeof(char *));
+	nstacks = 0;
+
+	if ((out = fopen(prof_file, "w")) == NULL || stacks == NULL)
+	{
+		fprintf(stderr, "PBD: unable to write the profile to %s!\n",
+			prof_file);
+		goto out;
+	}
+
+	/* Build the collapsed stacks: outermost function first. */
+	for (size_t off = 0; off < used && nstacks < prof_samples; )
+	{
+		uintptr_t n = prof_arena[off];
+		char *buf;
+		size_t buf_size;
+		FILE *fs;
+
+		if (!n || off + n + 1 > used)
+			break;
+
+		if ((fs = open_memstream(&buf, &buf_size)) == NULL)
+			break;
+
+		for (uintptr_t i = n; i > 0; i--)
+		{
+			/* Return addresses point to the instruction after the call. */
+			uintptr_t pc = prof_arena[off + i] - (i > 1);
+			fprintf(fs, "%s%s", prof_symbolize(maps, nmaps, pc),
+				i > 1 ? ";" : "");
+		}
+
+		fclose(fs);
+		stacks[nstacks++] = buf;
+		off += n + 1;
+	}
+
+	/* Aggregate identical stacks. */
+	qsort(stacks, nstacks, sizeof(char *), prof_str_cmp);
+	for (size_t i = 0, j; i < nstacks; i = j)
+	{
+		for (j = i + 1; j < nstacks && !strcmp(stacks[i], stacks[j]); j++);
+		fprintf(out, "%s %zu\n", stacks[i], j - i);
+	}
+
+	fprintf(stderr, "PBD: self-profile: %" PRIu64 " samples (%" PRIu64
+		" dropped) written to %s\n", prof_samples, prof_dropped, prof_file);
+
+out:
+	if (out != NULL)
+		fclose(out);
+
+	for (size_t i = 0; i < nstacks; i++)
+		free(stacks[i]);
+	free(stacks);
+
+	/* Modules are shared between mappings of the same file. */
+	for (size_t i = 0; i < nmaps; i++)
+	{
+		int last = 1;
+		for (size_t j = i + 1; j < nmaps; j++)
+			if (maps[j].mod == maps[i].mod)
+				last = 0;
+
+		if (last && maps[i].mod != NULL)
+		{
+			elf_close(&maps[i].mod->ef);
+			free(maps[i].mod->syms);
+			free(maps[i].mod);
+		}
+		free(maps[i].path);
+	}
+	free(maps);
+
+	munmap(prof_arena, PROF_ARENA_WORDS * sizeof(uintptr_t));
+	prof_arena = NULL;
+	free(prof_file);
+	prof_file = NULL;
+}
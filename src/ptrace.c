@@ -25,6 +25,9 @@
 #include "ptrace.h"
 #include "util.h"
 #include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/syscall.h>
 
 /**
  * Architecture independent ptrace helper functions.
@@ -79,6 +82,32 @@ int pt_waitchild(void)
 	return (0);
 }
 
+/**
+ * @brief Waits until the thread @p tid has been stopped
+ * (breakpoint, signal...).
+ *
+ * Differently from pt_waitchild(), only the given thread
+ * is waited and only if it is traced by the calling thread,
+ * which allows multiple tracer threads to coexist.
+ *
+ * @param tid Thread to be waited.
+ *
+ * @return Returns PT_CHILD_EXIT if the thread was terminated,
+ * otherwise, returns 0.
+ */
+int pt_waittracee(pid_t tid)
+{
+	int status;    /* Status Code. */
+	while (waitpid(tid, &status, __WALL | __WNOTHREAD) < 0)
+		if (errno != EINTR)
+			return (PT_CHILD_EXIT);
+
+	if (WIFEXITED(status) || WIFSIGNALED(status))
+		return (PT_CHILD_EXIT);
+
+	return (0);
+}
+
 /**
  * @brief Continues the child execution.
  *
@@ -102,6 +131,100 @@ int pt_continue_single_step(pid_t child)
 	return (0);
 }
 
+/**
+ * @brief Single-steps the thread @p tid over one instruction,
+ * going through any ptrace event stop (e.g: fork/clone) that
+ * the instruction may trigger.
+ *
+ * A signal received before the instruction is executed stops
+ * the thread without stepping it: the step is retried and the
+ * signal is sent again afterwards, so that it is delivered on
+ * the next resume, as usual.
+ *
+ * @param tid Thread to be 'singlestepped', must be stopped.
+ *
+ * @return Returns PT_CHILD_EXIT if the thread was terminated,
+ * otherwise, returns 0.
+ */
+int pt_step_insn(pid_t tid)
+{
+	int status; /* Status Code.    */
+	int sig;    /* Pending signal. */
+
+	sig = 0;
+	for (;;)
+	{
+		ptrace(PTRACE_SINGLESTEP, tid, NULL, NULL);
+		while (waitpid(tid, &status, __WALL | __WNOTHREAD) < 0)
+			if (errno != EINTR)
+				return (PT_CHILD_EXIT);
+
+		if (WIFEXITED(status) || WIFSIGNALED(status))
+			return (PT_CHILD_EXIT);
+
+		/* Event stops have the event number at the upper bits. */
+		if (status >> 16)
+			continue;
+
+		if (WSTOPSIG(status) == SIGTRAP)
+			break;
+
+		sig = WSTOPSIG(status);
+	}
+
+	if (sig)
+		syscall(SYS_tkill, tid, sig);
+
+	return (0);
+}
+
+/**
+ * @brief Creates a copy-on-write copy of the stopped process
+ * @p child, by injecting a clone() system call into it.
+ *
+ * The copy is created with CLONE_PARENT and no exit signal, so
+ * its parent is PBD itself and the child is never notified of
+ * its existence. The copy is automatically traced and remains
+ * stopped until killed, so it can be read as a frozen image of
+ * the child memory at the time of the call.
+ *
+ * @param child Child process, must be stopped and not traced
+ * with any ptrace option set (the copy inherits PTRACE_O_EXITKILL,
+ * so it does not outlive PBD).
+ *
+ * @return Returns the pid of the stopped copy, or -1 if error.
+ *
+ * @note The copy must be released with SIGKILL and waited for
+ * with __WALL.
+ */
+pid_t pt_fork(pid_t child)
+{
+	long ret;   /* Clone return value. */
+	int status; /* Status Code.        */
+
+	if (ptrace(PTRACE_SETOPTIONS, child, NULL,
+		PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL) < 0)
+	{
+		return (-1);
+	}
+
+	ret = pt_syscall(child, SYS_clone, CLONE_PARENT, 0, 0, 0, 0, 0);
+	ptrace(PTRACE_SETOPTIONS, child, NULL, 0);
+
+	if (ret <= 0)
+		return (-1);
+
+	/* Wait for the initial SIGSTOP of the copy. */
+	while (waitpid(ret, &status, __WALL) < 0)
+		if (errno != EINTR)
+			return (-1);
+
+	if (!WIFSTOPPED(status))
+		return (-1);
+
+	return ((pid_t)ret);
+}
+
 /**
  * @brief Reads sizeof(long) bytes from a given process
  * @p child at address @p addr.
@@ -291,6 +414,104 @@ char *pt_readmemory(pid_t child, uintptr_t addr, size_t len)
 #endif
 }
 
+/**
+ * @brief Reads an arbitrary amount of bytes @p len from the given
+ * process @p child in the address @p addr, into the buffer @p buf.
+ *
+ * Differently from pt_readmemory(), no memory is allocated, which
+ * is preferable for frequent reads of the same size.
+ *
+ * @param child Child process.
+ * @param addr Address to be read.
+ * @param buf Destination buffer.
+ * @param len How many bytes will be read.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int pt_readmemory_buf(pid_t child, uintptr_t addr, void *buf, size_t len)
+{
+#if defined(__linux__) && defined(__GLIBC__) \
+	&& (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 15))
+
+	struct iovec local[1];   /* IO Vector Local.  */
+	struct iovec remote[1];  /* IO Vector Remote. */
+
+	local[0].iov_base  = buf;
+	local[0].iov_len   = len;
+	remote[0].iov_base = (void *) addr;
+	remote[0].iov_len  = len;
+
+	if (process_vm_readv(child, local, 1, remote, 1, 0) != (ssize_t)len)
+		return (-1);
+	return (0);
+
+/* Ptrace approach. */
+#else
+	char *data;      /* Data read. */
+
+	if ((data = pt_readmemory(child, addr, len)) == NULL)
+		return (-1);
+
+	memcpy(buf, data, len);
+	free(data);
+	return (0);
+#endif
+}
+
+/**
+ * @brief Reads @p n (possibly scattered) memory areas from the
+ * given process @p child, contiguously into the buffer @p buf,
+ * with as few system calls as possible.
+ *
+ * @param child Child process.
+ * @param remote Areas to be read, at most IOV_MAX.
+ * @param n Amount of areas.
+ * @param buf Destination buffer, big enough for all the areas.
+ *
+ * @return Returns the amount of bytes read, that might be less
+ * than requested if an area could not be read: in this case,
+ * all the areas before it were read completely. Returns a
+ * negative number if error.
+ */
+ssize_t pt_readmemory_iov(pid_t child, const struct iovec *remote, int n,
+	void *buf)
+{
+#if defined(__linux__) && defined(__GLIBC__) \
+	&& (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 15))
+
+	struct iovec local[1];  /* IO Vector Local. */
+	ssize_t ret;
+
+	local[0].iov_base = buf;
+	local[0].iov_len  = 0;
+	for (int i = 0; i < n; i++)
+		local[0].iov_len += remote[i].iov_len;
+
+	ret = process_vm_readv(child, local, 1, remote, n, 0);
+	if (ret >= 0)
+		return (ret);
+
+	/* Nothing read, e.g: the first area is not mapped. */
+	if (errno != EFAULT)
+		return (-1);
+	return (0);
+
+/* Ptrace approach. */
+#else
+	ssize_t total;  /* Bytes read. */
+
+	total = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (pt_readmemory_buf(child, (uintptr_t)remote[i].iov_base,
+			(char *)buf + total, remote[i].iov_len) < 0)
+			break;
+		total += remote[i].iov_len;
+	}
+	return (total);
+#endif
+}
+
 /**
  * @brief Writes an arbitrary amount of bytes @p len into the given
  * process @p child in the address @p addr.
@@ -299,6 +520,10 @@ char *pt_readmemory(pid_t child, uintptr_t addr, size_t len)
  * @param addr Address to be written.
  * @param data Data to be write.
  * @param len How many bytes will be written.
+ *
+ * @note Read-only mappings (such as the program text) cannot be
+ * written with process_vm_writev(), in this case, the slower
+ * ptrace approach is used.
  */
 void pt_writememory(pid_t child, uintptr_t addr, char *data, size_t len)
 {
@@ -307,6 +532,22 @@ void pt_writememory(pid_t child, uintptr_t addr, char *data, size_t len)
 	char *laddr;   /* Auxiliar pointer. */
 	int long_size; /* Long size.        */
 
+#if defined(__linux__) && defined(__GLIBC__) \
+	&& (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 15))
+
+	struct iovec local[1];   /* IO Vector Local.  */
+	struct iovec remote[1];  /* IO Vector Remote. */
+
+	/* Prepare arguments for writev. */
+	local[0].iov_base  = data;
+	local[0].iov_len   = len;
+	remote[0].iov_base = (void *) addr;
+	remote[0].iov_len  = len;
+
+	if (process_vm_writev(child, local, 1, remote, 1, 0) == (ssize_t)len)
+		return;
+#endif
+
 	long_size = sizeof(long);
 	union u
 	{
@@ -327,10 +568,15 @@ void pt_writememory(pid_t child, uintptr_t addr, char *data, size_t len)
 		laddr += long_size;
 	}
 
-	/* If few bytes remaining, write them. */
+	/*
+	 * If few bytes remaining, write them, preserving the bytes
+	 * that do not belong to the buffer.
+	 */
 	j = len % long_size;
 	if (j != 0)
 	{
+		temp_data.val = ptrace(PTRACE_PEEKDATA, child,
+			addr + i * sizeof(char *), NULL);
 		memcpy(temp_data.chars, laddr, j);
 		ptrace(PTRACE_POKEDATA, child, addr + i * sizeof(char *), temp_data.val);
 	}
@@ -0,0 +1,728 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "region.h"
+#include "pbd.h"
+#include "ptrace.h"
+#include "variable.h"
+#include "function.h"
+#include "line.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Soft-dirty bit, in a pagemap entry. */
+#define PM_SOFT_DIRTY (1ULL << 55)
+
+/**
+ * @brief Watched memory region.
+ */
+struct region
+{
+	char *name;          /* Name shown in the output.           */
+	int mapping;         /* Mapping index, -1 if address range. */
+	uintptr_t base;      /* Base address for reported offsets.  */
+	uintptr_t addr;      /* Start address.                      */
+	size_t len;          /* Length, in bytes.                   */
+	size_t elem_size;    /* Size per element.                   */
+	int encoding;        /* Element encoding (ENC_*).           */
+	char *shadow;        /* Last known contents.                */
+	char *buf;           /* Current contents.                   */
+	uint64_t *pagemap;   /* Pagemap entries, if soft-dirty.     */
+	size_t npages;       /* Amount of pages covered.            */
+	int softdirty;       /* Filter pages through soft-dirty.    */
+};
+
+/**
+ * @brief Named mapping, to be resolved on the first
+ * function entry that finds it.
+ */
+struct mapping
+{
+	char *name;          /* Path or file name, as in maps.      */
+	size_t elem_size;    /* Size per element.                   */
+	int encoding;        /* Element encoding (ENC_*).           */
+	int resolved;        /* 0: pending, 1: found, 2: resolved.  */
+};
+
+/* Regions and mappings. */
+static struct region regions[RG_MAX];
+static struct mapping mappings[RG_MAX];
+static int nregions;
+static int nmappings;
+
+/* Regions being watched, i.e: already read at least once. */
+static int nactive;
+
+/* Mappings not found yet. */
+static int rg_pending;
+
+/* Soft-dirty support, -1 if not checked yet. */
+static int rg_softdirty = -1;
+static int pagemap_fd = -1;
+static int clear_refs_fd = -1;
+
+/* Serializes the checks when tracing multiple threads. */
+static pthread_mutex_t rg_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Duplicates the string @p str.
+ *
+ * @param str String to be duplicated.
+ *
+ * @return Returns the new string.
+ */
+static char *rg_strdup(const char *str)
+{
+	char *s;
+	s = malloc(sizeof(char) * (strlen(str) + 1));
+	if (s != NULL)
+		strcpy(s, str);
+	return (s);
+}
+
+/**
+ * @brief Parses the optional element size and encoding,
+ * i.e: [:elemsize[:encoding]].
+ *
+ * @param spec Remaining spec, NULL or empty if none.
+ * @param elem_size Parsed element size.
+ * @param encoding Parsed encoding.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int rg_parse_elem(const char *spec, size_t *elem_size, int *encoding)
+{
+	char *end;
+
+	*elem_size = 1;
+	*encoding  = ENC_UNSIGNED;
+
+	if (spec == NULL || *spec == '\0')
+		return (0);
+
+	*elem_size = strtoul(spec, &end, 0);
+	if (end == spec || (*end != '\0' && *end != ':'))
+		return (-1);
+
+	/* Encoding. */
+	if (*end == ':')
+	{
+		if (end[1] == '\0' || end[2] != '\0')
+			return (-1);
+
+		switch (end[1])
+		{
+			case 's': *encoding = ENC_SIGNED;   break;
+			case 'u': *encoding = ENC_UNSIGNED; break;
+			case 'f': *encoding = ENC_FLOAT;    break;
+			case 'x': *encoding = ENC_POINTER;  break;
+			default:
+				return (-1);
+		}
+	}
+
+	/* Sizes supported by the printer. */
+	switch (*encoding)
+	{
+		case ENC_FLOAT:
+		case ENC_POINTER:
+			if (*elem_size != 4 && *elem_size != 8)
+				return (-1);
+			break;
+		default:
+			if (*elem_size != 1 && *elem_size != 2 &&
+				*elem_size != 4 && *elem_size != 8)
+				return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Adds a new address range to be watched.
+ *
+ * @param spec Range, in the form addr:len[:elemsize[:encoding]],
+ * where encoding is one of: s (signed), u (unsigned), f (float)
+ * or x (hexadecimal).
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int rg_add_range(const char *spec)
+{
+	struct region *r;
+	uintptr_t addr;
+	size_t len;
+	char *end;
+	char *name;
+
+	if (nregions == RG_MAX)
+	{
+		fprintf(stderr, "PBD: --watch-region: too many regions (max: %d)\n",
+			RG_MAX);
+		return (-1);
+	}
+
+	r = &regions[nregions];
+
+	addr = strtoull(spec, &end, 0);
+	if (end == spec || *end != ':')
+		goto err;
+
+	name = end;
+	len = strtoull(end + 1, &end, 0);
+	if (end == name + 1 || (*end != '\0' && *end != ':') || !len)
+		goto err;
+
+	if (rg_parse_elem(*end ? end + 1 : NULL, &r->elem_size, &r->encoding) < 0)
+		goto err;
+
+	if (len % r->elem_size)
+	{
+		fprintf(stderr, "PBD: --watch-region: length (%zu) should be a "
+			"multiple of the element size (%zu)\n", len, r->elem_size);
+		return (-1);
+	}
+
+	/* Name the region by its address. */
+	if ((r->name = malloc(sizeof(char) * 24)) == NULL)
+		return (-1);
+
+	snprintf(r->name, 24, "0x%" PRIxPTR, addr);
+	r->mapping = -1;
+	r->base = addr;
+	r->addr = addr;
+	r->len  = len;
+	nregions++;
+	return (0);
+err:
+	fprintf(stderr, "PBD: --watch-region: invalid region (%s), expected: "
+		"addr:len[:elemsize[:s|u|f|x]]\n", spec);
+	return (-1);
+}
+
+/**
+ * @brief Adds a new mapping to be watched, whose writable segments
+ * are resolved through /proc/<pid>/maps.
+ *
+ * @param spec Mapping name (e.g: [heap] or libfoo.so), optionally
+ * followed by [:elemsize[:encoding]].
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int rg_add_mapping(const char *spec)
+{
+	struct mapping *m;
+	const char *colon;
+	size_t nlen;
+
+	if (nmappings == RG_MAX)
+	{
+		fprintf(stderr, "PBD: --watch-mapping: too many mappings (max: %d)\n",
+			RG_MAX);
+		return (-1);
+	}
+
+	m = &mappings[nmappings];
+	colon = strchr(spec, ':');
+	nlen  = colon ? (size_t)(colon - spec) : strlen(spec);
+
+	if (!nlen || rg_parse_elem(colon ? colon + 1 : NULL, &m->elem_size,
+		&m->encoding) < 0)
+	{
+		fprintf(stderr, "PBD: --watch-mapping: invalid mapping (%s), expected: "
+			"name[:elemsize[:s|u|f|x]]\n", spec);
+		return (-1);
+	}
+
+	if ((m->name = malloc(sizeof(char) * (nlen + 1))) == NULL)
+		return (-1);
+
+	memcpy(m->name, spec, nlen);
+	m->name[nlen] = '\0';
+	m->resolved = 0;
+	nmappings++;
+	rg_pending++;
+	return (0);
+}
+
+/**
+ * @brief Checks if the running kernel keeps the soft-dirty bits,
+ * by clearing them for PBD itself and dirtying a page.
+ *
+ * @return Returns 1 if supported and 0 otherwise.
+ */
+int rg_softdirty_supported(void)
+{
+	static volatile char page[8192];
+	uint64_t entry;
+	uintptr_t addr;
+	long page_size;
+	int ret;
+	int cfd;
+	int pfd;
+
+	ret = 0;
+	page_size = sysconf(_SC_PAGESIZE);
+	addr = ((uintptr_t)page + page_size - 1) & ~((uintptr_t)page_size - 1);
+
+	cfd = open("/proc/self/clear_refs", O_WRONLY);
+	pfd = open("/proc/self/pagemap", O_RDONLY);
+	if (cfd < 0 || pfd < 0)
+		goto out;
+
+	*(volatile char *)addr = 1;
+	if (write(cfd, "4", 1) != 1)
+		goto out;
+
+	*(volatile char *)addr = 2;
+	if (pread(pfd, &entry, sizeof entry, (addr / page_size) * sizeof entry)
+		!= sizeof entry)
+		goto out;
+
+	ret = !!(entry & PM_SOFT_DIRTY);
+out:
+	if (cfd >= 0)
+		close(cfd);
+	if (pfd >= 0)
+		close(pfd);
+	return (ret);
+}
+
+/**
+ * @brief Clears the soft-dirty bits of the child, if any
+ * region is using them.
+ */
+static void rg_clear_refs(void)
+{
+	if (clear_refs_fd < 0)
+		return;
+
+	if (write(clear_refs_fd, "4", 1) != 1)
+	{
+		fprintf(stderr, "PBD: unable to clear soft-dirty bits (%s), "
+			"reading whole regions from now on\n", strerror(errno));
+
+		for (int i = 0; i < nregions; i++)
+			regions[i].softdirty = 0;
+
+		close(clear_refs_fd);
+		clear_refs_fd = -1;
+	}
+}
+
+/**
+ * @brief Allocates the buffers of the region @p r and reads
+ * its initial contents.
+ *
+ * @param r Region to be activated.
+ * @param child Child process.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int rg_activate(struct region *r, pid_t child)
+{
+	long page_size;
+	uintptr_t first;
+	uintptr_t last;
+
+	r->shadow = malloc(r->len);
+	r->buf    = malloc(r->len);
+	if (r->shadow == NULL || r->buf == NULL)
+		goto err;
+
+	if (pt_readmemory_buf(child, r->addr, r->shadow, r->len) < 0)
+	{
+		fprintf(stderr, "PBD: unable to read region %s (%zu bytes), "
+			"ignoring it\n", r->name, r->len);
+		goto err;
+	}
+
+	/* Soft-dirty, only worth for big regions. */
+	page_size = sysconf(_SC_PAGESIZE);
+	first     = r->addr / page_size;
+	last      = (r->addr + r->len - 1) / page_size;
+	r->npages = last - first + 1;
+
+	if (r->npages >= RG_SOFTDIRTY_MIN_PAGES && !args.threads)
+	{
+		if (rg_softdirty < 0)
+			rg_softdirty = rg_softdirty_supported();
+
+		if (rg_softdirty && pagemap_fd < 0)
+		{
+			char path[64];
+			snprintf(path, sizeof path, "/proc/%d/pagemap", (int)child);
+			pagemap_fd = open(path, O_RDONLY);
+			snprintf(path, sizeof path, "/proc/%d/clear_refs", (int)child);
+			clear_refs_fd = open(path, O_WRONLY);
+		}
+
+		if (pagemap_fd >= 0 && clear_refs_fd >= 0)
+		{
+			r->pagemap = malloc(sizeof(uint64_t) * r->npages);
+			r->softdirty = (r->pagemap != NULL);
+		}
+	}
+
+	return (0);
+err:
+	free(r->shadow);
+	free(r->buf);
+	r->shadow = NULL;
+	r->buf = NULL;
+	return (-1);
+}
+
+/**
+ * @brief Resolves the pending mappings through /proc/<pid>/maps
+ * and reads the initial contents of all the new regions.
+ *
+ * @param child Child process.
+ *
+ * @note Must be called with rg_mutex held.
+ */
+static void rg_resolve_locked(pid_t child)
+{
+	char path[64];
+	char line[4096];
+	FILE *fp;
+
+	/* Mappings, only writable segments matters. */
+	if (rg_pending)
+	{
+		snprintf(path, sizeof path, "/proc/%d/maps", (int)child);
+		if ((fp = fopen(path, "r")) == NULL)
+			goto activate;
+
+		while (fgets(line, sizeof line, fp) != NULL)
+		{
+			uintptr_t start, end;
+			char perms[5];
+			char *pathname;
+			char *base_name;
+			int off;
+
+			if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %4s %*s %*s %*s%n",
+				&start, &end, perms, &off) != 3 || perms[1] != 'w')
+				continue;
+
+			pathname = line + off;
+			pathname += strspn(pathname, " ");
+			pathname[strcspn(pathname, "\n")] = '\0';
+			base_name = strrchr(pathname, '/');
+			base_name = base_name ? base_name + 1 : pathname;
+
+			for (int i = 0; i < nmappings; i++)
+			{
+				struct mapping *m = &mappings[i];
+				struct region *r;
+				int j;
+
+				if (m->resolved == 2 || (strcmp(m->name, pathname) &&
+					strcmp(m->name, base_name)))
+					continue;
+
+				if (nregions == RG_MAX)
+				{
+					fprintf(stderr, "PBD: too many regions, ignoring the "
+						"remaining segments of %s\n", m->name);
+					m->resolved = 2;
+					continue;
+				}
+
+				/*
+				 * Offsets are relative to the first writable segment
+				 * found for this mapping.
+				 */
+				r = &regions[nregions++];
+				r->base = start;
+				for (j = 0; j < nregions - 1; j++)
+				{
+					if (regions[j].mapping == i)
+					{
+						r->base = regions[j].base;
+						break;
+					}
+				}
+
+				r->name = rg_strdup(m->name);
+				r->mapping = i;
+				r->addr = start;
+				r->len  = ((end - start) / m->elem_size) * m->elem_size;
+				r->elem_size = m->elem_size;
+				r->encoding  = m->encoding;
+				m->resolved  = 1;
+			}
+		}
+		fclose(fp);
+
+		/* Found mappings do not need to be searched again. */
+		rg_pending = 0;
+		for (int i = 0; i < nmappings; i++)
+		{
+			if (mappings[i].resolved)
+				mappings[i].resolved = 2;
+			else
+				rg_pending++;
+		}
+	}
+
+activate:
+	/* Read the initial contents of the new regions. */
+	if (nactive != nregions)
+	{
+		for (int i = nactive; i < nregions; i++)
+			rg_activate(&regions[i], child);
+
+		nactive = nregions;
+		rg_clear_refs();
+	}
+}
+
+/**
+ * @brief Resolves the pending mappings and reads the initial
+ * contents of all the new regions.
+ *
+ * Should be called at the function entry. Mappings not found
+ * yet (e.g: [heap], before the first malloc) are also searched
+ * at every stop, until found.
+ *
+ * @param child Child process.
+ */
+void rg_resolve(pid_t child)
+{
+	pthread_mutex_lock(&rg_mutex);
+	rg_resolve_locked(child);
+	pthread_mutex_unlock(&rg_mutex);
+}
+
+/**
+ * @brief Compares the @p size bytes of @p old and @p new, element
+ * by element, reports every element changed and updates @p old.
+ *
+ * @param kind Kind of memory, e.g: region or heap.
+ * @param name Name shown in the output.
+ * @param offset Offset of @p old/@p new within @p name.
+ * @param old Last known contents.
+ * @param new Current contents.
+ * @param size Size to be compared, multiple of @p elem_size.
+ * @param elem_size Size per element.
+ * @param encoding Element encoding (ENC_*).
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns the amount of changes found.
+ */
+int rg_diff(const char *kind, const char *name, uintptr_t offset,
+	char *old, char *new, size_t size, size_t elem_size, int encoding,
+	unsigned line_no, int depth)
+{
+	char before[BS];    /* Value before, formatted. */
+	char after[BS];     /* Value after, formatted.  */
+	char *cmp1, *cmp2;  /* Old and new contents.    */
+	int64_t byte_offset;
+	int changes;
+
+	cmp1 = old;
+	cmp2 = new;
+	changes = 0;
+
+	while (size && (byte_offset = offmemcmp(cmp1, cmp2, elem_size,
+		size)) >= 0)
+	{
+		union var_value value1;
+		union var_value value2;
+
+		cmp1 += byte_offset;
+		cmp2 += byte_offset;
+
+		memset(&value1, 0, sizeof value1);
+		memset(&value2, 0, sizeof value2);
+		memcpy(value1.u8_value, cmp1, elem_size);
+		memcpy(value2.u8_value, cmp2, elem_size);
+
+		fn_printf(depth, 0,
+			"[Line: %d] [%s] (%s+0x%" PRIxPTR ") has changed!, "
+			"before: %s, after: %s\n",
+			line_no,
+			kind,
+			name,
+			offset + (uintptr_t)(cmp1 - old),
+			var_format_value(before, &value1, encoding, elem_size),
+			var_format_value(after,  &value2, encoding, elem_size)
+		);
+
+		/* Keep the new value. */
+		memcpy(cmp1, cmp2, elem_size);
+
+		changes++;
+		cmp1 += elem_size;
+		cmp2 += elem_size;
+		size -= byte_offset + elem_size;
+	}
+
+	return (changes);
+}
+
+/**
+ * @brief Checks the dirty pages only, read from the pagemap of
+ * the child, merging contiguous pages into a single read.
+ *
+ * @param r Region.
+ * @param child Child process.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns the amount of changes found, or a negative
+ * number if the pagemap could not be read.
+ */
+static int rg_check_dirty(struct region *r, pid_t child, unsigned line_no,
+	int depth)
+{
+	long page_size;
+	uintptr_t first;
+	size_t start, end;
+	size_t i, j;
+	int changes;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	first = r->addr / page_size;
+	changes = 0;
+
+	if (pread(pagemap_fd, r->pagemap, sizeof(uint64_t) * r->npages,
+		first * sizeof(uint64_t)) != (ssize_t)(sizeof(uint64_t) * r->npages))
+		return (-1);
+
+	for (i = 0; i < r->npages; i = j)
+	{
+		if (!(r->pagemap[i] & PM_SOFT_DIRTY))
+		{
+			j = i + 1;
+			continue;
+		}
+
+		/* Merge the contiguous dirty pages. */
+		for (j = i + 1; j < r->npages && (r->pagemap[j] & PM_SOFT_DIRTY); j++);
+
+		/* Clip to the region and align to its elements. */
+		start = (first + i) * page_size > r->addr ?
+			(first + i) * page_size - r->addr : 0;
+		end = (first + j) * page_size - r->addr;
+		if (end > r->len)
+			end = r->len;
+
+		start -= start % r->elem_size;
+		end   += (r->elem_size - end % r->elem_size) % r->elem_size;
+
+		if (pt_readmemory_buf(child, r->addr + start, r->buf + start,
+			end - start) < 0)
+			continue;
+
+		changes += rg_diff("region", r->name, (r->addr - r->base) + start,
+			r->shadow + start, r->buf + start, end - start, r->elem_size,
+			r->encoding, line_no, depth);
+	}
+
+	return (changes);
+}
+
+/**
+ * @brief Checks if there is a change for all the watched
+ * regions, if so, exhibits the changed elements.
+ *
+ * @param child Child process.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns the amount of changes found.
+ */
+int rg_check_changes(pid_t child, unsigned line_no, int depth)
+{
+	int changes;
+	int ret;
+
+	changes = 0;
+	pthread_mutex_lock(&rg_mutex);
+
+	if (rg_pending)
+		rg_resolve_locked(child);
+
+	for (int i = 0; i < nactive; i++)
+	{
+		struct region *r = &regions[i];
+		if (r->shadow == NULL)
+			continue;
+
+		if (r->softdirty)
+		{
+			if ((ret = rg_check_dirty(r, child, line_no, depth)) >= 0)
+			{
+				changes += ret;
+				continue;
+			}
+			r->softdirty = 0;
+		}
+
+		if (pt_readmemory_buf(child, r->addr, r->buf, r->len) < 0)
+			continue;
+
+		changes += rg_diff("region", r->name, r->addr - r->base, r->shadow,
+			r->buf, r->len, r->elem_size, r->encoding, line_no, depth);
+	}
+
+	rg_clear_refs();
+	pthread_mutex_unlock(&rg_mutex);
+	return (changes);
+}
+
+/**
+ * @brief Deallocates all the regions and mappings.
+ */
+void rg_finish(void)
+{
+	for (int i = 0; i < nregions; i++)
+	{
+		free(regions[i].name);
+		free(regions[i].shadow);
+		free(regions[i].buf);
+		free(regions[i].pagemap);
+	}
+
+	for (int i = 0; i < nmappings; i++)
+		free(mappings[i].name);
+
+	if (pagemap_fd >= 0)
+		close(pagemap_fd);
+	if (clear_refs_fd >= 0)
+		close(clear_refs_fd);
+
+	memset(regions, 0, sizeof regions);
+	nregions = nmappings = nactive = rg_pending = 0;
+	pagemap_fd = clear_refs_fd = -1;
+}
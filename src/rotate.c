@@ -0,0 +1,501 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "rotate.h"
+#include "lz.h"
+#include "pbd.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/* Rotation state. */
+static struct rotate
+{
+	char *path;          /* Output file.                   */
+	int fd;              /* Output file descriptor.        */
+	size_t max_size;     /* Maximum segment size.          */
+	int keep;            /* Rotated segments kept, 0: all. */
+	size_t size;         /* Current segment size.          */
+	int last_nl;         /* Segment ends with a newline?.  */
+
+	/* Ring buffer, head and tail only grow. */
+	char *ring;
+	size_t head;
+	size_t tail;
+
+	/* Segments rotated and compressed so far. */
+	unsigned rotated;
+	unsigned compressed;
+
+	int done;            /* No more data.                  */
+	int writer_done;     /* No more segments.              */
+	pthread_mutex_t lock;
+	pthread_cond_t data;
+	pthread_cond_t space;
+	pthread_cond_t segment;
+	pthread_t writer;
+	pthread_t compressor;
+	int running;
+} ro = {
+	.fd = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.data = PTHREAD_COND_INITIALIZER,
+	.space = PTHREAD_COND_INITIALIZER,
+	.segment = PTHREAD_COND_INITIALIZER
+};
+
+/**
+ * @brief Builds the name of the segment @p seq.
+ *
+ * @param seq Segment number.
+ * @param ext Extension, may be empty.
+ *
+ * @return Returns the name (should be freed), or NULL if
+ * out of memory.
+ */
+static char *ro_segment_name(unsigned seq, const char *ext)
+{
+	char *name;
+	size_t len;
+
+	len = strlen(ro.path) + strlen(ext) + 16;
+	if ((name = malloc(len)) != NULL)
+		snprintf(name, len, "%s.%u%s", ro.path, seq, ext);
+	return (name);
+}
+
+/**
+ * @brief Renames the current output file to the next segment
+ * and creates a new (empty) one in its place, using the same
+ * file descriptor.
+ */
+static void ro_rotate(void)
+{
+	char *name;
+	int fd;
+
+	if ((name = ro_segment_name(ro.rotated + 1, "")) == NULL)
+		return;
+
+	if (rename(ro.path, name) < 0)
+	{
+		fprintf(stderr, "PBD: unable to rotate the output (%s)\n",
+			strerror(errno));
+		free(name);
+		return;
+	}
+	free(name);
+
+	fd = open(ro.path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd < 0 || dup2(fd, ro.fd) < 0)
+	{
+		fprintf(stderr, "PBD: unable to create the output (%s)\n",
+			strerror(errno));
+	}
+	if (fd >= 0)
+		close(fd);
+
+	ro.size = 0;
+
+	pthread_mutex_lock(&ro.lock);
+		ro.rotated++;
+		pthread_cond_signal(&ro.segment);
+	pthread_mutex_unlock(&ro.lock);
+}
+
+/**
+ * @brief Writes (part of) @p data into the current segment,
+ * rotating it when full.
+ *
+ * Segments only end at line boundaries: if the data does not
+ * fit, it is written up to the last newline that fits (or up
+ * to the first one, if none fits).
+ *
+ * @param data Data to be written.
+ * @param len Data length.
+ *
+ * @return Returns the amount of bytes consumed.
+ */
+static size_t ro_segment_write(const char *data, size_t len)
+{
+	const char *nl;  /* Newline.        */
+	size_t room;     /* Segment room.   */
+	size_t n;        /* Bytes to write. */
+	ssize_t w;       /* Bytes written.  */
+
+	n = len;
+	room = (ro.size < ro.max_size) ? ro.max_size - ro.size : 0;
+
+	if (n > room)
+	{
+		nl = NULL;
+		for (size_t i = room; i > 0 && !nl; i--)
+			if (data[i - 1] == '\n')
+				nl = data + i - 1;
+
+		if (!nl)
+			nl = memchr(data + room, '\n', len - room);
+		if (nl)
+			n = nl - data + 1;
+	}
+
+	for (size_t off = 0; off < n; )
+	{
+		w = write(ro.fd, data + off, n - off);
+		if (w < 0 && errno == EINTR)
+			continue;
+
+		/* Unrecoverable error (e.g: ENOSPC), drop the data. */
+		if (w <= 0)
+			break;
+
+		off += w;
+	}
+
+	ro.size += n;
+	ro.last_nl = (data[n - 1] == '\n');
+
+	if (ro.size >= ro.max_size && ro.last_nl)
+		ro_rotate();
+
+	return (n);
+}
+
+/**
+ * @brief Writer thread: writes the ring buffer data into the
+ * output file, until there is no more data.
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *ro_writer(void *arg)
+{
+	size_t start;
+	size_t len;
+	((void)arg);
+
+	/* Diagnostics only, never the traced output. */
+	pbd_output = stderr;
+
+	pthread_mutex_lock(&ro.lock);
+	for (;;)
+	{
+		while (ro.head == ro.tail && !ro.done)
+			pthread_cond_wait(&ro.data, &ro.lock);
+
+		if (ro.head == ro.tail)
+			break;
+
+		start = ro.tail % RO_RING_SIZE;
+		len   = ro.head - ro.tail;
+		if (len > RO_RING_SIZE - start)
+			len = RO_RING_SIZE - start;
+
+		/* The producer never touches the pending data. */
+		pthread_mutex_unlock(&ro.lock);
+			len = ro_segment_write(ro.ring + start, len);
+		pthread_mutex_lock(&ro.lock);
+
+		ro.tail += len;
+		pthread_cond_signal(&ro.space);
+	}
+	pthread_mutex_unlock(&ro.lock);
+	return (NULL);
+}
+
+/**
+ * @brief Compresses the segment @p seq and removes the original.
+ *
+ * @param seq Segment number.
+ */
+static void ro_compress(unsigned seq)
+{
+	char buf[64 << 10];
+	char *src_name;
+	char *dst_name;
+	FILE *src;
+	int ret;
+
+	src_name = ro_segment_name(seq, "");
+	dst_name = ro_segment_name(seq, RO_EXT);
+	if (!src_name || !dst_name)
+		goto out0;
+
+	if ((src = fopen(src_name, "rb")) == NULL)
+		goto out0;
+
+	ret = -1;
+
+#ifdef HAVE_ZLIB
+	{
+		gzFile dst;
+		size_t n;
+
+		/* Fast compression, level 1. */
+		if ((dst = gzopen(dst_name, "wb1")) != NULL)
+		{
+			ret = 0;
+			while ((n = fread(buf, 1, sizeof(buf), src)) > 0)
+			{
+				if (gzwrite(dst, buf, n) != (int)n)
+				{
+					ret = -1;
+					break;
+				}
+			}
+			if (gzclose(dst) != Z_OK || ferror(src))
+				ret = -1;
+		}
+	}
+#else
+	{
+		FILE *dst;
+
+		if ((dst = fopen(dst_name, "wb")) != NULL)
+		{
+			setvbuf(dst, buf, _IOFBF, sizeof(buf));
+			ret = lz_compress_file(src, dst);
+			if (fclose(dst))
+				ret = -1;
+		}
+	}
+#endif
+
+	fclose(src);
+
+	/* Keep the original if anything goes wrong. */
+	if (ret < 0)
+	{
+		fprintf(stderr, "PBD: unable to compress %s\n", src_name);
+		unlink(dst_name);
+	}
+	else
+		unlink(src_name);
+
+out0:
+	free(src_name);
+	free(dst_name);
+}
+
+/**
+ * @brief Removes the segment that exceeds the amount of segments
+ * to be kept, after the segment @p seq.
+ *
+ * @param seq Last segment.
+ */
+static void ro_expire(unsigned seq)
+{
+	char *name;
+
+	if (!ro.keep || seq <= (unsigned)ro.keep)
+		return;
+
+	seq -= ro.keep;
+
+	if ((name = ro_segment_name(seq, RO_EXT)) != NULL)
+		unlink(name);
+	free(name);
+
+	if ((name = ro_segment_name(seq, "")) != NULL)
+		unlink(name);
+	free(name);
+}
+
+/**
+ * @brief Compressor thread: compresses the rotated segments,
+ * in order, until there are no more segments.
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *ro_compressor(void *arg)
+{
+	unsigned seq;
+	((void)arg);
+
+	/* Diagnostics only, never the traced output. */
+	pbd_output = stderr;
+
+	pthread_mutex_lock(&ro.lock);
+	for (;;)
+	{
+		while (ro.compressed == ro.rotated && !ro.writer_done)
+			pthread_cond_wait(&ro.segment, &ro.lock);
+
+		if (ro.compressed == ro.rotated)
+			break;
+
+		seq = ro.compressed + 1;
+		pthread_mutex_unlock(&ro.lock);
+			ro_compress(seq);
+			ro_expire(seq);
+		pthread_mutex_lock(&ro.lock);
+
+		ro.compressed = seq;
+	}
+	pthread_mutex_unlock(&ro.lock);
+	return (NULL);
+}
+
+/**
+ * @brief Starts the rotating output, for the file @p path,
+ * already opened as @p fd.
+ *
+ * @param fd Output file descriptor.
+ * @param path Output file.
+ * @param max_size Maximum size, per segment.
+ * @param keep Amount of rotated segments kept, 0 means all.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int ro_init(int fd, const char *path, size_t max_size, int keep)
+{
+	ro.fd = fd;
+	ro.max_size = max_size;
+	ro.keep = keep;
+
+	ro.path = malloc(sizeof(char) * (strlen(path) + 1));
+	ro.ring = malloc(RO_RING_SIZE);
+	if (!ro.path || !ro.ring)
+		goto err;
+
+	strcpy(ro.path, path);
+
+	if (pthread_create(&ro.writer, NULL, ro_writer, NULL))
+		goto err;
+
+	if (pthread_create(&ro.compressor, NULL, ro_compressor, NULL))
+	{
+		pthread_mutex_lock(&ro.lock);
+			ro.done = 1;
+			pthread_cond_signal(&ro.data);
+		pthread_mutex_unlock(&ro.lock);
+		pthread_join(ro.writer, NULL);
+		goto err;
+	}
+
+	ro.running = 1;
+	return (0);
+err:
+	free(ro.path);
+	free(ro.ring);
+	ro.path = NULL;
+	ro.ring = NULL;
+	return (-1);
+}
+
+/**
+ * @brief Hands @p data to the writer thread.
+ *
+ * @param data Data to be written.
+ * @param len Data length.
+ * @param block If set, waits until everything is accepted.
+ *
+ * @return Returns the amount of bytes accepted, which may be
+ * less than @p len if the ring buffer is full and @p block
+ * is not set.
+ */
+size_t ro_write(const char *data, size_t len, int block)
+{
+	size_t accepted;
+	size_t start;
+	size_t free_space;
+	size_t n;
+
+	accepted = 0;
+
+	pthread_mutex_lock(&ro.lock);
+	while (accepted < len)
+	{
+		free_space = RO_RING_SIZE - (ro.head - ro.tail);
+		if (!free_space)
+		{
+			if (!block)
+				break;
+			pthread_cond_wait(&ro.space, &ro.lock);
+			continue;
+		}
+
+		n = len - accepted;
+		if (n > free_space)
+			n = free_space;
+
+		/* Up to the end of the ring, and then, from the start. */
+		start = ro.head % RO_RING_SIZE;
+		if (n > RO_RING_SIZE - start)
+		{
+			memcpy(ro.ring + start, data + accepted, RO_RING_SIZE - start);
+			memcpy(ro.ring, data + accepted + (RO_RING_SIZE - start),
+				n - (RO_RING_SIZE - start));
+		}
+		else
+			memcpy(ro.ring + start, data + accepted, n);
+
+		ro.head  += n;
+		accepted += n;
+		pthread_cond_signal(&ro.data);
+	}
+	pthread_mutex_unlock(&ro.lock);
+	return (accepted);
+}
+
+/**
+ * @brief Writes everything pending, waits for the compression
+ * of all the rotated segments and releases everything.
+ */
+void ro_finish(void)
+{
+	if (!ro.running)
+		return;
+
+	pthread_mutex_lock(&ro.lock);
+		ro.done = 1;
+		pthread_cond_signal(&ro.data);
+	pthread_mutex_unlock(&ro.lock);
+	pthread_join(ro.writer, NULL);
+
+	pthread_mutex_lock(&ro.lock);
+		ro.writer_done = 1;
+		pthread_cond_signal(&ro.segment);
+	pthread_mutex_unlock(&ro.lock);
+	pthread_join(ro.compressor, NULL);
+
+	free(ro.path);
+	free(ro.ring);
+	ro.path = NULL;
+	ro.ring = NULL;
+	ro.running = 0;
+}
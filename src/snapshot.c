@@ -0,0 +1,666 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ptrace.h"
+#include "snapshot.h"
+#include "heatmap.h"
+#include "pbd.h"
+#include "line.h"
+#include "plugin.h"
+#include "pbd_plugin.h"
+#include "strdiff.h"
+#include "summary.h"
+#include "transition.h"
+#include "variable.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+
+/**
+ * Work item: a chunk of an offloaded array.
+ */
+struct ss_item
+{
+	struct dw_variable *v;  /* Variable.                       */
+	uintptr_t addr;         /* Chunk address, in the child.    */
+	size_t off;             /* Chunk offset, in the variable.  */
+	size_t len;             /* Chunk size.                     */
+	int changes;            /* Amount of changes found.        */
+	int error;              /* Unable to read the chunk.       */
+	char *out;              /* Chunk output.                   */
+	size_t out_size;        /* Chunk output size.              */
+};
+
+/**
+ * Snapshot: a copy of the child, taken at a stop, its chunks
+ * to be compared and the output of the stops that follow it,
+ * held until the snapshot is written.
+ */
+struct ss_snap
+{
+	struct ss_item *items;  /* Work items.                     */
+	int nitems;             /* Amount of work items.           */
+	int maxitems;           /* Work items capacity.            */
+	int next;               /* Next item to be compared.       */
+	int finished;           /* Items already compared.         */
+	pid_t pid;              /* Child copy (or the child).      */
+	unsigned line_no;       /* Line of the stop.               */
+	int depth;              /* Function depth.                 */
+	FILE *text;             /* Output of the following stops.  */
+	char *text_buf;         /* Output buffer.                  */
+	size_t text_size;       /* Output size.                    */
+};
+
+/*
+ * Snapshots queue, compared (one at a time, as each one is
+ * compared against the values left by the previous one) and
+ * written in order: [ss_head, ss_work) are compared, and
+ * [ss_work, ss_tail) are waiting for or being compared.
+ */
+static struct ss_snap ss_queue[SS_MAX_SNAPSHOTS];
+static uint64_t ss_head;
+static uint64_t ss_work;
+static uint64_t ss_tail;
+
+#define SS_SNAP(n) (&ss_queue[(n) % SS_MAX_SNAPSHOTS])
+
+/* Child and its real output, while the stops output is held. */
+static pid_t ss_child;
+static FILE *ss_output;
+
+/* Changes written by ss_start(), not returned yet. */
+static int ss_changes;
+
+/* Worker threads. */
+static pthread_t ss_threads[SS_MAX_THREADS];
+static int ss_nthreads;
+static int ss_started;
+static int ss_quit;
+static pthread_mutex_t ss_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ss_cond  = PTHREAD_COND_INITIALIZER;
+
+/* Main thread buffer. */
+static char *ss_buf;
+static size_t ss_buf_size;
+
+/**
+ * @brief Marks the arrays of @p vars with at least @p min_size
+ * bytes to be compared in a snapshot of the child, instead of
+ * in the child itself.
+ *
+ * @param vars Variables list.
+ * @param min_size Minimum array size, in bytes.
+ *
+ * @return Returns the amount of variables marked.
+ */
+int ss_mark(struct array *vars, size_t min_size)
+{
+	int marked;
+
+	marked = 0;
+	for (int i = 0; i < (int) array_size(&vars); i++)
+	{
+		struct dw_variable *v;
+		v = array_get(&vars, i, NULL);
+
+		if (v->type.var_type != TARRAY ||
+			!(v->type.array.var_type & (TBASE_TYPE|TENUM|TPOINTER)) ||
+			v->byte_size < min_size)
+		{
+			continue;
+		}
+
+		v->offload = 1;
+		marked++;
+	}
+	return (marked);
+}
+
+/**
+ * @brief Adds a new work item for the variable @p v into the
+ * snapshot @p s.
+ *
+ * @param s Snapshot.
+ * @param v Variable.
+ * @param addr Chunk address, in the child.
+ * @param off Chunk offset, in the variable.
+ * @param len Chunk size.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int ss_add_item(struct ss_snap *s, struct dw_variable *v,
+	uintptr_t addr, size_t off, size_t len)
+{
+	struct ss_item *it;
+
+	if (s->nitems == s->maxitems)
+	{
+		int n = s->maxitems ? s->maxitems * 2 : 16;
+		if ((it = realloc(s->items, n * sizeof(struct ss_item))) == NULL)
+			return (-1);
+
+		s->items = it;
+		s->maxitems = n;
+	}
+
+	it = &s->items[s->nitems++];
+	memset(it, 0, sizeof(struct ss_item));
+	it->v    = v;
+	it->addr = addr + off;
+	it->off  = off;
+	it->len  = len;
+	return (0);
+}
+
+/**
+ * @brief Reports a change found in a snapshot, just like
+ * var_report_change(): through the plugins (that may suppress
+ * it) and the current printer, or the statistics, in --summary
+ * mode.
+ *
+ * @param s Snapshot.
+ * @param v Changed variable.
+ * @param v_before Value before.
+ * @param v_after Value after.
+ * @param array_idxs Element indexes, NULL if bitmap.
+ */
+static void ss_report(struct ss_snap *s, struct dw_variable *v,
+	union var_value *v_before, union var_value *v_after, int *array_idxs)
+{
+	if (args.flags & FLG_SUMMARY)
+	{
+		sm_update(v, v_after);
+		return;
+	}
+
+	if (args.flags & FLG_TRANSITIONS)
+	{
+		tm_update(v, s->line_no, v_before, v_after);
+		return;
+	}
+
+	/* Bitmaps and strings are never seen by plugins. */
+	if ((args.flags & FLG_PLUGIN) && !v->bitmap && !v->string &&
+		plugin_change(ss_child, s->depth, s->line_no, v, v_before,
+		v_after, array_idxs) == PBD_PLUGIN_SUPPRESS)
+	{
+		return;
+	}
+
+	line_output(s->depth, s->line_no, v, v_before, v_after, array_idxs);
+}
+
+/**
+ * @brief Compares the chunk @p it of the snapshot against the
+ * last known value of its variable, writes the changes into
+ * the chunk own output and updates the variable.
+ *
+ * @param s Snapshot.
+ * @param it Work item.
+ * @param buf Buffer, at least as big as the chunk.
+ */
+static void ss_diff(struct ss_snap *s, struct ss_item *it, char *buf)
+{
+	int idxs[MATRIX_MAX_DIMENSIONS] = {0}; /* Element indexes. */
+	union var_value value1, value2;        /* Element values.  */
+	struct dw_variable *v;                 /* Variable.        */
+	size_t size_per_element;               /* Element size.    */
+	int64_t byte_offset;                   /* Change offset.   */
+	size_t elem;                           /* Element index.   */
+	size_t off;                            /* Current offset.  */
+	char *old;                             /* Old chunk.       */
+	FILE *prev;                            /* Caller output.   */
+	FILE *out;                             /* Chunk output.    */
+
+	v   = it->v;
+	old = v->value.p_value + it->off;
+
+	if (pt_readmemory_buf(s->pid, it->addr, buf, it->len) < 0 ||
+		(out = open_memstream(&it->out, &it->out_size)) == NULL)
+	{
+		it->error = 1;
+		return;
+	}
+
+	/*
+	 * The chunk may be compared by the main thread (see ss_wait()),
+	 * so the output is restored before closing the memory stream.
+	 */
+	prev = pbd_output;
+	pbd_output = out;
+
+	/* Bitmaps and strings are reported at once, and are never split. */
+	if (v->bitmap || v->string)
+	{
+		if (offmemcmp(old, buf, 1, it->len) >= 0)
+		{
+			/* Only past the NUL: same string, just keep it. */
+			if (v->string && !sd_changed(old, buf, it->len))
+			{
+				memcpy(old, buf, it->len);
+				goto out;
+			}
+
+			if (args.flags & FLG_HEATMAP)
+				hm_update_range(v, old, buf,
+					it->off / v->type.array.size_per_element, it->len);
+
+			value1.p_value = old;
+			value2.p_value = buf;
+			ss_report(s, v, &value1, &value2, NULL);
+			it->changes++;
+		}
+		goto out;
+	}
+
+	size_per_element = v->type.array.size_per_element;
+	off = 0;
+
+	while (off < it->len &&
+		(byte_offset = offmemcmp(old + off, buf + off,
+		size_per_element, it->len - off)) >= 0)
+	{
+		off += byte_offset;
+
+		memcpy(value1.u8_value, old + off, size_per_element);
+		memcpy(value2.u8_value, buf + off, size_per_element);
+
+		elem = (it->off + off) / size_per_element;
+		if (args.flags & FLG_HEATMAP)
+			hm_update(v, elem);
+
+		for (int j = v->type.array.dimensions - 1; j >= 0; j--)
+		{
+			idxs[j] = elem % v->type.array.elements_per_dimension[j];
+			elem /= v->type.array.elements_per_dimension[j];
+		}
+
+		ss_report(s, v, &value1, &value2, idxs);
+		it->changes++;
+
+		off += size_per_element;
+	}
+
+out:
+	if (it->changes)
+		memcpy(old, buf, it->len);
+	pbd_output = prev;
+	fclose(out);
+}
+
+/**
+ * @brief Compares the next work item of the snapshot being
+ * compared, if any, with the queue lock held (and released
+ * meanwhile).
+ *
+ * @param buf Buffer, grown as needed.
+ * @param size Buffer size.
+ *
+ * @return Returns 1 if an item was compared, 0 otherwise.
+ */
+static int ss_step(char **buf, size_t *size)
+{
+	struct ss_item *it;
+	struct ss_snap *s;
+	char *p;
+
+	if (ss_work == ss_tail)
+		return (0);
+
+	s = SS_SNAP(ss_work);
+	if (s->next == s->nitems)
+		return (0);
+
+	it = &s->items[s->next++];
+	pthread_mutex_unlock(&ss_lock);
+
+	if (it->len > *size && (p = realloc(*buf, it->len)) != NULL)
+	{
+		*buf  = p;
+		*size = it->len;
+	}
+
+	if (it->len <= *size)
+		ss_diff(s, it, *buf);
+	else
+		it->error = 1;
+
+	pthread_mutex_lock(&ss_lock);
+
+	/* The next snapshot may start now. */
+	if (++s->finished == s->nitems)
+	{
+		ss_work++;
+		pthread_cond_broadcast(&ss_cond);
+	}
+	return (1);
+}
+
+/**
+ * @brief Worker thread: compares the work items, one at a time,
+ * snapshot after snapshot.
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *ss_worker(void *arg)
+{
+	size_t size;
+	char *buf;
+	((void)arg);
+
+	buf  = NULL;
+	size = 0;
+
+	pthread_mutex_lock(&ss_lock);
+	while (!ss_quit)
+		if (!ss_step(&buf, &size))
+			pthread_cond_wait(&ss_cond, &ss_lock);
+	pthread_mutex_unlock(&ss_lock);
+
+	free(buf);
+	return (NULL);
+}
+
+/**
+ * @brief Waits until the snapshot @p n has been compared,
+ * helping the workers meanwhile.
+ *
+ * @param n Snapshot number.
+ */
+static void ss_wait(uint64_t n)
+{
+	pthread_mutex_lock(&ss_lock);
+	while (ss_work <= n)
+		if (!ss_step(&ss_buf, &ss_buf_size))
+			pthread_cond_wait(&ss_cond, &ss_lock);
+	pthread_mutex_unlock(&ss_lock);
+}
+
+/**
+ * @brief Writes the changes of the (compared) snapshot @p s and
+ * the output held after it into the real output, and releases
+ * the child copy.
+ *
+ * @param s Snapshot.
+ *
+ * @return Returns the amount of changes found.
+ */
+static int ss_write(struct ss_snap *s)
+{
+	int changes;
+	int status;
+
+	if (s->pid != ss_child)
+	{
+		kill(s->pid, SIGKILL);
+		while (waitpid(s->pid, &status, __WALL) < 0 && errno == EINTR)
+			;
+	}
+
+	changes = 0;
+	for (int i = 0; i < s->nitems; i++)
+	{
+		struct ss_item *it = &s->items[i];
+
+		if (it->error)
+			fprintf(stderr, "PBD: unable to read (%s) from the snapshot, "
+				"skipping!\n", it->v->name);
+		else if (it->out)
+			fwrite(it->out, 1, it->out_size, ss_output);
+
+		changes += it->changes;
+		free(it->out);
+	}
+
+	if (s->text != NULL)
+	{
+		if (pbd_output == s->text)
+			pbd_output = ss_output;
+
+		fclose(s->text);
+		fwrite(s->text_buf, 1, s->text_size, ss_output);
+		free(s->text_buf);
+		s->text = NULL;
+	}
+
+	s->nitems = 0;
+	return (changes);
+}
+
+/**
+ * @brief Starts the worker threads, if not started yet.
+ *
+ * @return Returns the amount of worker threads.
+ */
+static int ss_start_workers(void)
+{
+	long nprocs; /* Online CPUs. */
+
+	if (ss_started)
+		return (ss_nthreads);
+
+	ss_started = 1;
+	nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+	nprocs = (nprocs > 0 && nprocs < SS_MAX_THREADS) ? nprocs : SS_MAX_THREADS;
+
+	for (ss_nthreads = 0; ss_nthreads < nprocs; ss_nthreads++)
+		if (pthread_create(&ss_threads[ss_nthreads], NULL, ss_worker, NULL))
+			break;
+
+	return (ss_nthreads);
+}
+
+/**
+ * @brief Starts comparing the offloaded arrays of @p vars, as
+ * seen by the (stopped) @p child at the line @p line_no.
+ *
+ * A copy-on-write copy of the child is created and queued, to
+ * be compared by worker threads, so the child may be resumed
+ * right away. From now on, and until the copy is compared and
+ * its changes written (see ss_flush()), the output is held, so
+ * that everything is still written in order.
+ *
+ * If the copy cannot be created (or there are no workers), the
+ * child itself is compared, before returning.
+ *
+ * @param child Child process, must be stopped.
+ * @param vars Variables list, for the current context.
+ * @param line_no Line number.
+ * @param depth Function depth.
+ *
+ * @return Returns 0 if the comparison was offloaded, 1 if it
+ * was done in the child, and a negative number if error.
+ *
+ * @note The changes are only known after ss_flush() or
+ * ss_join(), and the latter must be called before the variables
+ * of @p vars are released.
+ */
+int ss_start(pid_t child, struct array *vars, unsigned line_no, int depth)
+{
+	uintptr_t base_pointer; /* Base pointer. */
+	struct ss_snap *s;      /* Snapshot.     */
+	size_t chunk;           /* Chunk size.   */
+
+	/* Queue full, wait for the oldest one. */
+	if (ss_tail - ss_head == SS_MAX_SNAPSHOTS)
+	{
+		ss_wait(ss_head);
+		ss_changes += ss_flush();
+	}
+
+	s = SS_SNAP(ss_tail);
+	s->nitems   = 0;
+	s->next     = 0;
+	s->finished = 0;
+	base_pointer = 0;
+
+	for (int i = 0; i < (int) array_size(&vars); i++)
+	{
+		struct dw_variable *v;
+		uintptr_t addr;
+
+		v = array_get(&vars, i, NULL);
+		if (!v->offload || v->value.p_value == NULL)
+			continue;
+
+		if (v->scope == VGLOBAL)
+			addr = v->location.address;
+		else
+		{
+			if (!base_pointer)
+				base_pointer = pt_readregister_bp(child);
+			addr = base_pointer + v->location.fp_offset;
+		}
+
+		/*
+		 * Chunks are multiple of the element size and of 16 bytes,
+		 * as required by offmemcmp().
+		 */
+		chunk = v->type.array.size_per_element * 16;
+		chunk = (v->bitmap || v->string || chunk >= SS_CHUNK) ?
+			v->byte_size : (SS_CHUNK / chunk) * chunk;
+
+		for (size_t off = 0; off < v->byte_size; off += chunk)
+		{
+			if (ss_add_item(s, v, addr, off, (v->byte_size - off < chunk) ?
+				v->byte_size - off : chunk) < 0)
+			{
+				return (-1);
+			}
+		}
+	}
+
+	if (!s->nitems)
+		return (0);
+
+	ss_child   = child;
+	s->line_no = line_no;
+	s->depth   = depth;
+	s->text    = NULL;
+
+	/* Output written so far, if not held. */
+	if (ss_head == ss_tail)
+		ss_output = pbd_output;
+
+	/*
+	 * No copy: compare the child itself, after everything queued
+	 * before, and write it right away.
+	 */
+	if (!ss_start_workers() || (s->pid = pt_fork(child)) < 0)
+	{
+		ss_changes += ss_join();
+
+		s->pid = child;
+		pthread_mutex_lock(&ss_lock);
+			ss_tail++;
+		pthread_mutex_unlock(&ss_lock);
+
+		ss_changes += ss_join();
+		return (1);
+	}
+
+	/* Output of the next stops, held until the copy is compared. */
+	if ((s->text = open_memstream(&s->text_buf, &s->text_size)) == NULL)
+	{
+		s->nitems = 0;
+		kill(s->pid, SIGKILL);
+		waitpid(s->pid, NULL, __WALL);
+		return (-1);
+	}
+
+	pthread_mutex_lock(&ss_lock);
+		ss_tail++;
+		pthread_cond_broadcast(&ss_cond);
+	pthread_mutex_unlock(&ss_lock);
+
+	pbd_output = s->text;
+	return (0);
+}
+
+/**
+ * @brief Writes, in order, the snapshots already compared and
+ * the output held after them, without waiting for the others.
+ *
+ * @return Returns the amount of changes found.
+ */
+int ss_flush(void)
+{
+	uint64_t work;
+	int changes;
+
+	pthread_mutex_lock(&ss_lock);
+		work = ss_work;
+	pthread_mutex_unlock(&ss_lock);
+
+	changes = ss_changes;
+	ss_changes = 0;
+
+	for (; ss_head < work; ss_head++)
+		changes += ss_write(SS_SNAP(ss_head));
+
+	return (changes);
+}
+
+/**
+ * @brief Waits for all the snapshots queued and writes them, in
+ * order, along with the output held after them.
+ *
+ * @return Returns the amount of changes found.
+ */
+int ss_join(void)
+{
+	if (ss_tail != ss_head)
+		ss_wait(ss_tail - 1);
+
+	return (ss_flush());
+}
+
+/**
+ * @brief Stops the worker threads and releases the snapshots,
+ * after ss_join().
+ */
+void ss_finish(void)
+{
+	pthread_mutex_lock(&ss_lock);
+		ss_quit = 1;
+		pthread_cond_broadcast(&ss_cond);
+	pthread_mutex_unlock(&ss_lock);
+
+	for (int i = 0; i < ss_nthreads; i++)
+		pthread_join(ss_threads[i], NULL);
+
+	for (int i = 0; i < SS_MAX_SNAPSHOTS; i++)
+	{
+		free(ss_queue[i].items);
+		ss_queue[i].items = NULL;
+		ss_queue[i].maxitems = 0;
+	}
+
+	free(ss_buf);
+	ss_buf = NULL;
+	ss_buf_size = 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "strdiff.h"
+#include "dwarf_helper.h"
+#include "variable.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Characters shown per string and report mode. */
+static size_t sd_max = SD_MAX_DEFAULT;
+static int sd_edit;
+
+/**
+ * @brief Marks all the char arrays (one dimension, 1-byte
+ * integer elements) of @p vars, except the bitmaps, to be
+ * reported as strings.
+ *
+ * @param vars Variables list.
+ * @param max Maximum amount of characters shown, per string.
+ * @param edit If set, reports only the range changed.
+ */
+void sd_mark(struct array *vars, int max, int edit)
+{
+	sd_max  = max;
+	sd_edit = edit;
+
+	for (int i = 0; i < (int) array_size(&vars); i++)
+	{
+		struct dw_variable *v;
+		v = array_get(&vars, i, NULL);
+
+		if (v->type.var_type != TARRAY || v->bitmap ||
+			v->type.array.var_type != TBASE_TYPE ||
+			v->type.array.size_per_element != 1 ||
+			v->type.array.dimensions != 1 ||
+			!(v->type.encoding & (ENC_SIGNED|ENC_UNSIGNED)))
+			continue;
+
+		v->string = 1;
+	}
+}
+
+/**
+ * @brief Appends the first @p len bytes of @p str, escaped and
+ * quoted, into @p buf, up to sd_max characters.
+ *
+ * @param buf Output buffer, at least 4 * sd_max + 8 bytes.
+ * @param str String.
+ * @param len String length.
+ *
+ * @return Returns the amount of bytes written.
+ */
+static size_t sd_quote(char *buf, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned char c;
+	size_t n;
+	size_t i;
+
+	n = 0;
+	buf[n++] = '"';
+	for (i = 0; i < len && i < sd_max; i++)
+	{
+		c = str[i];
+		switch (c)
+		{
+			case '"':  buf[n++] = '\\'; buf[n++] = '"';  break;
+			case '\\': buf[n++] = '\\'; buf[n++] = '\\'; break;
+			case '\n': buf[n++] = '\\'; buf[n++] = 'n';  break;
+			case '\r': buf[n++] = '\\'; buf[n++] = 'r';  break;
+			case '\t': buf[n++] = '\\'; buf[n++] = 't';  break;
+			case '\0': buf[n++] = '\\'; buf[n++] = '0';  break;
+			default:
+				if (c >= 0x20 && c < 0x7f)
+					buf[n++] = c;
+				else
+				{
+					buf[n++] = '\\';
+					buf[n++] = 'x';
+					buf[n++] = hex[c >> 4];
+					buf[n++] = hex[c & 0xf];
+				}
+				break;
+		}
+	}
+	buf[n++] = '"';
+
+	/* Truncated. */
+	if (i < len)
+	{
+		memcpy(buf + n, "...", 3);
+		n += 3;
+	}
+	buf[n] = '\0';
+	return (n);
+}
+
+/**
+ * @brief Checks whether the strings of the char arrays @p old
+ * and @p new differ: if only the bytes after the NUL terminator
+ * changed, the strings are the same, and there is nothing to
+ * report (although the array should still be updated).
+ *
+ * @param old Old buffer.
+ * @param new New buffer.
+ * @param len Buffers length.
+ *
+ * @return Returns 1 if the strings differ, 0 otherwise.
+ */
+int sd_changed(const char *old, const char *new, size_t len)
+{
+	size_t l1, l2; /* Strings lengths. */
+
+	l1 = strnlen(old, len);
+	l2 = strnlen(new, len);
+	return (l1 != l2 || memcmp(old, new, l1));
+}
+
+/**
+ * @brief Formats the change of the char array @p old into @p new:
+ * the strings before and after (up to the first NUL) or, in edit
+ * mode, the range changed (up to the longest NUL) and its new
+ * content. The strings must differ (see sd_changed()).
+ *
+ * @param buffer Output buffer, SD_BS bytes.
+ * @param size Buffer size.
+ * @param old Old buffer.
+ * @param new New buffer.
+ * @param len Buffers length.
+ *
+ * @return Returns the formatted change.
+ */
+char *sd_format(char *buffer, size_t size, const char *old,
+	const char *new, size_t len)
+{
+	int64_t first;  /* First byte changed. */
+	size_t last;    /* Last byte changed.  */
+	size_t n;       /* Bytes written.      */
+	size_t l1, l2;  /* Strings lengths.    */
+
+	if (size < SD_BS)
+	{
+		buffer[0] = '\0';
+		return (buffer);
+	}
+
+	l1 = strnlen(old, len);
+	l2 = strnlen(new, len);
+
+	if (!sd_edit)
+	{
+		n = snprintf(buffer, size, "before: ");
+		n += sd_quote(buffer + n, old, l1);
+		n += snprintf(buffer + n, size - n, ", after: ");
+		sd_quote(buffer + n, new, l2);
+		return (buffer);
+	}
+
+	/*
+	 * The strings differ, so does a byte up to the shortest NUL;
+	 * the range ends, at most, at the longest one.
+	 */
+	first = offmemcmp((void *)old, (void *)new, 1, len);
+	last  = (l1 > l2) ? l1 : l2;
+	if (last >= len)
+		last = len - 1;
+
+	for (; last > (size_t)first && old[last] == new[last]; last--)
+		;
+
+	if ((size_t)first == last)
+		n = snprintf(buffer, size, "edit: [%zu] = ", (size_t)first);
+	else
+		n = snprintf(buffer, size, "edit: [%zu-%zu] = ", (size_t)first, last);
+
+	sd_quote(buffer + n, new + first, last - first + 1);
+	return (buffer);
+}
@@ -0,0 +1,479 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "summary.h"
+#include "pbd.h"
+#include "variable.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Quantiles estimated, see SM_QUANTILES. */
+static const double sm_quantiles[SM_QUANTILES] = {0.5, 0.9, 0.99};
+
+/**
+ * P² quantile estimator (Jain & Chlamtac), five markers.
+ */
+struct sm_p2
+{
+	double q[5];   /* Marker heights.            */
+	double n[5];   /* Marker positions.          */
+	double np[5];  /* Desired marker positions.  */
+	double dn[5];  /* Desired position steps.    */
+};
+
+/**
+ * Online statistics of a single variable.
+ */
+struct sm_var
+{
+	char *name;                /* Variable name.            */
+	int scope;                 /* Variable scope.           */
+	uint64_t changes;          /* Amount of changes.        */
+	uint64_t samples;          /* Numeric samples.          */
+	double min;                /* Minimum value.            */
+	double max;                /* Maximum value.            */
+	double mean;               /* Running mean (Welford).   */
+	double m2;                 /* Squared diffs (Welford).  */
+	struct sm_p2 p2[SM_QUANTILES];
+	uint8_t hll[SM_HLL_M];     /* HyperLogLog registers.    */
+};
+
+/* Statistics, indexed by dw_variable::stats. */
+static struct sm_var *sm_vars;
+static int sm_nvars;
+
+/* Threads mode: variables may change concurrently. */
+static pthread_mutex_t sm_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* On demand report (SIGUSR1). */
+static volatile sig_atomic_t sm_signaled;
+
+/**
+ * @brief SIGUSR1 handler: just asks for a report, which is
+ * written at the next stop.
+ *
+ * @param sig Signal number.
+ */
+static void sm_sigusr1(int sig)
+{
+	((void)sig);
+	sm_signaled = 1;
+}
+
+/**
+ * @brief Initializes the statistics for the variables @p vars,
+ * of the first function context: since the contexts created
+ * afterwards copy these variables, all of them share the same
+ * statistics.
+ *
+ * @param vars Variables list.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int sm_init(struct array *vars)
+{
+	struct sigaction sa;
+
+	sm_nvars = (int) array_size(&vars);
+	if (!sm_nvars)
+		return (0);
+
+	if ((sm_vars = calloc(sm_nvars, sizeof(struct sm_var))) == NULL)
+		return (-1);
+
+	for (int i = 0; i < sm_nvars; i++)
+	{
+		struct dw_variable *v;
+		v = array_get(&vars, i, NULL);
+
+		sm_vars[i].name = malloc(sizeof(char) * (strlen(v->name) + 1));
+		if (sm_vars[i].name == NULL)
+			return (-1);
+
+		strcpy(sm_vars[i].name, v->name);
+		sm_vars[i].scope = v->scope;
+		v->stats = i;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sm_sigusr1;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+	return (0);
+}
+
+/**
+ * @brief Converts the value @p value, of @p size bytes and
+ * encoding @p encoding, to double.
+ *
+ * @param value Variable value.
+ * @param encoding Variable encoding.
+ * @param size Value size, in bytes.
+ *
+ * @return Returns the value as double.
+ */
+static double sm_to_double(union var_value *value, int encoding,
+	size_t size)
+{
+	uint64_t u;
+	int shift;
+
+	if (encoding == ENC_FLOAT)
+	{
+		if (size == 4)
+			return (value->f_value);
+		else if (size == 8)
+			return (value->d_value);
+		return ((double)value->ld_value);
+	}
+
+	u = value->u64_value[0];
+	if (size >= 8)
+		return (encoding == ENC_SIGNED ? (double)(int64_t)u : (double)u);
+
+	/* Sign/zero extend. */
+	shift = 64 - (int)size * 8;
+	if (encoding == ENC_SIGNED)
+		return ((double)((int64_t)(u << shift) >> shift));
+	return ((double)((u << shift) >> shift));
+}
+
+/**
+ * @brief Hashes the @p size first bytes of @p value (MurMur3
+ * finalizer, per 64-bit word).
+ *
+ * @param value Variable value.
+ * @param size Value size, in bytes.
+ *
+ * @return Returns the 64-bit hash.
+ */
+static uint64_t sm_hash(union var_value *value, size_t size)
+{
+	uint64_t w[2] = {0};
+	uint64_t h;
+
+	memcpy(w, value->u8_value, size < 16 ? size : 16);
+	h = w[0] ^ (w[1] * 0x9E3779B97F4A7C15ULL);
+
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return (h);
+}
+
+/**
+ * @brief Adds the hash @p h to the HyperLogLog registers @p hll.
+ *
+ * @param hll HyperLogLog registers.
+ * @param h Value hash.
+ */
+static inline void sm_hll_add(uint8_t *hll, uint64_t h)
+{
+	uint64_t rest;
+	uint8_t rank;
+
+	rest = (h << SM_HLL_P) | (1ULL << (SM_HLL_P - 1));
+	rank = (uint8_t)(__builtin_clzll(rest) + 1);
+
+	if (hll[h >> (64 - SM_HLL_P)] < rank)
+		hll[h >> (64 - SM_HLL_P)] = rank;
+}
+
+/**
+ * @brief Estimates the amount of distinct values seen by the
+ * HyperLogLog registers @p hll.
+ *
+ * @param hll HyperLogLog registers.
+ *
+ * @return Returns the estimated cardinality.
+ */
+static double sm_hll_count(const uint8_t *hll)
+{
+	double alpha;
+	double sum;
+	double e;
+	int zeros;
+
+	sum = 0.0;
+	zeros = 0;
+	for (int i = 0; i < SM_HLL_M; i++)
+	{
+		sum += ldexp(1.0, -hll[i]);
+		zeros += !hll[i];
+	}
+
+	alpha = 0.7213 / (1.0 + 1.079 / SM_HLL_M);
+	e = alpha * SM_HLL_M * SM_HLL_M / sum;
+
+	/* Small range correction: linear counting. */
+	if (e <= 2.5 * SM_HLL_M && zeros)
+		e = SM_HLL_M * log((double)SM_HLL_M / zeros);
+
+	return (e);
+}
+
+/**
+ * @brief Adds the sample @p x to the P² estimator @p p, for the
+ * quantile @p quantile, whose sample count (including @p x) is
+ * @p count.
+ *
+ * @param p P² estimator.
+ * @param quantile Quantile, between 0 and 1.
+ * @param count Amount of samples, including @p x.
+ * @param x New sample.
+ */
+static void sm_p2_add(struct sm_p2 *p, double quantile, uint64_t count,
+	double x)
+{
+	double d, qp;
+	int k, s;
+
+	/* The first five samples are kept as is. */
+	if (count <= 5)
+	{
+		p->q[count - 1] = x;
+		if (count < 5)
+			return;
+
+		/* Sort them and initialize the markers. */
+		for (int i = 1; i < 5; i++)
+			for (int j = i; j > 0 && p->q[j - 1] > p->q[j]; j--)
+				d = p->q[j], p->q[j] = p->q[j - 1], p->q[j - 1] = d;
+
+		for (int i = 0; i < 5; i++)
+			p->n[i] = i;
+
+		p->np[0] = 0; p->np[1] = 2 * quantile; p->np[2] = 4 * quantile;
+		p->np[3] = 2 + 2 * quantile; p->np[4] = 4;
+		p->dn[0] = 0; p->dn[1] = quantile / 2; p->dn[2] = quantile;
+		p->dn[3] = (1 + quantile) / 2; p->dn[4] = 1;
+		return;
+	}
+
+	/* Cell of x, adjusting the extremes if needed. */
+	if (x < p->q[0])
+	{
+		p->q[0] = x;
+		k = 0;
+	}
+	else if (x >= p->q[4])
+	{
+		p->q[4] = x;
+		k = 3;
+	}
+	else
+		for (k = 0; k < 3 && x >= p->q[k + 1]; k++)
+			continue;
+
+	for (int i = k + 1; i < 5; i++)
+		p->n[i]++;
+	for (int i = 0; i < 5; i++)
+		p->np[i] += p->dn[i];
+
+	/* Adjust the middle markers, if needed. */
+	for (int i = 1; i < 4; i++)
+	{
+		d = p->np[i] - p->n[i];
+		if (!((d >= 1 && p->n[i + 1] - p->n[i] > 1) ||
+			(d <= -1 && p->n[i - 1] - p->n[i] < -1)))
+			continue;
+
+		s = d >= 0 ? 1 : -1;
+
+		/* Parabolic prediction. */
+		qp = p->q[i] + s / (p->n[i + 1] - p->n[i - 1]) *
+			((p->n[i] - p->n[i - 1] + s) * (p->q[i + 1] - p->q[i]) /
+			(p->n[i + 1] - p->n[i]) +
+			(p->n[i + 1] - p->n[i] - s) * (p->q[i] - p->q[i - 1]) /
+			(p->n[i] - p->n[i - 1]));
+
+		/* Otherwise, linear. */
+		if (!(p->q[i - 1] < qp && qp < p->q[i + 1]))
+			qp = p->q[i] + s * (p->q[i + s] - p->q[i]) /
+				(p->n[i + s] - p->n[i]);
+
+		p->q[i] = qp;
+		p->n[i] += s;
+	}
+}
+
+/**
+ * @brief Returns the estimated quantile of the P² estimator
+ * @p p, for @p quantile and @p count samples.
+ *
+ * @param p P² estimator.
+ * @param quantile Quantile, between 0 and 1.
+ * @param count Amount of samples.
+ *
+ * @return Returns the estimated quantile.
+ */
+static double sm_p2_get(const struct sm_p2 *p, double quantile,
+	uint64_t count)
+{
+	double q[5];
+	double d;
+
+	if (count >= 5)
+		return (p->q[2]);
+
+	/* Few samples: nearest rank. */
+	memcpy(q, p->q, sizeof(q));
+	for (int i = 1; i < (int)count; i++)
+		for (int j = i; j > 0 && q[j - 1] > q[j]; j--)
+			d = q[j], q[j] = q[j - 1], q[j - 1] = d;
+
+	return (q[(int)(quantile * (count - 1) + 0.5)]);
+}
+
+/**
+ * @brief Accounts a change of the variable @p v, whose new value
+ * (or new element value, if array) is @p value.
+ *
+ * @param v Changed variable.
+ * @param value New value.
+ */
+void sm_update(struct dw_variable *v, union var_value *value)
+{
+	struct sm_var *s;
+	size_t size;
+	double delta;
+	double x;
+
+	if (v->stats < 0 || v->stats >= sm_nvars)
+		return;
+
+	s = &sm_vars[v->stats];
+
+	pthread_mutex_lock(&sm_mutex);
+	s->changes++;
+
+	/*
+	 * Bitmap arrays and strings are changed as a whole, no value
+	 * to account.
+	 */
+	if (v->type.var_type == TARRAY && (v->bitmap || v->string))
+		goto out;
+
+	size = (v->type.var_type == TARRAY) ?
+		v->type.array.size_per_element : v->byte_size;
+
+	x = sm_to_double(value, v->type.encoding, size);
+	s->samples++;
+
+	if (s->samples == 1 || x < s->min)
+		s->min = x;
+	if (s->samples == 1 || x > s->max)
+		s->max = x;
+
+	delta = x - s->mean;
+	s->mean += delta / s->samples;
+	s->m2 += delta * (x - s->mean);
+
+	for (int i = 0; i < SM_QUANTILES; i++)
+		sm_p2_add(&s->p2[i], sm_quantiles[i], s->samples, x);
+
+	sm_hll_add(s->hll, sm_hash(value, size));
+out:
+	pthread_mutex_unlock(&sm_mutex);
+}
+
+/**
+ * @brief Checks (and clears) if a report was asked, through
+ * SIGUSR1.
+ *
+ * @return Returns 1 if a report was asked, 0 otherwise.
+ */
+int sm_requested(void)
+{
+	if (!sm_signaled)
+		return (0);
+	sm_signaled = 0;
+	return (1);
+}
+
+/**
+ * @brief Writes the statistics of all variables into @p out.
+ *
+ * @param out Output stream.
+ */
+void sm_report(FILE *out)
+{
+	struct sm_var *s;
+	double stddev;
+
+	pthread_mutex_lock(&sm_mutex);
+
+	fprintf(out, "\nSummary:\n");
+	for (int i = 0; i < sm_nvars; i++)
+	{
+		s = &sm_vars[i];
+
+		fprintf(out, "  [%s] (%s): %" PRIu64 " changes",
+			(s->scope == VGLOBAL ? "global" : "local"), s->name,
+			s->changes);
+
+		if (!s->samples)
+		{
+			fprintf(out, "\n");
+			continue;
+		}
+
+		stddev = s->samples > 1 ? sqrt(s->m2 / (s->samples - 1)) : 0.0;
+
+		fprintf(out, ", min: %g, max: %g, mean: %g, stddev: %g, "
+			"distinct: ~%.0f", s->min, s->max, s->mean, stddev,
+			sm_hll_count(s->hll));
+
+		for (int j = 0; j < SM_QUANTILES; j++)
+			fprintf(out, ", p%g: %g", sm_quantiles[j] * 100,
+				sm_p2_get(&s->p2[j], sm_quantiles[j], s->samples));
+
+		fprintf(out, "\n");
+	}
+	fprintf(out, "\n");
+
+	pthread_mutex_unlock(&sm_mutex);
+}
+
+/**
+ * @brief Deallocates the statistics.
+ */
+void sm_finish(void)
+{
+	for (int i = 0; i < sm_nvars; i++)
+		free(sm_vars[i].name);
+
+	free(sm_vars);
+	sm_vars = NULL;
+	sm_nvars = 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Test plugin: suppresses all the array changes and, at the
+ * end, writes into the PBD output how many were suppressed.
+ */
+
+#include <pbd_plugin.h>
+
+/* PBD services and changes suppressed. */
+static const struct pbd_host *host;
+static int suppressed;
+
+/**
+ * Session start, keeps the PBD services.
+ */
+static int session_start(const struct pbd_host *h,
+	const struct pbd_session *session, void **data)
+{
+	((void)session);
+	((void)data);
+	host = h;
+	return (0);
+}
+
+/**
+ * Suppresses the array changes.
+ */
+static int change(void *data, const struct pbd_change *change)
+{
+	((void)data);
+	if (change->var->type != PBD_TYPE_ARRAY)
+		return (PBD_PLUGIN_EMIT);
+
+	suppressed++;
+	return (PBD_PLUGIN_SUPPRESS);
+}
+
+/**
+ * Session end, writes the amount of changes suppressed.
+ */
+static void session_end(void *data)
+{
+	((void)data);
+	host->emit("[plugin] %d array changes suppressed\n", suppressed);
+}
+
+static const struct pbd_plugin plugin = {
+	.abi           = PBD_PLUGIN_ABI,
+	.name          = "test_plugin",
+	.session_start = session_start,
+	.change        = change,
+	.session_end   = session_end
+};
+
+/**
+ * Plugin entry point.
+ */
+const struct pbd_plugin *pbd_plugin_init(int abi)
+{
+	if (abi != PBD_PLUGIN_ABI)
+		return (NULL);
+	return (&plugin);
+}
@@ -27,17 +27,19 @@
 # Fancy colors =)
 RED='\033[0;31m'
 GREEN='\033[0;32m'
+YELLOW='\033[0;33m'
 NC='\033[0m'
 
 # PBD Folder
 PBD_FOLDER=$(readlink -f ../)
 
-echo -n "Tests (normal + static analysis)..."
+echo -n "Tests (normal + static analysis + fast tracepoints)..."
 
 # Run iterative and recursive tests
 {
 	"$PBD_FOLDER"/pbd test func1     > outputs/test_func1_out    &&\
 	"$PBD_FOLDER"/pbd test func1 -S  > outputs/test_func1_out_sa &&\
+	"$PBD_FOLDER"/pbd test func1 --fast-tracepoints > outputs/test_func1_out_ft &&\
 	"$PBD_FOLDER"/pbd test factorial
 } &> /dev/null
 
@@ -57,6 +59,11 @@ then
 			echo -e " [${RED}NOT PASSED${NC}] (static analysis differ from expected output)"
 			exit 1
 		fi
+		if ! cmp -s "outputs/test_func1_expected" "outputs/test_func1_out_ft"
+		then
+			echo -e " [${RED}NOT PASSED${NC}] (fast tracepoints differ from expected output)"
+			exit 1
+		fi
 
 		echo -e " [${GREEN}PASSED${NC}]"
 
@@ -79,6 +86,13 @@ then
 					--error-exitcode=1\
 					"$PBD_FOLDER"/pbd test func1 -S &&\
 
+				valgrind\
+					--leak-check=full\
+					--suppressions=pbd.supp\
+					--errors-for-leak-kinds=all\
+					--error-exitcode=1\
+					"$PBD_FOLDER"/pbd test func1 --fast-tracepoints &&\
+
 				valgrind\
 					--leak-check=full\
 					--suppressions=pbd.supp\
@@ -120,3 +134,447 @@ else
 	echo -e " [${RED}NOT PASSED${NC}]"
 	exit 1
 fi
+
+#
+# Feature tests
+#
+# Each case runs PBD with the given arguments, filters its output
+# with the given command (e.g: to hide thread ids or addresses),
+# and compares it against outputs/test_<case>_expected.
+#
+# $1: Case name
+# $2: Filter command
+# $@: PBD arguments
+#
+feature_test()
+{
+	local name=$1
+	local filter=$2
+	shift 2
+
+	echo -n "Feature tests ($name)..."
+
+	"$PBD_FOLDER"/pbd "$@" 2> /dev/null | $filter > "outputs/test_${name}_out"
+
+	if [ "${PIPESTATUS[0]}" -ne 0 ]
+	then
+		echo -e " [${RED}NOT PASSED${NC}] (execution error)"
+		exit 1
+	fi
+
+	if ! cmp -s "outputs/test_${name}_expected" "outputs/test_${name}_out"
+	then
+		echo -e " [${RED}NOT PASSED${NC}] (differ from expected output)"
+		exit 1
+	fi
+
+	echo -e " [${GREEN}PASSED${NC}]"
+}
+
+# Thread ids, in order of appearance: T1, T2...
+tid_filter()
+{
+	awk '/^\[tid: [0-9]+\]$/ {
+		tid = $2 + 0
+		if (!(tid in ids))
+			ids[tid] = ++n
+		print "[tid: T" ids[tid] "]"
+		next
+	}
+	{ print }'
+}
+
+# Shadow verification: every stop (and a random sample of them) checked
+# exhaustively, with the regular output unchanged
+verify_test()
+{
+	local name=$1
+	shift
+
+	echo -n "Feature tests ($name)..."
+	"$PBD_FOLDER"/pbd test func1 "$@" > "outputs/test_${name}_out"\
+		2> "outputs/test_${name}_err"
+
+	if ! grep -q ", 0 discrepancies$" "outputs/test_${name}_err"
+	then
+		echo -e " [${RED}NOT PASSED${NC}] (discrepancies found)"
+		exit 1
+	fi
+
+	if ! cmp -s outputs/test_func1_expected "outputs/test_${name}_out"
+	then
+		echo -e " [${RED}NOT PASSED${NC}] (differ from expected output)"
+		exit 1
+	fi
+	rm -f "outputs/test_${name}_err"
+	echo -e " [${GREEN}PASSED${NC}]"
+}
+
+verify_test verify --verify 1
+verify_test verify_random --verify 3 --verify-random
+verify_test verify_ft --verify 1 --fast-tracepoints
+
+# Multi-threaded, merged in sequence order
+feature_test threads tid_filter test thread_func --threads 2 --args threads
+
+# Thread outputs grouped by thread and sorted, for the threads that
+# run at the same time, whose events interleave in any order
+tid_group_filter()
+{
+	awk '/^\[tid: [0-9]+\]$/ { tid = $2; next }
+	tid == "" { print; next }
+	{ block[tid] = block[tid] $0 "\001" }
+	END {
+		fflush()
+		for (tid in block)
+			print block[tid] | "sort"
+		close("sort")
+	}' | tr '\001' '\n'
+}
+
+# Multi-threaded, several threads in the function at once: shards
+# handoffs and breakpoints stepped out of line
+feature_test concurrent tid_group_filter test conc_func --threads 3\
+	--args concurrent
+
+# Fork snapshots: a large array compared in the copies (queued) and,
+# with clone() forbidden by seccomp, in place: same output either way
+feature_test snapshot cat test snap_func --fork-snapshot 4096\
+	--args snapshot
+feature_test snapshot_noclone cat test snap_func --fork-snapshot 4096\
+	--args snapshot noclone
+
+# Plugins: array changes suppressed by the test plugin
+feature_test plugin cat test func1 --plugin plugin/test_plugin.so
+
+# Raw memory regions: region_buf, by its address
+REGION=$(printf "0x%x" "0x$(nm test | awk '$3 == "region_buf" {print $1}')")
+region_filter()
+{
+	sed "s/$REGION+/region_buf+/"
+}
+feature_test region region_filter test region_func -l\
+	--watch-region "$REGION":32:4:s --args region
+
+# Heap blocks, in order of appearance: B1, B2...
+heap_filter()
+{
+	awk '{
+		if (match($0, /\(0x[0-9a-f]+\+/))
+		{
+			addr = substr($0, RSTART + 1, RLENGTH - 2)
+			if (!(addr in ids))
+				ids[addr] = ++n
+			$0 = substr($0, 1, RSTART) "B" ids[addr] substr($0, RSTART + RLENGTH - 1)
+		}
+		print
+	}'
+}
+feature_test heap heap_filter test heap_func -g --watch-heap=4:s --args heap
+
+# DWARF: the internal reader and libdwarf (--libdwarf) should find the
+# same variables, lines and breakpoints (-d), and give the same output
+echo -n "Feature tests (dwarf)..."
+{
+	"$PBD_FOLDER"/pbd -d test func1 > outputs/test_dwarf_out &&\
+	"$PBD_FOLDER"/pbd -d --libdwarf test func1 > outputs/test_dwarf_out_ld &&\
+	"$PBD_FOLDER"/pbd --libdwarf test func1 > outputs/test_func1_out_ld
+} &> /dev/null
+
+if [ $? -ne 0 ]
+then
+	echo -e " [${RED}NOT PASSED${NC}] (execution error)"
+	exit 1
+fi
+
+if ! cmp -s "outputs/test_dwarf_out" "outputs/test_dwarf_out_ld"
+then
+	echo -e " [${RED}NOT PASSED${NC}] (internal reader and libdwarf differ)"
+	exit 1
+fi
+
+if ! cmp -s "outputs/test_func1_expected" "outputs/test_func1_out_ld"
+then
+	echo -e " [${RED}NOT PASSED${NC}] (libdwarf differ from expected output)"
+	exit 1
+fi
+
+echo -e " [${GREEN}PASSED${NC}]"
+
+# Rotated and compressed output (--output-max-size), rebuilt from its
+# segments: the oldest first (.1), decompressed with --lz-decompress
+# (or gzip, if built with zlib), and the current one last.
+#
+# $1: Output file
+#
+rotate_rebuild()
+{
+	local seg
+
+	for seg in $(ls "$1".*.lz "$1".*.gz 2> /dev/null | sort -V)
+	do
+		case "$seg" in
+			*.gz) gzip -dc "$seg" ;;
+			*)    "$PBD_FOLDER"/pbd --lz-decompress "$seg" ;;
+		esac || return 1
+	done
+	cat "$1"
+}
+
+echo -n "Feature tests (rotate)..."
+rm -f outputs/test_rotate_out*
+"$PBD_FOLDER"/pbd test func1 -o outputs/test_rotate_out\
+	--output-max-size 1k &> /dev/null &&\
+rotate_rebuild outputs/test_rotate_out > outputs/test_rotate_rebuilt
+
+if [ $? -ne 0 ] || [ "$(ls outputs/test_rotate_out.* | wc -l)" -lt 2 ]
+then
+	echo -e " [${RED}NOT PASSED${NC}] (execution error)"
+	exit 1
+fi
+
+if ! cmp -s "outputs/test_func1_expected" "outputs/test_rotate_rebuilt"
+then
+	echo -e " [${RED}NOT PASSED${NC}] (differ from expected output)"
+	exit 1
+fi
+
+# Only the last 2 segments kept: the end of the output
+rm -f outputs/test_rotate_out*
+"$PBD_FOLDER"/pbd test func1 -o outputs/test_rotate_out\
+	--output-max-size 1k --output-keep 2 &> /dev/null &&\
+rotate_rebuild outputs/test_rotate_out > outputs/test_rotate_rebuilt
+
+if [ $? -ne 0 ] || [ "$(ls outputs/test_rotate_out.* | wc -l)" -ne 2 ] ||\
+	! tail -c "$(wc -c < outputs/test_rotate_rebuilt)"\
+		outputs/test_func1_expected | cmp -s - outputs/test_rotate_rebuilt
+then
+	echo -e " [${RED}NOT PASSED${NC}] (--output-keep)"
+	exit 1
+fi
+
+rm -f outputs/test_rotate_*
+echo -e " [${GREEN}PASSED${NC}]"
+
+# Statistics only: streaming sketches per variable
+feature_test summary cat test func1 --summary
+
+# Post-mortem: a series of core files taken from core_func(), with ASLR
+# disabled, so that its frames (and locals) match between them. Skipped
+# if no core file could be dumped (e.g: core_pattern is a pipe).
+core_dump()
+{
+	local dir
+
+	dir=$(mktemp -d)
+	{
+		(
+			cd "$dir" || exit 1
+			ulimit -c unlimited
+			setarch "$(uname -m)" -R "$OLDPWD"/test core "$1"
+		)
+	} &> /dev/null
+
+	mv "$(ls -d "$dir"/core* 2> /dev/null | head -n 1)"\
+		"outputs/test_core_$1.core" &> /dev/null
+	rm -rf "$dir"
+	[ -f "outputs/test_core_$1.core" ]
+}
+
+if core_dump 1 && core_dump 2 && core_dump 3
+then
+	feature_test core cat --core outputs/test_core_1.core\
+		outputs/test_core_2.core outputs/test_core_3.core test core_func
+else
+	echo -e "Feature tests (core)... [${YELLOW}SKIPPED${NC}] (no core files)"
+fi
+rm -f outputs/test_core_*.core
+
+# Stop-free polling, without the pid and timestamps
+poll_filter()
+{
+	sed -e "s/(pid [0-9]*)/(pid P)/" -e "s/^\[Time: [0-9.]*\]/[Time: T]/"
+}
+feature_test poll poll_filter test poll_func --poll 20 --args poll
+
+# Self-profiling: collapsed stacks ('frame;frame;... count'), whose
+# counts sum up to the samples taken, also for the modes that exit on
+# their own, like --poll
+echo -n "Feature tests (self-profile)..."
+SAMPLES=$("$PBD_FOLDER"/pbd test prof_func --self-profile\
+	outputs/test_profile_out --args prof 2>&1 > /dev/null |
+	sed -n "s/^PBD: self-profile: \([0-9]*\) samples.*/\1/p")
+
+if ! awk -v samples="$SAMPLES" '
+	!/^[^ ;]+(;[^ ;]+)* [0-9]+$/ { exit 1 }
+	/;handle_trap(;| )/ { trap = 1 }
+	{ sum += $NF }
+	END { exit !(trap && sum == samples && samples > 0) }'\
+	outputs/test_profile_out
+then
+	echo -e " [${RED}NOT PASSED${NC}] (invalid collapsed stacks)"
+	exit 1
+fi
+
+rm -f outputs/test_profile_out
+"$PBD_FOLDER"/pbd test poll_func --poll 20 --self-profile\
+	outputs/test_profile_out --args poll &> /dev/null
+if [ ! -f outputs/test_profile_out ]
+then
+	echo -e " [${RED}NOT PASSED${NC}] (not profiled with --poll)"
+	exit 1
+fi
+rm -f outputs/test_profile_out
+echo -e " [${GREEN}PASSED${NC}]"
+
+# Loops reported once, at their exit, and with their first and last
+# iterations
+feature_test loops cat test func1 --loop-summary
+feature_test loops_detail cat test func1 --loop-summary --loop-detail
+
+# Heap pointers, in order of appearance: P1, P2...
+ptr_filter()
+{
+	awk '{
+		line = ""
+		while (match($0, /0x[0-9A-F][0-9A-F][0-9A-F][0-9A-F][0-9A-F]+/))
+		{
+			addr = substr($0, RSTART, RLENGTH)
+			if (!(addr in ids))
+				ids[addr] = ++n
+			line = line substr($0, 1, RSTART - 1) "P" ids[addr]
+			$0 = substr($0, RSTART + RLENGTH)
+		}
+		print line $0
+	}'
+}
+
+# Linked list: nodes inserted, changed and removed
+feature_test linked ptr_filter test linked_func -g\
+	--watch-linked "list_head->next*{key,val}" --args linked
+
+# Heatmap of a 2-D array: text report and PGM image
+feature_test heatmap cat test heat_func -w heat_grid --heatmap=3\
+	--heatmap-pgm=outputs/test_heatmap_ --args heatmap
+
+echo -n "Feature tests (heatmap image)..."
+if ! cmp -s outputs/test_heatmap_expected.pgm outputs/test_heatmap_heat_grid.pgm
+then
+	echo -e " [${RED}NOT PASSED${NC}] (differ from expected image)"
+	exit 1
+fi
+rm -f outputs/test_heatmap_heat_grid.pgm
+echo -e " [${GREEN}PASSED${NC}]"
+
+# Enum state transitions: matrix, first lines and DOT graph
+feature_test transitions cat test conn_func --transitions\
+	--transitions-dot outputs/test_transitions_out.dot --args conn
+
+echo -n "Feature tests (transitions graph)..."
+if ! cmp -s outputs/test_transitions_expected.dot\
+	outputs/test_transitions_out.dot
+then
+	echo -e " [${RED}NOT PASSED${NC}] (differ from expected graph)"
+	exit 1
+fi
+rm -f outputs/test_transitions_out.dot
+echo -e " [${GREEN}PASSED${NC}]"
+
+# Bitmaps: bits set and cleared of a flag word and of an array, with
+# a change big enough to fill both lists (the rest is only counted)
+feature_test bitmap cat test bitmap_func --bitmap auto --args bitmap
+
+# Bitmaps are reported at once, but still counted per element changed
+feature_test bitmap_heatmap cat test bitmap_func --bitmap auto --heatmap=3\
+	--args bitmap
+
+# Char arrays as strings: before/after (escaped and truncated at a
+# maximum length) and edits, with a change past the NUL terminator,
+# not reported
+feature_test strings cat test str_func -w str_buf --strings --args strings
+feature_test strings_edit cat test str_func -w str_buf --strings-edit\
+	--args strings
+feature_test strings_max cat test str_func -w str_buf --strings=16\
+	--args strings
+
+# Keyframes: the state at a few events, reconstructed from the nearest
+# keyframe, must match the one replayed from the very start (a trace
+# whose only keyframe is the first one). The entries are sorted, as
+# their order depends on where the replay started.
+reconstruct()
+{
+	"$PBD_FOLDER"/pbd --reconstruct "outputs/test_reconstruct_$1:$2"
+}
+
+echo -n "Feature tests (reconstruct)..."
+"$PBD_FOLDER"/pbd -o outputs/test_reconstruct_kf --keyframe-every 10\
+	test func1 &> /dev/null
+"$PBD_FOLDER"/pbd -o outputs/test_reconstruct_full --keyframe-every 1000000\
+	test func1 &> /dev/null
+
+for event in 1 10 25 47 60 1000
+do
+	if ! cmp -s <(reconstruct kf $event | tail -n +2 | sort)\
+		<(reconstruct full $event | tail -n +2 | sort)
+	then
+		echo -e " [${RED}NOT PASSED${NC}] (differ from the full replay at event $event)"
+		exit 1
+	fi
+done
+
+if ! reconstruct kf 60 | head -n 1 | grep -q "(keyframe [1-9]"
+then
+	echo -e " [${RED}NOT PASSED${NC}] (nearest keyframe not used)"
+	exit 1
+fi
+rm -f outputs/test_reconstruct_*
+echo -e " [${GREEN}PASSED${NC}]"
+
+# Arrow IPC stream, read back (and validated) with pyarrow. Skipped if
+# pyarrow is not available.
+arrow_dump()
+{
+	python3 - outputs/test_arrow_out.arrow <<'PYEOF'
+import sys
+import pyarrow.ipc as ipc
+
+t = ipc.open_stream(open(sys.argv[1], "rb")).read_all()
+t.validate(full=True)
+
+cols = t.select(["seq", "line", "name", "global", "index",
+	"before_int", "after_int", "before_uint", "after_uint",
+	"before_float", "after_float"]).to_pylist()
+
+for r in cols:
+	idx = "".join("[%d]" % i for i in (r["index"] or []))
+	for k in ("int", "uint", "float"):
+		if r["after_" + k] is not None:
+			break
+	print("%d [Line: %d] [%s] (%s%s) before: %s, after: %s" % (r["seq"],
+		r["line"], "global" if r["global"] else "local", r["name"], idx,
+		r["before_" + k], r["after_" + k]))
+PYEOF
+}
+
+echo -n "Feature tests (arrow)..."
+if ! python3 -c "import pyarrow" &> /dev/null
+then
+	echo -e " [${YELLOW}SKIPPED${NC}] (pyarrow not available)"
+else
+	"$PBD_FOLDER"/pbd test func1 --arrow outputs/test_arrow_out.arrow\
+		&> /dev/null && arrow_dump > outputs/test_arrow_out
+
+	if [ $? -ne 0 ]
+	then
+		echo -e " [${RED}NOT PASSED${NC}] (execution error)"
+		exit 1
+	fi
+
+	if ! cmp -s "outputs/test_arrow_expected" "outputs/test_arrow_out"
+	then
+		echo -e " [${RED}NOT PASSED${NC}] (differ from expected output)"
+		exit 1
+	fi
+
+	echo -e " [${GREEN}PASSED${NC}]"
+fi
@@ -343,11 +343,457 @@ uint64_t factorial(uint64_t n)
 	}
 }
 
+/*===========================================================================*
+ * Multi-threaded analysis                                                   *
+ *===========================================================================*/
+
+/*
+ * Included here, so that the functions above keep their line
+ * numbers (and thus, their expected outputs).
+ */
+#include <pthread.h>
+
+int thread_sum;
+
+/**
+ * Thread routine, analyzed in every thread.
+ *
+ * @param arg Thread number.
+ *
+ * @return Always NULL.
+ */
+void *thread_func(void *arg)
+{
+	int thread_local_a;
+
+	thread_local_a = (int)(intptr_t)arg;
+	thread_local_a *= 10;
+	thread_sum += thread_local_a;
+	return (NULL);
+}
+
+/**
+ * Creates the threads one after another, so that the
+ * (merged) output is always the same.
+ */
+void threads(void)
+{
+	pthread_t thread;
+
+	for (intptr_t i = 1; i <= 3; i++)
+	{
+		pthread_create(&thread, NULL, thread_func, (void *)i);
+		pthread_join(thread, NULL);
+	}
+}
+
+/*===========================================================================*
+ * Raw memory analysis                                                       *
+ *===========================================================================*/
+
+/* Watched by its address and length only. */
+int region_buf[8];
+
+/**
+ * Changes some elements of the raw memory region.
+ */
+void region_func(void)
+{
+	region_buf[1] = 10;
+	region_buf[6] = -3;
+	region_buf[1]++;
+	memset(region_buf, 0, sizeof(region_buf));
+}
+
+/*===========================================================================*
+ * Heap analysis                                                             *
+ *===========================================================================*/
+
+#include <stdlib.h>
+
+/**
+ * Allocates, changes and frees some heap blocks: the freed
+ * blocks are changed by the allocator itself, and should not
+ * be reported.
+ */
+void heap_func(void)
+{
+	int *heap_a;
+	int *heap_b;
+
+	heap_a = malloc(4 * sizeof(int));
+	heap_b = calloc(2, sizeof(int));
+	heap_a[2] = 7;
+	heap_b[1] = 3;
+	free(heap_a);
+	heap_b[0] = 1;
+	free(heap_b);
+}
+
+/*===========================================================================*
+ * Post-mortem analysis                                                      *
+ *===========================================================================*/
+
+int core_vals[4];
+
+/**
+ * Changes some variables and aborts (dumping core) at the
+ * given stage, so that a series of core files can be taken
+ * from the same function.
+ *
+ * @param stage Stage (1, 2 or 3) to abort at.
+ */
+void core_func(int stage)
+{
+	int core_local;
+
+	core_local = 1;
+	core_vals[0] = 5;
+	if (stage == 1)
+		abort();
+
+	core_local = 2;
+	core_vals[3] = 9;
+	if (stage == 2)
+		abort();
+
+	core_local = 3;
+	core_vals[0] = core_local * 2;
+	abort();
+}
+
+/*===========================================================================*
+ * Stop-free polling                                                         *
+ *===========================================================================*/
+
+#include <poll.h>
+
+int poll_val;
+int poll_arr[4];
+
+/**
+ * Changes some globals, slowly enough (300 ms apart) for
+ * every state to be seen by the poller.
+ */
+void poll_func(void)
+{
+	poll(NULL, 0, 300);
+	poll_val = 1;
+	poll(NULL, 0, 300);
+	poll_val = 2;
+	poll_arr[1] = 7;
+	poll(NULL, 0, 300);
+}
+
+/*===========================================================================*
+ * Linked structures                                                         *
+ *===========================================================================*/
+
+/* List node. */
+struct list_node
+{
+	int key;
+	int val;
+	struct list_node *next;
+};
+
+struct list_node *list_head;
+
+/**
+ * Inserts a node at the head of the list.
+ *
+ * @param key Node key.
+ * @param val Node value.
+ */
+static void list_push(int key, int val)
+{
+	struct list_node *node;
+
+	node = calloc(1, sizeof(struct list_node));
+	node->key = key;
+	node->val = val;
+	node->next = list_head;
+	list_head = node;
+}
+
+/**
+ * Builds a small list and then inserts, changes and removes
+ * some of its nodes.
+ */
+void linked_func(void)
+{
+	struct list_node *node;
+
+	list_push(1, 10);
+	list_push(2, 20);
+	list_push(3, 30);
+	list_head->next->val = 21;
+	node = list_head->next;
+	list_head->next = node->next;
+	free(node);
+	list_head->val = 31;
+}
+
+/*===========================================================================*
+ * Heatmaps                                                                  *
+ *===========================================================================*/
+
+int heat_grid[4][6];
+
+/**
+ * Writes the lower triangle of the grid, the diagonal being
+ * written once per row below it.
+ */
+void heat_func(void)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j <= i; j++)
+			heat_grid[j][j] += i + 1;
+		heat_grid[i][0] = i + 1;
+	}
+}
+
+/*===========================================================================*
+ * State machines                                                            *
+ *===========================================================================*/
+
+enum conn_states {CONN_CLOSED, CONN_CONNECTING, CONN_OPEN, CONN_CLOSING};
+enum conn_states conn_state;
+
+/**
+ * Opens and closes a connection three times, the second
+ * attempt failing before it is open.
+ */
+void conn_func(void)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		conn_state = CONN_CONNECTING;
+		if (i == 1)
+		{
+			conn_state = CONN_CLOSED;
+			continue;
+		}
+		conn_state = CONN_OPEN;
+		conn_state = CONN_CLOSING;
+		conn_state = CONN_CLOSED;
+	}
+}
+
+/*===========================================================================*
+ * Strings                                                                   *
+ *===========================================================================*/
+
+char str_buf[256];
+
+/**
+ * Copies a few strings into the buffer: a longer one, one to
+ * be escaped, one past the maximum length and a shorter one,
+ * and then writes past the NUL terminator.
+ */
+void str_func(void)
+{
+	strcpy(str_buf, "hello");
+	strcpy(str_buf, "hello, world");
+	strcpy(str_buf, "tab\there, \"quoted\"\n");
+	strcpy(str_buf, "a string longer than sixteen characters");
+	strcpy(str_buf, "a string");
+	str_buf[200] = 'x';
+}
+
+/*===========================================================================*
+ * Concurrent threads                                                        *
+ *===========================================================================*/
+
+/* Threads ready to run. */
+int conc_ready;
+
+/**
+ * Thread routine, analyzed in every thread at the same time.
+ *
+ * @param arg Thread number.
+ *
+ * @return Always NULL.
+ */
+void *conc_func(void *arg)
+{
+	int conc_local_a;
+	int conc_local_i;
+
+	conc_local_a = (int)(intptr_t)arg;
+	for (conc_local_i = 0; conc_local_i < 4; conc_local_i++)
+		conc_local_a += conc_local_i * 100;
+	return (NULL);
+}
+
+/**
+ * Waits for all the threads to be created and then runs
+ * conc_func().
+ *
+ * @param arg Thread number.
+ *
+ * @return Always NULL.
+ */
+static void *conc_start(void *arg)
+{
+	__atomic_add_fetch(&conc_ready, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&conc_ready, __ATOMIC_SEQ_CST) < 4)
+		;
+	return (conc_func(arg));
+}
+
+/**
+ * Creates the threads all at once, so that they all run the
+ * analyzed function concurrently.
+ */
+void concurrent(void)
+{
+	pthread_t thread[4];
+
+	for (intptr_t i = 0; i < 4; i++)
+		pthread_create(&thread[i], NULL, conc_start, (void *)(i + 1));
+	for (int i = 0; i < 4; i++)
+		pthread_join(thread[i], NULL);
+}
+
+/*===========================================================================*
+ * Bitmaps                                                                   *
+ *===========================================================================*/
+
+uint32_t bm_flags;
+uint64_t bm_mask_arr[64];
+
+/**
+ * Sets and clears some bits of a flag word, and then changes
+ * whole ranges of a bitmap array, enough to fill both the lists
+ * of bits set and cleared (the remaining bits are then just
+ * counted), with unchanged words after them.
+ */
+void bitmap_func(void)
+{
+	bm_flags = 0x0F;
+	bm_flags |= 1u << 20;
+	bm_flags &= ~0x3u;
+	bm_flags ^= 0x80000001u;
+	memset(bm_mask_arr, 0xAA, sizeof(bm_mask_arr));
+	memset(bm_mask_arr + 8, 0x55, 40 * sizeof(uint64_t));
+	bm_mask_arr[63] = 0;
+}
+
+/*===========================================================================*
+ * Self-profiling                                                            *
+ *===========================================================================*/
+
+/**
+ * Long loop, that keeps PBD busy enough to be profiled.
+ */
+void prof_func(void)
+{
+	int prof_local_sum;
+
+	prof_local_sum = 0;
+	for (int i = 0; i < 20000; i++)
+		prof_local_sum += i & 7;
+}
+
+/*===========================================================================*
+ * Fork snapshots                                                            *
+ *===========================================================================*/
+
+#include <errno.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <stddef.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+int snap_big_arr[524288];
+int snap_small;
+
+/**
+ * Changes a few elements of a large array (two chunks) and a
+ * small variable, in more stops than the snapshots queue holds.
+ */
+void snap_func(void)
+{
+	for (int i = 1; i <= 12; i++)
+	{
+		snap_big_arr[i * 40000] = i;
+		snap_small = i;
+	}
+	snap_big_arr[0] = -1;
+}
+
+/**
+ * Forbids clone(2) from now on, so that the snapshot copies
+ * cannot be created, and the arrays are compared in place.
+ */
+void snap_noclone(void)
+{
+	struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, SYS_clone, 0, 1),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ERRNO|EPERM),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),
+	};
+	struct sock_fprog prog = {
+		.len    = sizeof(filter) / sizeof(filter[0]),
+		.filter = filter,
+	};
+
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0 ||
+		prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) < 0)
+	{
+		perror("seccomp");
+		exit(1);
+	}
+}
+
 /**
  * Entry point
+ *
+ * If an argument is given, runs the scenario of the same
+ * name, used by the feature tests.
  */
-int main()
+int main(int argc, char **argv)
 {
+	if (argc > 1)
+	{
+		if (!strcmp(argv[1], "threads"))
+			threads();
+		else if (!strcmp(argv[1], "concurrent"))
+			concurrent();
+		else if (!strcmp(argv[1], "region"))
+			region_func();
+		else if (!strcmp(argv[1], "heap"))
+			heap_func();
+		else if (!strcmp(argv[1], "core") && argc > 2)
+			core_func(atoi(argv[2]));
+		else if (!strcmp(argv[1], "poll"))
+			poll_func();
+		else if (!strcmp(argv[1], "linked"))
+			linked_func();
+		else if (!strcmp(argv[1], "heatmap"))
+			heat_func();
+		else if (!strcmp(argv[1], "conn"))
+			conn_func();
+		else if (!strcmp(argv[1], "strings"))
+			str_func();
+		else if (!strcmp(argv[1], "prof"))
+			prof_func();
+		else if (!strcmp(argv[1], "bitmap"))
+			bitmap_func();
+		else if (!strcmp(argv[1], "snapshot"))
+		{
+			if (argc > 2 && !strcmp(argv[2], "noclone"))
+				snap_noclone();
+			snap_func();
+		}
+
+		return (0);
+	}
+
 	/* Multiples function calls. */
 	for (int i = 0; i < 2; i++)
 		func1(i);
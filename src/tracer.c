@@ -0,0 +1,919 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Sharded tracer.
+ *
+ * The tracing work is split between a pool of tracer threads
+ * (shards), each one with its own wait loop, that only waits
+ * for the threads it owns (__WNOTHREAD).
+ *
+ * - Thread ownership:
+ *   The main thread of the child belongs to the first shard (the
+ *   calling thread). New threads are automatically attached
+ *   (PTRACE_O_TRACECLONE) to the shard that owns its parent,
+ *   which then may pass it to a less loaded shard: the new
+ *   thread is parked in a 'jmp .' loop injected in the child,
+ *   detached, and then seized by the new owner, which restores
+ *   its registers.
+ *
+ * - Shared data:
+ *   The breakpoint list and variables metadata are shared
+ *   between all shards, only the return address breakpoints
+ *   are created on the fly, so the breakpoint list is protected
+ *   by a read/write lock (tr_rdlock/tr_wrlock).
+ *
+ * - Breakpoints:
+ *   Removing a breakpoint from memory in order to step over it
+ *   would let the other threads run through it unnoticed, so,
+ *   whenever possible, the original instruction is executed
+ *   out of line, in a per shard slot of the park page
+ *   (tr_step_over).
+ *
+ * - Output:
+ *   Each shard writes into its own memory buffer, and everything
+ *   printed while handling a single stop becomes a record, tagged
+ *   with a global sequence number. A merger thread periodically
+ *   writes all the records that are safe to write (i.e: no shard
+ *   is still producing an older record) in sequence order, with
+ *   a '[tid: N]' line whenever the thread changes.
+ */
+
+#define _GNU_SOURCE
+#include "tracer.h"
+#include "breakpoint.h"
+#include "insn.h"
+#include "pbd.h"
+#include "profiler.h"
+#include "probes.h"
+#include "util.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* Signal used to wake up a shard blocked in waitpid(). */
+#define TR_WAKEUP_SIGNAL SIGUSR2
+
+/* Merger period, in milliseconds. */
+#define TR_MERGE_PERIOD_MS 10
+
+/* Shard is not producing any record. */
+#define TR_IDLE UINT64_MAX
+
+/* Park page layout: park loop and one slot per shard. */
+#define TR_SLOTS_OFFSET 64
+#define TR_SLOT_SIZE    32
+
+/* Preferred distance between the park page and the function. */
+#define TR_PARK_DISTANCE 0x200000
+
+/* ptrace options for every traced thread. */
+#define TR_PTRACE_OPTIONS (PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL)
+
+/**
+ * @brief Output record, i.e: everything printed while
+ * handling a single stop.
+ */
+struct tr_record
+{
+	uint64_t seq;           /* Global sequence number. */
+	pid_t tid;              /* Thread id.              */
+	char *text;             /* Output text.            */
+	size_t len;             /* Text length.            */
+	struct tr_record *next; /* Next record.            */
+};
+
+/**
+ * @brief Thread being passed to another shard.
+ */
+struct tr_handoff
+{
+	pid_t tid;                    /* Thread id.          */
+	struct user_regs_struct regs; /* Original registers. */
+	struct tr_handoff *next;      /* Next handoff.       */
+};
+
+/**
+ * @brief Tracer thread.
+ */
+struct tr_shard
+{
+	pthread_t thread;            /* Tracer thread.              */
+	pthread_mutex_t lock;        /* Shard lock.                 */
+	pthread_cond_t cond;         /* Handoff condition.          */
+	struct array *tracees;       /* Owned threads.              */
+	int load;                    /* Owned + incoming threads.   */
+	struct tr_handoff *handoffs; /* Incoming threads.           */
+	char *buf;                   /* Output buffer.              */
+	size_t buf_size;             /* Output buffer size.         */
+	uint64_t busy_seq;           /* Record being produced.      */
+	struct tr_record *head;      /* First record to be written. */
+	struct tr_record *tail;      /* Last record to be written.  */
+	pid_t exited;                /* Exited while stepped.       */
+};
+
+/* Shards. */
+static struct tr_shard *shards;
+static int nshards;
+
+/* Current shard. */
+static PBD_TLS struct tr_shard *tr_self;
+
+/* Callbacks and final output. */
+static const struct tracer_ops *tr_ops;
+static FILE *tr_output;
+static pid_t tr_output_tid;
+
+/* Address of the 'jmp .' loop inside the child, if any. */
+static uintptr_t tr_park;
+
+/* Alive threads and termination flag. */
+static int tr_live;
+static int tr_done;
+
+/* Sequence numbers. */
+static uint64_t tr_next_seq;
+static pthread_mutex_t tr_seq_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Merger thread. */
+static int tr_merger_stop;
+static pthread_mutex_t tr_merge_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tr_merge_cond = PTHREAD_COND_INITIALIZER;
+
+/* Breakpoint list lock. */
+static pthread_rwlock_t tr_bp_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * @brief Locks the breakpoint list for reading.
+ */
+void tr_rdlock(void)
+{
+	pthread_rwlock_rdlock(&tr_bp_lock);
+}
+
+/**
+ * @brief Locks the breakpoint list for writing, i.e: when
+ * adding new breakpoints or temporarily removing one from
+ * the child memory.
+ */
+void tr_wrlock(void)
+{
+	pthread_rwlock_wrlock(&tr_bp_lock);
+}
+
+/**
+ * @brief Unlocks the breakpoint list.
+ */
+void tr_unlock(void)
+{
+	pthread_rwlock_unlock(&tr_bp_lock);
+}
+
+/**
+ * @brief Wake up signal handler, does nothing, its only
+ * purpose is to interrupt a blocking waitpid().
+ *
+ * @param sig Signal number.
+ */
+static void tr_wakeup_handler(int sig)
+{
+	((void)sig);
+}
+
+/**
+ * @brief Wakes up the shard @p s, whether it is waiting
+ * for a handoff or blocked waiting its threads.
+ *
+ * @param s Shard to be woken up.
+ */
+static void tr_kick(struct tr_shard *s)
+{
+	pthread_mutex_lock(&s->lock);
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	pthread_kill(s->thread, TR_WAKEUP_SIGNAL);
+}
+
+/**
+ * @brief Marks a thread as terminated; if there is no
+ * thread left, signals all the shards to finish.
+ */
+static void tr_release(void)
+{
+	if (__atomic_sub_fetch(&tr_live, 1, __ATOMIC_SEQ_CST) > 0)
+		return;
+
+	__atomic_store_n(&tr_done, 1, __ATOMIC_SEQ_CST);
+	for (int i = 0; i < nshards; i++)
+		tr_kick(&shards[i]);
+}
+
+/**
+ * @brief Creates a small page inside the child, containing a
+ * 'jmp .' loop, used to park threads while they are passed
+ * between shards, and the shards slots, see tr_step_over().
+ *
+ * @param child Child process.
+ * @param near Address the page should be near to, if possible.
+ *
+ * @return Returns the page address, or 0 if not possible.
+ */
+static uintptr_t tr_create_park(pid_t child, uintptr_t near)
+{
+	char loop[2] = {(char)0xEB, (char)0xFE}; /* jmp . */
+	long number;                             /* Syscall number. */
+	long addr;                               /* Page address.   */
+	uintptr_t hint;                          /* Address hint.   */
+
+#ifdef SYS_mmap2
+	number = SYS_mmap2;
+#else
+	number = SYS_mmap;
+#endif
+
+	/*
+	 * Below the function, so RIP-relative instructions can be
+	 * executed from the slots.
+	 */
+	hint = 0;
+	if (near > 2 * TR_PARK_DISTANCE)
+		hint = (near - TR_PARK_DISTANCE) & ~((uintptr_t)0xFFF);
+
+	addr = pt_syscall(child, number, hint, sysconf(_SC_PAGESIZE),
+		PROT_READ|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+	if (addr < 0 && addr > -4096)
+		return (0);
+
+	pt_writememory(child, addr, loop, sizeof(loop));
+	if ((pt_readmemory_long(child, addr) & 0xFFFF) != 0xFEEB)
+		return (0);
+
+	return ((uintptr_t)addr);
+}
+
+/**
+ * @brief Steps the thread @p tid over the breakpoint @p bp
+ * without removing it from memory, by executing the original
+ * instruction in the current shard slot.
+ *
+ * Branches cannot be executed out of line, and neither
+ * RIP-relative instructions too far from the slot; in these
+ * cases the caller should step over the breakpoint as usual,
+ * i.e: bp_skipbreakpoint().
+ *
+ * @param bp Breakpoint to be stepped over.
+ * @param tid Stopped thread, at @p bp.
+ *
+ * @return Returns 0 if success, PT_CHILD_EXIT if the thread
+ * has exited while stepped (and must not be resumed), or a
+ * negative number if the instruction cannot be executed out
+ * of line.
+ */
+int tr_step_over(struct breakpoint *bp, pid_t tid)
+{
+	struct insn insn; /* Original instruction. */
+	uintptr_t slot;   /* Shard slot.           */
+	uintptr_t pc;     /* Program counter.      */
+	uint8_t *code;    /* Instruction bytes.    */
+	int32_t disp;     /* RIP-relative disp.    */
+	int64_t rel;      /* Relocated disp.       */
+
+	if (!tr_park || tr_self == NULL)
+		return (-1);
+
+	slot = tr_park + TR_SLOTS_OFFSET + (tr_self - shards) * TR_SLOT_SIZE;
+	if ((code = (uint8_t *)pt_readmemory(tid, bp->addr, INSN_MAX_LEN)) == NULL)
+		return (-1);
+
+	code[0] = bp->original_byte;
+	if (insn_decode(code, INSN_MAX_LEN, bp->addr, sizeof(long) == 8 ?
+		INSN_MODE64 : INSN_MODE32, &insn) < 0 || (insn.flags & INSN_BRANCH))
+	{
+		goto err;
+	}
+
+	/* Relocate the displacement, if possible. */
+	if (insn.flags & INSN_RIPREL)
+	{
+		memcpy(&disp, code + insn.disp_off, sizeof(disp));
+		rel = (int64_t)disp + (int64_t)(bp->addr - slot);
+		if (rel < INT32_MIN || rel > INT32_MAX)
+			goto err;
+
+		disp = (int32_t)rel;
+		memcpy(code + insn.disp_off, &disp, sizeof(disp));
+	}
+
+	pt_writememory(tid, slot, (char *)code, insn.length);
+	pt_setregister_pc(tid, slot);
+
+	free(code);
+
+	/* Its exit is handled after the trap, see tr_handle(). */
+	if (pt_step_insn(tid) == PT_CHILD_EXIT)
+	{
+		tr_self->exited = tid;
+		return (PT_CHILD_EXIT);
+	}
+
+	/* Back to the function, unless something unexpected happened. */
+	pc = pt_readregister_pc(tid);
+	if (pc >= slot && pc <= slot + insn.length)
+		pt_setregister_pc(tid, bp->addr + (pc - slot));
+
+	return (0);
+err:
+	free(code);
+	return (-1);
+}
+
+/**
+ * @brief Amount of threads of the child still alive, i.e:
+ * being traced or about to be.
+ *
+ * @return Returns the amount of alive threads.
+ */
+int tr_live_threads(void)
+{
+	return (__atomic_load_n(&tr_live, __ATOMIC_SEQ_CST));
+}
+
+/**
+ * @brief Finds the thread @p tid in the shard @p s.
+ *
+ * @param s Shard.
+ * @param tid Thread id.
+ * @param idx Thread index, if found.
+ *
+ * @return Returns the thread, or NULL if not found.
+ */
+static struct tracee *tr_find(struct tr_shard *s, pid_t tid, size_t *idx)
+{
+	struct tracee *t; /* Current thread. */
+
+	for (size_t i = 0; i < array_size(&s->tracees); i++)
+	{
+		t = array_get(&s->tracees, i, NULL);
+		if (t->tid == tid)
+		{
+			*idx = i;
+			return (t);
+		}
+	}
+	return (NULL);
+}
+
+/**
+ * @brief Adds the thread @p tid to the shard @p s.
+ *
+ * @param s Shard.
+ * @param tid Thread id.
+ */
+static void tr_adopt(struct tr_shard *s, pid_t tid)
+{
+	struct tracee *t; /* New thread. */
+
+	t = calloc(1, sizeof(struct tracee));
+	t->tid = tid;
+	tr_ops->attach(t);
+	array_add(&s->tracees, t);
+}
+
+/**
+ * @brief Seizes all the threads passed to the shard @p s.
+ *
+ * @param s Shard.
+ */
+static void tr_adopt_pending(struct tr_shard *s)
+{
+	struct tr_handoff *h;    /* Current handoff. */
+	struct tr_handoff *next; /* Next handoff.    */
+
+	pthread_mutex_lock(&s->lock);
+		h = s->handoffs;
+		s->handoffs = NULL;
+	pthread_mutex_unlock(&s->lock);
+
+	for (; h != NULL; h = next)
+	{
+		next = h->next;
+
+		/*
+		 * The thread is spinning inside the park loop, so it
+		 * is safe to stop it at any point.
+		 */
+		if (ptrace(PTRACE_SEIZE, h->tid, NULL, TR_PTRACE_OPTIONS) < 0 ||
+			ptrace(PTRACE_INTERRUPT, h->tid, NULL, NULL) < 0 ||
+			pt_waittracee(h->tid) == PT_CHILD_EXIT)
+		{
+			__atomic_sub_fetch(&s->load, 1, __ATOMIC_SEQ_CST);
+			tr_release();
+		}
+		else
+		{
+			ptrace(PTRACE_SETREGS, h->tid, NULL, &h->regs);
+			tr_adopt(s, h->tid);
+			pt_continue(h->tid);
+		}
+		free(h);
+	}
+}
+
+/**
+ * @brief Assigns a new thread, stopped and owned by the shard
+ * @p s, to the less loaded shard.
+ *
+ * @param s Current shard.
+ * @param tid New thread.
+ */
+static void tr_assign(struct tr_shard *s, pid_t tid)
+{
+	struct tr_shard *target; /* Target shard. */
+	struct tr_handoff *h;    /* Handoff.      */
+
+	target = s;
+	if (tr_park)
+	{
+		for (int i = 0; i < nshards; i++)
+		{
+			if (__atomic_load_n(&shards[i].load, __ATOMIC_SEQ_CST) <
+				__atomic_load_n(&target->load, __ATOMIC_SEQ_CST))
+			{
+				target = &shards[i];
+			}
+		}
+	}
+
+	/* Keep it. */
+	if (target == s)
+		goto adopt;
+
+	h = calloc(1, sizeof(struct tr_handoff));
+	h->tid = tid;
+
+	if (ptrace(PTRACE_GETREGS, tid, NULL, &h->regs) < 0)
+	{
+		free(h);
+		goto adopt;
+	}
+
+	/* Park and detach it. */
+	pt_setregister_pc(tid, tr_park);
+	if (ptrace(PTRACE_DETACH, tid, NULL, NULL) < 0)
+	{
+		ptrace(PTRACE_SETREGS, tid, NULL, &h->regs);
+		free(h);
+		goto adopt;
+	}
+
+	pthread_mutex_lock(&target->lock);
+		h->next = target->handoffs;
+		target->handoffs = h;
+		__atomic_add_fetch(&target->load, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&target->lock);
+
+	tr_kick(target);
+	return;
+
+adopt:
+	__atomic_add_fetch(&s->load, 1, __ATOMIC_SEQ_CST);
+	tr_adopt(s, tid);
+	pt_continue(tid);
+}
+
+/**
+ * @brief Reserves the next sequence number for the record
+ * that is about to be produced by the shard @p s.
+ *
+ * @param s Shard.
+ */
+static void tr_record_begin(struct tr_shard *s)
+{
+	pthread_mutex_lock(&tr_seq_lock);
+		s->busy_seq = tr_next_seq++;
+	pthread_mutex_unlock(&tr_seq_lock);
+}
+
+/**
+ * @brief Moves everything printed since tr_record_begin()
+ * into a new record of the shard @p s.
+ *
+ * @param s Shard.
+ * @param tid Thread that produced the record.
+ */
+static void tr_record_end(struct tr_shard *s, pid_t tid)
+{
+	struct tr_record *r; /* New record. */
+
+	r = NULL;
+	fflush(pbd_output);
+
+	if (s->buf_size)
+	{
+		r = malloc(sizeof(struct tr_record));
+		r->seq = s->busy_seq;
+		r->tid = tid;
+		r->len = s->buf_size;
+		r->text = malloc(r->len);
+		r->next = NULL;
+		memcpy(r->text, s->buf, r->len);
+		rewind(pbd_output);
+	}
+
+	pthread_mutex_lock(&s->lock);
+		if (r != NULL)
+		{
+			if (s->tail)
+				s->tail->next = r;
+			else
+				s->head = r;
+			s->tail = r;
+		}
+		s->busy_seq = TR_IDLE;
+	pthread_mutex_unlock(&s->lock);
+}
+
+/**
+ * @brief Writes, in sequence order, all the records that
+ * are safe to be written.
+ *
+ * @param all If set, writes all the records, regardless of
+ * the shards state.
+ */
+static void tr_flush(int all)
+{
+	struct tr_record *lists[TR_MAX_THREADS]; /* Records per shard. */
+	struct tr_record *r;                     /* Current record.    */
+	uint64_t watermark;                      /* First unsafe seq.  */
+	size_t nrecords;                         /* Records written.   */
+	size_t bytes;                            /* Bytes written.     */
+	int min;                                 /* Min shard.         */
+
+	nrecords = 0;
+	bytes = 0;
+
+	/* Nothing older than the oldest record in progress. */
+	pthread_mutex_lock(&tr_seq_lock);
+		watermark = all ? TR_IDLE : tr_next_seq;
+		for (int i = 0; i < nshards; i++)
+		{
+			pthread_mutex_lock(&shards[i].lock);
+				if (shards[i].busy_seq < watermark)
+					watermark = shards[i].busy_seq;
+			pthread_mutex_unlock(&shards[i].lock);
+		}
+	pthread_mutex_unlock(&tr_seq_lock);
+
+	/* Detach the safe records. */
+	for (int i = 0; i < nshards; i++)
+	{
+		struct tr_shard *s = &shards[i];
+		struct tr_record *last = NULL;
+
+		pthread_mutex_lock(&s->lock);
+			lists[i] = s->head;
+			for (r = s->head; r != NULL && r->seq < watermark; r = r->next)
+				last = r;
+
+			if (last == NULL)
+				lists[i] = NULL;
+			else
+			{
+				s->head = last->next;
+				if (s->head == NULL)
+					s->tail = NULL;
+				last->next = NULL;
+			}
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	/* Merge them. */
+	for (;;)
+	{
+		min = -1;
+		for (int i = 0; i < nshards; i++)
+			if (lists[i] && (min < 0 || lists[i]->seq < lists[min]->seq))
+				min = i;
+
+		if (min < 0)
+			break;
+
+		r = lists[min];
+		lists[min] = r->next;
+
+		/* Identify the thread, whenever it changes. */
+		if (r->tid != tr_output_tid)
+		{
+			fprintf(tr_output, "[tid: %d]\n", (int)r->tid);
+			tr_output_tid = r->tid;
+		}
+
+		fwrite(r->text, 1, r->len, tr_output);
+		nrecords++;
+		bytes += r->len;
+		free(r->text);
+		free(r);
+	}
+	fflush(tr_output);
+
+	if (nrecords)
+		PBD_PROBE2(output_merge, nrecords, bytes);
+}
+
+/**
+ * @brief Merger thread: periodically writes the records and
+ * wakes up the shards with pending handoffs, in case the
+ * wake up signal was lost.
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *tr_merger(void *arg)
+{
+	struct timespec ts; /* Timeout. */
+	((void)arg);
+
+	prof_thread_init();
+	pbd_output = tr_output;
+
+	pthread_mutex_lock(&tr_merge_lock);
+	while (!tr_merger_stop)
+	{
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += TR_MERGE_PERIOD_MS * 1000000L;
+		if (ts.tv_nsec >= 1000000000L)
+		{
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&tr_merge_cond, &tr_merge_lock, &ts);
+		pthread_mutex_unlock(&tr_merge_lock);
+
+		tr_flush(0);
+		for (int i = 0; i < nshards; i++)
+			if (__atomic_load_n(&shards[i].handoffs, __ATOMIC_SEQ_CST))
+				pthread_kill(shards[i].thread, TR_WAKEUP_SIGNAL);
+
+		pthread_mutex_lock(&tr_merge_lock);
+	}
+	pthread_mutex_unlock(&tr_merge_lock);
+	return (NULL);
+}
+
+/**
+ * @brief Releases the thread @p t, that has exited.
+ *
+ * @param s Shard.
+ * @param t Thread.
+ * @param idx Thread index.
+ */
+static void tr_exit(struct tr_shard *s, struct tracee *t, size_t idx)
+{
+	array_remove(&s->tracees, idx, NULL);
+	tr_ops->detach(t);
+	free(t);
+	__atomic_sub_fetch(&s->load, 1, __ATOMIC_SEQ_CST);
+	tr_release();
+}
+
+/**
+ * @brief Handles a single wait status of the thread @p tid.
+ *
+ * @param s Shard.
+ * @param tid Thread id.
+ * @param status Wait status.
+ */
+static void tr_handle(struct tr_shard *s, pid_t tid, int status)
+{
+	struct tracee *t; /* Thread.       */
+	size_t idx;       /* Thread index. */
+	int sig;          /* Stop signal.  */
+
+	t = tr_find(s, tid, &idx);
+
+	/* Thread exited. */
+	if (WIFEXITED(status) || WIFSIGNALED(status))
+	{
+		if (t != NULL)
+			tr_exit(s, t, idx);
+		return;
+	}
+
+	if (!WIFSTOPPED(status))
+		return;
+
+	/* New thread, automatically attached. */
+	if (t == NULL)
+	{
+		__atomic_add_fetch(&tr_live, 1, __ATOMIC_SEQ_CST);
+		tr_assign(s, tid);
+		return;
+	}
+
+	sig = WSTOPSIG(status);
+
+	/* ptrace events (clone, group-stop...) and job control. */
+	if ((status >> 16) != 0 || sig == SIGSTOP)
+	{
+		pt_continue(tid);
+		return;
+	}
+
+	/* Signals that do not belong to us. */
+	if (sig != SIGTRAP)
+	{
+		ptrace(PTRACE_CONT, tid, NULL, sig);
+		return;
+	}
+
+	tr_record_begin(s);
+		tr_ops->trap(t);
+	tr_record_end(s, tid);
+
+	/* Exited while stepped, its status was already waited. */
+	if (s->exited == tid)
+	{
+		s->exited = 0;
+		if ((t = tr_find(s, tid, &idx)) != NULL)
+			tr_exit(s, t, idx);
+	}
+}
+
+/**
+ * @brief Shard main loop.
+ *
+ * @param arg Shard.
+ *
+ * @return Always NULL.
+ */
+static void *tr_shard_loop(void *arg)
+{
+	struct tr_shard *s;  /* Shard.           */
+	FILE *prev_output;   /* Previous output. */
+	pid_t tid;           /* Stopped thread.  */
+	int status;          /* Wait status.     */
+
+	s = arg;
+	tr_self = s;
+	prof_thread_init();
+	prev_output = pbd_output;
+	if ((pbd_output = open_memstream(&s->buf, &s->buf_size)) == NULL)
+		QUIT(EXIT_FAILURE, "unable to allocate the shard output!\n");
+
+	while (!__atomic_load_n(&tr_done, __ATOMIC_SEQ_CST))
+	{
+		tr_adopt_pending(s);
+
+		/* Nothing to trace, wait for a new thread. */
+		if (array_size(&s->tracees) == 0)
+		{
+			pthread_mutex_lock(&s->lock);
+				while (s->handoffs == NULL && !tr_done)
+					pthread_cond_wait(&s->cond, &s->lock);
+			pthread_mutex_unlock(&s->lock);
+			continue;
+		}
+
+		if ((tid = waitpid(-1, &status, __WALL | __WNOTHREAD)) < 0)
+			continue;
+
+		tr_handle(s, tid, status);
+	}
+
+	fclose(pbd_output);
+	free(s->buf);
+	pbd_output = prev_output;
+	tr_self = NULL;
+	return (NULL);
+}
+
+/**
+ * @brief Traces the @p child process, and all its threads,
+ * with @p nthreads tracer threads.
+ *
+ * The calling thread must be the @p child tracer, and the
+ * child must be stopped. This function only returns when all
+ * the child threads have been terminated.
+ *
+ * @param child Child process.
+ * @param nthreads Amount of tracer threads.
+ * @param ops Tracer callbacks.
+ * @param output Final output file.
+ * @param near Address of the analyzed function.
+ *
+ * @return Returns 0 if success, or a negative number if
+ * was not possible to trace the child threads.
+ */
+int tr_run(pid_t child, int nthreads, const struct tracer_ops *ops,
+	FILE *output, uintptr_t near)
+{
+	struct sigaction sa; /* Wake up signal. */
+	pthread_t merger;    /* Merger thread.  */
+
+	if (nthreads < 1)
+		nthreads = 1;
+	else if (nthreads > TR_MAX_THREADS)
+		nthreads = TR_MAX_THREADS;
+
+	/* Trace all the threads created by the child. */
+	if (ptrace(PTRACE_SETOPTIONS, child, NULL, TR_PTRACE_OPTIONS) < 0)
+		return (-1);
+
+	tr_ops = ops;
+	tr_output = output;
+	tr_live = 1;
+	tr_done = 0;
+	tr_next_seq = 0;
+	tr_output_tid = 0;
+	tr_merger_stop = 0;
+	tr_park = tr_create_park(child, near);
+
+	/* Wake up signal, without SA_RESTART. */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = tr_wakeup_handler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(TR_WAKEUP_SIGNAL, &sa, NULL);
+
+	/* Shards. */
+	nshards = nthreads;
+	shards = calloc(nshards, sizeof(struct tr_shard));
+	for (int i = 0; i < nshards; i++)
+	{
+		pthread_mutex_init(&shards[i].lock, NULL);
+		pthread_cond_init(&shards[i].cond, NULL);
+		array_init(&shards[i].tracees);
+		shards[i].busy_seq = TR_IDLE;
+	}
+
+	/* The calling thread is the first shard and owns the child. */
+	shards[0].thread = pthread_self();
+	shards[0].load = 1;
+	tr_adopt(&shards[0], child);
+
+	for (int i = 1; i < nshards; i++)
+		if (pthread_create(&shards[i].thread, NULL, tr_shard_loop, &shards[i]))
+			QUIT(EXIT_FAILURE, "unable to create tracer thread!\n");
+
+	if (pthread_create(&merger, NULL, tr_merger, NULL))
+		QUIT(EXIT_FAILURE, "unable to create merger thread!\n");
+
+	pt_continue(child);
+	tr_shard_loop(&shards[0]);
+
+	for (int i = 1; i < nshards; i++)
+		pthread_join(shards[i].thread, NULL);
+
+	pthread_mutex_lock(&tr_merge_lock);
+		tr_merger_stop = 1;
+		pthread_cond_signal(&tr_merge_cond);
+	pthread_mutex_unlock(&tr_merge_lock);
+	pthread_join(merger, NULL);
+
+	/* Remaining output. */
+	tr_flush(1);
+
+	/* Release everything. */
+	for (int i = 0; i < nshards; i++)
+	{
+		struct tracee *t;
+		while (array_size(&shards[i].tracees) > 0)
+		{
+			t = array_remove_last(&shards[i].tracees, NULL);
+			tr_ops->detach(t);
+			free(t);
+		}
+		array_finish(&shards[i].tracees);
+		pthread_mutex_destroy(&shards[i].lock);
+		pthread_cond_destroy(&shards[i].cond);
+	}
+	free(shards);
+	shards = NULL;
+	return (0);
+}
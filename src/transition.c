@@ -0,0 +1,503 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "transition.h"
+#include "pbd.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Transition matrix of an enum variable.
+ */
+struct tm_var
+{
+	char *name;                /* Variable name.            */
+	int scope;                 /* Variable scope.           */
+	uint64_t mask;             /* Value mask, element size. */
+	int nstates;               /* States, '?' included.     */
+	uint64_t *values;          /* States values, sorted.    */
+	char **labels;             /* States enumerators.       */
+	uint64_t *counts;          /* Transitions, from*n + to. */
+	unsigned *lines;           /* First line, 0 if unknown. */
+	uint64_t changes;          /* Amount of transitions.    */
+};
+
+/* Matrices, indexed by dw_variable::trans. */
+static struct tm_var *tm_vars;
+static int tm_nvars;
+
+/* DOT graph file, if any. */
+static const char *tm_dot;
+
+/**
+ * @brief Compares two enumerator values, for qsort().
+ */
+static int tm_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Builds the states of @p t from the enumerators
+ * @p enums: one per distinct value (enumerators sharing
+ * the same value are labeled together, as in: a|b), plus
+ * the unknown state, always the first one.
+ *
+ * @param t Transition matrix.
+ * @param enums Enumerators list.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+static int tm_states(struct tm_var *t, struct array *enums)
+{
+	struct dw_enumerator *e; /* Enumerator.      */
+	size_t len;              /* Label length.    */
+	int n;                   /* Enumerators.     */
+	int s;                   /* Current state.   */
+
+	n = (int) array_size(&enums);
+	t->values = calloc(n + 1, sizeof(uint64_t));
+	t->labels = calloc(n + 1, sizeof(char *));
+	if (t->values == NULL || t->labels == NULL)
+		return (-1);
+
+	for (int i = 0; i < n; i++)
+	{
+		e = array_get(&enums, i, NULL);
+		t->values[i + 1] = e->value & t->mask;
+	}
+
+	/* Distinct values, sorted. */
+	qsort(t->values + 1, n, sizeof(uint64_t), tm_cmp);
+	t->nstates = 1;
+	for (int i = 1; i <= n; i++)
+		if (t->nstates == 1 || t->values[i] != t->values[t->nstates - 1])
+			t->values[t->nstates++] = t->values[i];
+
+	t->labels[0] = malloc(sizeof(char) * (strlen(TM_UNKNOWN) + 1));
+	if (t->labels[0] == NULL)
+		return (-1);
+	strcpy(t->labels[0], TM_UNKNOWN);
+
+	/* Labels, in declaration order. */
+	for (s = 1; s < t->nstates; s++)
+	{
+		len = 1;
+		for (int i = 0; i < n; i++)
+		{
+			e = array_get(&enums, i, NULL);
+			if ((e->value & t->mask) == t->values[s])
+				len += strlen(e->name) + 1;
+		}
+
+		if ((t->labels[s] = malloc(sizeof(char) * len)) == NULL)
+			return (-1);
+
+		t->labels[s][0] = '\0';
+		for (int i = 0; i < n; i++)
+		{
+			e = array_get(&enums, i, NULL);
+			if ((e->value & t->mask) != t->values[s])
+				continue;
+
+			if (t->labels[s][0] != '\0')
+				strcat(t->labels[s], "|");
+			strcat(t->labels[s], e->name);
+		}
+	}
+
+	t->counts = calloc((size_t)t->nstates * t->nstates, sizeof(uint64_t));
+	t->lines  = calloc((size_t)t->nstates * t->nstates, sizeof(unsigned));
+	if (t->counts == NULL || t->lines == NULL)
+		return (-1);
+
+	return (0);
+}
+
+/**
+ * @brief Initializes the transition matrices for the enum
+ * variables (and arrays of enums) of @p vars, of the first
+ * function context: since the contexts created afterwards copy
+ * these variables, all of them share the same matrices.
+ *
+ * The enumerators are read from the debug information, so this
+ * should be called before the DWARF context is released.
+ *
+ * @param dw Dwarf Utils structure pointer.
+ * @param vars Variables list.
+ * @param dot_file DOT graph file, or NULL if none.
+ *
+ * @return Returns 0 if success and a negative number otherwise.
+ */
+int tm_init(struct dw_utils *dw, struct array *vars, const char *dot_file)
+{
+	struct dw_variable *v; /* Current variable. */
+	struct array *enums;   /* Enumerators.      */
+	struct tm_var *t;      /* Matrix.           */
+	size_t size;           /* Element size.     */
+	int n;                 /* Variables amount. */
+
+	tm_dot = dot_file;
+
+	n = (int) array_size(&vars);
+	if (n && (tm_vars = calloc(n, sizeof(struct tm_var))) == NULL)
+		return (-1);
+
+	for (int i = 0; i < n; i++)
+	{
+		v = array_get(&vars, i, NULL);
+		v->trans = -1;
+
+		/* Bitmaps are reported as a whole, not as values. */
+		if (v->bitmap)
+			continue;
+
+		if (v->type.var_type == TENUM)
+			size = v->byte_size;
+		else if (v->type.var_type == TARRAY &&
+			v->type.array.var_type == TENUM)
+			size = v->type.array.size_per_element;
+		else
+			continue;
+
+		if (!size || size > sizeof(uint64_t) ||
+			(enums = dw_get_enumerators(dw, v->name)) == NULL)
+		{
+			fprintf(stderr, "PBD: --transitions: unable to read the "
+				"enumerators of %s, ignoring...\n", v->name);
+			continue;
+		}
+
+		t = &tm_vars[tm_nvars];
+		t->name = malloc(sizeof(char) * (strlen(v->name) + 1));
+		if (t->name == NULL)
+		{
+			dw_enumerators_free(enums);
+			return (-1);
+		}
+
+		strcpy(t->name, v->name);
+		t->scope = v->scope;
+		t->mask  = size == sizeof(uint64_t) ? UINT64_MAX :
+			(((uint64_t)1 << (size * 8)) - 1);
+
+		/* Counts the matrix even if it fails, so it is released. */
+		tm_nvars++;
+		if (tm_states(t, enums) < 0)
+		{
+			dw_enumerators_free(enums);
+			return (-1);
+		}
+
+		dw_enumerators_free(enums);
+		v->trans = tm_nvars - 1;
+	}
+
+	if (!tm_nvars)
+		fprintf(stderr, "PBD: --transitions: no enum variables found!\n");
+
+	return (0);
+}
+
+/**
+ * @brief Finds the state of the value @p value in @p t.
+ *
+ * @param t Transition matrix.
+ * @param value Variable value, already masked.
+ *
+ * @return Returns the state index, 0 (unknown) if the value
+ * matches no enumerator.
+ */
+static int tm_state(struct tm_var *t, uint64_t value)
+{
+	int lo, hi, mid;
+
+	lo = 1;
+	hi = t->nstates - 1;
+	while (lo <= hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (t->values[mid] == value)
+			return (mid);
+		else if (t->values[mid] < value)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return (0);
+}
+
+/**
+ * @brief Accounts the transition of the enum variable (or
+ * array element) @p v from @p v_before to @p v_after.
+ *
+ * @param v Changed variable.
+ * @param line_no Line number, 0 if unknown.
+ * @param v_before Value before.
+ * @param v_after Value after.
+ */
+void tm_update(struct dw_variable *v, unsigned line_no,
+	union var_value *v_before, union var_value *v_after)
+{
+	struct tm_var *t; /* Matrix.     */
+	size_t cell;      /* Transition. */
+	unsigned zero;    /* No line.    */
+
+	if (v->trans < 0 || v->trans >= tm_nvars)
+		return;
+
+	t = &tm_vars[v->trans];
+	cell = (size_t)tm_state(t, v_before->u64_value[0] & t->mask) * t->nstates +
+		tm_state(t, v_after->u64_value[0] & t->mask);
+
+	__atomic_add_fetch(&t->counts[cell], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&t->changes, 1, __ATOMIC_RELAXED);
+
+	/* First occurrence only. */
+	zero = 0;
+	if (line_no)
+		__atomic_compare_exchange_n(&t->lines[cell], &zero, line_no, 0,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Checks if the state @p s of @p t should be reported:
+ * the enumerators always are, the unknown state only if it
+ * was seen.
+ */
+static int tm_shown(struct tm_var *t, int s)
+{
+	if (s)
+		return (1);
+
+	for (int i = 0; i < t->nstates; i++)
+		if (t->counts[i] || t->counts[(size_t)i * t->nstates])
+			return (1);
+	return (0);
+}
+
+/**
+ * @brief Prints the transition matrix of @p t as a table, rows
+ * being the previous state and columns the new one, followed by
+ * the list of transitions seen.
+ *
+ * @param out Output file.
+ * @param t Transition matrix.
+ */
+static void tm_report_table(FILE *out, struct tm_var *t)
+{
+	static const char corner[] = "from \\ to"; /* Header.       */
+	char count[24];                            /* Count string. */
+	int *width;                                /* Column width. */
+	int first;                                 /* Rows width.   */
+	size_t cell;                               /* Transition.   */
+	int len;
+
+	if ((width = calloc(t->nstates, sizeof(int))) == NULL)
+		return;
+
+	first = (int) strlen(corner);
+	for (int s = 0; s < t->nstates; s++)
+	{
+		width[s] = (int) strlen(t->labels[s]);
+		if (width[s] > first)
+			first = width[s];
+
+		for (int f = 0; f < t->nstates; f++)
+		{
+			len = snprintf(count, sizeof(count), "%" PRIu64,
+				t->counts[(size_t)f * t->nstates + s]);
+			if (len > width[s])
+				width[s] = len;
+		}
+	}
+
+	/* Header. */
+	fprintf(out, "    %-*s", first, corner);
+	for (int s = 0; s < t->nstates; s++)
+		if (tm_shown(t, s))
+			fprintf(out, " | %*s", width[s], t->labels[s]);
+	fprintf(out, "\n    ");
+	for (int i = 0; i < first; i++)
+		fputc('-', out);
+	for (int s = 0; s < t->nstates; s++)
+	{
+		if (!tm_shown(t, s))
+			continue;
+		fputs("-+-", out);
+		for (int i = 0; i < width[s]; i++)
+			fputc('-', out);
+	}
+	fputc('\n', out);
+
+	/* Rows. */
+	for (int f = 0; f < t->nstates; f++)
+	{
+		if (!tm_shown(t, f))
+			continue;
+
+		fprintf(out, "    %-*s", first, t->labels[f]);
+		for (int s = 0; s < t->nstates; s++)
+		{
+			if (!tm_shown(t, s))
+				continue;
+
+			cell = (size_t)f * t->nstates + s;
+			if (t->counts[cell])
+				fprintf(out, " | %*" PRIu64, width[s], t->counts[cell]);
+			else
+				fprintf(out, " | %*s", width[s], ".");
+		}
+		fputc('\n', out);
+	}
+
+	/* Transitions seen. */
+	fputc('\n', out);
+	for (int f = 0; f < t->nstates; f++)
+	{
+		for (int s = 0; s < t->nstates; s++)
+		{
+			cell = (size_t)f * t->nstates + s;
+			if (!t->counts[cell])
+				continue;
+
+			fprintf(out, "    %s -> %s: %" PRIu64, t->labels[f], t->labels[s],
+				t->counts[cell]);
+			if (t->lines[cell])
+				fprintf(out, ", first at line %u", t->lines[cell]);
+			fputc('\n', out);
+		}
+	}
+	free(width);
+}
+
+/**
+ * @brief Writes the transition matrix of @p t as a DOT
+ * subgraph: a node per state and an edge per transition seen,
+ * labeled with its count and first line.
+ *
+ * @param fp DOT file.
+ * @param t Transition matrix.
+ * @param idx Matrix index, to keep the node names unique.
+ */
+static void tm_write_dot(FILE *fp, struct tm_var *t, int idx)
+{
+	size_t cell; /* Transition. */
+
+	fprintf(fp, "\tsubgraph cluster_%d {\n", idx);
+	fprintf(fp, "\t\tlabel = \"[%s] %s: %" PRIu64 " transitions\";\n",
+		(t->scope == VGLOBAL ? "global" : "local"), t->name, t->changes);
+
+	for (int s = 0; s < t->nstates; s++)
+		if (tm_shown(t, s))
+			fprintf(fp, "\t\tv%d_s%d [label = \"%s\"];\n", idx, s,
+				t->labels[s]);
+
+	for (int f = 0; f < t->nstates; f++)
+	{
+		for (int s = 0; s < t->nstates; s++)
+		{
+			cell = (size_t)f * t->nstates + s;
+			if (!t->counts[cell])
+				continue;
+
+			fprintf(fp, "\t\tv%d_s%d -> v%d_s%d [label = \"%" PRIu64,
+				idx, f, idx, s, t->counts[cell]);
+			if (t->lines[cell])
+				fprintf(fp, " (line %u)", t->lines[cell]);
+			fprintf(fp, "\"];\n");
+		}
+	}
+	fprintf(fp, "\t}\n");
+}
+
+/**
+ * @brief Writes the transition matrices of all the enum
+ * variables, and the DOT graph, if requested.
+ *
+ * @param out Output file.
+ */
+void tm_report(FILE *out)
+{
+	struct tm_var *t; /* Matrix.   */
+	FILE *fp;         /* DOT file. */
+
+	fprintf(out, "\nEnum transitions:\n");
+	for (int i = 0; i < tm_nvars; i++)
+	{
+		t = &tm_vars[i];
+		fprintf(out, "  [%s] (%s): %" PRIu64 " transitions\n",
+			(t->scope == VGLOBAL ? "global" : "local"), t->name, t->changes);
+
+		if (t->changes)
+			tm_report_table(out, t);
+	}
+
+	if (tm_dot != NULL)
+	{
+		if ((fp = fopen(tm_dot, "w")) == NULL)
+			fprintf(stderr, "PBD: --transitions-dot: unable to create %s\n",
+				tm_dot);
+		else
+		{
+			fprintf(fp, "digraph transitions {\n");
+			for (int i = 0; i < tm_nvars; i++)
+				tm_write_dot(fp, &tm_vars[i], i);
+			fprintf(fp, "}\n");
+			fclose(fp);
+			fprintf(out, "  graph: %s\n", tm_dot);
+		}
+	}
+	fprintf(out, "\n");
+}
+
+/**
+ * @brief Deallocates the transition matrices.
+ */
+void tm_finish(void)
+{
+	struct tm_var *t;
+
+	for (int i = 0; i < tm_nvars; i++)
+	{
+		t = &tm_vars[i];
+		for (int s = 0; t->labels != NULL && s < t->nstates; s++)
+			free(t->labels[s]);
+
+		free(t->name);
+		free(t->labels);
+		free(t->values);
+		free(t->counts);
+		free(t->lines);
+	}
+
+	free(tm_vars);
+	tm_vars = NULL;
+	tm_nvars = 0;
+}
@@ -28,7 +28,17 @@
 #include "dwarf_helper.h"
 #include "ptrace.h"
 #include "function.h"
+#include "heatmap.h"
+#include "keyframe.h"
 #include "line.h"
+#include "verify.h"
+#include "probes.h"
+#include "plugin.h"
+#include "pbd_plugin.h"
+#include "summary.h"
+#include "transition.h"
+#include "loop.h"
+#include "strdiff.h"
 
 /* Offset memcmp pointer. */
 int64_t (*offmemcmp)(
@@ -306,6 +316,7 @@ int var_new_context(
 	 */
 	array_add(&ctx_list, *curr_ctx);
 
+	PBD_PROBE1(context_push, (int)array_size(&ctx_list));
 	return (0);
 }
 
@@ -351,6 +362,7 @@ int var_deallocate_context(
 	{
 		array_finish(&vars);
 		free( array_remove_last(&context, NULL) );
+		PBD_PROBE1(context_pop, depth - 1);
 	}
 
 	return (0);
@@ -370,6 +382,8 @@ int var_read(union var_value *value, struct dw_variable *v, pid_t child)
 	uintptr_t base_pointer; /* Base Pointer Value.            */
 	uintptr_t location;     /* Base Pointer Relative Address. */
 
+	PBD_PROBE3(var_read_start, child, v->name, v->byte_size);
+
 	/*
 	 * If a primitive type, read a u64 should be
 	 * enough, otherwise, read an arbitrary amount
@@ -396,7 +410,7 @@ int var_read(union var_value *value, struct dw_variable *v, pid_t child)
 					value->u64_value[1] = pt_readmemory64(child, v->location.address + 8);
 				}
 				else
-					return (-1);
+					goto err;
 			}
 		}
 
@@ -419,7 +433,7 @@ int var_read(union var_value *value, struct dw_variable *v, pid_t child)
 					value->u64_value[1] = pt_readmemory64(child, location + 8);
 				}
 				else
-					return (-1);
+					goto err;
 			}
 		}
 	}
@@ -449,14 +463,19 @@ int var_read(union var_value *value, struct dw_variable *v, pid_t child)
 		}
 
 		else
-			return (-1);
+			goto err;
 	}
 
 	/* TODO: Implement the other cases here. */
 	else
-		return (-1);
+		goto err;
 
+	PBD_PROBE3(var_read_end, child, v->name, v->byte_size);
 	return (0);
+err:
+	/* Paired with the start anyway, with a negative size. */
+	PBD_PROBE3(var_read_end, child, v->name, -1);
+	return (-1);
 }
 
 /**
@@ -543,6 +562,63 @@ void var_initialize(struct array *vars, pid_t child)
 	}
 }
 
+/**
+ * @brief Reports a variable change, using the current printer.
+ *
+ * @param child Child process.
+ * @param depth Function depth.
+ * @param line_no Line number.
+ * @param v Changed variable.
+ * @param v_before Value before.
+ * @param v_after Value after.
+ * @param array_idxs Element indexes, if array, NULL otherwise.
+ */
+static inline void var_report_change(pid_t child, int depth,
+	unsigned line_no, struct dw_variable *v, union var_value *v_before,
+	union var_value *v_after, int *array_idxs)
+{
+	PBD_PROBE3(var_change, line_no, v->name, v->byte_size);
+
+	/* Let the verification know what the fast path has found. */
+	if (args.flags & FLG_VERIFY)
+		vf_note(v, line_no, v_after, array_idxs);
+
+	/* Statistics-only mode: just account the change. */
+	if (args.flags & FLG_SUMMARY)
+	{
+		sm_update(v, v_after);
+		return;
+	}
+
+	/* Enum transitions mode: same as above. */
+	if (args.flags & FLG_TRANSITIONS)
+	{
+		tm_update(v, line_no, v_before, v_after);
+		return;
+	}
+
+	/*
+	 * Plugins may suppress the change. Bitmap arrays and strings are
+	 * reported as a whole, without element indexes, so they are not
+	 * seen by plugins.
+	 */
+	if ((args.flags & FLG_PLUGIN) &&
+		!((v->bitmap || v->string) && v->type.var_type == TARRAY) &&
+		plugin_change(child, depth, line_no, v,
+		v_before, v_after, array_idxs) == PBD_PLUGIN_SUPPRESS)
+		return;
+
+	/* Changes inside loops are reported when the loop exits. */
+	if ((args.flags & FLG_LOOP_SUMMARY) &&
+		lp_change(v, depth, line_no, v_before, v_after, array_idxs))
+		return;
+
+	if (args.flags & FLG_KEYFRAMES)
+		kf_event();
+
+	line_output(depth, line_no, v, v_before, v_after, array_idxs);
+}
+
 /**
  * @brief Checks if there is a change for all variables
  * in the current context, if so, updates its value and
@@ -553,13 +629,18 @@ void var_initialize(struct array *vars, pid_t child)
  * @param child Child process.
  * @param depth Function depth.
  *
+ * @return Returns the amount of changes found.
+ *
  * @TODO: Check variable change for other types, other than
  * TBASE_TYPE, TENUM and TPOINTER.
  */
-void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, int depth)
+int var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, int depth)
 {
 	union var_value value;                                /* Variable value.      */
 	int index_per_dimension[MATRIX_MAX_DIMENSIONS] = {0}; /* Index per dimension. */
+	int changes;                                          /* Amount of changes.   */
+
+	changes = 0;
 
 	/* For each variable. */
 	for (int i = 0; i < (int) array_size(&vars); i++)
@@ -593,8 +674,9 @@ void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, in
 						v->scratch_value.ld_value = 0.0;
 
 					/* Output changes using the current printer. */
-					line_output(depth, b->line_no, v, &v->scratch_value, &value, NULL);
+					var_report_change(child, depth, b->line_no, v, &v->scratch_value, &value, NULL);
 					v->initialized = 1;
+					changes++;
 				}
 				continue;
 			}
@@ -603,7 +685,8 @@ void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, in
 			if (memcmp(&value.u64_value, &v->value.u64_value, v->byte_size))
 			{
 				/* Output changes using the current printer. */
-				line_output(depth, b->line_no, v, &v->value, &value, NULL);
+				var_report_change(child, depth, b->line_no, v, &v->value, &value, NULL);
+				changes++;
 
 				v->value.u64_value[0] = value.u64_value[0];
 				v->value.u64_value[1] = value.u64_value[1];
@@ -628,9 +711,47 @@ void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, in
 				int64_t byte_offset;     /* Byte offset.      */
 				size_t size;
 
+				/* Large arrays are compared in a snapshot, see ss_start(). */
+				if (v->offload)
+					continue;
+
 				/* Read and compares its value. */
 				var_read(&value, v, child);
 
+				/*
+				 * Bitmaps are reported at once, with all the bits changed,
+				 * and strings, with the whole string.
+				 */
+				if (v->bitmap || v->string)
+				{
+					if (offmemcmp(v->value.p_value, value.p_value, 1,
+						v->byte_size) >= 0)
+					{
+						/* Only past the NUL: same string, just keep it. */
+						if (v->string && !sd_changed(v->value.p_value,
+							value.p_value, v->byte_size))
+						{
+							free(v->value.p_value);
+							v->value.p_value = value.p_value;
+							continue;
+						}
+
+						if (args.flags & FLG_HEATMAP)
+							hm_update_range(v, v->value.p_value, value.p_value, 0,
+								v->byte_size);
+
+						var_report_change(child, depth, b->line_no, v, &v->value,
+							&value, NULL);
+						changes++;
+
+						free(v->value.p_value);
+						v->value.p_value = value.p_value;
+					}
+					else
+						free(value.p_value);
+					continue;
+				}
+
 				/* Setup pointers and data. */
 				v1 = (char *)v->value.p_value;
 				v2 = (char *)value.p_value;
@@ -647,6 +768,7 @@ void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, in
 					union var_value value1;
 					union var_value value2;
 					changed = 1;
+					changes++;
 
 					cmp1 += byte_offset;
 					cmp2 += byte_offset;
@@ -658,13 +780,16 @@ void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, in
 					memcpy(value1.u8_value, cmp1, size_per_element);
 					memcpy(value2.u8_value, cmp2, size_per_element);
 
+					if (args.flags & FLG_HEATMAP)
+						hm_update(v, (cmp1 - v1) / size_per_element);
+
 					/* If one dimension. */
 					if (v->type.array.dimensions == 1)
 					{
 						index_per_dimension[0] = (cmp1 - v1) / size_per_element;
 
 						/* Output changes using the current printer. */
-						line_output(depth, b->line_no, v, &value1, &value2,
+						var_report_change(child, depth, b->line_no, v, &value1, &value2,
 							index_per_dimension);
 					}
 
@@ -688,7 +813,7 @@ void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, in
 						}
 
 						/* Output changes using the current printer. */
-						line_output(depth, b->line_no, v, &value1, &value2,
+						var_report_change(child, depth, b->line_no, v, &value1, &value2,
 							index_per_dimension);
 					}
 
@@ -715,6 +840,8 @@ void var_check_changes(struct breakpoint *b, struct array *vars, pid_t child, in
 			}
 		}
 	}
+
+	return (changes);
 }
 
 /**
@@ -0,0 +1,433 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Davidson Francis <davidsondfgl@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "verify.h"
+#include "pbd.h"
+#include "tracepoint.h"
+#include "variable.h"
+#include "line.h"
+#include "strdiff.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+/* FNV-1a, 64-bit. */
+#define VF_HASH_INIT  UINT64_C(0xcbf29ce484222325)
+#define VF_HASH_PRIME UINT64_C(0x100000001b3)
+
+/* Element index of base types, bitmaps and strings. */
+#define VF_NO_INDEX SIZE_MAX
+
+/**
+ * @brief Verification state for a single variable.
+ *
+ * Besides the amount of changes, the exact engine and the
+ * fast path hash each change found, in order, i.e: its line,
+ * element index and new value, so that a change reported in
+ * the wrong line, element or with the wrong value is also
+ * noticed.
+ */
+struct vf_var
+{
+	size_t expected;        /* Changes found by the exact engine. */
+	size_t reported;        /* Changes reported by the fast path. */
+	uint64_t expected_hash; /* Changes hash, exact engine.        */
+	uint64_t reported_hash; /* Changes hash, fast path.           */
+	size_t first;           /* First changed element, if array.   */
+	union var_value before; /* Previous value, if base type.      */
+	union var_value after;  /* Current value, if base type.       */
+	int skip;               /* Variable not verified.             */
+};
+
+/* Sampling rate, i.e: 1 out of vf_rate stops. */
+static int vf_rate;
+static int vf_random;
+
+/* Statistics. */
+static uint64_t vf_stops;
+static uint64_t vf_verified;
+static uint64_t vf_discrepancies;
+
+/* Random sampling seed, per tracer thread. */
+static PBD_TLS uint32_t vf_seed;
+
+/* Stop being verified, per tracer thread. */
+static PBD_TLS struct
+{
+	int active;            /* Verification in progress. */
+	unsigned line_no;      /* Line being checked.       */
+	uint64_t stop;         /* Stop number.              */
+	pid_t child;           /* Stopped thread.           */
+	struct array *vars;    /* Variables list.           */
+	struct vf_var *state;  /* State, per variable.      */
+} vf;
+
+/**
+ * @brief Initializes the verification mode.
+ *
+ * @param rate Sampling rate, 1 out of @p rate stops are
+ * verified.
+ * @param random If set, the stops are randomly sampled
+ * (with probability 1/rate) instead of every rate-th stop.
+ */
+void vf_init(int rate, int random)
+{
+	vf_rate = rate > 0 ? rate : 1;
+	vf_random = random;
+	vf_stops = 0;
+	vf_verified = 0;
+	vf_discrepancies = 0;
+}
+
+/**
+ * @brief Xorshift32 random generator.
+ *
+ * @return Returns a new pseudo-random number.
+ */
+static uint32_t vf_rand(void)
+{
+	if (vf_seed == 0)
+		vf_seed = ((uint32_t)time(NULL) ^ (uint32_t)(uintptr_t)&vf) | 1;
+
+	vf_seed ^= vf_seed << 13;
+	vf_seed ^= vf_seed >> 17;
+	vf_seed ^= vf_seed << 5;
+	return (vf_seed);
+}
+
+/**
+ * @brief Adds a single change, i.e: its line, element index
+ * and new value, into the hash @p hash.
+ *
+ * @param hash Current hash.
+ * @param line_no Line number.
+ * @param idx Element index, or VF_NO_INDEX.
+ * @param value New value.
+ * @param len Value length.
+ *
+ * @return Returns the new hash.
+ */
+static uint64_t vf_hash(uint64_t hash, unsigned line_no, size_t idx,
+	const void *value, size_t len)
+{
+	const uint8_t *p; /* Current byte. */
+
+	p = (const uint8_t *)&line_no;
+	for (size_t i = 0; i < sizeof(line_no); i++)
+		hash = (hash ^ p[i]) * VF_HASH_PRIME;
+
+	p = (const uint8_t *)&idx;
+	for (size_t i = 0; i < sizeof(idx); i++)
+		hash = (hash ^ p[i]) * VF_HASH_PRIME;
+
+	p = value;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ p[i]) * VF_HASH_PRIME;
+
+	return (hash);
+}
+
+/**
+ * @brief Counts a new stop and decides if it should be
+ * verified or not.
+ *
+ * @return Returns 1 if the stop should be verified, 0
+ * otherwise.
+ */
+int vf_sample(void)
+{
+	uint64_t stop; /* Stop number. */
+
+	stop = __atomic_add_fetch(&vf_stops, 1, __ATOMIC_RELAXED);
+	vf.stop = stop;
+
+	if (vf_random)
+		return ((vf_rand() % vf_rate) == 0);
+
+	return ((stop % vf_rate) == 0);
+}
+
+/**
+ * @brief Runs the exact engine over all the variables, right
+ * before the fast path checks the line @p bp.
+ *
+ * @param bp Line being checked.
+ * @param vars Variables list, current context.
+ * @param child Stopped thread.
+ */
+void vf_begin(struct breakpoint *bp, struct array *vars, pid_t child)
+{
+	size_t nvars; /* Amount of variables. */
+
+	nvars = array_size(&vars);
+	vf.state = calloc(nvars ? nvars : 1, sizeof(struct vf_var));
+	vf.line_no = bp->line_no;
+	vf.child = child;
+	vf.vars = vars;
+	vf.active = 1;
+
+	__atomic_add_fetch(&vf_verified, 1, __ATOMIC_RELAXED);
+
+	for (size_t i = 0; i < nvars; i++)
+	{
+		struct dw_variable *v;
+		struct vf_var *s;
+
+		v = array_get(&vars, i, NULL);
+		s = &vf.state[i];
+		s->expected_hash = VF_HASH_INIT;
+		s->reported_hash = VF_HASH_INIT;
+
+		/*
+		 * Other threads may change the globals between the exact
+		 * engine and the fast path, so they are not verified.
+		 */
+		if (args.threads && v->scope == VGLOBAL)
+		{
+			s->skip = 1;
+			continue;
+		}
+
+		/* Base types. */
+		if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+		{
+			union var_value *prev;
+			prev = v->initialized ? &v->value : &v->scratch_value;
+
+			if (var_read(&s->after, v, child))
+			{
+				s->skip = 1;
+				continue;
+			}
+
+			s->before = *prev;
+			if (memcmp(s->after.u8_value, prev->u8_value, v->byte_size))
+			{
+				s->expected = 1;
+				s->expected_hash = vf_hash(s->expected_hash, vf.line_no,
+					VF_NO_INDEX, s->after.u8_value, v->byte_size);
+			}
+		}
+
+		/* Arrays, element by element. */
+		else if (v->type.var_type == TARRAY &&
+			(v->type.array.var_type & (TBASE_TYPE|TENUM|TPOINTER)))
+		{
+			union var_value now;
+			size_t size_per_element;
+			char *old_buf, *new_buf;
+
+			if (v->value.p_value == NULL || var_read(&now, v, child) ||
+				now.p_value == NULL)
+			{
+				s->skip = 1;
+				continue;
+			}
+
+			size_per_element = v->type.array.size_per_element;
+			old_buf = v->value.p_value;
+			new_buf = now.p_value;
+
+			for (size_t off = 0; off + size_per_element <= v->byte_size;
+				off += size_per_element)
+			{
+				if (memcmp(old_buf + off, new_buf + off, size_per_element))
+				{
+					if (!s->expected)
+						s->first = off / size_per_element;
+					s->expected++;
+
+					s->expected_hash = vf_hash(s->expected_hash, vf.line_no,
+						off / size_per_element, new_buf + off, size_per_element);
+				}
+			}
+
+			/*
+			 * Bitmaps and strings are reported once, regardless
+			 * the elements, with the whole array.
+			 */
+			if ((v->bitmap || v->string) && s->expected)
+			{
+				/* Only past the NUL: same string, not reported. */
+				if (v->string && !sd_changed(old_buf, new_buf, v->byte_size))
+				{
+					s->expected = 0;
+					s->expected_hash = VF_HASH_INIT;
+					free(now.p_value);
+					continue;
+				}
+
+				s->expected = 1;
+				s->expected_hash = vf_hash(VF_HASH_INIT, vf.line_no,
+					VF_NO_INDEX, new_buf, v->byte_size);
+			}
+			free(now.p_value);
+		}
+		else
+			s->skip = 1;
+	}
+}
+
+/**
+ * @brief Notes a change reported by the fast path.
+ *
+ * @param v Changed variable.
+ * @param line_no Line number.
+ * @param v_after Value after.
+ * @param array_idxs Element indexes, if array, NULL otherwise.
+ */
+void vf_note(struct dw_variable *v, unsigned line_no,
+	union var_value *v_after, int *array_idxs)
+{
+	struct vf_var *s;  /* Variable state. */
+	const void *value; /* New value.      */
+	size_t len;        /* Value length.   */
+	size_t idx;        /* Element index.  */
+
+	if (!vf.active)
+		return;
+
+	for (size_t i = 0; i < array_size(&vf.vars); i++)
+	{
+		if (array_get(&vf.vars, i, NULL) != v)
+			continue;
+
+		s = &vf.state[i];
+		s->reported++;
+
+		/* Whole variable: base types, bitmaps and strings. */
+		idx   = VF_NO_INDEX;
+		value = v_after->u8_value;
+		len   = v->byte_size;
+
+		if (v->type.var_type == TARRAY)
+		{
+			if (array_idxs != NULL)
+			{
+				idx = 0;
+				for (int j = 0; j < v->type.array.dimensions; j++)
+					idx = idx * v->type.array.elements_per_dimension[j] +
+						array_idxs[j];
+				len = v->type.array.size_per_element;
+			}
+			else
+				value = v_after->p_value;
+		}
+
+		s->reported_hash = vf_hash(s->reported_hash, line_no, idx,
+			value, len);
+		break;
+	}
+}
+
+/**
+ * @brief Compares the changes found by the exact engine with
+ * the ones reported by the fast path, and reports any
+ * discrepancy.
+ */
+void vf_end(void)
+{
+	char before[BS]; /* Formatted before. */
+	char after[BS];  /* Formatted after.  */
+
+	if (!vf.active)
+		return;
+
+	for (size_t i = 0; i < array_size(&vf.vars); i++)
+	{
+		struct dw_variable *v;
+		struct vf_var *s;
+
+		v = array_get(&vf.vars, i, NULL);
+		s = &vf.state[i];
+
+		if (s->skip || (s->expected == s->reported &&
+			s->expected_hash == s->reported_hash))
+		{
+			continue;
+		}
+
+		__atomic_add_fetch(&vf_discrepancies, 1, __ATOMIC_RELAXED);
+
+		fprintf(stderr, "PBD: verify: discrepancy at line %u, stop #%" PRIu64
+			" (tid: %d)\n", vf.line_no, vf.stop, (int)vf.child);
+		fprintf(stderr, "    variable: %s (%s), exact engine: %zu change(s), "
+			"fast path: %zu change(s)%s\n", v->name,
+			(v->scope == VGLOBAL) ? "global" : "local",
+			s->expected, s->reported, (s->expected == s->reported) ?
+			", with a different line, element or value" : "");
+
+		if (v->type.var_type & (TBASE_TYPE|TENUM|TPOINTER))
+		{
+			fprintf(stderr, "    exact engine: before: %s, after: %s\n",
+				var_format_value(before, &s->before, v->type.encoding,
+					v->byte_size),
+				var_format_value(after, &s->after, v->type.encoding,
+					v->byte_size));
+		}
+		else if (s->expected)
+			fprintf(stderr, "    exact engine: first changed element: #%zu\n",
+				s->first);
+	}
+
+	free(vf.state);
+	vf.state = NULL;
+	vf.active = 0;
+}
+
+/**
+ * @brief Checks if the fast tracepoints shadow copy, i.e: the
+ * values the injected checker compares against, matches the
+ * values known by PBD.
+ *
+ * @param bp Line being checked.
+ * @param vars Variables list, current context.
+ * @param child Stopped thread.
+ */
+void vf_check_shadow(struct breakpoint *bp, struct array *vars, pid_t child)
+{
+	struct dw_variable *v; /* Mismatched variable. */
+	int idx;               /* Variable index.      */
+
+	if ((idx = tp_check_shadow(child, vars)) < 0)
+		return;
+
+	v = array_get(&vars, idx, NULL);
+	__atomic_add_fetch(&vf_discrepancies, 1, __ATOMIC_RELAXED);
+
+	fprintf(stderr, "PBD: verify: discrepancy at line %u, stop #%" PRIu64
+		" (tid: %d)\n", bp ? bp->line_no : 0, vf.stop, (int)child);
+	fprintf(stderr, "    variable: %s, fast tracepoints shadow copy out "
+		"of sync\n", v->name);
+}
+
+/**
+ * @brief Prints the verification summary.
+ */
+void vf_finish(void)
+{
+	fprintf(stderr, "PBD: verify: %" PRIu64 " stops, %" PRIu64 " verified, %"
+		PRIu64 " discrepancies\n", vf_stops, vf_verified, vf_discrepancies);
+}